@@ -0,0 +1,362 @@
+// guru-opcode-bench : measures host time per 68000 instruction, with no Amiga involved.
+//
+// Every opcode word is decoded once to find which kEncodingList entry it belongs to. One
+// representative opcode is kept for each combination of entry, size field and effective
+// address modes, and each is then timed against flat ram. Decode and execute are timed
+// separately by subtracting the cost of a loop that only decodes.
+
+#include "Amiga/68000.h"
+#include "Amiga/disassembler.h"
+
+#include "3rd Party/cxxopts.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t kCodeAddr = 0x2000;
+	constexpr uint32_t kHandlerAddr = 0x3000;
+	constexpr uint32_t kSupervisorStack = 0x8000;
+	constexpr uint32_t kUserStack = 0x9000;
+
+	// Used for every extension word so displacements, immediates and absolute addresses are
+	// small, even and non-zero (no divide by zero).
+	constexpr uint16_t kExtensionWord = 0x0004;
+	constexpr int kMaxExtensionWords = 4;
+
+	class FlatRam : public cpu::IBus, public am::IMemory
+	{
+	public:
+		FlatRam()
+			: m_ram(16 * 1024 * 1024, 0)
+		{
+			// Point every exception vector at the same (unused) handler.
+			for (uint32_t v = 2; v < 256; v++)
+			{
+				WriteBusWord(v * 4, uint16_t(kHandlerAddr >> 16));
+				WriteBusWord(v * 4 + 2, uint16_t(kHandlerAddr));
+			}
+		}
+
+		void SetInstruction(uint16_t opcode)
+		{
+			WriteBusWord(kCodeAddr, opcode);
+			for (int i = 1; i <= kMaxExtensionWords; i++)
+				WriteBusWord(kCodeAddr + i * 2, kExtensionWord);
+		}
+
+		virtual uint16_t ReadBusWord(uint32_t addr) override
+		{
+			addr &= 0xfffffe;
+			return uint16_t((m_ram[addr] << 8) | m_ram[addr + 1]);
+		}
+
+		virtual void WriteBusWord(uint32_t addr, uint16_t value) override
+		{
+			addr &= 0xfffffe;
+			m_ram[addr] = uint8_t(value >> 8);
+			m_ram[addr + 1] = uint8_t(value);
+		}
+
+		virtual uint8_t ReadBusByte(uint32_t addr) override
+		{
+			return m_ram[addr & 0xffffff];
+		}
+
+		virtual void WriteBusByte(uint32_t addr, uint8_t value) override
+		{
+			m_ram[addr & 0xffffff] = value;
+		}
+
+		virtual uint16_t GetWord(uint32_t addr) const override
+		{
+			addr &= 0xfffffe;
+			return uint16_t((m_ram[addr] << 8) | m_ram[addr + 1]);
+		}
+
+		virtual uint8_t GetByte(uint32_t addr) const override
+		{
+			return m_ram[addr & 0xffffff];
+		}
+
+	private:
+		std::vector<uint8_t> m_ram;
+	};
+
+	cpu::Registers InitialRegisters()
+	{
+		cpu::Registers regs = {};
+		for (int i = 0; i < 8; i++)
+		{
+			regs.d[i] = uint32_t(i + 1);
+			regs.a[i] = 0x10000 + i * 0x1000;
+		}
+		regs.a[7] = kSupervisorStack;
+		regs.altA7 = kUserStack;
+		regs.pc = kCodeAddr;
+		regs.status = 0x2700;
+		return regs;
+	}
+
+	// Groups the 64 effective address encodings into the 12 addressing modes.
+	int EaMode(int ea)
+	{
+		const int mode = (ea >> 3) & 7;
+		return (mode == 7) ? 7 + (ea & 7) : mode;
+	}
+
+	struct Case
+	{
+		uint16_t opcode = 0;
+		uint32_t entry = 0;
+		std::string text;
+		double decodeNs = 0.0;
+		double executeNs = 0.0;
+		bool implemented = true;
+	};
+
+	std::vector<Case> FindCases(FlatRam& ram, cpu::M68000& cpu, const cpu::Registers& regs)
+	{
+		std::map<std::tuple<uint32_t, int, int, int>, Case> cases;
+
+		for (uint32_t op = 0; op < 0x10000; op++)
+		{
+			const auto opcode = uint16_t(op);
+			ram.SetInstruction(opcode);
+			cpu.SetRegisters(regs);
+
+			int delay = 0;
+			cpu.DecodeOneInstruction(delay);
+
+			const auto entry = cpu.GetCurrentInstructionIndex();
+			if (entry >= cpu::kNumOpcodeEntries)
+				continue;
+
+			// move encodes its destination in bits 6-11 so use that as a second address mode.
+			const bool isMove = (opcode & 0xc000) == 0 && (opcode & 0x3000) != 0;
+			const int srcMode = EaMode(opcode & 0x3f);
+			const int dstMode = isMove ? EaMode(((opcode >> 9) & 7) | ((opcode >> 3) & 0x38)) : 0;
+			const int sizeField = isMove ? 0 : (opcode >> 6) & 3;
+
+			auto [it, inserted] = cases.try_emplace({ entry, sizeField, srcMode, dstMode });
+			if (inserted)
+			{
+				am::Disassembler disassembler(&ram);
+				disassembler.pc = kCodeAddr;
+
+				it->second.opcode = opcode;
+				it->second.entry = entry;
+				it->second.text = disassembler.Disassemble().text;
+			}
+		}
+
+		std::vector<Case> result;
+		for (auto& [key, c] : cases)
+			result.push_back(std::move(c));
+		return result;
+	}
+
+	template <typename F>
+	double TimeNs(int iterations, int repeats, F&& f)
+	{
+		double best = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < iterations; i++)
+			{
+				f();
+			}
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			const double perIteration = elapsed.count() / iterations;
+			best = (r == 0) ? perIteration : std::min(best, perIteration);
+		}
+		return best;
+	}
+
+	void MeasureCase(Case& c, FlatRam& ram, cpu::M68000& cpu, const cpu::Registers& regs, int iterations, int repeats)
+	{
+		ram.SetInstruction(c.opcode);
+
+		int delay = 0;
+
+		const double restoreNs = TimeNs(iterations, repeats, [&]()
+		{
+			cpu.SetRegisters(regs);
+		});
+
+		const double decodeNs = TimeNs(iterations, repeats, [&]()
+		{
+			cpu.SetRegisters(regs);
+			cpu.DecodeOneInstruction(delay);
+		});
+
+		bool implemented = true;
+		const double executeNs = TimeNs(iterations, repeats, [&]()
+		{
+			cpu.SetRegisters(regs);
+			cpu.DecodeOneInstruction(delay);
+			implemented &= cpu.ExecuteOneInstruction(delay);
+		});
+
+		c.decodeNs = std::max(decodeNs - restoreNs, 0.0);
+		c.executeNs = std::max(executeNs - decodeNs, 0.0);
+		c.implemented = implemented;
+	}
+
+	std::string EscapeJson(const std::string& s)
+	{
+		std::string out;
+		for (char c : s)
+		{
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += c;
+			}
+			else if (uint8_t(c) < 0x20)
+			{
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+				out += escaped;
+			}
+			else
+			{
+				out += c;
+			}
+		}
+		return out;
+	}
+
+	void WriteJson(FILE* f, const std::vector<Case>& cases)
+	{
+		fprintf(f, "[");
+		for (size_t i = 0; i < cases.size(); i++)
+		{
+			const auto& c = cases[i];
+			fprintf(f, "%s\n  { \"entry\": %u, \"opcode\": \"%04x\", \"text\": \"%s\", \"implemented\": %s, \"decode_ns\": %.2f, \"execute_ns\": %.2f }",
+				i == 0 ? "" : ",", c.entry, c.opcode, EscapeJson(c.text).c_str(), c.implemented ? "true" : "false", c.decodeNs, c.executeNs);
+		}
+		fprintf(f, "\n]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 2000;
+	int repeats = 5;
+	int onlyEntry = -1;
+	bool showAll = false;
+	std::string jsonFile;
+
+	cxxopts::Options options("guru-opcode-bench", "68000 per-opcode microbenchmarks");
+	options.add_options()
+		("i,iterations", "iterations per timing loop", cxxopts::value<int>()->default_value("2000"))
+		("n,repeats", "timing loops per measurement (fastest is kept)", cxxopts::value<int>()->default_value("5"))
+		("e,entry", "only measure this kEncodingList entry", cxxopts::value<int>()->default_value("-1"))
+		("a,all", "list every measured variant rather than a per-entry summary")
+		("json", "write every measured variant to this JSON file", cxxopts::value<std::string>()->default_value(""))
+		("h,help", "show help");
+
+	try
+	{
+		auto result = options.parse(argc, argv);
+		if (result.count("help"))
+		{
+			printf("%s\n", options.help().c_str());
+			return 0;
+		}
+
+		iterations = result["iterations"].as<int>();
+		repeats = result["repeats"].as<int>();
+		onlyEntry = result["entry"].as<int>();
+		showAll = result.count("all") != 0;
+		jsonFile = result["json"].as<std::string>();
+	}
+	catch (cxxopts::OptionParseException& e)
+	{
+		printf("Error : %s\n\n", e.what());
+		printf("%s\n", options.help().c_str());
+		return -1;
+	}
+
+	if (iterations < 1 || repeats < 1)
+	{
+		printf("%s\n", options.help().c_str());
+		return -1;
+	}
+
+	FlatRam ram;
+	cpu::M68000 cpu(&ram);
+	const auto regs = InitialRegisters();
+
+	int delay = 0;
+	cpu.Reset(delay);
+
+	auto cases = FindCases(ram, cpu, regs);
+	if (onlyEntry >= 0)
+	{
+		std::erase_if(cases, [&](const Case& c) { return c.entry != uint32_t(onlyEntry); });
+	}
+
+	for (auto& c : cases)
+	{
+		MeasureCase(c, ram, cpu, regs, iterations, repeats);
+	}
+
+	if (showAll)
+	{
+		printf("entry opcode decode(ns) execute(ns)  instruction\n");
+		for (const auto& c : cases)
+		{
+			printf("%5u   %04x %10.1f %11.1f  %s%s\n", c.entry, c.opcode, c.decodeNs, c.executeNs, c.text.c_str(), c.implemented ? "" : " (unimplemented)");
+		}
+	}
+	else
+	{
+		printf("entry variants  decode(ns) min/mean/max   execute(ns) min/mean/max  example\n");
+		for (size_t begin = 0; begin < cases.size();)
+		{
+			size_t end = begin;
+			double decode[3] = { 1e9, 0.0, 0.0 };
+			double execute[3] = { 1e9, 0.0, 0.0 };
+			while (end < cases.size() && cases[end].entry == cases[begin].entry)
+			{
+				const auto& c = cases[end++];
+				decode[0] = std::min(decode[0], c.decodeNs);
+				decode[1] += c.decodeNs;
+				decode[2] = std::max(decode[2], c.decodeNs);
+				execute[0] = std::min(execute[0], c.executeNs);
+				execute[1] += c.executeNs;
+				execute[2] = std::max(execute[2], c.executeNs);
+			}
+
+			const auto count = double(end - begin);
+			printf("%5u %8zu  %6.1f %6.1f %6.1f      %6.1f %6.1f %6.1f    %s%s\n", cases[begin].entry, end - begin,
+				decode[0], decode[1] / count, decode[2], execute[0], execute[1] / count, execute[2],
+				cases[begin].text.c_str(), cases[begin].implemented ? "" : " (unimplemented)");
+
+			begin = end;
+		}
+	}
+
+	if (!jsonFile.empty())
+	{
+		FILE* f = fopen(jsonFile.c_str(), "w");
+		if (!f)
+		{
+			printf("Error : failed to create '%s'\n", jsonFile.c_str());
+			return 1;
+		}
+		WriteJson(f, cases);
+		fclose(f);
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,334 @@
+// guru-bench : runs reproducible emulation scenarios and reports emulated colour clocks per
+// host second, percentage of real time and a sampled breakdown of host time by subsystem.
+//
+// Each scenario is booted, run for a few warm up frames and then its state saved. Every timed
+// run restores that state and calls Amiga::ExecuteFor, so repeated runs (and runs on
+// different commits) execute exactly the same emulated work. Results are written as JSON.
+
+#include "scenarios.h"
+
+#include "Amiga/amiga.h"
+#include "rom_image.h"
+#include "util/file.h"
+#include "util/log.h"
+
+#include "3rd Party/cxxopts.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+	constexpr int PAL_CClockFreq = 3546895;
+
+	// Long enough for Kickstart 1.x to reach the insert disk screen.
+	constexpr double kBootSeconds = 8.0;
+
+	constexpr auto kSampleInterval = std::chrono::microseconds(50);
+
+	using SubsystemSamples = std::array<uint64_t, size_t(am::Subsystem::NumSubsystems)>;
+
+	struct Result
+	{
+		std::string name;
+		std::string description;
+		uint64_t cclocks = 0;
+		double bestSeconds = 0.0;
+		double meanSeconds = 0.0;
+		SubsystemSamples samples = {};
+	};
+
+	struct Options
+	{
+		double seconds = 5.0;
+		int repeats = 3;
+		std::string romFile;
+		std::string snapshotFile;
+		std::string filter;
+	};
+
+	// Polls the subsystem the emulation is running on another thread.
+	class SamplingProfiler
+	{
+	public:
+		SamplingProfiler(const am::Amiga& amiga, SubsystemSamples& samples)
+			: m_thread([this, &amiga, &samples]()
+			{
+				while (!m_stop.load(std::memory_order_relaxed))
+				{
+					std::this_thread::sleep_for(kSampleInterval);
+					samples[size_t(amiga.GetActiveSubsystem())]++;
+				}
+			})
+		{
+		}
+
+		~SamplingProfiler()
+		{
+			m_stop = true;
+			m_thread.join();
+		}
+
+	private:
+		std::atomic<bool> m_stop = false;
+		std::thread m_thread;
+	};
+
+	Result RunScenario(am::Amiga& amiga, const am::SavedState& state, uint64_t cclocks, const Options& options)
+	{
+		Result result;
+		result.cclocks = cclocks;
+
+		double total = 0.0;
+
+		for (int i = 0; i < options.repeats; i++)
+		{
+			amiga.LoadState(state);
+
+			const auto start = std::chrono::steady_clock::now();
+			{
+				SamplingProfiler profiler(amiga, result.samples);
+				amiga.ExecuteFor(cclocks);
+			}
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			total += elapsed.count();
+			result.bestSeconds = (i == 0) ? elapsed.count() : std::min(result.bestSeconds, elapsed.count());
+		}
+
+		result.meanSeconds = total / options.repeats;
+		return result;
+	}
+
+	am::SavedState SaveState(const am::Amiga& amiga)
+	{
+		am::SavedState state;
+		amiga.SaveState(state);
+		return state;
+	}
+
+	bool IncludeScenario(const Options& options, const std::string& name)
+	{
+		return options.filter.empty() || name.find(options.filter) != std::string::npos;
+	}
+
+	std::string EscapeJson(const std::string& s)
+	{
+		std::string out;
+		for (char c : s)
+		{
+			if (c == '"' || c == '\\')
+				out += '\\';
+			out += c;
+		}
+		return out;
+	}
+
+	void WriteJson(FILE* f, const std::vector<Result>& results, const Options& options)
+	{
+#if GURU_PROFILE_SUBSYSTEMS
+		constexpr bool profiled = true;
+#else
+		constexpr bool profiled = false;
+#endif
+
+		fprintf(f, "{\n");
+		fprintf(f, "  \"emulated_seconds\": %g,\n", options.seconds);
+		fprintf(f, "  \"repeats\": %d,\n", options.repeats);
+		fprintf(f, "  \"cclock_frequency\": %d,\n", PAL_CClockFreq);
+		fprintf(f, "  \"profiled\": %s,\n", profiled ? "true" : "false");
+		fprintf(f, "  \"scenarios\": [");
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+			const double cclocksPerSecond = double(r.cclocks) / r.bestSeconds;
+
+			fprintf(f, "%s\n    {\n", i == 0 ? "" : ",");
+			fprintf(f, "      \"name\": \"%s\",\n", EscapeJson(r.name).c_str());
+			fprintf(f, "      \"description\": \"%s\",\n", EscapeJson(r.description).c_str());
+			fprintf(f, "      \"cclocks\": %llu,\n", (unsigned long long)r.cclocks);
+			fprintf(f, "      \"best_host_seconds\": %.6f,\n", r.bestSeconds);
+			fprintf(f, "      \"mean_host_seconds\": %.6f,\n", r.meanSeconds);
+			fprintf(f, "      \"cclocks_per_second\": %.0f,\n", cclocksPerSecond);
+			fprintf(f, "      \"realtime_percent\": %.1f,\n", 100.0 * cclocksPerSecond / PAL_CClockFreq);
+			fprintf(f, "      \"subsystems\": {");
+
+			uint64_t totalSamples = 0;
+			for (auto s : r.samples)
+				totalSamples += s;
+
+			for (size_t s = 0; s < r.samples.size(); s++)
+			{
+				const double percent = totalSamples ? 100.0 * double(r.samples[s]) / double(totalSamples) : 0.0;
+				fprintf(f, "%s\"%s\": %.1f", s == 0 ? " " : ", ", am::GetSubsystemName(am::Subsystem(s)), percent);
+			}
+			fprintf(f, " }\n    }");
+		}
+
+		fprintf(f, "\n  ]\n}\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	std::string outputFile;
+
+	cxxopts::Options cmdOptions("guru-bench", "Guru Amiga Emulator scenario benchmarks");
+	cmdOptions.add_options()
+		("s,seconds", "emulated seconds to run each synthetic scenario for", cxxopts::value<double>()->default_value("5"))
+		("n,repeats", "number of timed runs of each scenario", cxxopts::value<int>()->default_value("3"))
+		("r,rom", "kickstart rom file (enables the kickstart-boot scenario)", cxxopts::value<std::string>()->default_value(""))
+		("snapshot", "also run from this emulator snapshot (requires --rom)", cxxopts::value<std::string>()->default_value(""))
+		("filter", "only run scenarios whose name contains this string", cxxopts::value<std::string>()->default_value(""))
+		("o,output", "write JSON results to this file rather than stdout", cxxopts::value<std::string>()->default_value(""))
+		("h,help", "show help");
+
+	try
+	{
+		auto result = cmdOptions.parse(argc, argv);
+		if (result.count("help"))
+		{
+			printf("%s\n", cmdOptions.help().c_str());
+			return 0;
+		}
+
+		options.seconds = result["seconds"].as<double>();
+		options.repeats = result["repeats"].as<int>();
+		options.romFile = result["rom"].as<std::string>();
+		options.snapshotFile = result["snapshot"].as<std::string>();
+		options.filter = result["filter"].as<std::string>();
+		outputFile = result["output"].as<std::string>();
+	}
+	catch (cxxopts::OptionParseException& e)
+	{
+		printf("Error : %s\n\n", e.what());
+		printf("%s\n", cmdOptions.help().c_str());
+		return -1;
+	}
+
+	if (options.seconds <= 0.0 || options.repeats < 1 || (!options.snapshotFile.empty() && options.romFile.empty()))
+	{
+		printf("%s\n", cmdOptions.help().c_str());
+		return -1;
+	}
+
+	const auto syntheticCClocks = uint64_t(options.seconds * PAL_CClockFreq);
+
+	util::Log log(1000);
+	std::vector<Result> results;
+
+	for (const auto& scenario : bench::BuildSyntheticScenarios())
+	{
+		if (!IncludeScenario(options, scenario.name))
+			continue;
+
+		am::Amiga amiga(am::ChipRamConfig::ChipRam512k, &log);
+		amiga.SetFrameSkip(0);
+		amiga.SetRom(scenario.rom);
+
+		for (int i = 0; i < scenario.warmupFrames; i++)
+		{
+			amiga.ExecuteFrame();
+		}
+
+		auto result = RunScenario(amiga, SaveState(amiga), syntheticCClocks, options);
+		result.name = scenario.name;
+		result.description = scenario.description;
+		results.push_back(std::move(result));
+	}
+
+	std::vector<uint8_t> rom;
+	if (!options.romFile.empty())
+	{
+		auto [romOk, romStatus] = guru::CheckRom(options.romFile);
+		if (romOk)
+		{
+			rom = guru::LoadRom(options.romFile);
+		}
+
+		if (rom.empty())
+		{
+			fprintf(stderr, "Error : can't use rom '%s' : %s\n", options.romFile.c_str(), romStatus.c_str());
+			return 1;
+		}
+	}
+
+	if (!rom.empty() && IncludeScenario(options, "kickstart-boot"))
+	{
+		am::Amiga amiga(am::ChipRamConfig::ChipRam512k, &log);
+		amiga.SetRom(rom);
+
+		auto result = RunScenario(amiga, SaveState(amiga), uint64_t(kBootSeconds * PAL_CClockFreq), options);
+		result.name = "kickstart-boot";
+		result.description = "Kickstart boot from reset to the insert disk screen";
+		results.push_back(std::move(result));
+	}
+
+	if (!options.snapshotFile.empty())
+	{
+		std::ifstream ifile(options.snapshotFile, std::ios::binary);
+
+		am::Amiga amiga(am::ChipRamConfig::ChipRam512k, &log);
+		amiga.SetRom(rom);
+
+		// Disks the snapshot refers to are loaded from their files, as guru-headless does. A
+		// snapshot without its disks would be a different workload, so that is an error.
+		std::vector<std::string> missingDisks;
+		auto loadDisk = [&missingDisks](const std::string& fileLocation, std::vector<uint8_t>& data)
+		{
+			if (util::LoadBinaryFile(fileLocation, data))
+				return true;
+
+			missingDisks.push_back(fileLocation);
+			return false;
+		};
+
+		if (!ifile.is_open() || !amiga.ReadSnapshot(ifile, loadDisk))
+		{
+			fprintf(stderr, "Error : failed to read snapshot '%s'\n", options.snapshotFile.c_str());
+			return 1;
+		}
+
+		if (!missingDisks.empty())
+		{
+			for (const auto& disk : missingDisks)
+			{
+				fprintf(stderr, "Error : can't restore disk '%s' for snapshot '%s'\n", disk.c_str(), options.snapshotFile.c_str());
+			}
+			return 1;
+		}
+
+		auto result = RunScenario(amiga, SaveState(amiga), syntheticCClocks, options);
+		result.name = std::filesystem::path(options.snapshotFile).filename().string();
+		result.description = "Snapshot " + options.snapshotFile;
+		results.push_back(std::move(result));
+	}
+
+	FILE* f = stdout;
+	if (!outputFile.empty())
+	{
+		f = fopen(outputFile.c_str(), "w");
+		if (!f)
+		{
+			fprintf(stderr, "Error : failed to create '%s'\n", outputFile.c_str());
+			return 1;
+		}
+	}
+
+	WriteJson(f, results, options);
+
+	if (f != stdout)
+	{
+		fclose(f);
+	}
+
+	return 0;
+}
\ No newline at end of file
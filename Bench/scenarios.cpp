@@ -0,0 +1,220 @@
+#include "scenarios.h"
+
+#include <initializer_list>
+
+namespace
+{
+	constexpr size_t kRomSize = 512 * 1024;
+	constexpr uint32_t kCodeOffset = 0x10;
+	constexpr uint32_t kDataOffset = 0x1000;
+
+	// Chip ram address the rom data block is copied to.
+	constexpr uint32_t kChipData = 0x800;
+
+	// Offset within the data block (and so chip ram) of any audio samples.
+	constexpr uint32_t kSampleOffset = 0x800;
+
+	constexpr uint16_t kCopperEnd[] = { 0xffff, 0xfffe };
+
+	class Program
+	{
+	public:
+		void Emit(std::initializer_list<uint16_t> words)
+		{
+			code.insert(code.end(), words);
+		}
+
+		void Emit(uint16_t opcode, uint32_t value)
+		{
+			code.push_back(opcode);
+			code.push_back(uint16_t(value >> 16));
+			code.push_back(uint16_t(value));
+		}
+
+		// move.w #value,reg(a6)
+		void SetRegister(uint16_t reg, uint16_t value)
+		{
+			Emit({ 0x3d7c, value, reg });
+		}
+
+		// move.l #value,reg(a6)
+		void SetRegisterPair(uint16_t reg, uint32_t value)
+		{
+			Emit({ 0x2d7c, uint16_t(value >> 16), uint16_t(value), reg });
+		}
+
+		std::vector<uint16_t> code;
+	};
+
+	// Common start up code. Leaves a6 pointing at the custom chip registers.
+	void EmitPrologue(Program& p, size_t dataWords)
+	{
+		p.Emit({ 0x13fc, 0x0003, 0x00bf, 0xe201 });	// move.b #3,$bfe201 (CIAA DDRA)
+		p.Emit({ 0x13fc, 0x0002, 0x00bf, 0xe001 });	// move.b #2,$bfe001 (overlay off)
+		p.Emit(0x4df9, 0xdff000);					// lea $dff000,a6
+		p.SetRegister(0x09a, 0x7fff);				// INTENA - disable all
+		p.SetRegister(0x096, 0x7fff);				// DMACON - disable all
+
+		// Copy the data block (copper list, samples etc.) to chip ram.
+		p.Emit(0x41f9, 0xf80000 + kDataOffset);	// lea data,a0
+		p.Emit(0x43f9, kChipData);					// lea kChipData,a1
+		p.Emit({ 0x303c, uint16_t(dataWords - 1) });	// move.w #dataWords-1,d0
+		p.Emit({ 0x32d8 });							// .copy: move.w (a0)+,(a1)+
+		p.Emit({ 0x51c8, 0xfffc });					// dbra d0,.copy
+
+		p.SetRegisterPair(0x080, kChipData);		// COP1LC
+		p.SetRegister(0x088, 0);					// COPJMP1
+	}
+
+	std::vector<uint8_t> BuildRom(const Program& p, const std::vector<uint16_t>& data)
+	{
+		std::vector<uint8_t> rom(kRomSize, 0);
+
+		auto Put = [&](uint32_t offset, uint16_t word)
+		{
+			rom[offset] = uint8_t(word >> 8);
+			rom[offset + 1] = uint8_t(word);
+		};
+
+		// Reset vectors: initial ssp and pc.
+		Put(0, 0x0000);
+		Put(2, 0x1000);
+		Put(4, 0x00f8);
+		Put(6, uint16_t(kCodeOffset));
+
+		for (size_t i = 0; i < p.code.size(); i++)
+			Put(uint32_t(kCodeOffset + i * 2), p.code[i]);
+
+		for (size_t i = 0; i < data.size(); i++)
+			Put(uint32_t(kDataOffset + i * 2), data[i]);
+
+		return rom;
+	}
+
+	std::vector<uint16_t> CopperEndOnly()
+	{
+		return { std::begin(kCopperEnd), std::end(kCopperEnd) };
+	}
+
+	bench::Scenario CpuLoop()
+	{
+		Program p;
+		EmitPrologue(p, 2);
+		p.Emit({ 0x7000 });						// moveq #0,d0
+		p.Emit({ 0x7201 });						// moveq #1,d1
+		p.Emit({ 0x7403 });						// moveq #3,d2
+		p.Emit(0x41f9, 0x1000);					// lea $1000,a0
+		p.Emit({ 0xd081 });						// .loop: add.l d1,d0
+		p.Emit({ 0xc6c2 });						// mulu.w d2,d3
+		p.Emit({ 0xe78c });						// lsl.l #3,d4
+		p.Emit({ 0x2080 });						// move.l d0,(a0)
+		p.Emit({ 0x2a10 });						// move.l (a0),d5
+		p.Emit({ 0x4845 });						// swap d5
+		p.Emit({ 0x5286 });						// addq.l #1,d6
+		p.Emit({ 0x60f0 });						// bra.s .loop
+
+		return { "cpu-loop", "CPU bound integer loop with no DMA", BuildRom(p, CopperEndOnly()), 10 };
+	}
+
+	bench::Scenario BlitterScene()
+	{
+		// Four low-res bitplanes displaying the area being continually blitted over.
+		const uint32_t planes[4] = { 0x10000, 0x12800, 0x15000, 0x17800 };
+
+		std::vector<uint16_t> copper;
+		for (int i = 0; i < 4; i++)
+		{
+			copper.insert(copper.end(), {
+				uint16_t(0x0e0 + i * 4), uint16_t(planes[i] >> 16),
+				uint16_t(0x0e2 + i * 4), uint16_t(planes[i]) });
+		}
+		copper.insert(copper.end(), { 0x0100, 0x4200 });	// BPLCON0 - 4 planes
+		copper.insert(copper.end(), { 0x008e, 0x2c81 });	// DIWSTRT
+		copper.insert(copper.end(), { 0x0090, 0x2cc1 });	// DIWSTOP
+		copper.insert(copper.end(), { 0x0092, 0x0038 });	// DDFSTRT
+		copper.insert(copper.end(), { 0x0094, 0x00d0 });	// DDFSTOP
+		copper.insert(copper.end(), { 0x0108, 0x0000 });	// BPL1MOD
+		copper.insert(copper.end(), { 0x010a, 0x0000 });	// BPL2MOD
+		copper.insert(copper.end(), std::begin(kCopperEnd), std::end(kCopperEnd));
+
+		Program p;
+		EmitPrologue(p, copper.size());
+		p.SetRegister(0x040, 0x09f0);			// BLTCON0 - A -> D copy
+		p.SetRegister(0x042, 0x0000);			// BLTCON1
+		p.SetRegister(0x044, 0xffff);			// BLTAFWM
+		p.SetRegister(0x046, 0xffff);			// BLTALWM
+		p.SetRegister(0x064, 0x0000);			// BLTAMOD
+		p.SetRegister(0x066, 0x0000);			// BLTDMOD
+		p.SetRegister(0x096, 0x83c0);			// DMACON - DMAEN | BPLEN | COPEN | BLTEN
+		p.Emit({ 0x082e, 0x0006, 0x0002 });		// .loop: btst #6,DMACONR(a6)
+		p.Emit({ 0x66f8 });						// bne.s .loop
+		p.SetRegisterPair(0x050, 0x20000);		// BLTAPT
+		p.SetRegisterPair(0x054, planes[0]);	// BLTDPT
+		p.SetRegister(0x058, (256 << 6) | 40);	// BLTSIZE - 256 lines of 40 words
+		p.Emit({ 0x60e0 });						// bra.s .loop
+
+		return { "blitter", "Back to back 20KiB blits under a 4 bitplane display", BuildRom(p, copper), 10 };
+	}
+
+	bench::Scenario CopperRainbow()
+	{
+		std::vector<uint16_t> copper;
+		uint16_t colour = 0;
+		for (int line = 0x2c; line < 0x100; line++)
+		{
+			copper.insert(copper.end(), { uint16_t((line << 8) | 0x07), 0xfffe });	// WAIT line
+			copper.insert(copper.end(), { 0x0180, colour });							// COLOR00
+			colour = (colour + 0x0111) & 0x0fff;
+		}
+		copper.insert(copper.end(), std::begin(kCopperEnd), std::end(kCopperEnd));
+
+		Program p;
+		EmitPrologue(p, copper.size());
+		p.SetRegister(0x096, 0x8280);			// DMACON - DMAEN | COPEN
+		p.Emit({ 0x60fe });						// bra.s *
+
+		return { "copper-rainbow", "Copper list changing the background colour every line", BuildRom(p, copper), 10 };
+	}
+
+	bench::Scenario AudioTrack()
+	{
+		constexpr uint16_t kSampleWords = 128;
+
+		std::vector<uint16_t> data = CopperEndOnly();
+		data.resize(kSampleOffset / 2, 0);
+		for (int i = 0; i < kSampleWords; i++)
+		{
+			// Sawtooth
+			const auto a = uint8_t(i * 2);
+			const auto b = uint8_t(i * 2 + 1);
+			data.push_back(uint16_t((a << 8) | b));
+		}
+
+		const uint16_t periods[4] = { 124, 180, 254, 320 };
+
+		Program p;
+		EmitPrologue(p, data.size());
+		for (int ch = 0; ch < 4; ch++)
+		{
+			const uint16_t base = uint16_t(0x0a0 + ch * 0x10);
+			p.SetRegisterPair(base + 0x0, kChipData + kSampleOffset);	// AUDxLC
+			p.SetRegister(base + 0x4, kSampleWords);					// AUDxLEN
+			p.SetRegister(base + 0x6, periods[ch]);					// AUDxPER
+			p.SetRegister(base + 0x8, 64);								// AUDxVOL
+		}
+		p.SetRegister(0x096, 0x828f);			// DMACON - DMAEN | COPEN | AUD0-3
+		p.Emit({ 0x60fe });						// bra.s *
+
+		return { "audio", "All four audio channels playing looping samples", BuildRom(p, data), 10 };
+	}
+}
+
+std::vector<bench::Scenario> bench::BuildSyntheticScenarios()
+{
+	std::vector<Scenario> scenarios;
+	scenarios.push_back(CpuLoop());
+	scenarios.push_back(BlitterScene());
+	scenarios.push_back(CopperRainbow());
+	scenarios.push_back(AudioTrack());
+	return scenarios;
+}
\ No newline at end of file
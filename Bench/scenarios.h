@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace bench
+{
+	struct Scenario
+	{
+		std::string name;
+		std::string description;
+		std::vector<uint8_t> rom;
+		int warmupFrames = 0;
+	};
+
+	/// Builds the self-contained scenarios. Each one is a small 512KiB boot rom which disables
+	/// the rom overlay, installs a copper list in chip ram, programs the custom chips and then
+	/// runs its main loop, so they can be run without a kickstart image.
+	std::vector<Scenario> BuildSyntheticScenarios();
+}
\ No newline at end of file
@@ -0,0 +1,386 @@
+// CpuTest : runs single-step 68000 test vectors against cpu::M68000.
+//
+// Each vector gives the registers, prefetch queue and ram before one instruction and the
+// expected state after it. Files are shared between one worker thread per host core, each
+// with its own CPU and sparse ram, and mismatches are reported grouped by opcode.
+
+#include "test_vectors.h"
+
+#include "Amiga/68000.h"
+
+#include "3rd Party/cxxopts.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	class SparseRam : public cpu::IBus
+	{
+	public:
+		void Clear()
+		{
+			m_bytes.clear();
+		}
+
+		uint8_t Get(uint32_t addr) const
+		{
+			auto it = m_bytes.find(addr & 0xffffff);
+			return it != m_bytes.end() ? it->second : 0;
+		}
+
+		void Set(uint32_t addr, uint8_t value)
+		{
+			m_bytes[addr & 0xffffff] = value;
+		}
+
+		virtual uint16_t ReadBusWord(uint32_t addr) override
+		{
+			return uint16_t((Get(addr) << 8) | Get(addr + 1));
+		}
+
+		virtual void WriteBusWord(uint32_t addr, uint16_t value) override
+		{
+			Set(addr, uint8_t(value >> 8));
+			Set(addr + 1, uint8_t(value));
+		}
+
+		virtual uint8_t ReadBusByte(uint32_t addr) override
+		{
+			return Get(addr);
+		}
+
+		virtual void WriteBusByte(uint32_t addr, uint8_t value) override
+		{
+			Set(addr, value);
+		}
+
+	private:
+		std::unordered_map<uint32_t, uint8_t> m_bytes;
+	};
+
+	struct OpcodeFailures
+	{
+		int count = 0;
+		std::string example;
+	};
+
+	struct FileResult
+	{
+		std::string filename;
+		std::string error;
+		int numTests = 0;
+		int numFailed = 0;
+		std::map<uint16_t, OpcodeFailures> failures;
+	};
+
+	struct Worker
+	{
+		Worker()
+			: cpu(&ram)
+		{
+		}
+
+		SparseRam ram;
+		cpu::M68000 cpu;
+	};
+
+	struct Options
+	{
+		uint32_t pcAdjust = 0;
+		std::string convertDir;
+	};
+
+	cpu::Registers ToRegisters(const cputest::TestState& state, uint32_t pcAdjust)
+	{
+		cpu::Registers regs = {};
+		std::copy(std::begin(state.d), std::end(state.d), regs.d);
+		std::copy(std::begin(state.a), std::end(state.a), regs.a);
+
+		const bool supervisor = (state.sr & 0x2000) != 0;
+		regs.a[7] = supervisor ? state.ssp : state.usp;
+		regs.altA7 = supervisor ? state.usp : state.ssp;
+		regs.pc = state.pc - pcAdjust;
+		regs.status = state.sr;
+		return regs;
+	}
+
+	// Returns an empty string if the CPU and ram match the expected state.
+	std::string Compare(const cputest::TestState& expected, const cpu::Registers& actual, const SparseRam& ram, uint32_t pcAdjust)
+	{
+		char buffer[128];
+
+		const bool supervisor = (actual.status & 0x2000) != 0;
+		const uint32_t usp = supervisor ? actual.altA7 : actual.a[7];
+		const uint32_t ssp = supervisor ? actual.a[7] : actual.altA7;
+
+		auto Check = [&](const char* name, uint32_t want, uint32_t got)
+		{
+			if (want == got)
+				return false;
+			snprintf(buffer, sizeof(buffer), "%s expected %08x got %08x", name, want, got);
+			return true;
+		};
+
+		static const char* const dNames[] = { "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7" };
+		static const char* const aNames[] = { "a0", "a1", "a2", "a3", "a4", "a5", "a6" };
+
+		for (int i = 0; i < 8; i++)
+		{
+			if (Check(dNames[i], expected.d[i], actual.d[i]))
+				return buffer;
+		}
+
+		for (int i = 0; i < 7; i++)
+		{
+			if (Check(aNames[i], expected.a[i], actual.a[i]))
+				return buffer;
+		}
+
+		if (Check("usp", expected.usp, usp)
+			|| Check("ssp", expected.ssp, ssp)
+			|| Check("sr", expected.sr, actual.status)
+			|| Check("pc", expected.pc - pcAdjust, actual.pc))
+		{
+			return buffer;
+		}
+
+		for (auto [addr, value] : expected.ram)
+		{
+			const auto got = ram.Get(addr);
+			if (got != value)
+			{
+				snprintf(buffer, sizeof(buffer), "ram[%06x] expected %02x got %02x", addr, value, got);
+				return buffer;
+			}
+		}
+
+		return {};
+	}
+
+	std::string RunTest(const cputest::TestCase& test, Worker& worker, uint32_t pcAdjust)
+	{
+		auto& ram = worker.ram;
+		auto& cpu = worker.cpu;
+
+		ram.Clear();
+		for (auto [addr, value] : test.initial.ram)
+		{
+			ram.Set(addr, value);
+		}
+
+		const auto regs = ToRegisters(test.initial, pcAdjust);
+		ram.WriteBusWord(regs.pc, test.initial.prefetch[0]);
+		ram.WriteBusWord(regs.pc + 2, test.initial.prefetch[1]);
+
+		cpu.SetRegisters(regs);
+
+		int delay = 0;
+		if (!cpu.DecodeOneInstruction(delay) || !cpu.ExecuteOneInstruction(delay))
+			return "unimplemented";
+
+		return Compare(test.final, cpu.GetRegisters(), ram, pcAdjust);
+	}
+
+	bool EndsWith(const std::string& s, std::string_view suffix)
+	{
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	FileResult RunFile(const std::string& filename, Worker& worker, const Options& options)
+	{
+		FileResult result;
+		result.filename = filename;
+
+		std::vector<cputest::TestCase> tests;
+		const bool isBinary = EndsWith(filename, ".bin");
+		const bool loaded = isBinary
+			? cputest::LoadBinaryTests(filename, tests, result.error)
+			: cputest::LoadJsonTests(filename, tests, result.error);
+
+		if (!loaded)
+			return result;
+
+		if (!isBinary && !options.convertDir.empty())
+		{
+			auto name = std::filesystem::path(filename).filename().string();
+			name = name.substr(0, name.find('.')) + ".bin";
+			cputest::SaveBinaryTests((std::filesystem::path(options.convertDir) / name).string(), tests);
+		}
+
+		for (const auto& test : tests)
+		{
+			result.numTests++;
+
+			auto mismatch = RunTest(test, worker, options.pcAdjust);
+			if (mismatch.empty())
+				continue;
+
+			result.numFailed++;
+
+			auto& failures = result.failures[test.initial.prefetch[0]];
+			if (failures.count++ == 0)
+			{
+				failures.example = test.name + " : " + mismatch;
+			}
+		}
+
+		return result;
+	}
+
+	void AddFiles(const std::filesystem::path& path, std::vector<std::string>& files)
+	{
+		auto IsTestFile = [](const std::string& name)
+		{
+			return EndsWith(name, ".json") || EndsWith(name, ".json.gz") || EndsWith(name, ".bin");
+		};
+
+		if (std::filesystem::is_directory(path))
+		{
+			for (auto& entry : std::filesystem::recursive_directory_iterator(path))
+			{
+				if (entry.is_regular_file() && IsTestFile(entry.path().string()))
+					files.push_back(entry.path().string());
+			}
+		}
+		else
+		{
+			files.push_back(path.string());
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	std::vector<std::string> inputs;
+	int numThreads = 0;
+	int maxOpcodes = 8;
+
+	cxxopts::Options cmdOptions("CpuTest", "Single-step 68000 test vector runner");
+	cmdOptions.add_options()
+		("j,threads", "worker threads (default: one per core)", cxxopts::value<int>()->default_value("0"))
+		("pc-adjust", "amount the vectors' pc is ahead of the instruction address (e.g. 4 if pc follows the prefetch queue)", cxxopts::value<uint32_t>()->default_value("0"))
+		("convert", "also save each JSON file in the binary format to this directory", cxxopts::value<std::string>()->default_value(""))
+		("max-opcodes", "failing opcodes to list per file", cxxopts::value<int>()->default_value("8"))
+		("inputs", "test files or directories (.json, .json.gz or .bin)", cxxopts::value<std::vector<std::string>>())
+		("h,help", "show help");
+	cmdOptions.parse_positional({ "inputs" });
+	cmdOptions.positional_help("<files or directories>");
+
+	try
+	{
+		auto result = cmdOptions.parse(argc, argv);
+		if (result.count("help") || !result.count("inputs"))
+		{
+			printf("%s\n", cmdOptions.help().c_str());
+			return result.count("help") ? 0 : -1;
+		}
+
+		numThreads = result["threads"].as<int>();
+		options.pcAdjust = result["pc-adjust"].as<uint32_t>();
+		options.convertDir = result["convert"].as<std::string>();
+		maxOpcodes = result["max-opcodes"].as<int>();
+		inputs = result["inputs"].as<std::vector<std::string>>();
+	}
+	catch (cxxopts::OptionParseException& e)
+	{
+		printf("Error : %s\n\n", e.what());
+		printf("%s\n", cmdOptions.help().c_str());
+		return -1;
+	}
+
+	std::vector<std::string> files;
+	for (const auto& input : inputs)
+	{
+		AddFiles(input, files);
+	}
+	std::sort(files.begin(), files.end());
+
+	if (numThreads <= 0)
+	{
+		numThreads = std::max(1, int(std::thread::hardware_concurrency()));
+	}
+	numThreads = std::min(numThreads, std::max(1, int(files.size())));
+
+	if (!options.convertDir.empty())
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(options.convertDir, ec);
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	// One worker per thread. The CPUs share no state, so they need no locking between them.
+	std::vector<std::unique_ptr<Worker>> workers;
+	for (int i = 0; i < numThreads; i++)
+	{
+		workers.push_back(std::make_unique<Worker>());
+	}
+
+	std::vector<FileResult> results(files.size());
+	std::atomic<size_t> nextFile = 0;
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back([&, worker = workers[i].get()]()
+		{
+			for (size_t f = nextFile++; f < files.size(); f = nextFile++)
+			{
+				results[f] = RunFile(files[f], *worker, options);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+	int64_t totalTests = 0;
+	int64_t totalFailed = 0;
+	int filesWithErrors = 0;
+
+	for (const auto& result : results)
+	{
+		const auto name = std::filesystem::path(result.filename).filename().string();
+
+		if (!result.error.empty())
+		{
+			printf("%-24s ERROR : %s\n", name.c_str(), result.error.c_str());
+			filesWithErrors++;
+			continue;
+		}
+
+		totalTests += result.numTests;
+		totalFailed += result.numFailed;
+
+		printf("%-24s %7d tests %7d failed\n", name.c_str(), result.numTests, result.numFailed);
+
+		int listed = 0;
+		for (const auto& [opcode, failures] : result.failures)
+		{
+			if (listed++ == maxOpcodes)
+			{
+				printf("    ... %zu more failing opcodes\n", result.failures.size() - maxOpcodes);
+				break;
+			}
+			printf("    %04x : %5d failed, e.g. %s\n", opcode, failures.count, failures.example.c_str());
+		}
+	}
+
+	printf("\n%lld tests, %lld failed, %d unreadable files, %d threads, %.2fs\n",
+		(long long)totalTests, (long long)totalFailed, filesWithErrors, numThreads, elapsed.count());
+
+	return (totalFailed == 0 && filesWithErrors == 0) ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,430 @@
+#include "test_vectors.h"
+
+#include "util/stream.h"
+
+#include <zlib.h>
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+	constexpr char kBinaryMagic[8] = "GuRu68k";
+	constexpr int kBinaryVersion = 1;
+
+	// Just enough of a JSON reader for the test vector files. Throws std::runtime_error
+	// on malformed input.
+	class JsonReader
+	{
+	public:
+		explicit JsonReader(std::string_view text)
+			: m_text(text)
+		{
+		}
+
+		// Consume the character if it is next.
+		bool Next(char c)
+		{
+			SkipWhitespace();
+			if (m_pos < m_text.size() && m_text[m_pos] == c)
+			{
+				m_pos++;
+				return true;
+			}
+			return false;
+		}
+
+		void Expect(char c)
+		{
+			if (!Next(c))
+				Fail(std::string("expected '") + c + "'");
+		}
+
+		std::string_view ReadString()
+		{
+			Expect('"');
+			const auto start = m_pos;
+			while (m_pos < m_text.size() && m_text[m_pos] != '"')
+			{
+				if (m_text[m_pos] == '\\')
+					m_pos++;
+				m_pos++;
+			}
+			if (m_pos >= m_text.size())
+				Fail("unterminated string");
+
+			return m_text.substr(start, m_pos++ - start);
+		}
+
+		int64_t ReadInteger()
+		{
+			SkipWhitespace();
+			int64_t value = 0;
+			auto [ptr, ec] = std::from_chars(m_text.data() + m_pos, m_text.data() + m_text.size(), value);
+			if (ec != std::errc())
+				Fail("expected integer");
+
+			m_pos = ptr - m_text.data();
+			return value;
+		}
+
+		void SkipValue()
+		{
+			SkipWhitespace();
+			if (m_pos >= m_text.size())
+				Fail("unexpected end of file");
+
+			const char c = m_text[m_pos];
+			if (c == '"')
+			{
+				ReadString();
+			}
+			else if (c == '{' || c == '[')
+			{
+				const char close = (c == '{') ? '}' : ']';
+				m_pos++;
+				if (Next(close))
+					return;
+				do
+				{
+					if (c == '{')
+					{
+						ReadString();
+						Expect(':');
+					}
+					SkipValue();
+				}
+				while (Next(','));
+				Expect(close);
+			}
+			else
+			{
+				// number, true, false or null
+				while (m_pos < m_text.size() && std::strchr(",}] \t\r\n", m_text[m_pos]) == nullptr)
+					m_pos++;
+			}
+		}
+
+		[[noreturn]] void Fail(const std::string& message) const
+		{
+			throw std::runtime_error(message + " at offset " + std::to_string(m_pos));
+		}
+
+	private:
+		void SkipWhitespace()
+		{
+			while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\r' || m_text[m_pos] == '\n'))
+				m_pos++;
+		}
+
+		std::string_view m_text;
+		size_t m_pos = 0;
+	};
+
+	bool ReadRegisterField(std::string_view key, JsonReader& r, cputest::TestState& state)
+	{
+		if (key.size() == 2 && (key[0] == 'd' || key[0] == 'a') && key[1] >= '0' && key[1] <= '7')
+		{
+			const int n = key[1] - '0';
+			if (key[0] == 'd')
+			{
+				state.d[n] = uint32_t(r.ReadInteger());
+				return true;
+			}
+			if (n < 7)
+			{
+				state.a[n] = uint32_t(r.ReadInteger());
+				return true;
+			}
+		}
+
+		if (key == "usp")
+			state.usp = uint32_t(r.ReadInteger());
+		else if (key == "ssp")
+			state.ssp = uint32_t(r.ReadInteger());
+		else if (key == "pc")
+			state.pc = uint32_t(r.ReadInteger());
+		else if (key == "sr")
+			state.sr = uint16_t(r.ReadInteger());
+		else
+			return false;
+
+		return true;
+	}
+
+	void ReadState(JsonReader& r, cputest::TestState& state)
+	{
+		r.Expect('{');
+		if (r.Next('}'))
+			return;
+
+		do
+		{
+			const auto key = r.ReadString();
+			r.Expect(':');
+
+			if (ReadRegisterField(key, r, state))
+				continue;
+
+			if (key == "prefetch")
+			{
+				r.Expect('[');
+				state.prefetch[0] = uint16_t(r.ReadInteger());
+				r.Expect(',');
+				state.prefetch[1] = uint16_t(r.ReadInteger());
+				r.Expect(']');
+			}
+			else if (key == "ram")
+			{
+				r.Expect('[');
+				if (!r.Next(']'))
+				{
+					do
+					{
+						r.Expect('[');
+						const auto addr = uint32_t(r.ReadInteger());
+						r.Expect(',');
+						const auto value = uint8_t(r.ReadInteger());
+						r.Expect(']');
+						state.ram.emplace_back(addr, value);
+					}
+					while (r.Next(','));
+					r.Expect(']');
+				}
+			}
+			else
+			{
+				r.SkipValue();
+			}
+		}
+		while (r.Next(','));
+
+		r.Expect('}');
+	}
+
+	void ReadTest(JsonReader& r, cputest::TestCase& test)
+	{
+		r.Expect('{');
+		if (r.Next('}'))
+			return;
+
+		do
+		{
+			const auto key = r.ReadString();
+			r.Expect(':');
+
+			if (key == "name")
+				test.name = r.ReadString();
+			else if (key == "initial")
+				ReadState(r, test.initial);
+			else if (key == "final")
+				ReadState(r, test.final);
+			else if (key == "length")
+				test.length = uint32_t(r.ReadInteger());
+			else
+				r.SkipValue();
+		}
+		while (r.Next(','));
+
+		r.Expect('}');
+	}
+
+	// Reads a whole file, transparently decompressing gzip files.
+	bool ReadFileText(const std::string& filename, std::string& text)
+	{
+		gzFile file = gzopen(filename.c_str(), "rb");
+		if (!file)
+			return false;
+
+		char buffer[64 * 1024];
+		int bytesRead = 0;
+		while ((bytesRead = gzread(file, buffer, sizeof(buffer))) > 0)
+		{
+			text.append(buffer, bytesRead);
+		}
+
+		const bool ok = bytesRead == 0;
+		gzclose(file);
+		return ok;
+	}
+
+	// The fixed part of a state (registers, prefetch queue and the ram count) and of a whole
+	// test (name length, two states and the cycle count), for checking counts against.
+	constexpr size_t kMinBinaryStateSize = sizeof(uint32_t) * 18 + sizeof(uint16_t) * 3 + sizeof(size_t);
+	constexpr size_t kMinBinaryTestSize = sizeof(size_t) + kMinBinaryStateSize * 2 + sizeof(uint32_t);
+
+	// Reads a count, and checks that what is left of the file could hold that many elements
+	// before anything is sized from it.
+	bool ReadCount(std::istream& is, uint64_t fileSize, size_t elementSize, size_t& count)
+	{
+		count = 0;
+		util::Stream(is, count);
+
+		const auto pos = is.tellg();
+		if (!is || pos < 0 || uint64_t(pos) > fileSize)
+			return false;
+
+		return count <= (fileSize - uint64_t(pos)) / elementSize;
+	}
+
+	bool ReadState(std::istream& is, uint64_t fileSize, cputest::TestState& state)
+	{
+		using util::Stream;
+
+		Stream(is, state.d);
+		Stream(is, state.a);
+		Stream(is, state.usp);
+		Stream(is, state.ssp);
+		Stream(is, state.pc);
+		Stream(is, state.sr);
+		Stream(is, state.prefetch);
+
+		size_t ramSize = 0;
+		if (!ReadCount(is, fileSize, sizeof(state.ram[0]), ramSize))
+			return false;
+
+		state.ram.resize(ramSize);
+		is.read(reinterpret_cast<char*>(state.ram.data()), ramSize * sizeof(state.ram[0]));
+		return bool(is);
+	}
+
+	bool ReadString(std::istream& is, uint64_t fileSize, std::string& str)
+	{
+		size_t length = 0;
+		if (!ReadCount(is, fileSize, 1, length))
+			return false;
+
+		str.resize(length);
+		is.read(str.data(), length);
+		return bool(is);
+	}
+
+	void WriteState(std::ostream& os, const cputest::TestState& state)
+	{
+		using util::Stream;
+
+		Stream(os, state.d);
+		Stream(os, state.a);
+		Stream(os, state.usp);
+		Stream(os, state.ssp);
+		Stream(os, state.pc);
+		Stream(os, state.sr);
+		Stream(os, state.prefetch);
+		util::StreamVector(os, state.ram);
+	}
+}
+
+bool cputest::LoadJsonTests(const std::string& filename, std::vector<TestCase>& tests, std::string& error)
+{
+	std::string text;
+	if (!ReadFileText(filename, text))
+	{
+		error = "unable to read file";
+		return false;
+	}
+
+	try
+	{
+		JsonReader r(text);
+		r.Expect('[');
+		if (!r.Next(']'))
+		{
+			do
+			{
+				ReadTest(r, tests.emplace_back());
+			}
+			while (r.Next(','));
+			r.Expect(']');
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		error = e.what();
+		return false;
+	}
+
+	return true;
+}
+
+bool cputest::LoadBinaryTests(const std::string& filename, std::vector<TestCase>& tests, std::string& error)
+{
+	std::ifstream is(filename, std::ios::binary | std::ios::ate);
+	if (!is.is_open())
+	{
+		error = "unable to read file";
+		return false;
+	}
+
+	const auto end = is.tellg();
+	if (end < 0)
+	{
+		error = "unable to read file";
+		return false;
+	}
+	const auto fileSize = uint64_t(end);
+	is.seekg(0);
+
+	using util::Stream;
+
+	char magic[8] = {};
+	int version = 0;
+	Stream(is, magic);
+	Stream(is, version);
+	if (memcmp(magic, kBinaryMagic, sizeof(magic)) != 0 || version != kBinaryVersion)
+	{
+		error = "not a test vector file";
+		return false;
+	}
+
+	size_t count = 0;
+	if (!ReadCount(is, fileSize, kMinBinaryTestSize, count))
+	{
+		error = "file truncated";
+		return false;
+	}
+
+	tests.resize(count);
+	for (auto& test : tests)
+	{
+		if (!ReadString(is, fileSize, test.name)
+			|| !ReadState(is, fileSize, test.initial)
+			|| !ReadState(is, fileSize, test.final))
+		{
+			error = "file truncated";
+			return false;
+		}
+		Stream(is, test.length);
+	}
+
+	if (!is)
+	{
+		error = "file truncated";
+		return false;
+	}
+	return true;
+}
+
+bool cputest::SaveBinaryTests(const std::string& filename, const std::vector<TestCase>& tests)
+{
+	std::ofstream os(filename, std::ios::out | std::ios::binary);
+	if (!os.is_open())
+		return false;
+
+	using util::Stream;
+
+	Stream(os, kBinaryMagic);
+	Stream(os, kBinaryVersion);
+	Stream(os, tests.size());
+	for (auto& test : tests)
+	{
+		util::StreamString(os, test.name);
+		WriteState(os, test.initial);
+		WriteState(os, test.final);
+		Stream(os, test.length);
+	}
+
+	return os.good();
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace cputest
+{
+	/// Processor state before or after a single-step test.
+	struct TestState
+	{
+		uint32_t d[8] = {};
+		uint32_t a[7] = {};
+		uint32_t usp = 0;
+		uint32_t ssp = 0;
+		uint32_t pc = 0;
+		uint16_t sr = 0;
+		uint16_t prefetch[2] = {};
+		std::vector<std::pair<uint32_t, uint8_t>> ram;
+	};
+
+	struct TestCase
+	{
+		std::string name;
+		TestState initial;
+		TestState final;
+		uint32_t length = 0; // cycles
+	};
+
+	/// Loads single-step test vectors from a JSON file (optionally gzip compressed) in the
+	/// layout used by the public 680x0 single-step test suites.
+	bool LoadJsonTests(const std::string& filename, std::vector<TestCase>& tests, std::string& error);
+
+	/// Loads/saves a compact binary form of the same tests, which is much quicker to load.
+	bool LoadBinaryTests(const std::string& filename, std::vector<TestCase>& tests, std::string& error);
+	bool SaveBinaryTests(const std::string& filename, const std::vector<TestCase>& tests);
+}
\ No newline at end of file
@@ -1,4 +1,6 @@
-﻿#include "../Emulator/amiga/disassembler.h"
+﻿#include "../Emulator/Amiga/disassembler.h"
+
+#include <cassert>
 
 #include <vector>
 #include <iostream>
@@ -21,13 +23,13 @@ struct MachineCode : public am::IMemory
 	{
 		if ((addr & 1) == 1)
 		{
-			_ASSERTE(false);
+			assert(false);
 			return 0;
 		}
 
 		if (addr >= memory.size())
 		{
-			_ASSERTE(false);
+			assert(false);
 			return 0;
 		}
 
@@ -40,7 +42,7 @@ struct MachineCode : public am::IMemory
 	virtual uint8_t GetByte(uint32_t) const override
 	{
 		// Not needed by the disassembler so leave unimplemented
-		_ASSERTE(false);
+		assert(false);
 		return 0;
 	}
 
@@ -69,7 +71,7 @@ int main()
 	while (d.pc < m.memory.size())
 	{
 		auto result = d.Disassemble();
-		std::cout << result << "\n";
+		std::cout << result.text << "\n";
 	}
 
 	return 0;
@@ -2,6 +2,7 @@
 
 #include "util/stream.h"
 
+#include <cstring>
 #include <functional>
 #include <utility>
 
@@ -9,15 +10,13 @@ using namespace cpu;
 
 namespace
 {
-	int gOpcodeGroups[16] = {};
-
 	struct InstructionCode
 	{
 		uint16_t mask;
 		uint16_t signature;
 	};
 
-	const InstructionCode kEncodingList[kNumOpcodeEntries] =
+	constexpr InstructionCode kEncodingList[kNumOpcodeEntries] =
 	{
 		{ 0b11111111'11111111,	0b00000000'00111100 }, //	ori     {imm:b}, CCR
 		{ 0b11111111'11111111,	0b00000000'01111100 }, //	ori     {imm:w}, SR
@@ -252,10 +251,14 @@ namespace
 		{ kSizeVariableNormal, 0 },																				//	ro{R}.{s}   D{REG}, D{reg}
 	};
 
-	bool BuildOpcodeGroupsTable()
+	// Index of the first entry in kEncodingList for each value of the top 4 bits of an opcode.
+	// Built at compile time so that no state is shared between cpu instances.
+	constexpr auto kOpcodeGroups = []()
 	{
 		const uint16_t groupMask = 0xf000;
 
+		std::array<int, 16> groups = {};
+
 		for (int i = 0; i < 16; i++)
 		{
 			uint16_t toMatch = uint16_t(i << 12);
@@ -264,13 +267,13 @@ namespace
 			{
 				if ((kEncodingList[j].signature & groupMask) == toMatch)
 				{
-					gOpcodeGroups[i] = j;
+					groups[i] = j;
 					break;
 				}
 			}
 		}
-		return true;
-	}
+		return groups;
+	}();
 
 	constexpr uint64_t SignExtend64(uint16_t value)
 	{
@@ -318,7 +321,7 @@ namespace
 
 }
 
-M68000::OpcodeInstruction M68000::OpcodeFunction[kNumOpcodeEntries] =
+const M68000::OpcodeInstruction M68000::OpcodeFunction[kNumOpcodeEntries] =
 {
 	&M68000::Opcode_bitwise_to_status,	//	ori     {imm:b}, CCR
 	&M68000::Opcode_bitwise_to_status,	//	ori     {imm:w}, SR
@@ -419,8 +422,6 @@ M68000::OpcodeInstruction M68000::OpcodeFunction[kNumOpcodeEntries] =
 M68000::M68000(IBus* bus)
 	: m_bus(bus)
 {
-	// TODO: Can this be done at compile time?
-	BuildOpcodeGroupsTable();
 }
 
 void M68000::Reset(int& delay)
@@ -481,7 +482,7 @@ bool M68000::DecodeOneInstruction(int& delay)
 
 	m_currentInstructionIndex = kNumOpcodeEntries; // represents illegal opcode
 
-	size_t instIndex = gOpcodeGroups[(m_operation & 0xf000) >> 12];
+	size_t instIndex = kOpcodeGroups[(m_operation & 0xf000) >> 12];
 	for (; instIndex < kNumOpcodeEntries; instIndex++)
 	{
 		if ((m_operation & kEncodingList[instIndex].mask) == kEncodingList[instIndex].signature)
@@ -898,6 +899,11 @@ bool M68000::ExecuteOneInstruction(int& delay)
 	{
 		result = std::invoke(OpcodeFunction[m_currentInstructionIndex], *this, delay);
 	}
+	else if ((m_operation & 0xf000) == 0xf000 && m_bus->LineFTrap(m_operation, m_regs))
+	{
+		// handled by the machine, in place of the Line 1111 Emulator exception.
+		result = true;
+	}
 	else
 	{
 		// illegal/unknown instruction.
@@ -2888,25 +2894,55 @@ bool M68000::Opcode_tas(int& delay)
 	return true;
 }
 
+namespace
+{
+	// Streamed a field at a time rather than copied whole, so saved state doesn't depend on the
+	// layout or padding of the structs. T is const when writing.
+
+	template <typename S, typename T>
+	void StreamRegisters(S& s, T& regs)
+	{
+		using util::Stream;
+
+		Stream(s, regs.a);
+		Stream(s, regs.d);
+		Stream(s, regs.altA7);
+		Stream(s, regs.pc);
+		Stream(s, regs.status);
+	}
+
+	template <typename S, typename T>
+	void StreamEa(S& s, T& ea)
+	{
+		using util::Stream;
+
+		Stream(s, ea.type);
+		Stream(s, ea.addrIdx);
+		Stream(s, ea.mode);
+		Stream(s, ea.xn);
+	}
+}
 
-template <typename S>
-void M68000::Stream(S& s)
+template <typename S, typename Self>
+void M68000::Stream(S& s, Self& self)
 {
 	using util::Stream;
 
-	Stream(s, m_regs);
-	Stream(s, m_executeState);
-	Stream(s, m_operationAddr);
-	Stream(s, m_currentInstructionIndex);
-	Stream(s, m_immediateValue);
-	Stream(s, m_interruptControl);
-	Stream(s, m_operation);
-	Stream(s, m_opcodeSize);
-	Stream(s, m_ea[0]);
-	Stream(s, m_ea[1]);
-	Stream(s, m_operationHistory);
-	Stream(s, m_operationHistoryPtr);
-}
-
-template void M68000::Stream<>(std::istream& s);
-template void M68000::Stream<>(std::ostream& s);
\ No newline at end of file
+	StreamRegisters(s, self.m_regs);
+	Stream(s, self.m_executeState);
+	Stream(s, self.m_operationAddr);
+	Stream(s, self.m_currentInstructionIndex);
+	Stream(s, self.m_immediateValue);
+	Stream(s, self.m_interruptControl);
+	Stream(s, self.m_operation);
+	Stream(s, self.m_opcodeSize);
+	StreamEa(s, self.m_ea[0]);
+	StreamEa(s, self.m_ea[1]);
+	Stream(s, self.m_operationHistory);
+	Stream(s, self.m_operationHistoryPtr);
+}
+
+template void M68000::Stream<>(std::istream& s, M68000& self);
+template void M68000::Stream<>(std::ostream& s, const M68000& self);
+template void M68000::Stream<>(util::MemoryReader& s, M68000& self);
+template void M68000::Stream<>(util::MemoryWriter& s, const M68000& self);
\ No newline at end of file
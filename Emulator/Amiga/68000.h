@@ -74,6 +74,14 @@ namespace cpu
 		virtual void WriteBusWord(uint32_t addr, uint16_t value) = 0;
 		virtual uint8_t ReadBusByte(uint32_t addr) = 0;
 		virtual void WriteBusByte(uint32_t addr, uint8_t value) = 0;
+
+		// Offered each line 1111 (unimplemented) opcode before the exception is taken. Returns true
+		// if the opcode was handled instead, in which case the pc (still the opcode's address) must be
+		// moved on by the handler.
+		virtual bool LineFTrap(uint16_t opcode, Registers& regs)
+		{
+			return false;
+		}
 	};
 
 	class M68000
@@ -88,6 +96,11 @@ namespace cpu
 			return m_regs;
 		}
 
+		void SetRegisters(const Registers& regs)
+		{
+			m_regs = regs;
+		}
+
 		void SetPC(uint32_t pc)
 		{
 			m_regs.pc = pc;
@@ -116,6 +129,13 @@ namespace cpu
 		bool DecodeOneInstruction(int& delay);
 		bool ExecuteOneInstruction(int& delay);
 
+		// Index into the opcode encoding list of the last decoded instruction. Returns kNumOpcodeEntries
+		// for an illegal instruction and ~0 for a privileged instruction decoded in user mode.
+		uint32_t GetCurrentInstructionIndex() const
+		{
+			return m_currentInstructionIndex;
+		}
+
 		std::pair<const std::array<uint32_t, 32>*, uint32_t> GetOperationHistory() const
 		{
 			return std::make_pair(&m_operationHistory, m_operationHistoryPtr);
@@ -123,8 +143,9 @@ namespace cpu
 
 		void SetInterruptControl(int intLevel);
 
-		template <typename S>
-		void Stream(S& s);
+		// Self is const when writing.
+		template <typename S, typename Self>
+		static void Stream(S& s, Self& self);
 
 	private:
 
@@ -250,10 +271,10 @@ namespace cpu
 		EA m_ea[2];
 
 		std::array<uint32_t, 32> m_operationHistory;
-		uint32_t m_operationHistoryPtr;
+		uint32_t m_operationHistoryPtr = 0;
 
 		typedef bool (cpu::M68000::* OpcodeInstruction)(int&);
-		static OpcodeInstruction OpcodeFunction[kNumOpcodeEntries];
+		static const OpcodeInstruction OpcodeFunction[kNumOpcodeEntries];
 
 	};
 
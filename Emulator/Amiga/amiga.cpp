@@ -6,9 +6,16 @@
 #include "util/platform.h"
 #include "util/strings.h"
 #include "util/stream.h"
+#include "util/hash.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <iterator>
 #include <sstream>
+#include <utility>
+
+#include <zlib.h>
 
 
 namespace
@@ -24,6 +31,14 @@ namespace
 	constexpr int kPAL_longFrameLines = 313;
 	constexpr int kPAL_shortFrameLines = 312;
 
+	// A disk revolution at 300rpm. Turbo floppy mode spins the disk 8x faster and raises the
+	// block finished interrupt a few lines after a transfer has been copied.
+	constexpr int kDiskRevolutionCClocks = 700000;
+	constexpr int kTurboDiskRevolutionCClocks = kDiskRevolutionCClocks / 8;
+	constexpr int kTurboDiskDmaDelay = 4 * kPAL_lineLength;
+
+	constexpr size_t kRomSize = 512 * 1024;
+
 	enum class RegType : uint8_t
 	{
 		Reserved,
@@ -323,6 +338,26 @@ namespace
 	{
 		return (uint32_t(m) & uint32_t(am::Mapped::Shared)) != 0;
 	}
+
+	const char* const kSubsystemNames[] =
+	{
+		"other",
+		"dma",
+		"copper",
+		"cpu",
+		"blitter",
+		"display",
+		"cia",
+		"floppy",
+		"audio",
+	};
+
+	static_assert(std::size(kSubsystemNames) == size_t(am::Subsystem::NumSubsystems));
+}
+
+const char* am::GetSubsystemName(Subsystem subsystem)
+{
+	return kSubsystemNames[size_t(subsystem)];
 }
 
 am::Amiga::Amiga(ChipRamConfig chipRamConfig, util::Log* log)
@@ -331,14 +366,35 @@ am::Amiga::Amiga(ChipRamConfig chipRamConfig, util::Log* log)
 	, m_log(log)
 {
 	m_chipRam.resize(size_t(chipRamConfig));
-	m_rom.resize(512*1024, 0xcc);
-	m_registers.resize(_countof(registerInfo), 0x0000);
+	ResetDirtyPages();
+	m_romCopy.resize(kRomSize, 0xcc);
+	m_rom = m_romCopy;
+	m_registers.resize(std::size(registerInfo), 0x0000);
 	m_m68000 = std::make_unique<cpu::M68000>(this);
 }
 
 void am::Amiga::SetRom(std::span<const uint8_t> rom)
 {
-	memcpy(m_rom.data(), rom.data(), std::min(rom.size(), m_rom.size()));
+	std::vector<uint8_t> romCopy(kRomSize, 0xcc);
+	memcpy(romCopy.data(), rom.data(), std::min(rom.size(), romCopy.size()));
+
+	m_romFile.reset();
+	m_romCopy = std::move(romCopy);
+	m_rom = m_romCopy;
+	Reset();
+}
+
+void am::Amiga::SetRom(std::shared_ptr<const util::MappedFile> romFile)
+{
+	if (!romFile || romFile->GetData().size() != kRomSize)
+	{
+		SetRom(romFile ? romFile->GetData() : std::span<const uint8_t>());
+		return;
+	}
+
+	m_romFile = std::move(romFile);
+	m_romCopy = {};
+	m_rom = m_romFile->GetData();
 	Reset();
 }
 
@@ -456,9 +512,20 @@ uint16_t am::Amiga::PeekWord(uint32_t addr) const
 void am::Amiga::PokeByte(uint32_t addr, uint8_t value)
 {
 	auto [type, mem] = GetMappedMemory(addr);
+
+	if (type == Mapped::Rom && m_romFile && mem >= m_rom.data() && mem < m_rom.data() + m_rom.size())
+	{
+		// The rom is a read-only mapping of its file, so patch a copy of it instead.
+		m_romCopy.assign(m_rom.begin(), m_rom.end());
+		m_romFile.reset();
+		m_rom = m_romCopy;
+		std::tie(type, mem) = GetMappedMemory(addr);
+	}
+
 	if (mem)
 	{
 		*mem = value;
+		MarkRamDirty(type, mem);
 	}
 }
 
@@ -467,9 +534,13 @@ std::tuple<am::Mapped, uint8_t*> am::Amiga::GetMappedMemory(uint32_t addr)
 	// ignore the most-significant byte. The 68000-based Amigas only have a 24-bit address bus.
 	addr &= 0x00ff'ffff;
 
+	// The rom may be a read-only mapping of the rom file, but is never written through the pointer
+	// returned, as writes are not made to Mapped::Rom.
+	uint8_t* rom = const_cast<uint8_t*>(m_rom.data());
+
 	if (m_romOverlayEnabled && addr < m_rom.size())
 	{
-		return { Mapped::Rom, m_rom.data() + addr };
+		return { Mapped::Rom, rom + addr };
 	}
 
 	if (addr < 0x20'0000)
@@ -482,7 +553,7 @@ std::tuple<am::Mapped, uint8_t*> am::Amiga::GetMappedMemory(uint32_t addr)
 
 	if (addr < 0xa0'0000)
 	{
-		return { Mapped::AutoConfig, nullptr };
+		return GetExpansionMemory(addr);
 	}
 
 	if (addr < 0xbf'0000)
@@ -503,6 +574,11 @@ std::tuple<am::Mapped, uint8_t*> am::Amiga::GetMappedMemory(uint32_t addr)
 			return { Mapped::SlowRam, m_slowRam.data() + (addr - 0xc0'0000) };
 		}
 
+		if (m_gayle.IsAttached() && ((addr & 0xfe'0000) == Gayle::kRegisterBase || (addr & 0xff'0000) == Gayle::kIdRegisterBase))
+		{
+			return { Mapped::Ide, nullptr };
+		}
+
 		return { Mapped::ChipRegisters, nullptr };
 	}
 
@@ -513,7 +589,7 @@ std::tuple<am::Mapped, uint8_t*> am::Amiga::GetMappedMemory(uint32_t addr)
 
 	if (addr < 0xf0'0000)
 	{
-		return { Mapped::AutoConfig, nullptr };
+		return GetExpansionMemory(addr);
 	}
 
 	if (addr < 0xf8'0000)
@@ -525,7 +601,19 @@ std::tuple<am::Mapped, uint8_t*> am::Amiga::GetMappedMemory(uint32_t addr)
 
 	// Rom
 	const uint32_t romMask = uint32_t(m_rom.size()) - 1;
-	return { Mapped::Rom, m_rom.data() + ((addr - 0xf8'0000) & romMask) };
+	return { Mapped::Rom, rom + ((addr - 0xf8'0000) & romMask) };
+}
+
+std::tuple<am::Mapped, uint8_t*> am::Amiga::GetExpansionMemory(uint32_t addr)
+{
+	// The only expansion board is the host file system's, once it has been configured.
+	bool readOnly = false;
+	if (uint8_t* mem = m_hostFs.GetBoardMemory(addr, readOnly))
+	{
+		return { readOnly ? Mapped::Rom : Mapped::FastRam, mem };
+	}
+
+	return { Mapped::AutoConfig, nullptr };
 }
 
 uint16_t am::Amiga::ReadBusWord(uint32_t addr)
@@ -556,6 +644,16 @@ uint16_t am::Amiga::ReadBusWord(uint32_t addr)
 				return ReadRegister(regNum);
 			}
 		}
+		else if (type == Mapped::Ide)
+		{
+			const uint16_t value = m_gayle.ReadWord(addr);
+			DoInterruptRequest();
+			return value;
+		}
+		else if (type == Mapped::AutoConfig)
+		{
+			return (uint16_t(m_hostFs.ReadConfigByte(addr)) << 8) | m_hostFs.ReadConfigByte(addr + 1);
+		}
 
 		// TODO : implement register/peripheral access
 		return 0;
@@ -578,6 +676,7 @@ void am::Amiga::WriteBusWord(uint32_t addr, uint16_t value)
 	{
 		value = SwapEndian(value);
 		memcpy(mem, &value, 2);
+		MarkRamDirty(type, mem);
 	}
 	else
 	{
@@ -593,6 +692,16 @@ void am::Amiga::WriteBusWord(uint32_t addr, uint16_t value)
 		{
 			// TODO : implement CIA access
 		}
+		else if (type == Mapped::Ide)
+		{
+			m_gayle.WriteWord(addr, value);
+			DoInterruptRequest();
+		}
+		else if (type == Mapped::AutoConfig)
+		{
+			// The configuration registers are only a byte wide, on the upper half of the bus.
+			m_hostFs.WriteConfigByte(addr, uint8_t(value >> 8));
+		}
 	}
 }
 
@@ -646,6 +755,16 @@ uint8_t am::Amiga::ReadBusByte(uint32_t addr)
 				}
 			}
 		}
+		else if (type == Mapped::Ide)
+		{
+			const uint8_t value = m_gayle.ReadByte(addr);
+			DoInterruptRequest();
+			return value;
+		}
+		else if (type == Mapped::AutoConfig)
+		{
+			return m_hostFs.ReadConfigByte(addr);
+		}
 
 		// TODO : implement register/peripheral access
 		return 0;
@@ -667,6 +786,7 @@ void am::Amiga::WriteBusByte(uint32_t addr, uint8_t value)
 	if (mem && type != Mapped::Rom)
 	{
 		*mem = value;
+		MarkRamDirty(type, mem);
 	}
 	else
 	{
@@ -694,7 +814,31 @@ void am::Amiga::WriteBusByte(uint32_t addr, uint8_t value)
 				WriteRegister(regNum, wordValue);
 			}
 		}
+		else if (type == Mapped::Ide)
+		{
+			m_gayle.WriteByte(addr, value);
+			DoInterruptRequest();
+		}
+		else if (type == Mapped::AutoConfig)
+		{
+			m_hostFs.WriteConfigByte(addr, value);
+		}
+	}
+}
+
+bool am::Amiga::LineFTrap(uint16_t opcode, cpu::Registers& regs)
+{
+	if (!m_hostFs.IsMounted() || !HostFileSystem::IsTrap(opcode))
+		return false;
+
+	// The host's files aren't part of the saved state, so they are left alone while running
+	// ahead. The pc stays on the trap, which repeats until the frame is run for real.
+	if (!m_runningAhead)
+	{
+		m_hostFs.Trap(opcode, regs);
+		regs.pc += 2;
 	}
+	return true;
 }
 
 uint16_t am::Amiga::ReadChipWord(uint32_t addr) const
@@ -710,6 +854,7 @@ void am::Amiga::WriteChipWord(uint32_t addr, uint16_t value)
 	const uint32_t chipRamMask = uint32_t(m_chipRam.size()) - 1;
 	value = SwapEndian(value);
 	memcpy(&m_chipRam[addr & chipRamMask], &value, 2);
+	m_chipRamDirty.Mark(addr & chipRamMask);
 }
 
 bool am::Amiga::ExecuteFor(uint64_t cclocks)
@@ -725,6 +870,88 @@ bool am::Amiga::ExecuteFor(uint64_t cclocks)
 	return m_running;
 }
 
+// Run until the current frame has been completed and swapped to the last screen.
+bool am::Amiga::ExecuteFrame()
+{
+	const auto frame = m_frameCount;
+
+	m_running = true;
+
+	while (m_running && m_frameCount == frame)
+	{
+		DoOneTick();
+	}
+	return m_running;
+}
+
+bool am::Amiga::ExecuteFrame(uint64_t stopAtCClock)
+{
+	const auto frame = m_frameCount;
+
+	m_running = true;
+
+	while (m_running && m_frameCount == frame && m_totalCClocks < stopAtCClock)
+	{
+		DoOneTick();
+	}
+	return m_running;
+}
+
+void am::Amiga::RunAhead(int frames)
+{
+	if (frames <= 0)
+		return;
+
+	SaveState(m_runAheadState);
+	m_runAheadChipRamDirty = m_chipRamDirty;
+	m_runAheadSlowRamDirty = m_slowRamDirty;
+
+	// Frame skip, audio output and the display aren't part of the saved state.
+	const auto frameSkip = m_frameSkip;
+	const auto frameSkipCounter = m_frameSkipCounter;
+	const auto skipFrameOutput = m_skipFrameOutput;
+	m_runAheadPlayfieldBuffer = m_playfieldBuffer;
+
+	// The frames run ahead are drawn into a screen of their own, so the lines of the frame
+	// being drawn for real are kept as they are. Only when the frame we start in is also the
+	// one presented does it need the lines drawn so far.
+	if (!m_runAheadScreen)
+	{
+		m_runAheadScreen = std::make_unique<ScreenBuffer>();
+	}
+	if (frames == 1)
+	{
+		*m_runAheadScreen = *m_currentScreen;
+	}
+	std::swap(m_currentScreen, m_runAheadScreen);
+
+	// Only draw the last frame. The partly emulated frame we start in counts as the first.
+	m_frameSkip = frames - 1;
+	m_frameSkipCounter = (frames > 1) ? 1 : 0;
+	m_skipFrameOutput = (frames > 1);
+	m_runningAhead = true;
+	m_gayle.SetRunningAhead(true);
+
+	for (int i = 0; i < frames && ExecuteFrame(); i++)
+	{
+	}
+
+	m_runningAhead = false;
+	m_gayle.SetRunningAhead(false);
+
+	LoadState(m_runAheadState);
+	m_chipRamDirty = m_runAheadChipRamDirty;
+	m_slowRamDirty = m_runAheadSlowRamDirty;
+
+	// Whatever frame was presented last is left in m_lastScreen.
+	std::swap(m_currentScreen, m_runAheadScreen);
+	m_playfieldBuffer = m_runAheadPlayfieldBuffer;
+
+	m_frameSkip = frameSkip;
+	m_frameSkipCounter = frameSkipCounter;
+	m_skipFrameOutput = skipFrameOutput;
+}
+
 bool am::Amiga::ExecuteOneCpuInstruction()
 {
 	while (!CpuReady())
@@ -766,14 +993,18 @@ bool am::Amiga::ExecuteToEndOfCpuInstruction()
 
 void am::Amiga::DoOneTick()
 {
+	EnterSubsystem(Subsystem::Dma);
 	bool chipBusBusy = DoScanlineDma();
 
 	const bool evenClock = (m_hPos & 1) == 0;
 	if (evenClock)
 	{
+		EnterSubsystem(Subsystem::Copper);
 		DoCopper(chipBusBusy);
 	}
 
+	EnterSubsystem(Subsystem::Cpu);
+
 	if (m_m68000->GetExecutionState() == cpu::ExecuteState::ReadyToDecode && CpuReady())
 	{
 		if (m_breakAtNextInstruction || (m_breakpointEnabled && m_m68000->GetPC() == m_breakpoint))
@@ -837,8 +1068,11 @@ void am::Amiga::DoOneTick()
 		}
 	}
 
+	EnterSubsystem(Subsystem::Display);
 	UpdateScreen();
 
+	EnterSubsystem(Subsystem::Other);
+
 	if (m_blitterCountdown > 0)
 	{
 		--m_blitterCountdown;
@@ -851,6 +1085,8 @@ void am::Amiga::DoOneTick()
 		}
 	}
 
+	EnterSubsystem(Subsystem::Cia);
+
 	m_timerCountdown--;
 	if (m_timerCountdown == 0)
 	{
@@ -870,66 +1106,34 @@ void am::Amiga::DoOneTick()
 	}
 
 	// Update Floppy
+	EnterSubsystem(Subsystem::Floppy);
 	if (m_driveSelected != -1 && IsDiskInserted(m_driveSelected))
 	{
 		if (m_floppyDrive[m_driveSelected].motorOn)
 		{
 			m_diskRotationCountdown--;
-			if (m_diskRotationCountdown == 0)
+			if (m_diskRotationCountdown <= 0)
 			{
 				// Each revolution of the disk sets the CIAB flag signal
 				SetCIAInterrupt(m_cia[1], 0x10);
-				m_diskRotationCountdown = 700000;
+				m_diskRotationCountdown = GetDiskRevolutionCClocks();
 			}
 		}
 	}
 
+	if (m_diskDma.turboFinishCountdown > 0 && --m_diskDma.turboFinishCountdown == 0)
+	{
+		FinishDiskDMA();
+	}
+
 	// Update Audio
+	EnterSubsystem(Subsystem::Audio);
 	for (int i = 0; i < 4; i++)
 	{
 		UpdateAudioChannel(i);
 	}
 
-	if (m_audioBufferCountdown == 0)
-	{
-		m_audioBufferCountdown = 100;
-
-		for (int i = 0; i < 2; i++)
-		{
-			auto& audioBuffer = m_audioBuffer[i];
-			auto pos = m_audioBufferPos * 2;
-			auto channel = i * 2;
-
-			auto GetSample = [this](int channel) -> uint8_t
-			{
-				auto& a = m_audio[channel];
-
-				if (a.volume == 64)
-				{
-					return a.currentSample ^ 0x80;
-				}
-				else
-				{
-					return uint8_t((int32_t(int8_t(a.currentSample)) * int32_t(a.volume) * 4) / 256) ^ 0x80;
-				}
-			};
-
-			audioBuffer[pos + 0] = GetSample(channel + 0);
-			audioBuffer[pos + 1] = GetSample(channel + 1);
-		}
-
-		m_audioBufferPos++;
-		if (m_audioBufferPos == kAudioBufferLength)
-		{
-			if (m_audioPlayer)
-			{
-				m_audioPlayer->AddAudioBuffer(&m_audioBuffer);
-			}
-			m_audioBufferPos = 0;
-		}
-
-	}
-	m_audioBufferCountdown--;
+	EnterSubsystem(Subsystem::Other);
 
 	m_totalCClocks++;
 	m_hPos++;
@@ -940,6 +1144,12 @@ void am::Amiga::DoOneTick()
 	{
 		m_hPos = 0;
 
+		// As with the levels, the output doesn't move on while running ahead.
+		if (!m_runningAhead)
+		{
+			m_audioSynth.Advance(m_totalCClocks);
+		}
+
 		if (m_isNtsc)
 		{
 			m_lineLength ^= 0b111; // Flip the last three bits to alternate between line lengths of 227/228
@@ -1014,6 +1224,8 @@ void am::Amiga::Reset()
 
 	::memset(m_chipRam.data(), 0, m_chipRam.size());
 	::memset(m_slowRam.data(), 0, m_slowRam.size());
+	m_chipRamDirty.MarkAll();
+	m_slowRamDirty.MarkAll();
 
 	m_palette.fill(ColourRef(0));
 
@@ -1051,10 +1263,15 @@ void am::Amiga::Reset()
 	m_sharedBusRws = 0;
 	m_exclusiveBusRws = 0;
 	m_totalCClocks = 0;
+	m_firstDriveSelectCClock = 0;
 
 	m_currentScreen->fill(0);
 	m_lastScreen->fill(0);
 
+	m_frameCount = 0;
+	m_frameSkipCounter = 0;
+	m_skipFrameOutput = false;
+
 	m_pixelBufferLoadPtr = 0;
 	m_pixelBufferReadPtr = 0;
 
@@ -1067,19 +1284,16 @@ void am::Amiga::Reset()
 
 	m_diskDma = {};
 
-	m_audioBufferCountdown = 0;
-	m_audioBufferPos = 0;
+	m_gayle.Reset();
+	m_hostFs.Reset();
 
 	for (int i = 0; i < 4; i++)
 	{
 		m_audio[i] = {};
 	}
 
-	for (int i = 0; i < 2; i++)
-	{
-		m_audioBuffer[i].clear();
-		m_audioBuffer[i].resize(kAudioBufferLength * 2);
-	}
+	m_audioSynth.SetClockRate(m_isNtsc ? kNtscColourClockRate : kPalColourClockRate);
+	ResyncAudioOutput();
 
 	m_m68000->Reset(m_cpuBusyTimer);
 
@@ -1413,6 +1627,8 @@ void am::Amiga::TickCIATimers()
 
 void am::Amiga::SetControllerButton(int controller, int button, bool pressed)
 {
+	RecordInput(InputType::ControllerButton, controller, button, pressed);
+
 	switch (button)
 	{
 
@@ -1460,6 +1676,11 @@ void am::Amiga::SetControllerButton(int controller, int button, bool pressed)
 
 void am::Amiga::SetMouseMove(int x, int y)
 {
+	if (x == 0 && y == 0)
+		return;
+
+	RecordInput(InputType::MouseMove, x, y);
+
 	auto& joy0dat = Reg(Register::JOY0DAT);
 
 	auto vertCount = (joy0dat >> 8) & 0xff;
@@ -1480,21 +1701,30 @@ void am::Amiga::SetJoystickMove(int x, int y)
 	const bool up = (y >= 0);
 	const bool down = (y <= 0);
 
-	joy1dat = 0;
+	uint16_t value = 0;
 
 	if (!right)
-		joy1dat |= 0x0002;
+		value |= 0x0002;
 	if (right ^ down)
-		joy1dat |= 0x0001;
+		value |= 0x0001;
 
 	if (!left)
-		joy1dat |= 0x0200;
+		value |= 0x0200;
 	if (left ^ up)
-		joy1dat |= 0x0100;
+		value |= 0x0100;
+
+	// This is called with the current stick position every update, so only record changes.
+	if (joy1dat != value)
+	{
+		RecordInput(InputType::JoystickMove, x, y);
+		joy1dat = value;
+	}
 }
 
 void am::Amiga::QueueKeyPress(uint8_t keycode)
 {
+	RecordInput(InputType::KeyPress, keycode);
+
 	if ((m_keyQueueBack + 1) % kKeyQueueSize == m_keyQueueFront)
 		return; // key buffer full
 
@@ -1537,7 +1767,7 @@ uint16_t am::Amiga::UpdateFlagRegister(am::Register r, uint16_t value)
 uint16_t am::Amiga::ReadRegister(uint32_t regNum)
 {
 	auto regIndex = regNum / 2;
-	if (regIndex >= _countof(registerInfo))
+	if (regIndex >= std::size(registerInfo))
 		return 0x0000;
 
 	const auto& regInfo = registerInfo[regIndex];
@@ -1571,7 +1801,7 @@ uint16_t am::Amiga::ReadRegister(uint32_t regNum)
 void am::Amiga::WriteRegister(uint32_t regNum, uint16_t value)
 {
 	auto regIndex = regNum / 2;
-	if (regIndex >= _countof(registerInfo))
+	if (regIndex >= std::size(registerInfo))
 		return;
 
 	const auto& regInfo = registerInfo[regIndex];
@@ -1622,6 +1852,7 @@ void am::Amiga::WriteRegister(uint32_t regNum, uint16_t value)
 		m_diskDma.writing = (value & 0x4000) != 0;
 		m_diskDma.len = (value & 0x3fff);
 		m_diskDma.inProgress = false;
+		m_diskDma.turboFinishCountdown = 0;
 
 		if (currentlyEnabled && m_diskDma.secondaryDmaEnabled)
 		{
@@ -1790,6 +2021,7 @@ void am::Amiga::WriteRegister(uint32_t regNum, uint16_t value)
 		const int channel = ((regNum & ~1) - int(am::Register::AUD0VOL)) / 16;
 		const uint8_t volume = std::min(value & 0x007f, 0x40);
 		m_audio[channel].volume = volume;
+		OutputAudioLevel(channel);
 	}	break;
 
 	case am::Register::AUD0DAT:
@@ -2089,12 +2321,12 @@ void am::Amiga::DoInterruptRequest()
 	// The interrupt request or mask registers have potentially been altered.
 	// So see if we need to inform the CPU of an interrupt request (and at which level).
 
-	// Also check if either CIA chip is signalling an interrupt
+	// Also check if either CIA chip (or Gayle, which shares CIAA's level) is signalling an interrupt
 
 	auto& intreqr = Reg(Register::INTREQR);
 	auto& intenar = Reg(Register::INTENAR);
 
-	if (m_cia[0].intSignal) // CIAA
+	if (m_cia[0].intSignal || m_gayle.IsInterrupting()) // CIAA
 	{
 		intreqr |= 0x0008;
 	}
@@ -2303,6 +2535,41 @@ void am::Amiga::DoCopper(bool& chipBusBusy)
 	}
 }
 
+am::ColourRef am::Amiga::HoldAndModify(uint8_t value)
+{
+	const uint32_t sel = (value >> 4) & 0b11;
+	const uint32_t mod = value & 0xf;
+
+	auto& heldCol = m_bitplane.heldCol;
+
+	switch (sel)
+	{
+	case 0b00: // new palette colour
+		heldCol = m_palette[mod];
+		break;
+
+	case 0b01: // new blue channel value
+		heldCol &= 0xff00ffff;
+		heldCol |= mod << 16;
+		heldCol |= mod << 20;
+		break;
+
+	case 0b10: // new red channel value
+		heldCol &= 0xffffff00;
+		heldCol |= mod;
+		heldCol |= mod << 4;
+		break;
+
+	case 0b11: // new green channel value
+		heldCol &= 0xffff00ff;
+		heldCol |= mod << 8;
+		heldCol |= mod << 12;
+		break;
+	}
+
+	return heldCol;
+}
+
 void am::Amiga::UpdateScreen()
 {
 	// early return for non-displayable lines
@@ -2327,8 +2594,21 @@ void am::Amiga::UpdateScreen()
 	else if (xPos == 0 && bufferLine == (m_isNtsc ? 216 : 272))
 	{
 		// Swap the screens immediately once the bottom line is finished.
-		std::swap(m_currentScreen, m_lastScreen);
-		m_currentScreen->fill(0);
+		// A skipped frame was never drawn so the last drawn frame stays as the visible one.
+		if (!m_skipFrameOutput)
+		{
+			std::swap(m_currentScreen, m_lastScreen);
+		}
+
+		m_frameCount++;
+
+		m_frameSkipCounter = (m_frameSkip > 0) ? (m_frameSkipCounter + 1) % (m_frameSkip + 1) : 0;
+		m_skipFrameOutput = (m_frameSkipCounter != 0);
+
+		if (!m_skipFrameOutput)
+		{
+			m_currentScreen->fill(0);
+		}
 		return;
 	}
 
@@ -2475,7 +2755,7 @@ void am::Amiga::UpdateScreen()
 					auto startIndex = m_windowStartX - 0x79;
 
 					// has a higher priority sprite already been written to this pixel?
-					if (loresPixelPos >= startIndex && s <= spriteNum[x])
+					if (!m_skipFrameOutput && loresPixelPos >= startIndex && s <= spriteNum[x])
 					{
 						const auto sprdata = Reg(Register(int(Register::SPR0DATA) + s * 8));
 						const auto sprdatb = Reg(Register(int(Register::SPR0DATB) + s * 8));
@@ -2518,6 +2798,19 @@ void am::Amiga::UpdateScreen()
 			}
 		}
 
+		if (m_skipFrameOutput)
+		{
+			// Nothing is drawn on a skipped frame but the HAM colour is still held across pixels and lines.
+			if (m_bitplane.ham)
+			{
+				for (int i = 0; i < valueIndex; i++)
+				{
+					HoldAndModify(values[i]);
+				}
+			}
+			return;
+		}
+
 		auto index = bufferLine * kScreenBufferWidth + (xPos * 4);
 		for (int i = 0; i < valueIndex; i++)
 		{
@@ -2545,37 +2838,7 @@ void am::Amiga::UpdateScreen()
 
 			if (m_bitplane.ham)
 			{
-				const uint32_t sel = (values[i] >> 4) & 0b11;
-				const uint32_t mod = values[i] & 0xf;
-
-				auto& heldCol = m_bitplane.heldCol;
-
-				switch (sel)
-				{
-				case 0b00: // new palette colour
-					heldCol = m_palette[mod];
-					break;
-
-				case 0b01: // new blue channel value
-					heldCol &= 0xff00ffff;
-					heldCol |= mod << 16;
-					heldCol |= mod << 20;
-					break;
-
-				case 0b10: // new red channel value
-					heldCol &= 0xffffff00;
-					heldCol |= mod;
-					heldCol |= mod << 4;
-					break;
-
-				case 0b11: // new green channel value
-					heldCol &= 0xffff00ff;
-					heldCol |= mod << 8;
-					heldCol |= mod << 12;
-					break;
-				}
-
-				col = heldCol;
+				col = HoldAndModify(values[i]);
 			}
 			else
 			{
@@ -2593,7 +2856,7 @@ void am::Amiga::UpdateScreen()
 	}
 	else
 	{
-		if (xPos >= 0 && xPos < 0xa8)
+		if (!m_skipFrameOutput && xPos >= 0 && xPos < 0xa8)
 		{
 			for (int x = 0; x < 4; x++)
 			{
@@ -2663,7 +2926,7 @@ namespace
 	// Lookup tables for appying inclusive and exclusive
 	// fill algorithms to a nibble of data.
 
-	uint8_t inFill[2][16] =
+	const uint8_t inFill[2][16] =
 	{
 		// without carry in
 		{
@@ -2705,7 +2968,7 @@ namespace
 		}
 	};
 
-	uint8_t exFill[2][16] =
+	const uint8_t exFill[2][16] =
 	{
 		// without carry in
 		{
@@ -2751,6 +3014,8 @@ namespace
 
 void am::Amiga::DoInstantBlitter()
 {
+	const auto previousSubsystem = EnterSubsystem(Subsystem::Blitter);
+
 	const auto con0 = Reg(Register::BLTCON0);
 	const auto con1 = Reg(Register::BLTCON1);
 	m_blitter.minterm = uint8_t(con0 & 0xff);
@@ -3019,6 +3284,8 @@ void am::Amiga::DoInstantBlitter()
 		dmaconr |= 0x4000; // set BBUSY bit
 		m_blitterCountdown = blitClks;
 	}
+
+	EnterSubsystem(previousSubsystem);
 }
 
 bool am::Amiga::DoScanlineDma()
@@ -3075,7 +3342,7 @@ bool am::Amiga::DoScanlineDma()
 
 	if (m_bpFetchState == BpFetchState::Fetching || m_bpFetchState == BpFetchState::Finishing)
 	{
-		static constexpr uint8_t kPlaneReadOrderLores[8] = { ~0, 3, 5, 1, ~0, 2, 4, 0 };
+		static constexpr uint8_t kPlaneReadOrderLores[8] = { uint8_t(~0), 3, 5, 1, uint8_t(~0), 2, 4, 0 };
 		static constexpr uint8_t kPlaneReadOrderHires[8] = {  3, 1, 2, 0,  3, 1, 2, 0 };
 
 		int bp = m_bitplane.hires
@@ -3178,20 +3445,73 @@ const std::string& am::Amiga::GetDiskFilename(int driveNum) const
 	return m_floppyDisk[driveNum].fileLocation;
 }
 
-bool am::Amiga::SetDisk(int driveNum, const std::string& filename, const std::string& displayName, std::vector<uint8_t>&& data)
+bool am::Amiga::SetHardDisk(const std::string& hdfFile)
+{
+	return m_gayle.Attach(hdfFile);
+}
+
+void am::Amiga::RemoveHardDisk()
+{
+	m_gayle.Detach();
+}
+
+bool am::Amiga::MountHostDirectory(const std::string& directory)
+{
+	return m_hostFs.Mount(directory);
+}
+
+void am::Amiga::UnmountHostDirectory()
+{
+	m_hostFs.Unmount();
+}
+
+bool am::Amiga::SetDisk(int driveNum, const std::string& filename, const std::string& displayName, std::vector<uint8_t>&& data, bool writeProtected)
+{
+	return InsertDisk(driveNum, filename, displayName, std::move(data), nullptr, writeProtected);
+}
+
+bool am::Amiga::SetDisk(int driveNum, const std::string& filename, const std::string& displayName, std::shared_ptr<const util::MappedFile> diskFile, bool writeProtected)
+{
+	if (!diskFile)
+		return false;
+
+	return InsertDisk(driveNum, filename, displayName, {}, std::move(diskFile), writeProtected);
+}
+
+bool am::Amiga::InsertDisk(int driveNum, const std::string& filename, const std::string& displayName, std::vector<uint8_t>&& data, std::shared_ptr<const util::MappedFile> mappedFile, bool writeProtected)
 {
 	assert(driveNum >= 0 && driveNum < 4);
 
-	if (filename.empty() || data.empty())
+	const auto diskData = mappedFile ? mappedFile->GetData() : std::span<const uint8_t>(data);
+
+	if (filename.empty() || diskData.empty())
+		return false;
+
+	DiskImage image;
+	if (!image.Reset(diskData))
 		return false;
 
 	auto& disk = m_floppyDisk[driveNum];
 
+	if (IsDiskInserted(driveNum))
+	{
+		CommitDiskWrites(driveNum);
+		if (m_diskWriteHandler)
+		{
+			m_diskWriteHandler->DiskEjected(disk);
+		}
+	}
+
 	disk.fileLocation = filename;
 	disk.displayName = displayName;
 	disk.data = std::move(data);
+	disk.mappedFile = std::move(mappedFile);
+	disk.image = std::move(image);
+	disk.writeProtected = writeProtected;
+
+	RecordInput(InputType::DiskInsert, driveNum, writeProtected, 0, &disk);
 
-	EncodeDiskImage(disk.data, disk.image);
+	UpdateFloppyDriveFlags();
 
 	return true;
 }
@@ -3202,16 +3522,41 @@ void am::Amiga::EjectDisk(int driveNum)
 
 	if (IsDiskInserted(driveNum))
 	{
+		RecordInput(InputType::DiskEject, driveNum);
+
 		auto& disk = m_floppyDisk[driveNum];
+
+		CommitDiskWrites(driveNum);
+		if (m_diskWriteHandler)
+		{
+			m_diskWriteHandler->DiskEjected(disk);
+		}
+
 		disk.displayName.clear();
 		disk.fileLocation.clear();
 		disk.data.clear();
-		disk.image.clear();
+		disk.mappedFile.reset();
+		disk.image.Reset(disk.data);
+		disk.writeProtected = true;
 
 		UpdateFloppyDriveFlags();
 	}
 }
 
+void am::Amiga::SetDiskWriteProtected(int driveNum, bool writeProtected)
+{
+	assert(driveNum >= 0 && driveNum < 4);
+
+	auto& disk = m_floppyDisk[driveNum];
+	if (!IsDiskInserted(driveNum) || disk.writeProtected == writeProtected)
+		return;
+
+	RecordInput(InputType::DiskWriteProtect, driveNum, writeProtected);
+
+	disk.writeProtected = writeProtected;
+	UpdateFloppyDriveFlags();
+}
+
 void am::Amiga::ProcessDriveCommands(uint8_t data)
 {
 	bool driveSelected = false;
@@ -3232,7 +3577,7 @@ void am::Amiga::ProcessDriveCommands(uint8_t data)
 			if (driveSelected)
 			{
 				// selected multiple drives? how to handle this?
-				_ASSERTE(false);
+				assert(false);
 			}
 			else
 			{
@@ -3248,7 +3593,7 @@ void am::Amiga::ProcessDriveCommands(uint8_t data)
 
 				if (drive.motorOn)
 				{
-					m_diskRotationCountdown = 700000;
+					m_diskRotationCountdown = GetDiskRevolutionCClocks();
 				}
 
 				// Set step signal to off for this drive so that it can be registered if set at same time as selection.
@@ -3270,6 +3615,11 @@ void am::Amiga::ProcessDriveCommands(uint8_t data)
 	}
 	else
 	{
+		if (m_firstDriveSelectCClock == 0)
+		{
+			m_firstDriveSelectCClock = m_totalCClocks;
+		}
+
 		auto& drive = m_floppyDrive[m_driveSelected];
 
 		if (step && !drive.stepSignal)
@@ -3308,6 +3658,13 @@ void am::Amiga::ProcessDriveCommands(uint8_t data)
 		drive.side = side ? 1 : 0;
 
 		drive.stepSignal = step;
+
+		// Encode the track under the head now, rather than on the first disk DMA read from it.
+		if (IsDiskInserted(m_driveSelected))
+		{
+			auto& disk = m_floppyDisk[m_driveSelected];
+			disk.image.GetTrack(disk.GetData(), drive.currCylinder, drive.side);
+		}
 	}
 
 	UpdateFloppyDriveFlags();
@@ -3337,7 +3694,7 @@ void am::Amiga::UpdateFloppyDriveFlags()
 		auto& drive = m_floppyDrive[m_driveSelected];
 
 		SetFlag(m_cia[0].pra, 0x04, drive.diskChange); // DSKCHANGE
-		SetFlag(m_cia[0].pra, 0x08, false); // DSKPROT (currently all disks appear write-protected)
+		SetFlag(m_cia[0].pra, 0x08, !IsDiskWriteProtected(m_driveSelected)); // DSKPROT (low when write protected)
 		SetFlag(m_cia[0].pra, 0x10, drive.currCylinder != 0); // DSKTRACK0
 		if (drive.motorOn)
 		{
@@ -3358,84 +3715,237 @@ void am::Amiga::StartDiskDMA()
 
 	m_diskDma.inProgress = true;
 
-	if (!m_diskDma.useWordSync)
+	// Word sync only applies to reads.
+	if (!m_diskDma.useWordSync || m_diskDma.writing)
 		return;
 
-	auto wordSync = Reg(Register::DSKSYNC);
-	if (wordSync == 0x4489)
-	{
-		// This is the most likely sync word as it is part of the MFM sector sync pattern.
-		// We therefore will hard-code the response to this, which is to skip the first three words.
-
-		const auto currentSector = m_diskDma.encodedSequenceCounter / kMfmSectorSize;
-		const auto currentSectorOffset = m_diskDma.encodedSequenceCounter % kMfmSectorSize;
+	// The transfer starts with the word following the next occurrence of the sync word under the
+	// head. If it never comes round (no disk or a track without it) the transfer never starts.
 
-		uint16_t nextSector = currentSector;
+	if (m_driveSelected == -1 || !m_floppyDrive[m_driveSelected].motorOn || !IsDiskInserted(m_driveSelected))
+	{
+		m_diskDma.inProgress = false;
+		return;
+	}
 
-		if (currentSector >= kSectorsPerTrack)
-		{
-			nextSector = 0;
-		}
-		else if (currentSectorOffset >= 6)
-		{
-			nextSector = ((currentSector + 1) % kSectorsPerTrack);
-		}
+	auto& drive = m_floppyDrive[m_driveSelected];
+	auto& disk = m_floppyDisk[m_driveSelected];
+	const auto positions = disk.image.GetSyncPositions(disk.GetData(), drive.currCylinder, drive.side, Reg(Register::DSKSYNC));
 
-		m_diskDma.encodedSequenceCounter = nextSector * kMfmSectorSize + 6;
-	}
-	else
+	if (positions.empty())
 	{
-		// TODO: How to respond to other Sync Words. Do we care?
-		DEBUGGER_BREAK();
+		m_diskDma.inProgress = false;
+		return;
 	}
+
+	const uint32_t bitLength = disk.image.GetTrackBitLength(drive.currCylinder, drive.side);
+
+	auto next = std::lower_bound(positions.begin(), positions.end(), GetDiskDmaPosition(bitLength));
+	if (next == positions.end())
+		next = positions.begin();
+
+	SetDiskDmaPosition((*next + 16) % bitLength);
 }
 
 void am::Amiga::DoDiskDMA()
 {
-	if (m_diskDma.writing)
-	{
-		// TODO : implement disk writing
-		DEBUGGER_BREAK();
-	}
-	else
-	{
-		uint16_t value = 0;
+	const auto previousSubsystem = EnterSubsystem(Subsystem::Floppy);
 
-		// Disk DMA continues even when drive is unselected or motor is switched off (reads zeros).
-
-		if (m_driveSelected > -1)
+	if (m_turboFloppy)
+	{
+		// Transfer the whole block in this slot. The interrupt follows a short time later, as software
+		// may not expect it before it has finished setting up the transfer.
+		while (m_diskDma.len > 0)
 		{
-			auto& drive = m_floppyDrive[m_driveSelected];
-			if (drive.motorOn)
+			if (m_diskDma.writing)
 			{
-				auto& disk = m_floppyDisk[m_driveSelected];
-				auto& track = disk.image[drive.currCylinder][drive.side];
-
-				value = track[m_diskDma.encodedSequenceCounter];
-				value <<= 8;
-				m_diskDma.encodedSequenceCounter = (m_diskDma.encodedSequenceCounter + 1) % track.size();
-				value |= uint16_t(track[m_diskDma.encodedSequenceCounter]);
-				m_diskDma.encodedSequenceCounter = (m_diskDma.encodedSequenceCounter + 1) % track.size();
+				WriteDiskDmaWord(ReadChipWord(m_diskDma.ptr));
 			}
-		}
-		WriteChipWord(m_diskDma.ptr, value);
+			else
+			{
+				WriteChipWord(m_diskDma.ptr, ReadDiskDmaWord());
+			}
+			m_diskDma.ptr += 2;
+			m_diskDma.len--;
+		}
+
+		m_diskDma.inProgress = false;
+		m_diskDma.turboFinishCountdown = kTurboDiskDmaDelay;
+
+		EnterSubsystem(previousSubsystem);
+		return;
+	}
+	else if (m_diskDma.writing)
+	{
+		WriteDiskDmaWord(ReadChipWord(m_diskDma.ptr));
+		m_diskDma.ptr += 2;
+	}
+	else
+	{
+		WriteChipWord(m_diskDma.ptr, ReadDiskDmaWord());
 		m_diskDma.ptr += 2;
 	}
 
 	m_diskDma.len--;
 	if (m_diskDma.len == 0)
 	{
+		FinishDiskDMA();
+	}
+
+	EnterSubsystem(previousSubsystem);
+}
+
+uint16_t am::Amiga::ReadDiskDmaWord()
+{
+	// Disk DMA continues even when drive is unselected or motor is switched off (reads zeros).
+
+	if (m_driveSelected == -1)
+		return 0;
+
+	auto& drive = m_floppyDrive[m_driveSelected];
+	if (!drive.motorOn)
+		return 0;
+
+	auto& disk = m_floppyDisk[m_driveSelected];
+	const uint8_t* track = disk.image.GetTrack(disk.GetData(), drive.currCylinder, drive.side);
+	if (track == nullptr)
+		return 0;
+
+	// Words needn't start on a byte boundary, if the sync word was found at an odd bit position or
+	// the track isn't a whole number of words long.
+	const uint32_t bitLength = disk.image.GetTrackBitLength(drive.currCylinder, drive.side);
+	const uint32_t position = GetDiskDmaPosition(bitLength);
+
+	SetDiskDmaPosition((position + 16) % bitLength);
+
+	return ReadTrackWord(track, bitLength, position);
+}
+
+void am::Amiga::WriteDiskDmaWord(uint16_t value)
+{
+	if (m_driveSelected == -1)
+		return;
+
+	auto& drive = m_floppyDrive[m_driveSelected];
+	if (!drive.motorOn)
+		return;
+
+	auto& disk = m_floppyDisk[m_driveSelected];
+	const uint32_t bitLength = disk.image.GetTrackBitLength(drive.currCylinder, drive.side);
+	if (bitLength == 0)
+		return;
+
+	const uint32_t position = GetDiskDmaPosition(bitLength);
+	SetDiskDmaPosition((position + 16) % bitLength);
+
+	// Nothing reaches a write protected disk, and disks aren't changed while running ahead as they
+	// aren't part of the state that is restored afterwards.
+	if (!IsDiskWriteProtected(m_driveSelected) && !m_runningAhead)
+	{
+		uint8_t* track = disk.image.GetTrackForWriting(GetWritableDiskData(m_driveSelected), drive.currCylinder, drive.side);
+		WriteTrackWord(track, bitLength, position, value);
+	}
+}
+
+uint32_t am::Amiga::GetDiskDmaPosition(uint32_t bitLength) const
+{
+	// The position is kept when the head moves, so may be past the end of a shorter track.
+	return (m_diskDma.encodedSequenceCounter * 8 + m_diskDma.encodedSequenceBitOffset) % bitLength;
+}
+
+void am::Amiga::SetDiskDmaPosition(uint32_t position)
+{
+	m_diskDma.encodedSequenceCounter = uint16_t(position / 8);
+	m_diskDma.encodedSequenceBitOffset = uint8_t(position % 8);
+}
+
+void am::Amiga::CommitDiskWrites(int driveNum)
+{
+	auto& disk = m_floppyDisk[driveNum];
+
+	const auto modified = disk.image.TakeModifiedTracks();
+	if (modified.none())
+		return;
+
+	for (int track = 0; track < kTracksPerDisk; track++)
+	{
+		if (!modified[track])
+			continue;
+
+		const auto& layout = disk.image.GetTrackLayout(track);
+
+		// Raw tracks were written in place.
+		if (!layout.raw)
+		{
+			if (layout.size < kDecodedTrackSize)
+				continue;
+
+			const auto data = GetWritableDiskData(driveNum);
+			const auto* encoded = disk.image.GetTrack(data, track / kTracksPerCylinder, track % kTracksPerCylinder);
+			DecodeTrack(encoded, track, &data[layout.offset]);
+		}
+
+		const auto written = disk.GetData().subspan(layout.offset, layout.raw ? layout.size : kDecodedTrackSize);
+
 		if (m_log->IsLogging(LogOptions::Disk))
 		{
-			m_log->AddMessage(m_totalCClocks, "Disk DMA Finished.");
+			std::stringstream ss;
+			ss << "Disk Track Written : drive=" << driveNum << " track=" << track;
+			m_log->AddMessage(m_totalCClocks, ss.str());
 		}
 
-		m_diskDma.inProgress = false;
-		auto& intreqr = Reg(Register::INTREQR);
-		intreqr |= 0x0002; // set disk block finished interupt
+		if (m_diskWriteHandler)
+		{
+			m_diskWriteHandler->TrackWritten(disk, layout.offset, written);
+		}
+	}
+}
 
-		DoInterruptRequest();
+std::span<uint8_t> am::Amiga::GetWritableDiskData(int driveNum)
+{
+	auto& disk = m_floppyDisk[driveNum];
+
+	// Copy on write: a mapped file is left as it is, and the disk held in memory from now on.
+	if (disk.mappedFile)
+	{
+		const auto mapped = disk.mappedFile->GetData();
+		disk.data.assign(mapped.begin(), mapped.end());
+		disk.mappedFile.reset();
+	}
+
+	return disk.data;
+}
+
+void am::Amiga::SetDiskWriteHandler(am::DiskWriteHandler* handler)
+{
+	m_diskWriteHandler = handler;
+}
+
+void am::Amiga::FinishDiskDMA()
+{
+	if (m_log->IsLogging(LogOptions::Disk))
+	{
+		m_log->AddMessage(m_totalCClocks, "Disk DMA Finished.");
+	}
+
+	if (m_diskDma.writing)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			CommitDiskWrites(i);
+		}
 	}
+
+	m_diskDma.inProgress = false;
+	auto& intreqr = Reg(Register::INTREQR);
+	intreqr |= 0x0002; // set disk block finished interupt
+
+	DoInterruptRequest();
+}
+
+int am::Amiga::GetDiskRevolutionCClocks() const
+{
+	return m_turboFloppy ? kTurboDiskRevolutionCClocks : kDiskRevolutionCClocks;
 }
 
 bool am::Amiga::DoAudioDMA(int channel)
@@ -3478,6 +3988,7 @@ void am::Amiga::UpdateAudioChannel(int channel)
 
 		audio.state = 0b011;
 		audio.currentSample = audio.data & 0xff;
+		OutputAudioLevel(channel);
 		audio.perCounter = Reg(am::Register(int(Register::AUD0PER) + channel * 0x10));
 	}	break;
 
@@ -3494,6 +4005,7 @@ void am::Amiga::UpdateAudioChannel(int channel)
 		{
 			audio.data = audio.holdingLatch;
 			audio.currentSample = uint8_t(audio.data >> 8);
+			OutputAudioLevel(channel);
 			audio.perCounter = Reg(am::Register(int(Register::AUD0PER) + channel * 0x10));
 			audio.state = 0b010;
 			if (audio.dmaOn)
@@ -3645,122 +4157,827 @@ void am::Amiga::UpdateAudioChannelOnData(int channel, uint16_t value)
 	}
 }
 
+void am::Amiga::OutputAudioLevel(int channel)
+{
+	// The audio output isn't part of the saved state, so is left alone while running ahead.
+	if (m_runningAhead)
+		return;
+
+	const auto& audio = m_audio[channel];
+	m_audioSynth.SetLevel(m_totalCClocks, channel, int(int8_t(audio.currentSample)) * int(audio.volume));
+}
+
+void am::Amiga::ResyncAudioOutput()
+{
+	m_audioSynth.Resync(m_totalCClocks);
+
+	for (int i = 0; i < 4; i++)
+	{
+		OutputAudioLevel(i);
+	}
+}
+
 namespace
 {
-	constexpr char shapshotMagicValue[] = "GuRuAmi";
-	constexpr int shapshotVersion = 0x01;
+	// The chipset's structs are streamed a field at a time rather than copied whole, so saved state
+	// doesn't depend on their layout or padding. T is const when writing.
+
+	template <typename S, typename T>
+	void StreamBitplaneControl(S& s, T& bitplane)
+	{
+		using util::Stream;
+
+		Stream(s, bitplane.hires);
+		Stream(s, bitplane.ham);
+		Stream(s, bitplane.doublePlayfield);
+		Stream(s, bitplane.compositeColourEnabled);
+		Stream(s, bitplane.genlockAudioEnabled);
+		Stream(s, bitplane.lightPenEnabled);
+		Stream(s, bitplane.interlaced);
+		Stream(s, bitplane.externalResync);
+		Stream(s, bitplane.numPlanesEnabled);
+		Stream(s, bitplane.playfieldPriority);
+		Stream(s, bitplane.playfieldDelay);
+		Stream(s, bitplane.playfieldSpritePri);
+		Stream(s, bitplane.ptr);
+		Stream(s, bitplane.heldCol);
+	}
+
+	template <typename S, typename T>
+	void StreamCopper(S& s, T& copper)
+	{
+		using util::Stream;
+
+		Stream(s, copper.pc);
+		Stream(s, copper.readAddr);
+		Stream(s, copper.ir1);
+		Stream(s, copper.ir2);
+		Stream(s, copper.verticalWaitPos);
+		Stream(s, copper.horizontalWaitPos);
+		Stream(s, copper.verticalMask);
+		Stream(s, copper.horizontalMask);
+		Stream(s, copper.state);
+		Stream(s, copper.skipping);
+		Stream(s, copper.waitForBlitter);
+	}
+
+	template <typename S, typename T>
+	void StreamBlitter(S& s, T& blitter)
+	{
+		using util::Stream;
+
+		Stream(s, blitter.ptr);
+		Stream(s, blitter.modulo);
+		Stream(s, blitter.data);
+		Stream(s, blitter.enabled);
+		Stream(s, blitter.lines);
+		Stream(s, blitter.wordsPerLine);
+		Stream(s, blitter.firstWordMask);
+		Stream(s, blitter.lastWordMask);
+		Stream(s, blitter.minterm);
+	}
+
+	template <typename S, typename T>
+	void StreamSprite(S& s, T& sprite)
+	{
+		using util::Stream;
+
+		Stream(s, sprite.active);
+		Stream(s, sprite.armed);
+		Stream(s, sprite.attached);
+		Stream(s, sprite.drawPos);
+		Stream(s, sprite.horizontalStart);
+		Stream(s, sprite.startLine);
+		Stream(s, sprite.endLine);
+		Stream(s, sprite.ptr);
+	}
+
+	template <typename S, typename T>
+	void StreamCia(S& s, T& cia)
+	{
+		using util::Stream;
+
+		Stream(s, cia.pra);
+		Stream(s, cia.prb);
+		Stream(s, cia.ddra);
+		Stream(s, cia.ddrb);
+		Stream(s, cia.sdr);
+
+		Stream(s, cia.irqData);
+		Stream(s, cia.irqMask);
+		Stream(s, cia.intSignal);
+
+		Stream(s, cia.tod);
+		Stream(s, cia.todLatched);
+		Stream(s, cia.todAlarm);
+
+		Stream(s, cia.todRunning);
+		Stream(s, cia.todWriteAlarm);
+		Stream(s, cia.todIsLatched);
+
+		Stream(s, cia.timerBCountsUnderflow);
+
+		for (auto& timer : cia.timer)
+		{
+			Stream(s, timer.running);
+			Stream(s, timer.continuous);
+			Stream(s, timer.value);
+			Stream(s, timer.latchedValue);
+			Stream(s, timer.controlRegister);
+		}
+	}
+
+	template <typename S, typename T>
+	void StreamDrive(S& s, T& drive)
+	{
+		using util::Stream;
+
+		Stream(s, drive.selected);
+		Stream(s, drive.motorOn);
+		Stream(s, drive.stepSignal);
+		Stream(s, drive.diskChange);
+		Stream(s, drive.currCylinder);
+		Stream(s, drive.side);
+	}
+
+	template <typename S, typename T>
+	void StreamDiskDma(S& s, T& diskDma)
+	{
+		using util::Stream;
+
+		Stream(s, diskDma.ptr);
+		Stream(s, diskDma.len);
+		Stream(s, diskDma.encodedSequenceCounter);
+		Stream(s, diskDma.encodedSequenceBitOffset);
+		Stream(s, diskDma.writing);
+		Stream(s, diskDma.inProgress);
+		Stream(s, diskDma.secondaryDmaEnabled);
+		Stream(s, diskDma.useWordSync);
+		Stream(s, diskDma.turboFinishCountdown);
+	}
+
+	template <typename S, typename T>
+	void StreamAudioChannel(S& s, T& audio)
+	{
+		using util::Stream;
+
+		Stream(s, audio.pointer);
+		Stream(s, audio.currentSample);
+		Stream(s, audio.volume);
+		Stream(s, audio.state);
+		Stream(s, audio.dmaOn);
+		Stream(s, audio.dmaReq);
+		Stream(s, audio.intreq2);
+		Stream(s, audio.data);
+		Stream(s, audio.perCounter);
+		Stream(s, audio.holdingLatch);
+		Stream(s, audio.lenCounter);
+	}
+
+	// Snapshot files are a header followed by tagged chunks. Each chunk carries its own version,
+	// size and CRC so that chunks can be checked before anything is loaded, and unknown ones skipped.
+	constexpr char kSnapshotMagic[8] = "GuRuAmi";
+	constexpr uint32_t kSnapshotVersion = 2;
+
+	constexpr uint32_t MakeChunkId(const char (&id)[5])
+	{
+		return uint32_t(uint8_t(id[0])) | (uint32_t(uint8_t(id[1])) << 8) | (uint32_t(uint8_t(id[2])) << 16) | (uint32_t(uint8_t(id[3])) << 24);
+	}
+
+	struct ChunkType
+	{
+		uint32_t id;
+		uint32_t version; // bump whenever what is streamed into the chunk changes
+	};
+
+	constexpr ChunkType kCpuChunk = { MakeChunkId("CPU "), 2 };
+	constexpr ChunkType kChipsetChunk = { MakeChunkId("CUST"), 2 };
+	constexpr ChunkType kCiaChunk = { MakeChunkId("CIA "), 2 };
+	constexpr ChunkType kFloppyChunk = { MakeChunkId("FLOP"), 3 };
+	constexpr ChunkType kAudioChunk = { MakeChunkId("AUD "), 2 };
+	constexpr ChunkType kIdeChunk = { MakeChunkId("IDE "), 1 };
+	constexpr ChunkType kHostFsChunk = { MakeChunkId("HOST"), 1 };
+	constexpr ChunkType kChipRamChunk = { MakeChunkId("CRAM"), 1 };
+	constexpr ChunkType kSlowRamChunk = { MakeChunkId("SRAM"), 1 };
+	constexpr ChunkType kDiskChunk[4] = {
+		{ MakeChunkId("DSK0"), 2 },
+		{ MakeChunkId("DSK1"), 2 },
+		{ MakeChunkId("DSK2"), 2 },
+		{ MakeChunkId("DSK3"), 2 },
+	};
+	constexpr ChunkType kEndChunk = { MakeChunkId("END "), 1 };
+
+	constexpr uint64_t kMaxChunkSize = 64 * 1024 * 1024;
+
+	struct Chunk
+	{
+		uint32_t id = 0;
+		uint32_t version = 0;
+		std::vector<uint8_t> data;
+	};
+
+	void WriteChunk(std::ostream& os, const ChunkType& type, const std::vector<uint8_t>& data)
+	{
+		util::Stream(os, type.id);
+		util::Stream(os, type.version);
+		util::Stream(os, uint64_t(data.size()));
+		util::Stream(os, uint32_t(crc32(0, data.data(), uInt(data.size()))));
+		os.write(reinterpret_cast<const char*>(data.data()), data.size());
+	}
+
+	// Compressed data is stored as its uncompressed size followed by the zlib stream.
+	void WriteCompressed(util::MemoryWriter& w, std::span<const uint8_t> data)
+	{
+		uLongf compressedSize = compressBound(uLong(data.size()));
+		std::vector<uint8_t> compressed(compressedSize);
+		compress2(compressed.data(), &compressedSize, data.data(), uLong(data.size()), Z_BEST_SPEED);
+
+		util::Stream(w, uint64_t(data.size()));
+		w.Write(compressed.data(), compressedSize);
+	}
+
+	// Inflates compressed data starting at offset in the chunk straight into dest, which must be
+	// exactly the uncompressed size.
+	bool ReadCompressed(const Chunk& chunk, size_t offset, std::span<uint8_t> dest)
+	{
+		uint64_t size = 0;
+		if (chunk.data.size() < offset + sizeof(size))
+			return false;
+
+		memcpy(&size, chunk.data.data() + offset, sizeof(size));
+		offset += sizeof(size);
+
+		if (size != dest.size())
+			return false;
+
+		uLongf destSize = uLongf(dest.size());
+		if (uncompress(dest.data(), &destSize, chunk.data.data() + offset, uLong(chunk.data.size() - offset)) != Z_OK)
+			return false;
+
+		return destSize == dest.size();
+	}
+
+	struct SnapshotDisk
+	{
+		bool inserted = false;
+		bool embedded = false;
+		bool writeProtected = true;
+		bool alreadyInserted = false; // the drive already holds the same disk
+		std::string fileLocation;
+		std::string displayName;
+		uint64_t hash = 0;
+		std::vector<uint8_t> data;
+		am::DiskImage image;
+	};
 }
 
-void am::Amiga::WriteSnapshot(std::ostream& os) const
+void am::Amiga::WriteSnapshot(std::ostream& os, bool embedDisks) const
 {
 	using util::Stream;
 
-	Stream(os, shapshotMagicValue);
-	Stream(os, shapshotVersion);
+	Stream(os, kSnapshotMagic);
+	Stream(os, kSnapshotVersion);
+
+	std::vector<uint8_t> data;
+
+	auto WriteStreamedChunk = [&](const ChunkType& type, void (*streamFunc)(util::MemoryWriter&, const Amiga&))
+	{
+		util::MemoryWriter writer(data);
+		streamFunc(writer, *this);
+		WriteChunk(os, type, data);
+	};
 
-	const_cast<Amiga*>(this)->Stream(os);
+	WriteStreamedChunk(kCpuChunk, &Amiga::StreamCpu<util::MemoryWriter, const Amiga>);
+	WriteStreamedChunk(kChipsetChunk, &Amiga::StreamChipset<util::MemoryWriter, const Amiga>);
+	WriteStreamedChunk(kCiaChunk, &Amiga::StreamCias<util::MemoryWriter, const Amiga>);
+	WriteStreamedChunk(kFloppyChunk, &Amiga::StreamFloppy<util::MemoryWriter, const Amiga>);
+	WriteStreamedChunk(kAudioChunk, &Amiga::StreamAudio<util::MemoryWriter, const Amiga>);
+	WriteStreamedChunk(kIdeChunk, &Amiga::StreamIde<util::MemoryWriter, const Amiga>);
+	WriteStreamedChunk(kHostFsChunk, &Amiga::StreamHostFs<util::MemoryWriter, const Amiga>);
+
+	{
+		util::MemoryWriter writer(data);
+		WriteCompressed(writer, m_chipRam);
+		WriteChunk(os, kChipRamChunk, data);
+	}
+
+	if (!m_slowRam.empty())
+	{
+		util::MemoryWriter writer(data);
+		WriteCompressed(writer, m_slowRam);
+		WriteChunk(os, kSlowRamChunk, data);
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		auto& disk = m_floppyDisk[i];
+		if (!IsDiskInserted(i))
+			continue;
+
+		util::MemoryWriter writer(data);
+		util::StreamString(writer, disk.fileLocation);
+		util::StreamString(writer, disk.displayName);
+		Stream(writer, util::Fnv1a64(disk.GetData()));
+		Stream(writer, disk.writeProtected);
+		Stream(writer, embedDisks);
+		if (embedDisks)
+		{
+			WriteCompressed(writer, disk.GetData());
+		}
+		WriteChunk(os, kDiskChunk[i], data);
+	}
+
+	WriteChunk(os, kEndChunk, {});
 }
 
-bool am::Amiga::ReadSnapshot(std::istream& is)
+bool am::Amiga::ReadSnapshot(std::istream& is, const SnapshotDiskLoader& loadDisk, std::vector<std::string>* missingDisks)
 {
-	char magicValue[8];
-
 	using util::Stream;
 
-	Stream(is, magicValue);
-	if (strncmp(magicValue, shapshotMagicValue, sizeof magicValue))
+	char magic[sizeof(kSnapshotMagic)] = {};
+	uint32_t version = 0;
+
+	Stream(is, magic);
+	Stream(is, version);
+
+	if (!is || memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 || version != kSnapshotVersion)
+		return false;
+
+	std::vector<Chunk> chunks;
+
+	for (;;)
+	{
+		Chunk chunk;
+		uint64_t size = 0;
+		uint32_t crc = 0;
+
+		Stream(is, chunk.id);
+		Stream(is, chunk.version);
+		Stream(is, size);
+		Stream(is, crc);
+
+		if (!is || size > kMaxChunkSize)
+			return false;
+
+		if (chunk.id == kEndChunk.id)
+			break;
+
+		chunk.data.resize(size_t(size));
+		is.read(reinterpret_cast<char*>(chunk.data.data()), size);
+		if (!is || crc32(0, chunk.data.data(), uInt(size)) != crc)
+			return false;
+
+		chunks.push_back(std::move(chunk));
+	}
+
+	auto FindChunk = [&chunks](const ChunkType& type) -> const Chunk*
+	{
+		auto it = std::find_if(chunks.begin(), chunks.end(), [&](const Chunk& c) { return c.id == type.id; });
+		return (it == chunks.end() || it->version != type.version) ? nullptr : &*it;
+	};
+
+	// Check everything before changing any state, so a bad snapshot leaves the machine as it was.
+
+	struct StreamedChunk
+	{
+		const ChunkType& type;
+		void (*write)(util::MemoryWriter&, const Amiga&);
+		void (*read)(util::MemoryReader&, Amiga&);
+		const Chunk* chunk = nullptr;
+	};
+
+	StreamedChunk streamedChunks[] = {
+		{ kCpuChunk, &Amiga::StreamCpu<util::MemoryWriter, const Amiga>, &Amiga::StreamCpu<util::MemoryReader, Amiga> },
+		{ kChipsetChunk, &Amiga::StreamChipset<util::MemoryWriter, const Amiga>, &Amiga::StreamChipset<util::MemoryReader, Amiga> },
+		{ kCiaChunk, &Amiga::StreamCias<util::MemoryWriter, const Amiga>, &Amiga::StreamCias<util::MemoryReader, Amiga> },
+		{ kFloppyChunk, &Amiga::StreamFloppy<util::MemoryWriter, const Amiga>, &Amiga::StreamFloppy<util::MemoryReader, Amiga> },
+		{ kAudioChunk, &Amiga::StreamAudio<util::MemoryWriter, const Amiga>, &Amiga::StreamAudio<util::MemoryReader, Amiga> },
+		{ kIdeChunk, &Amiga::StreamIde<util::MemoryWriter, const Amiga>, &Amiga::StreamIde<util::MemoryReader, Amiga> },
+		{ kHostFsChunk, &Amiga::StreamHostFs<util::MemoryWriter, const Amiga>, &Amiga::StreamHostFs<util::MemoryReader, Amiga> },
+	};
+
+	std::vector<uint8_t> current;
+	for (auto& streamed : streamedChunks)
 	{
+		streamed.chunk = FindChunk(streamed.type);
+		if (!streamed.chunk)
+			return false;
+
+		// The chunk must be exactly the size this build streams.
+		util::MemoryWriter writer(current);
+		streamed.write(writer, *this);
+		if (streamed.chunk->data.size() != current.size())
+			return false;
+	}
+
+	const Chunk* chipRamChunk = FindChunk(kChipRamChunk);
+	const Chunk* slowRamChunk = FindChunk(kSlowRamChunk);
+
+	if (!chipRamChunk || (!m_slowRam.empty() && !slowRamChunk))
 		return false;
+
+	SnapshotDisk disks[4];
+	for (int i = 0; i < 4; i++)
+	{
+		const Chunk* chunk = FindChunk(kDiskChunk[i]);
+		if (!chunk)
+			continue;
+
+		auto& disk = disks[i];
+		util::MemoryReader reader(chunk->data.data(), chunk->data.size());
+		util::StreamString(reader, disk.fileLocation);
+		util::StreamString(reader, disk.displayName);
+		Stream(reader, disk.hash);
+		Stream(reader, disk.writeProtected);
+		Stream(reader, disk.embedded);
+
+		if (reader.Failed())
+			return false;
+
+		if (disk.embedded)
+		{
+			uint64_t size = 0;
+			const size_t offset = chunk->data.size() - reader.Remaining();
+			if (reader.Remaining() < sizeof(size))
+				return false;
+
+			memcpy(&size, chunk->data.data() + offset, sizeof(size));
+			if (size > kMaxChunkSize)
+				return false;
+
+			disk.data.resize(size_t(size));
+			if (!ReadCompressed(*chunk, offset, disk.data) || util::Fnv1a64(disk.data) != disk.hash || !disk.image.Reset(disk.data))
+				return false;
+		}
+
+		disk.inserted = true;
 	}
 
-	int version;
-	Stream(is, version);
+	// RAM is inflated aside, and only swapped in once everything is known to be good.
+	std::vector<uint8_t> chipRam(m_chipRam.size());
+	std::vector<uint8_t> slowRam(m_slowRam.size());
 
-	if (version != shapshotVersion)
+	if (!ReadCompressed(*chipRamChunk, 0, chipRam))
 		return false;
 
-	this->Stream(is);
+	if (!m_slowRam.empty() && !ReadCompressed(*slowRamChunk, 0, slowRam))
+		return false;
+
+	// Resolve referenced disks. One still inserted is kept if it hasn't changed, counting any
+	// writes not yet committed to it; anything else has to be loaded and match the saved hash.
+	for (int i = 0; i < 4; i++)
+	{
+		auto& saved = disks[i];
+		if (!saved.inserted || saved.embedded)
+			continue;
+
+		if (IsDiskInserted(i) && m_floppyDisk[i].fileLocation == saved.fileLocation)
+		{
+			CommitDiskWrites(i);
+			if (util::Fnv1a64(m_floppyDisk[i].GetData()) == saved.hash)
+			{
+				saved.alreadyInserted = true;
+				continue;
+			}
+		}
+
+		if (!loadDisk || !loadDisk(saved.fileLocation, saved.data) || util::Fnv1a64(saved.data) != saved.hash || !saved.image.Reset(saved.data))
+		{
+			if (!missingDisks)
+				return false;
+
+			missingDisks->push_back(saved.fileLocation);
+			saved.inserted = false;
+		}
+	}
+
+	// Nothing can fail from here on. Disks being replaced are ejected first, so anything written to
+	// them is saved.
+	for (int i = 0; i < 4; i++)
+	{
+		if (IsDiskInserted(i) && !disks[i].alreadyInserted)
+		{
+			CommitDiskWrites(i);
+			if (m_diskWriteHandler)
+			{
+				m_diskWriteHandler->DiskEjected(m_floppyDisk[i]);
+			}
+		}
+	}
+
+	m_chipRam.swap(chipRam);
+	m_slowRam.swap(slowRam);
+
+	for (auto& streamed : streamedChunks)
+	{
+		util::MemoryReader reader(streamed.chunk->data.data(), streamed.chunk->data.size());
+		streamed.read(reader, *this);
+	}
+
+	// Disks are put in place directly rather than with SetDisk/EjectDisk, as the drive state has
+	// already been restored.
+	for (int i = 0; i < 4; i++)
+	{
+		auto& disk = m_floppyDisk[i];
+		auto& saved = disks[i];
+
+		if (saved.alreadyInserted)
+		{
+			disk.displayName = saved.displayName;
+			disk.writeProtected = saved.writeProtected;
+			continue;
+		}
+
+		if (!saved.inserted)
+		{
+			disk = FloppyDisk{};
+			continue;
+		}
+
+		disk.fileLocation = std::move(saved.fileLocation);
+		disk.displayName = std::move(saved.displayName);
+		disk.data = std::move(saved.data);
+		disk.mappedFile.reset();
+		disk.image = std::move(saved.image);
+		disk.writeProtected = saved.writeProtected;
+	}
+
+	ResetDirtyPages();
+	ResyncAudioOutput();
 
 	return true;
 }
 
-template <typename S>
-void am::Amiga::Stream(S& s)
+void am::Amiga::SaveState(SavedState& state) const
 {
-	m_m68000->Stream(s);
+	util::MemoryWriter writer(state.core);
+	StreamCore(writer, *this);
 
+	state.chipRam.assign(m_chipRam.begin(), m_chipRam.end());
+	state.slowRam.assign(m_slowRam.begin(), m_slowRam.end());
+	state.baseGeneration = 0;
+	state.frameCount = m_frameCount;
+}
+
+bool am::Amiga::IsCoreSizeValid(const std::vector<uint8_t>& core)
+{
+	util::MemoryWriter writer(m_coreSizeCheck);
+	StreamCore(writer, std::as_const(*this));
+	return core.size() == m_coreSizeCheck.size();
+}
+
+bool am::Amiga::LoadState(const SavedState& state)
+{
+	// Check everything before changing any state, so a bad state leaves the machine as it was.
+	if (state.chipRam.size() != m_chipRam.size() || state.slowRam.size() != m_slowRam.size() || !IsCoreSizeValid(state.core))
+		return false;
+
+	util::MemoryReader reader(state.core.data(), state.core.size());
+	StreamCore(reader, *this);
+	assert(!reader.Failed());
+
+	memcpy(m_chipRam.data(), state.chipRam.data(), m_chipRam.size());
+	memcpy(m_slowRam.data(), state.slowRam.data(), m_slowRam.size());
+
+	m_frameCount = state.frameCount;
+	ResyncAudioOutput();
+
+	if (state.baseGeneration != 0 && state.baseGeneration == m_baseGeneration)
+	{
+		// Back to the base exactly.
+		m_chipRamDirty.Clear();
+		m_slowRamDirty.Clear();
+	}
+	else
+	{
+		m_chipRamDirty.MarkAll();
+		m_slowRamDirty.MarkAll();
+	}
+	return true;
+}
+
+void am::Amiga::SaveBaseState(SavedState& base)
+{
+	SaveState(base);
+
+	base.baseGeneration = ++m_baseGeneration;
+	m_chipRamDirty.Clear();
+	m_slowRamDirty.Clear();
+}
+
+void am::Amiga::SaveDeltaState(DeltaState& delta) const
+{
+	util::MemoryWriter writer(delta.core);
+	StreamCore(writer, *this);
+
+	delta.baseGeneration = m_baseGeneration;
+	delta.frameCount = m_frameCount;
+	delta.chipRamPages.clear();
+	delta.slowRamPages.clear();
+	delta.pageData.clear();
+
+	auto SavePages = [&delta](const DirtyPages& dirty, const std::vector<uint8_t>& ram, std::vector<uint32_t>& pages)
+	{
+		dirty.ForEach([&](uint32_t page)
+		{
+			const size_t offset = size_t(page) * kDirtyPageSize;
+			const size_t size = std::min<size_t>(kDirtyPageSize, ram.size() - offset);
+			pages.push_back(page);
+			delta.pageData.insert(delta.pageData.end(), ram.begin() + offset, ram.begin() + offset + size);
+			delta.pageData.resize(delta.pageData.size() + kDirtyPageSize - size, 0);
+		});
+	};
+
+	SavePages(m_chipRamDirty, m_chipRam, delta.chipRamPages);
+	SavePages(m_slowRamDirty, m_slowRam, delta.slowRamPages);
+}
+
+bool am::Amiga::LoadDeltaState(const SavedState& base, const DeltaState& delta)
+{
+	if (delta.baseGeneration == 0 || delta.baseGeneration != base.baseGeneration)
+		return false;
+
+	if (base.chipRam.size() != m_chipRam.size() || base.slowRam.size() != m_slowRam.size())
+		return false;
+
+	if (!IsCoreSizeValid(delta.core) || (base.baseGeneration != m_baseGeneration && !IsCoreSizeValid(base.core)))
+		return false;
+
+	if (delta.pageData.size() != (delta.chipRamPages.size() + delta.slowRamPages.size()) * kDirtyPageSize)
+		return false;
+
+	auto InRange = [](const std::vector<uint32_t>& pages, const DirtyPages& dirty)
+	{
+		return std::all_of(pages.begin(), pages.end(), [&](uint32_t page) { return page < dirty.NumPages(); });
+	};
+
+	if (!InRange(delta.chipRamPages, m_chipRamDirty) || !InRange(delta.slowRamPages, m_slowRamDirty))
+		return false;
+
+	auto CopyPage = [](std::vector<uint8_t>& ram, const uint8_t* src, uint32_t page)
+	{
+		const size_t offset = size_t(page) * kDirtyPageSize;
+		memcpy(ram.data() + offset, src, std::min<size_t>(kDirtyPageSize, ram.size() - offset));
+	};
+
+	if (base.baseGeneration == m_baseGeneration)
+	{
+		// RAM only differs from the base in the dirty pages, so put those back.
+		m_chipRamDirty.ForEach([&](uint32_t page) { CopyPage(m_chipRam, base.chipRam.data() + size_t(page) * kDirtyPageSize, page); });
+		m_slowRamDirty.ForEach([&](uint32_t page) { CopyPage(m_slowRam, base.slowRam.data() + size_t(page) * kDirtyPageSize, page); });
+		m_chipRamDirty.Clear();
+		m_slowRamDirty.Clear();
+	}
+	else
+	{
+		// An older base. RAM could differ anywhere so restore all of it.
+		LoadState(base);
+	}
+
+	util::MemoryReader reader(delta.core.data(), delta.core.size());
+	StreamCore(reader, *this);
+	assert(!reader.Failed());
+
+	const uint8_t* pageData = delta.pageData.data();
+	for (auto page : delta.chipRamPages)
+	{
+		CopyPage(m_chipRam, pageData, page);
+		m_chipRamDirty.Mark(page * kDirtyPageSize);
+		pageData += kDirtyPageSize;
+	}
+	for (auto page : delta.slowRamPages)
+	{
+		CopyPage(m_slowRam, pageData, page);
+		m_slowRamDirty.Mark(page * kDirtyPageSize);
+		pageData += kDirtyPageSize;
+	}
+
+	m_frameCount = delta.frameCount;
+	ResyncAudioOutput();
+
+	return true;
+}
+
+template <typename S, typename Self>
+void am::Amiga::StreamCore(S& s, Self& self)
+{
+	StreamCpu(s, self);
+	StreamChipset(s, self);
+	StreamCias(s, self);
+	StreamFloppy(s, self);
+	StreamAudio(s, self);
+	StreamIde(s, self);
+	StreamHostFs(s, self);
+}
+
+template <typename S, typename Self>
+void am::Amiga::StreamCpu(S& s, Self& self)
+{
+	using Cpu = std::conditional_t<std::is_const_v<Self>, const cpu::M68000, cpu::M68000>;
+	cpu::M68000::Stream(s, static_cast<Cpu&>(*self.m_m68000));
+}
+
+template <typename S, typename Self>
+void am::Amiga::StreamChipset(S& s, Self& self)
+{
 	using util::Stream;
 	using util::StreamVector;
 
-	Stream(s, m_romOverlayEnabled);
-	Stream(s, m_isNtsc);
-	Stream(s, m_running);
-	Stream(s, m_rightMouseButtonDown);
-
-	Stream(s, m_bitplane);
+	Stream(s, self.m_romOverlayEnabled);
+	Stream(s, self.m_isNtsc);
+	Stream(s, self.m_running);
+	Stream(s, self.m_rightMouseButtonDown);
 
-	Stream(s, m_vPos);
-	Stream(s, m_hPos);
-	Stream(s, m_lineLength);
-	Stream(s, m_frameLength);
+	StreamBitplaneControl(s, self.m_bitplane);
 
-	Stream(s, m_bpFetchState);
-	Stream(s, m_fetchPos);
+	Stream(s, self.m_vPos);
+	Stream(s, self.m_hPos);
+	Stream(s, self.m_lineLength);
+	Stream(s, self.m_frameLength);
 
-	Stream(s, m_windowStartX);
-	Stream(s, m_windowStopX);
-	Stream(s, m_windowStartY);
-	Stream(s, m_windowStopY);
+	Stream(s, self.m_bpFetchState);
+	Stream(s, self.m_fetchPos);
 
-	Stream(s, m_sharedBusRws);
-	Stream(s, m_exclusiveBusRws);
+	Stream(s, self.m_windowStartX);
+	Stream(s, self.m_windowStopX);
+	Stream(s, self.m_windowStartY);
+	Stream(s, self.m_windowStopY);
 
-	Stream(s, m_timerCountdown);
+	Stream(s, self.m_sharedBusRws);
+	Stream(s, self.m_exclusiveBusRws);
 
-	Stream(s, m_totalCClocks);
-	Stream(s, m_cpuBusyTimer);
+	Stream(s, self.m_timerCountdown);
 
-	Stream(s, m_copper);
+	Stream(s, self.m_totalCClocks);
+	Stream(s, self.m_cpuBusyTimer);
 
-	Stream(s, m_blitter);
+	StreamCopper(s, self.m_copper);
 
-	Stream(s, m_blitterCountdown);
+	StreamBlitter(s, self.m_blitter);
 
-	Stream(s, m_cia[0]);
-	Stream(s, m_cia[1]);
+	Stream(s, self.m_blitterCountdown);
 
-	Stream(s, m_palette);
+	Stream(s, self.m_palette);
 
-	Stream(s, m_pixelBufferLoadPtr);
-	Stream(s, m_pixelBufferReadPtr);
-	Stream(s, m_pixelFetchDelay);
+	Stream(s, self.m_pixelBufferLoadPtr);
+	Stream(s, self.m_pixelBufferReadPtr);
+	Stream(s, self.m_pixelFetchDelay);
 
 	for (int i = 0; i < 8; i++)
 	{
-		Stream(s, m_sprite[i]);
+		StreamSprite(s, self.m_sprite[i]);
 	}
 
+	StreamVector(s, self.m_registers);
+}
+
+template <typename S, typename Self>
+void am::Amiga::StreamCias(S& s, Self& self)
+{
+	using util::Stream;
+
+	StreamCia(s, self.m_cia[0]);
+	StreamCia(s, self.m_cia[1]);
+
+	Stream(s, self.m_keyQueue);
+	Stream(s, self.m_keyQueueFront);
+	Stream(s, self.m_keyQueueBack);
+	Stream(s, self.m_keyCooldown);
+}
+
+template <typename S, typename Self>
+void am::Amiga::StreamFloppy(S& s, Self& self)
+{
+	using util::Stream;
+
 	for (int i = 0; i < 4; i++)
 	{
-		Stream(s, m_floppyDrive[i]);
+		StreamDrive(s, self.m_floppyDrive[i]);
 	}
 
-	Stream(s, m_driveSelected);
-	Stream(s, m_diskRotationCountdown);
+	Stream(s, self.m_driveSelected);
+	Stream(s, self.m_diskRotationCountdown);
 
-	Stream(s, m_diskDma);
-
-	Stream(s, m_keyQueue);
-	Stream(s, m_keyQueueFront);
-	Stream(s, m_keyQueueBack);
-	Stream(s, m_keyCooldown);
+	StreamDiskDma(s, self.m_diskDma);
+}
 
+template <typename S, typename Self>
+void am::Amiga::StreamAudio(S& s, Self& self)
+{
 	for (int i = 0; i < 4; i++)
 	{
-		Stream(s, m_audio[i]);
+		StreamAudioChannel(s, self.m_audio[i]);
 	}
+}
 
-	StreamVector(s, m_registers);
-	StreamVector(s, m_chipRam);
-	StreamVector(s, m_slowRam);
+template <typename S, typename Self>
+void am::Amiga::StreamIde(S& s, Self& self)
+{
+	Gayle::Stream(s, self.m_gayle);
+}
+
+template <typename S, typename Self>
+void am::Amiga::StreamHostFs(S& s, Self& self)
+{
+	HostFileSystem::Stream(s, self.m_hostFs);
 }
@@ -3,9 +3,14 @@
 #include "68000.h"
 #include "screen_buffer.h"
 #include "audio.h"
+#include "audio_synth.h"
 #include "mfm.h"
+#include "gayle.h"
+#include "host_fs.h"
+#include "dirty_pages.h"
 
-#include "util\log.h"
+#include "util/log.h"
+#include "util/mapped_file.h"
 
 #include <stdint.h>
 #include <tuple>
@@ -13,6 +18,9 @@
 #include <memory>
 #include <string>
 #include <span>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 
 namespace am
 {
@@ -35,6 +43,49 @@ namespace am
 		NTSC_ESC = 0x3000,
 	};
 
+	// Coarse areas of the emulation that host time can be attributed to when profiling.
+	enum class Subsystem : uint8_t
+	{
+		Other,
+		Dma,
+		Copper,
+		Cpu,
+		Blitter,
+		Display,
+		Cia,
+		Floppy,
+		Audio,
+
+		NumSubsystems
+	};
+
+	const char* GetSubsystemName(Subsystem subsystem);
+
+	// Machine state captured in memory by Amiga::SaveState. CPU and chipset state is packed into
+	// one block, with RAM held in separate buffers. Reusing a SavedState avoids reallocation.
+	struct SavedState
+	{
+		std::vector<uint8_t> core;
+		std::vector<uint8_t> chipRam;
+		std::vector<uint8_t> slowRam;
+		uint64_t baseGeneration = 0; // non-zero if saved with SaveBaseState
+		uint64_t frameCount = 0;
+	};
+
+	// Provides the contents of a disk image file referenced by a snapshot.
+	using SnapshotDiskLoader = std::function<bool(const std::string& fileLocation, std::vector<uint8_t>& data)>;
+
+	// Core state plus only the RAM pages written since a base state.
+	struct DeltaState
+	{
+		std::vector<uint8_t> core;
+		std::vector<uint32_t> chipRamPages;
+		std::vector<uint32_t> slowRamPages;
+		std::vector<uint8_t> pageData; // kDirtyPageSize bytes per page, chip pages then slow pages
+		uint64_t baseGeneration = 0;
+		uint64_t frameCount = 0;
+	};
+
 	enum class Mapped : uint32_t
 	{
 		Reserved = 0x00,
@@ -50,6 +101,7 @@ namespace am
 		RealTimeClock = 0x20,
 		ChipRegisters = 0x40,
 		AutoConfig = 0x80,
+		Ide = 0x100,
 
 		// Mapped Types
 
@@ -57,7 +109,7 @@ namespace am
 		SlowRam = Memory | ChipBus,
 		FastRam = Memory,
 		Rom = Memory | ReadOnly,
-		Peripheral = 0xf0,
+		Peripheral = 0x1f0,
 
 		Shared = ChipBus | ChipRegisters,
 	};
@@ -155,6 +207,61 @@ namespace am
 		std::string fileLocation;
 		std::vector<uint8_t> data;
 		DiskImage image;
+
+		// Set while the disk is used in place from a mapped file. The file is copied into data the
+		// first time the disk is written to.
+		std::shared_ptr<const util::MappedFile> mappedFile;
+
+		// As the tab on the disk is set. The machine can't write to a write protected disk.
+		bool writeProtected = true;
+
+		std::span<const uint8_t> GetData() const
+		{
+			return mappedFile ? mappedFile->GetData() : std::span<const uint8_t>(data);
+		}
+	};
+
+	// A guest-visible input, as passed to one of the Amiga's input functions.
+	enum class InputType : uint8_t
+	{
+		ControllerButton,	// a = controller, b = button, c = pressed
+		JoystickMove,		// a = x, b = y
+		MouseMove,			// a = x, b = y
+		KeyPress,			// a = keycode
+		DiskInsert,			// a = drive, b = write protected, disk = the disk inserted
+		DiskEject,			// a = drive
+		DiskWriteProtect,	// a = drive, b = write protected
+	};
+
+	struct InputEvent
+	{
+		uint64_t cclock = 0; // total colour clocks when the input was applied
+		InputType type = InputType::KeyPress;
+		int32_t a = 0;
+		int32_t b = 0;
+		int32_t c = 0;
+		const FloppyDisk* disk = nullptr;
+	};
+
+	// Receives every input that changes the machine, at the point it is applied. Applying the same
+	// inputs at the same colour clocks from the same starting state reproduces a session exactly.
+	class InputRecorder
+	{
+	public:
+		virtual void RecordInput(const InputEvent& event) = 0;
+	};
+
+	// Receives what the machine writes to its floppy disks so it can be saved. Called on the
+	// emulation thread; the data is only valid for the duration of the call.
+	class DiskWriteHandler
+	{
+	public:
+		// A track of the disk has been rewritten. data is the track as it is now stored in disk.data,
+		// at offset: its decoded sectors, or the MFM bitstream for a raw track of an extended ADF.
+		virtual void TrackWritten(const FloppyDisk& disk, size_t offset, std::span<const uint8_t> data) = 0;
+
+		// The disk is about to be ejected, so anything still to be saved for it should be written.
+		virtual void DiskEjected(const FloppyDisk& disk) = 0;
 	};
 
 	struct DiskDma
@@ -167,6 +274,7 @@ namespace am
 		bool inProgress = false;
 		bool secondaryDmaEnabled = false;
 		bool useWordSync = false;
+		int32_t turboFinishCountdown = 0; // turbo floppy: colour clocks until the block finished interrupt
 	};
 
 	struct Sprite
@@ -211,11 +319,25 @@ namespace am
 
 		void SetRom(std::span<const uint8_t> rom);
 
+		// Uses a mapped 512KiB rom file in place rather than copying it, so instances using the same
+		// file share its memory. Other sizes are copied as SetRom above.
+		void SetRom(std::shared_ptr<const util::MappedFile> romFile);
+
+		// The player is sent audio at the rate it asks for.
 		void SetAudioPlayer(am::AudioPlayer* player)
 		{
-			m_audioPlayer = player;
+			m_audioSynth.SetPlayer(player);
+		}
+
+		void SetInputRecorder(am::InputRecorder* recorder)
+		{
+			m_inputRecorder = recorder;
 		}
 
+		// Passed what is written to the disks, so it can be saved. Whether a disk can be written to at
+		// all is up to its write protection.
+		void SetDiskWriteHandler(am::DiskWriteHandler* handler);
+
 		uint8_t PeekByte(uint32_t addr) const;
 		uint16_t PeekWord(uint32_t addr) const;
 		void PokeByte(uint32_t addr, uint8_t value);
@@ -223,6 +345,15 @@ namespace am
 		uint16_t PeekRegister(am::Register r) const;
 
 		bool ExecuteFor(uint64_t cclocks);
+		bool ExecuteFrame();
+
+		// As ExecuteFrame, but also stops if the total colour clock count reaches stopAtCClock.
+		bool ExecuteFrame(uint64_t stopAtCClock);
+
+		// Runs the given number of frames ahead, presents the last of them as the current screen, and
+		// then puts the machine back where it was. Used to hide input latency. The frames run ahead
+		// produce no audio and write nothing to floppy or hard disk images.
+		void RunAhead(int frames);
 		bool ExecuteOneCpuInstruction();
 		bool ExecuteToEndOfCpuInstruction();
 
@@ -233,6 +364,62 @@ namespace am
 			return m_running ? m_lastScreen.get() : m_currentScreen.get();
 		}
 
+		// Only draw one frame in every (frameSkip + 1). Skipped frames are still fully emulated
+		// but no pixels are written, and the last drawn frame remains the one returned by GetScreen().
+		void SetFrameSkip(int frameSkip)
+		{
+			m_frameSkip = std::max(frameSkip, 0);
+		}
+
+		int GetFrameSkip() const
+		{
+			return m_frameSkip;
+		}
+
+		// Number of frames completed since the last reset (including skipped frames).
+		uint64_t GetFrameCount() const
+		{
+			return m_frameCount;
+		}
+
+		uint64_t GetTotalCClocks() const
+		{
+			return m_totalCClocks;
+		}
+
+		// Colour clock at which a floppy drive was first selected since the last reset, or zero if
+		// none has been yet. Nothing before this point can depend on which disks are inserted.
+		uint64_t GetFirstDriveSelectCClock() const
+		{
+			return m_firstDriveSelectCClock;
+		}
+
+		ChipRamConfig GetChipRamConfig() const
+		{
+			return ChipRamConfig(m_chipRam.size());
+		}
+
+		AgnusVersion GetAgnusVersion() const
+		{
+			return m_agnusVersion;
+		}
+
+		std::span<const uint8_t> GetRom() const
+		{
+			return m_rom;
+		}
+
+		// The subsystem currently being emulated. Can be polled from another thread by a sampling
+		// profiler. Always returns Subsystem::Other unless built with GURU_PROFILE_SUBSYSTEMS.
+		Subsystem GetActiveSubsystem() const
+		{
+#if GURU_PROFILE_SUBSYSTEMS
+			return m_activeSubsystem.load(std::memory_order_relaxed);
+#else
+			return Subsystem::Other;
+#endif
+		}
+
 		const cpu::M68000* GetCpu() const
 		{
 			return m_m68000.get();
@@ -283,7 +470,10 @@ namespace am
 
 		const std::string& GetDiskName(int driveNum) const;
 		const std::string& GetDiskFilename(int driveNum) const;
-		bool SetDisk(int driveNum, const std::string& filename, const std::string& displayName, std::vector<uint8_t>&& diskImage);
+		bool SetDisk(int driveNum, const std::string& filename, const std::string& displayName, std::vector<uint8_t>&& diskImage, bool writeProtected = true);
+
+		// Inserts a disk that is read in place from a mapped file until it is written to.
+		bool SetDisk(int driveNum, const std::string& filename, const std::string& displayName, std::shared_ptr<const util::MappedFile> diskFile, bool writeProtected = true);
 		void EjectDisk(int driveNum);
 
 		bool IsDiskInserted(int driveNum) const
@@ -291,30 +481,161 @@ namespace am
 			return !m_floppyDisk[driveNum].fileLocation.empty();
 		}
 
+		// Moves the write protect tab of the disk in the drive. An empty drive reads as write
+		// protected.
+		void SetDiskWriteProtected(int driveNum, bool writeProtected);
+
+		bool IsDiskWriteProtected(int driveNum) const
+		{
+			return !IsDiskInserted(driveNum) || m_floppyDisk[driveNum].writeProtected;
+		}
+
+		// Attaches a hard disk image (HDF) to an A600/A1200 style Gayle IDE interface, which is only
+		// present while a hard disk is attached. Booting from it needs a kickstart with an IDE driver
+		// (2.05 or later). The image is read and written directly, so isn't part of the saved state.
+		bool SetHardDisk(const std::string& hdfFile);
+		void RemoveHardDisk();
+
+		const std::string& GetHardDiskFilename() const
+		{
+			return m_gayle.GetFilename();
+		}
+
+		// Mounts a directory of the host as the DOS device HOST: on an expansion board (see
+		// HostFileSystem), from the next reset. Needs kickstart 1.3 or later.
+		bool MountHostDirectory(const std::string& directory);
+		void UnmountHostDirectory();
+
+		const std::string& GetHostDirectory() const
+		{
+			return m_hostFs.GetDirectory();
+		}
+
+		// Turbo floppy mode copies each disk DMA read into memory as soon as it starts and spins the
+		// disk faster, so loading takes a fraction of the emulated time. Software that times the disk
+		// itself may not cope with it. This is a host setting and isn't part of the saved state.
+		void SetTurboFloppy(bool turbo)
+		{
+			m_turboFloppy = turbo;
+		}
+
+		bool GetTurboFloppy() const
+		{
+			return m_turboFloppy;
+		}
+
 		void SetControllerButton(int controller, int button, bool pressed);
 		void SetJoystickMove(int x, int y);
 		void SetMouseMove(int x, int y);
 
 		void QueueKeyPress(uint8_t keycode);
 
-		void WriteSnapshot(std::ostream& os) const;
-		bool ReadSnapshot(std::istream& is);
+		// Snapshot files hold the machine state as tagged, versioned chunks with RAM compressed.
+		// Inserted disks are stored either as a reference to their file plus a content hash, or
+		// embedded in the snapshot. Referenced disks are resolved with loadDisk when loading, and
+		// must match their hash. A referenced disk that can't be resolved fails the load, unless
+		// missingDisks is given, in which case its file is added there and the drive left empty.
+		// The machine is untouched if the load fails.
+		void WriteSnapshot(std::ostream& os, bool embedDisks = false) const;
+		bool ReadSnapshot(std::istream& is, const SnapshotDiskLoader& loadDisk = {}, std::vector<std::string>* missingDisks = nullptr);
+
+		// Fast in-memory equivalents of Write/ReadSnapshot. The rom and inserted disks are not
+		// included, but unlike snapshots the frame count is, so going back to a state (rewinding)
+		// takes the frame count back with it. Nor are disk contents, so anything written to a floppy
+		// or hard disk since the state was saved stays written when it's loaded. LoadState fails if
+		// the state was saved with a different RAM configuration.
+		void SaveState(SavedState& state) const;
+		bool LoadState(const SavedState& state);
+
+		// A full save that also becomes the base for delta saves. RAM writes are tracked per
+		// page from this point on.
+		void SaveBaseState(SavedState& base);
+
+		// Saves the core state and the RAM pages written since the last SaveBaseState.
+		void SaveDeltaState(DeltaState& delta) const;
+
+		// Restores a delta on top of the base it was saved against. When that base is still the
+		// latest one only the pages that differ are copied, otherwise all of RAM is restored.
+		bool LoadDeltaState(const SavedState& base, const DeltaState& delta);
 
 	public:
 		virtual uint16_t ReadBusWord(uint32_t addr) override final;
 		virtual void WriteBusWord(uint32_t addr, uint16_t value) override final;
 		virtual uint8_t ReadBusByte(uint32_t addr) override final;
 		virtual void WriteBusByte(uint32_t addr, uint8_t value) override final;
+		virtual bool LineFTrap(uint16_t opcode, cpu::Registers& regs) override final;
 
 	private:
 
-		template <typename S>
-		void Stream(S& s);
+		// Everything but RAM, streamed per subsystem. Each subsystem is its own snapshot chunk. Self is
+		// const Amiga when writing, so saving doesn't need a mutable machine.
+		template <typename S, typename Self>
+		static void StreamCore(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamCpu(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamChipset(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamCias(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamFloppy(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamAudio(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamIde(S& s, Self& self);
+
+		template <typename S, typename Self>
+		static void StreamHostFs(S& s, Self& self);
+
+		bool IsCoreSizeValid(const std::vector<uint8_t>& core);
+
+		void RecordInput(InputType type, int32_t a, int32_t b = 0, int32_t c = 0, const FloppyDisk* disk = nullptr)
+		{
+			if (m_inputRecorder)
+			{
+				m_inputRecorder->RecordInput({ m_totalCClocks, type, a, b, c, disk });
+			}
+		}
+
+		// Returns the previously active subsystem so nested work can restore it.
+		Subsystem EnterSubsystem([[maybe_unused]] Subsystem subsystem)
+		{
+#if GURU_PROFILE_SUBSYSTEMS
+			return m_activeSubsystem.exchange(subsystem, std::memory_order_relaxed);
+#else
+			return Subsystem::Other;
+#endif
+		}
+
+		void MarkRamDirty(Mapped type, const uint8_t* mem)
+		{
+			if (type == Mapped::ChipRam)
+			{
+				m_chipRamDirty.Mark(uint32_t(mem - m_chipRam.data()));
+			}
+			else if (type == Mapped::SlowRam)
+			{
+				m_slowRamDirty.Mark(uint32_t(mem - m_slowRam.data()));
+			}
+		}
+
+		void ResetDirtyPages()
+		{
+			m_chipRamDirty.Resize(m_chipRam.size());
+			m_slowRamDirty.Resize(m_slowRam.size());
+		}
 
 		uint16_t ReadChipWord(uint32_t addr) const;
 		void WriteChipWord(uint32_t addr, uint16_t value);
 
 		std::tuple<Mapped, uint8_t*> GetMappedMemory(uint32_t addr);
+		std::tuple<Mapped, uint8_t*> GetExpansionMemory(uint32_t addr);
 
 		bool CpuReady() const
 		{
@@ -324,6 +645,7 @@ namespace am
 		void DoOneTick();
 
 		void UpdateScreen();
+		ColourRef HoldAndModify(uint8_t value);
 
 		void DoCopper(bool& chipBusBusy);
 		bool DoScanlineDma();
@@ -375,6 +697,15 @@ namespace am
 		void UpdateFloppyDriveFlags();
 		void StartDiskDMA();
 		void DoDiskDMA();
+		uint16_t ReadDiskDmaWord();
+		void WriteDiskDmaWord(uint16_t value);
+		uint32_t GetDiskDmaPosition(uint32_t bitLength) const;
+		void SetDiskDmaPosition(uint32_t position);
+		void CommitDiskWrites(int driveNum);
+		std::span<uint8_t> GetWritableDiskData(int driveNum);
+		bool InsertDisk(int driveNum, const std::string& filename, const std::string& displayName, std::vector<uint8_t>&& data, std::shared_ptr<const util::MappedFile> mappedFile, bool writeProtected);
+		void FinishDiskDMA();
+		int GetDiskRevolutionCClocks() const;
 
 		void TransmitKeyCode();
 
@@ -382,12 +713,30 @@ namespace am
 		void UpdateAudioChannel(int channel);
 		void UpdateAudioChannelOnDmaChange(int channel, bool dmaOn);
 		void UpdateAudioChannelOnData(int channel, uint16_t value);
+		void OutputAudioLevel(int channel);
+		void ResyncAudioOutput();
 
 	private:
-		std::vector<uint8_t> m_rom;
+		std::span<const uint8_t> m_rom;
+		std::vector<uint8_t> m_romCopy;
+		std::shared_ptr<const util::MappedFile> m_romFile;
 		std::vector<uint8_t> m_chipRam;
 		std::vector<uint8_t> m_slowRam;
 
+		// Pages written since the last base state.
+		DirtyPages m_chipRamDirty;
+		DirtyPages m_slowRamDirty;
+		uint64_t m_baseGeneration = 0;
+
+		// What this build streams for the core, to check a state's size against before loading it.
+		std::vector<uint8_t> m_coreSizeCheck;
+
+		// State to return to after running ahead.
+		SavedState m_runAheadState;
+		DirtyPages m_runAheadChipRamDirty;
+		DirtyPages m_runAheadSlowRamDirty;
+		bool m_runningAhead = false;
+
 		AgnusVersion m_agnusVersion = AgnusVersion::PAL_ECS;
 
 		bool m_romOverlayEnabled = false;
@@ -456,6 +805,10 @@ namespace am
 		int m_timerCountdown = 0;
 
 		uint64_t m_totalCClocks = 0;
+
+#if GURU_PROFILE_SUBSYSTEMS
+		std::atomic<Subsystem> m_activeSubsystem = Subsystem::Other;
+#endif
 		int m_cpuBusyTimer = 0;
 
 		Copper m_copper = {};
@@ -485,15 +838,29 @@ namespace am
 		std::unique_ptr<ScreenBuffer> m_currentScreen;
 		std::unique_ptr<ScreenBuffer> m_lastScreen;
 
+		// The display isn't part of the saved state, so RunAhead keeps it aside.
+		std::array<PlayfieldBuffer, 2> m_runAheadPlayfieldBuffer;
+		std::unique_ptr<ScreenBuffer> m_runAheadScreen; // drawn into while running ahead
+
+		uint64_t m_frameCount = 0;
+		uint64_t m_firstDriveSelectCClock = 0;
+		int m_frameSkip = 0;
+		int m_frameSkipCounter = 0;
+		bool m_skipFrameOutput = false;
+
 		Sprite m_sprite[8];
 
 		FloppyDisk m_floppyDisk[4];
 		FloppyDrive m_floppyDrive[4];
 		int m_driveSelected;
 		int m_diskRotationCountdown; // Countdown to next full disk rotation.
+		bool m_turboFloppy = false;
 
 		DiskDma m_diskDma;
 
+		Gayle m_gayle;
+		HostFileSystem m_hostFs{ *this };
+
 		// Keyboard
 		static constexpr int kKeyQueueSize = 32;
 		std::array<uint8_t, kKeyQueueSize> m_keyQueue;
@@ -502,11 +869,10 @@ namespace am
 		int m_keyCooldown;
 
 		// Audio
-		am::AudioPlayer* m_audioPlayer = nullptr;
-		uint64_t m_audioBufferPos = 0;
-		int m_audioBufferCountdown = 0;
+		am::InputRecorder* m_inputRecorder = nullptr;
+		am::DiskWriteHandler* m_diskWriteHandler = nullptr;
 		AudioChannel m_audio[4];
-		AudioBuffer m_audioBuffer;
+		AudioSynth m_audioSynth;
 
 		// Logging
 		util::Log* m_log = nullptr;
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <array>
 #include <vector>
 #include <stdint.h>
 
@@ -8,11 +7,25 @@ namespace am
 {
 	constexpr int kAudioBufferLength = 1024;
 
-	using AudioBuffer = std::array<std::vector<uint8_t>, 2>;
+	// Used by players that don't ask for a rate of their own.
+	constexpr int kDefaultAudioSampleRate = 48000;
+
+	// Paula's channels are clocked by the colour clock.
+	constexpr int kPalColourClockRate = 3546895;
+	constexpr int kNtscColourClockRate = 3579545;
+
+	// kAudioBufferLength frames of 16-bit stereo, interleaved left and right.
+	using AudioBuffer = std::vector<int16_t>;
 
 	class AudioPlayer
 	{
 	public:
 		virtual void AddAudioBuffer(const AudioBuffer* buffer) = 0;
+
+		// The rate the player wants its buffers at.
+		virtual int GetSampleRate() const
+		{
+			return kDefaultAudioSampleRate;
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "audio_synth.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+namespace
+{
+	// Where the filter of the steps starts to cut, as a fraction of the output sample rate. The
+	// window takes them from there to the bottom by about the Nyquist frequency.
+	constexpr double kCutoff = 0.42;
+}
+
+am::AudioSynth::AudioSynth()
+{
+	// The impulse response, a Blackman windowed sinc kTaps samples long, sampled kPhases times
+	// a sample.
+	const int length = kTaps * kPhases;
+	std::vector<double> impulse(length);
+
+	for (int i = 0; i < length; i++)
+	{
+		const double x = (i + 0.5) / kPhases - kTaps / 2;
+		const double t = 2.0 * kCutoff * x;
+		const double sinc = std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+		const double u = (i + 0.5) / length;
+		const double window = 0.42 - 0.5 * std::cos(2.0 * std::numbers::pi * u) + 0.08 * std::cos(4.0 * std::numbers::pi * u);
+		impulse[i] = sinc * window;
+	}
+
+	// Each entry is how much of a step at that phase arrives at that sample, i.e. the part of the
+	// impulse response that falls in the sample before it. The entries are rounded so that each
+	// phase adds up to exactly one unit, or steps wouldn't return to the level they should.
+	for (int phase = 0; phase < kPhases; phase++)
+	{
+		std::array<double, kTaps> part = {};
+		double total = 0.0;
+
+		for (int tap = 0; tap < kTaps; tap++)
+		{
+			const int first = std::max(tap * kPhases - phase, 0);
+			const int end = std::min((tap + 1) * kPhases - phase, length);
+
+			for (int i = first; i < end; i++)
+			{
+				part[tap] += impulse[i];
+			}
+			total += part[tap];
+		}
+
+		double sum = 0.0;
+		int32_t rounded = 0;
+
+		for (int tap = 0; tap < kTaps; tap++)
+		{
+			sum += part[tap];
+			const auto upToHere = int32_t(std::lround(sum / total * (1 << kStepBits)));
+			m_steps[phase][tap] = upToHere - rounded;
+			rounded = upToHere;
+		}
+	}
+
+	// Steps at the very start reach back before the first sample.
+	m_sampleBase = kTaps;
+
+	m_buffer.resize(kAudioBufferLength * 2);
+}
+
+void am::AudioSynth::SetPlayer(AudioPlayer* player)
+{
+	m_player = player;
+
+	if (player)
+	{
+		SetRates(m_clockRate, player->GetSampleRate());
+	}
+}
+
+void am::AudioSynth::SetClockRate(int clockRate)
+{
+	SetRates(clockRate, m_sampleRate);
+}
+
+void am::AudioSynth::SetRates(int clockRate, int sampleRate)
+{
+	if (clockRate == m_clockRate && sampleRate == m_sampleRate)
+		return;
+
+	// Carry on from the sample the current time maps to at the old rates.
+	m_sampleBase += (m_time - m_timeBase) * m_sampleRate / m_clockRate;
+	m_timeBase = m_time;
+
+	m_clockRate = clockRate;
+	m_sampleRate = sampleRate;
+}
+
+void am::AudioSynth::Resync(uint64_t cclock)
+{
+	m_clockOffset = m_time - cclock;
+}
+
+void am::AudioSynth::SetLevel(uint64_t cclock, int channel, int level)
+{
+	m_time = ToTime(cclock);
+
+	const int delta = level - m_level[channel];
+	if (delta == 0)
+		return;
+
+	m_level[channel] = level;
+
+	const uint64_t scaled = (m_time - m_timeBase) * m_sampleRate;
+	const uint64_t sample = m_sampleBase + scaled / m_clockRate;
+	const int phase = int((scaled % m_clockRate) * kPhases / m_clockRate);
+
+	// Everything before the first sample the step reaches is final now.
+	const uint64_t first = sample + 1 - kTaps / 2;
+	OutputUntil(first);
+
+	auto& ring = m_ring[(channel == 0 || channel == 3) ? 0 : 1];
+	const auto& step = m_steps[phase];
+
+	for (int tap = 0; tap < kTaps; tap++)
+	{
+		ring[(first + tap) % kRingSize] += int64_t(delta) * step[tap];
+	}
+}
+
+void am::AudioSynth::Advance(uint64_t cclock)
+{
+	m_time = ToTime(cclock);
+
+	// Every m_clockRate clocks are exactly m_sampleRate samples, so the base can be moved on by
+	// whole seconds without losing anything. This keeps the sums below well clear of overflowing.
+	const uint64_t seconds = (m_time - m_timeBase) / m_clockRate;
+	m_timeBase += seconds * m_clockRate;
+	m_sampleBase += seconds * m_sampleRate;
+
+	const uint64_t sample = m_sampleBase + (m_time - m_timeBase) * m_sampleRate / m_clockRate;
+	OutputUntil(sample + 1 - kTaps / 2);
+}
+
+void am::AudioSynth::OutputUntil(uint64_t sample)
+{
+	for (; m_nextSample < sample; m_nextSample++)
+	{
+		const auto index = m_nextSample % kRingSize;
+
+		for (int side = 0; side < 2; side++)
+		{
+			m_accumulator[side] += m_ring[side][index];
+			m_ring[side][index] = 0;
+
+			// Two channels at full volume just fit.
+			const auto value = m_accumulator[side] >> (kStepBits - 1);
+			m_buffer[m_bufferPos * 2 + side] = int16_t(std::clamp<int64_t>(value, INT16_MIN, INT16_MAX));
+		}
+
+		m_bufferPos++;
+		if (m_bufferPos == kAudioBufferLength)
+		{
+			if (m_player)
+			{
+				m_player->AddAudioBuffer(&m_buffer);
+			}
+			m_bufferPos = 0;
+		}
+	}
+}
\ No newline at end of file
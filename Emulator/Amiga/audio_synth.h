@@ -0,0 +1,76 @@
+#pragma once
+
+#include "audio.h"
+
+#include <array>
+#include <stdint.h>
+
+namespace am
+{
+	// Turns the output levels of Paula's four channels into 16-bit stereo at the player's rate.
+	//
+	// A channel's level only changes when it moves on to its next sample or its volume is written,
+	// so rather than sampling the levels at regular intervals, which folds everything above half the
+	// sample rate back down into the audible range, each change is added to the output as a
+	// band-limited step: the integral of a windowed sinc, positioned at the exact point between
+	// output samples where the change happened. Channels 0 and 3 make up the left side and 1 and 2
+	// the right.
+	//
+	// Times are given in colour clocks. None of this is part of the saved state.
+	class AudioSynth
+	{
+	public:
+		AudioSynth();
+
+		void SetPlayer(AudioPlayer* player);
+		void SetClockRate(int clockRate);
+
+		// The emulated clock has jumped to cclock, as it does when a state is loaded or the machine
+		// is reset. Output carries on from where it had got to.
+		void Resync(uint64_t cclock);
+
+		// level is the channel's sample scaled by its volume (-128 * 64 to 127 * 64).
+		void SetLevel(uint64_t cclock, int channel, int level);
+
+		// Outputs the samples that no change after cclock can affect any more.
+		void Advance(uint64_t cclock);
+
+	private:
+		static constexpr int kPhases = 64;		// positions of a step between two output samples
+		static constexpr int kTaps = 32;		// output samples affected by a step
+		static constexpr int kStepBits = 15;	// precision of the step table
+		static constexpr int kRingSize = 64;
+
+		uint64_t ToTime(uint64_t cclock) const
+		{
+			return cclock + m_clockOffset;
+		}
+
+		void SetRates(int clockRate, int sampleRate);
+		void OutputUntil(uint64_t sample);
+
+		std::array<std::array<int32_t, kTaps>, kPhases> m_steps;
+
+		AudioPlayer* m_player = nullptr;
+		int m_clockRate = kPalColourClockRate;
+		int m_sampleRate = kDefaultAudioSampleRate;
+
+		// Time runs on from one state to the next even when the emulated clock doesn't.
+		uint64_t m_clockOffset = 0;
+		uint64_t m_time = 0;
+
+		// Output sample number = m_sampleBase + (time - m_timeBase) * m_sampleRate / m_clockRate
+		uint64_t m_timeBase = 0;
+		uint64_t m_sampleBase = 0;
+
+		std::array<int, 4> m_level = {};
+
+		// The changes still to be added to the output, from sample m_nextSample on.
+		std::array<std::array<int64_t, kRingSize>, 2> m_ring = {};
+		std::array<int64_t, 2> m_accumulator = {};
+		uint64_t m_nextSample = 0;
+
+		AudioBuffer m_buffer;
+		int m_bufferPos = 0;
+	};
+}
\ No newline at end of file
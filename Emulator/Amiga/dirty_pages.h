@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+#include <stdint.h>
+
+namespace am
+{
+	constexpr uint32_t kDirtyPageShift = 12;
+	constexpr uint32_t kDirtyPageSize = 1 << kDirtyPageShift;
+
+	// One bit per 4KiB page of a RAM area, set when the page is written.
+	class DirtyPages
+	{
+	public:
+		void Resize(size_t ramSize)
+		{
+			m_numPages = uint32_t((ramSize + kDirtyPageSize - 1) >> kDirtyPageShift);
+			m_bits.assign((m_numPages + 63) / 64, 0);
+			MarkAll();
+		}
+
+		void Mark(uint32_t offset)
+		{
+			const auto page = offset >> kDirtyPageShift;
+			m_bits[page >> 6] |= uint64_t(1) << (page & 63);
+		}
+
+		void MarkAll()
+		{
+			for (uint32_t page = 0; page < m_numPages; page++)
+				m_bits[page >> 6] |= uint64_t(1) << (page & 63);
+		}
+
+		void Clear()
+		{
+			std::fill(m_bits.begin(), m_bits.end(), 0);
+		}
+
+		uint32_t NumPages() const
+		{
+			return m_numPages;
+		}
+
+		// Calls f(pageIndex) for each dirty page in ascending order.
+		template <typename F>
+		void ForEach(F&& f) const
+		{
+			for (size_t w = 0; w < m_bits.size(); w++)
+			{
+				for (uint64_t bits = m_bits[w]; bits != 0; bits &= bits - 1)
+				{
+					f(uint32_t(w * 64 + std::countr_zero(bits)));
+				}
+			}
+		}
+
+	private:
+		std::vector<uint64_t> m_bits;
+		uint32_t m_numPages = 0;
+	};
+}
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include "symbols.h"
 
+#include <cassert>
+#include <cstdio>
+#include <cwctype>
 #include <iterator>
 #include <string.h>
 
@@ -14,7 +17,7 @@ namespace
 		const char* disassembly;
 	};
 
-	OperationEncoding encodingList[] =
+	const OperationEncoding encodingList[] =
 	{
 		{ 0b11111111'11111111,	0b00000000'00111100,	"ori        {imm:b}, CCR" },
 		{ 0b11111111'11111111,	0b00000000'01111100,	"ori        {imm:w}, SR" },
@@ -241,7 +244,7 @@ namespace
 
 				const char* start = curr + 1;
 				const char* end = ::strchr(start, '}');
-				_ASSERTE(end);
+				assert(end);
 
 				const char* sizeSpecifierDivider = ::strchr(start, ':');
 				const char* codeEnd = sizeSpecifierDivider ? sizeSpecifierDivider : end;
@@ -257,7 +260,7 @@ namespace
 					}
 				}
 
-				_ASSERTE(p.code != CodeType::CodeType_length);
+				assert(p.code != CodeType::CodeType_length);
 
 				if (sizeSpecifierDivider)
 				{
@@ -271,15 +274,15 @@ namespace
 						}
 					}
 
-					_ASSERTE(p.size != -1);
+					assert(p.size != -1);
 				}
 
 				curr = end + 1;
 			}
-			else if (inOperator && ::iswspace(c))
+			else if (inOperator && std::iswspace(c))
 			{
 				p.type = PieceType::operator_done;
-				while (::iswspace(*curr))
+				while (std::iswspace(*curr))
 					++curr;
 
 				inOperator = false;
@@ -323,17 +326,17 @@ namespace
 	{
 		if (size == 0)
 		{
-			charsLeft -= sprintf_s(buffptr, charsLeft, "$%02x", value);
+			charsLeft -= snprintf(buffptr, charsLeft, "$%02x", value);
 			buffptr += 3;
 		}
 		else if (size == 1)
 		{
-			charsLeft -= sprintf_s(buffptr, charsLeft, "$%04x", value);
+			charsLeft -= snprintf(buffptr, charsLeft, "$%04x", value);
 			buffptr += 5;
 		}
 		else if (size == 2)
 		{
-			charsLeft -= sprintf_s(buffptr, charsLeft, "$%08x", value);
+			charsLeft -= snprintf(buffptr, charsLeft, "$%08x", value);
 			buffptr += 9;
 		}
 	}
@@ -343,13 +346,13 @@ namespace
 
 am::Disasm::Opcode am::Disassembler::Disassemble()
 {
-	_ASSERTE(m_memory);
+	assert(m_memory);
 
 	const auto instruction = m_memory->GetWord(pc);
 	pc += 2;
 	const auto savedPc = pc;
 
-	OperationEncoding* encoding = nullptr;
+	const OperationEncoding* encoding = nullptr;
 
 	for (auto& e : encodingList)
 	{
@@ -391,7 +394,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 		case PieceType::text:
 		{
 			auto numChars = std::min(charsLeft, p.textLength);
-			strncpy_s(buffptr, charsLeft, p.textStart, numChars);
+			snprintf(buffptr, charsLeft, "%.*s", int(numChars), p.textStart);
 			buffptr += numChars;
 			charsLeft -= numChars;
 		}	break;
@@ -481,7 +484,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 			case CodeType::condition:
 			{
 				const int cc = (instruction & 0b00001111'00000000) >> 8;
-				const auto count = sprintf_s(buffptr, charsLeft, "%s", condition[cc]);
+				const auto count = snprintf(buffptr, charsLeft, "%s", condition[cc]);
 				buffptr += count;
 				charsLeft -= count;
 			}	break;
@@ -489,7 +492,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 			case CodeType::register_low:
 			{
 				const auto reg = (instruction & 0b00000000'00000111);
-				const auto count = sprintf_s(buffptr, charsLeft, "%d", reg);
+				const auto count = snprintf(buffptr, charsLeft, "%d", reg);
 				buffptr += count;
 				charsLeft -= count;
 			}	break;
@@ -497,7 +500,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 			case CodeType::register_high:
 			{
 				const auto reg = (instruction & 0b00001110'00000000) >> 9;
-				const auto count = sprintf_s(buffptr, charsLeft, "%d", reg);
+				const auto count = snprintf(buffptr, charsLeft, "%d", reg);
 				buffptr += count;
 				charsLeft -= count;
 			}	break;
@@ -518,7 +521,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 			case CodeType::vector:
 			{
 				const int vector = (instruction & 0b00000000'00001111);
-				const auto count = sprintf_s(buffptr, charsLeft, "%d", vector);
+				const auto count = snprintf(buffptr, charsLeft, "%d", vector);
 				buffptr += count;
 				charsLeft -= count;
 			}	break;
@@ -533,7 +536,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 
 				pc += 2;
 
-				int count = sprintf_s(buffptr, charsLeft, "%hi -> $%08x", displacement, target);
+				int count = snprintf(buffptr, charsLeft, "%hi -> $%08x", displacement, target);
 				buffptr += count;
 				charsLeft -= count;
 
@@ -541,11 +544,11 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 				{
 					if (target > sub->start)
 					{
-						count = sprintf_s(buffptr, charsLeft, " (%s+%04x)", sub->name.c_str(), target - sub->start);
+						count = snprintf(buffptr, charsLeft, " (%s+%04x)", sub->name.c_str(), target - sub->start);
 					}
 					else
 					{
-						count = sprintf_s(buffptr, charsLeft, " (%s)", sub->name.c_str());
+						count = snprintf(buffptr, charsLeft, " (%s)", sub->name.c_str());
 					}
 					buffptr += count;
 					charsLeft -= count;
@@ -567,7 +570,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 
 				const am::Subroutine* sub = m_symbols ? m_symbols->GetSub(target) : nullptr;
 
-				int count = sprintf_s(buffptr, charsLeft, "%hi -> $%08x", displacement, target);
+				int count = snprintf(buffptr, charsLeft, "%hi -> $%08x", displacement, target);
 				buffptr += count;
 				charsLeft -= count;
 
@@ -575,11 +578,11 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 				{
 					if (target > sub->start)
 					{
-						count = sprintf_s(buffptr, charsLeft, " (%s+%04x)", sub->name.c_str(), target - sub->start);
+						count = snprintf(buffptr, charsLeft, " (%s+%04x)", sub->name.c_str(), target - sub->start);
 					}
 					else
 					{
-						count = sprintf_s(buffptr, charsLeft, " (%s)", sub->name.c_str());
+						count = snprintf(buffptr, charsLeft, " (%s)", sub->name.c_str());
 					}
 					buffptr += count;
 					charsLeft -= count;
@@ -590,7 +593,7 @@ am::Disasm::Opcode am::Disassembler::Disassemble()
 			case CodeType::displacement_data:
 			{
 				const auto displacement = int16_t(GetImmediateValue(1));
-				const auto count = sprintf_s(buffptr, charsLeft, "%hi", displacement);
+				const auto count = snprintf(buffptr, charsLeft, "%hi", displacement);
 				buffptr += count;
 				charsLeft -= count;
 			}	break;
@@ -716,25 +719,25 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 	switch (mode)
 	{
 	case 0b000: // Dn
-		count = sprintf_s(buffptr, charsLeft, "D%d", reg);
+		count = snprintf(buffptr, charsLeft, "D%d", reg);
 		break;
 
 	case 0b001: // An
-		count = sprintf_s(buffptr, charsLeft, "A%d", reg);
+		count = snprintf(buffptr, charsLeft, "A%d", reg);
 		break;
 
 	case 0b010: // (An)
-		count = sprintf_s(buffptr, charsLeft, "(A%d)", reg);
+		count = snprintf(buffptr, charsLeft, "(A%d)", reg);
 		eaMem = AddressRegIndirect(reg, 0);
 		break;
 
 	case 0b011: // (An)+
-		count = sprintf_s(buffptr, charsLeft, "(A%d)+", reg);
+		count = snprintf(buffptr, charsLeft, "(A%d)+", reg);
 		eaMem = AddressRegIndirect(reg, 0);
 		break;
 
 	case 0b100: // -(An)
-		count = sprintf_s(buffptr, charsLeft, "-(A%d)", reg);
+		count = snprintf(buffptr, charsLeft, "-(A%d)", reg);
 		eaMem = AddressRegIndirect(reg, -(1 << size));
 		break;
 
@@ -742,7 +745,7 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 	{
 		const uint32_t displacement = m_memory->GetWord(pc);
 		pc += 2;
-		count = sprintf_s(buffptr, charsLeft, "($%04x, A%d)", displacement, reg);
+		count = snprintf(buffptr, charsLeft, "($%04x, A%d)", displacement, reg);
 		eaMem = AddressRegIndirect(reg, uint32_t(int32_t(int16_t(displacement))));
 		break;
 	}
@@ -756,7 +759,7 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 		const bool isAddressReg = (briefExtensionWord & 0b10000000'00000000) != 0;
 		const bool isLong = (briefExtensionWord & 0b00001000'00000000) != 0;
 
-		count = sprintf_s(buffptr, charsLeft, "($%02x, A%d, %c%d.%c)",
+		count = snprintf(buffptr, charsLeft, "($%02x, A%d, %c%d.%c)",
 			displacement,
 			reg,
 			(isAddressReg ? 'A' : 'D'),
@@ -782,7 +785,7 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 		{
 			uint32_t value = m_memory->GetWord(pc);
 			pc += 2;
-			count = sprintf_s(buffptr, charsLeft, "($%04x).w", value);
+			count = snprintf(buffptr, charsLeft, "($%04x).w", value);
 			eaMem = Address(uint32_t(int32_t(int16_t(value))));
 		}	break;
 
@@ -810,11 +813,11 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 
 			if (symName)
 			{
-				count = sprintf_s(buffptr, charsLeft, "(%s).l", symName->c_str());
+				count = snprintf(buffptr, charsLeft, "(%s).l", symName->c_str());
 			}
 			else
 			{
-				count = sprintf_s(buffptr, charsLeft, "($%08x).l", value);
+				count = snprintf(buffptr, charsLeft, "($%08x).l", value);
 			}
 			eaMem = Address(value);
 		}	break;
@@ -823,7 +826,7 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 		{
 			const auto displacement = int16_t(m_memory->GetWord(pc));
 			uint32_t value = pc + displacement;
-			count = sprintf_s(buffptr, charsLeft, "($%04x, PC){$%08x}", uint16_t(displacement), value);
+			count = snprintf(buffptr, charsLeft, "($%04x, PC){$%08x}", uint16_t(displacement), value);
 			pc += 2;
 			eaMem = ProgramCounterIndirect(uint32_t(int32_t(displacement)));
 		}	break;
@@ -837,7 +840,7 @@ std::optional<am::Disasm::EaMem> am::Disassembler::WriteEffectiveAddress(int mod
 			const bool isAddressReg = (briefExtensionWord & 0b10000000'00000000) != 0;
 			const bool isLong = (briefExtensionWord & 0b00001000'00000000) != 0;
 
-			count = sprintf_s(buffptr, charsLeft, "($%02x, PC, %c%d.%c)",
+			count = snprintf(buffptr, charsLeft, "($%02x, PC, %c%d.%c)",
 				displacement,
 				(isAddressReg ? 'A' : 'D'),
 				exWordReg,
@@ -907,11 +910,11 @@ void am::Disassembler::WriteRegisterList(uint16_t mask, bool isReversed, char*&
 
 		if (first == last)
 		{
-			count = sprintf_s(buffptr, charsLeft, "%c%d", r, first);
+			count = snprintf(buffptr, charsLeft, "%c%d", r, first);
 		}
 		else
 		{
-			count = sprintf_s(buffptr, charsLeft, "%c%d-%c%d", r, first, r, last);
+			count = snprintf(buffptr, charsLeft, "%c%d-%c%d", r, first, r, last);
 		}
 		buffptr += count;
 		charsLeft -= count;
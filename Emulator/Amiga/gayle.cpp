@@ -0,0 +1,830 @@
+#include "gayle.h"
+
+#include "util/stream.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <string_view>
+
+namespace
+{
+	constexpr uint8_t kGayleId = 0xd0;
+
+	// Task file registers, by their index in the IDE register block.
+	enum IdeRegister : uint32_t
+	{
+		Data = 0,
+		Error = 1,			// Feature when written
+		SectorCount = 2,
+		SectorNumber = 3,
+		CylinderLow = 4,
+		CylinderHigh = 5,
+		DeviceHead = 6,
+		Status = 7,			// Command when written
+	};
+
+	// Of the control block, selected by 0x1000 in the address.
+	constexpr uint32_t kAltStatus = 6; // DeviceControl when written
+
+	namespace StatusBits
+	{
+		constexpr uint8_t Busy = 0x80;
+		constexpr uint8_t Ready = 0x40;
+		constexpr uint8_t SeekComplete = 0x10;
+		constexpr uint8_t DataRequest = 0x08;
+		constexpr uint8_t Error = 0x01;
+	}
+
+	namespace ErrorBits
+	{
+		constexpr uint8_t Uncorrectable = 0x40;
+		constexpr uint8_t IdNotFound = 0x10;
+		constexpr uint8_t Aborted = 0x04;
+	}
+
+	constexpr uint8_t kDeviceSlave = 0x10;
+	constexpr uint8_t kDeviceLba = 0x40;
+
+	constexpr uint8_t kControlSoftReset = 0x04;
+	constexpr uint8_t kControlInterruptDisable = 0x02;
+
+	constexpr uint8_t kIdleStatus = StatusBits::Ready | StatusBits::SeekComplete;
+
+	// Addresses beyond 28 bit LBA can't be reached by the commands implemented.
+	constexpr uint32_t kMaxSectors = 0x0fff'ffff;
+}
+
+bool am::Gayle::Attach(const std::string& hdfFile)
+{
+	Detach();
+
+	const auto path = std::filesystem::path(hdfFile);
+
+	std::error_code ec;
+	const auto size = std::filesystem::file_size(path, ec);
+	if (ec || size < kSectorSize)
+		return false;
+
+	m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+	m_readOnly = !m_file.is_open();
+	if (m_readOnly)
+	{
+		m_file.clear();
+		m_file.open(path, std::ios::in | std::ios::binary);
+		if (!m_file.is_open())
+			return false;
+	}
+
+	m_filename = hdfFile;
+	m_totalSectors = uint32_t(std::min<uint64_t>(size / kSectorSize, kMaxSectors));
+
+	// The geometry reported by IDENTIFY DEVICE. Drivers use LBA addressing, or the geometry from
+	// the rigid disk block, so it only needs to cover the disk.
+	m_defaultHeads = 16;
+	m_defaultSectors = 63;
+	m_defaultCylinders = uint16_t(std::clamp<uint32_t>(m_totalSectors / (16 * 63), 1, 16383));
+
+	Reset();
+	return true;
+}
+
+void am::Gayle::Detach()
+{
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+	m_file.clear();
+	m_filename.clear();
+	m_readOnly = false;
+	m_totalSectors = 0;
+	Reset();
+}
+
+void am::Gayle::SetRunningAhead(bool runningAhead)
+{
+	m_runningAhead = runningAhead;
+	if (!runningAhead)
+	{
+		m_runAheadWrites.clear();
+	}
+}
+
+void am::Gayle::Reset()
+{
+	m_cardStatus = 0;
+	m_irq = 0;
+	m_intEnable = 0;
+	m_config = 0;
+	m_idCount = 0;
+
+	m_feature = 0;
+	m_deviceControl = 0;
+	m_intrq = false;
+
+	m_heads = m_defaultHeads;
+	m_sectors = m_defaultSectors;
+	m_multipleSectors = 0;
+
+	m_transfer = Transfer::None;
+	m_sectorsLeft = 0;
+	m_bufferPos = 0;
+	m_bufferEnd = 0;
+
+	SetDiagnosticSignature();
+	m_status = kIdleStatus;
+}
+
+uint8_t am::Gayle::ReadByte(uint32_t addr)
+{
+	addr &= 0xff'ffff;
+
+	if ((addr & 0xff'0000) == kIdRegisterBase)
+	{
+		if ((addr & 0xf000) != 0x1000)
+			return 0;
+
+		// The id is read a bit at a time, most significant first, in bit 7.
+		const uint8_t bit = uint8_t(kGayleId << m_idCount) & 0x80;
+		m_idCount = (m_idCount + 1) & 7;
+		return bit;
+	}
+
+	const uint32_t offset = addr & 0xffff;
+	if (offset >= 0x8000)
+		return ReadGayleRegister(offset);
+
+	return ReadIdeRegister(offset);
+}
+
+uint16_t am::Gayle::ReadWord(uint32_t addr)
+{
+	const uint32_t offset = addr & 0xffff;
+	if ((addr & 0xff'0000) != kIdRegisterBase && (offset & 0xb000) == 0x2000 && ((offset >> 2) & 7) == IdeRegister::Data)
+		return ReadData();
+
+	// The 8 bit registers are on the upper half of the data bus.
+	return uint16_t(ReadByte(addr)) << 8;
+}
+
+void am::Gayle::WriteByte(uint32_t addr, uint8_t value)
+{
+	addr &= 0xff'ffff;
+
+	if ((addr & 0xff'0000) == kIdRegisterBase)
+	{
+		// Any write restarts reading the id.
+		if ((addr & 0xf000) == 0x1000)
+		{
+			m_idCount = 0;
+		}
+		return;
+	}
+
+	const uint32_t offset = addr & 0xffff;
+	if (offset >= 0x8000)
+	{
+		WriteGayleRegister(offset, value);
+	}
+	else
+	{
+		WriteIdeRegister(offset, value);
+	}
+}
+
+void am::Gayle::WriteWord(uint32_t addr, uint16_t value)
+{
+	const uint32_t offset = addr & 0xffff;
+	if ((addr & 0xff'0000) != kIdRegisterBase && (offset & 0xb000) == 0x2000 && ((offset >> 2) & 7) == IdeRegister::Data)
+	{
+		WriteData(value);
+		return;
+	}
+
+	WriteByte(addr, uint8_t(value >> 8));
+}
+
+uint8_t am::Gayle::ReadGayleRegister(uint32_t offset)
+{
+	switch (offset & 0xf000)
+	{
+	case 0x8000: // card status, with the current state of the IDE interrupt line
+		return (m_cardStatus & ~kGayleIde) | ((m_intrq && !(m_deviceControl & kControlInterruptDisable)) ? kGayleIde : 0);
+
+	case 0x9000: // interrupt requests
+		return m_irq;
+
+	case 0xa000: // interrupt enables
+		return m_intEnable;
+
+	case 0xb000:
+		return m_config;
+
+	default:
+		return 0;
+	}
+}
+
+void am::Gayle::WriteGayleRegister(uint32_t offset, uint8_t value)
+{
+	switch (offset & 0xf000)
+	{
+	case 0x8000:
+		m_cardStatus = value & ~kGayleIde;
+		break;
+
+	case 0x9000:
+		// Requests are acknowledged by writing zeros to them.
+		m_irq &= value;
+		break;
+
+	case 0xa000:
+		m_intEnable = value;
+		break;
+
+	case 0xb000:
+		m_config = value & 0x0f;
+		break;
+	}
+}
+
+uint8_t am::Gayle::ReadIdeRegister(uint32_t offset)
+{
+	if ((offset & 0x2000) == 0)
+		return 0xff;
+
+	const uint32_t reg = (offset >> 2) & 7;
+
+	if (offset & 0x1000)
+	{
+		if (reg != kAltStatus)
+			return 0xff;
+
+		// As the status register, but doesn't acknowledge the interrupt.
+		return IsDriveSelected() ? m_status : 0;
+	}
+
+	switch (reg)
+	{
+	case IdeRegister::Data:
+		return uint8_t(ReadData() >> 8);
+
+	case IdeRegister::Error:
+		return m_error;
+
+	case IdeRegister::SectorCount:
+		return m_sectorCount;
+
+	case IdeRegister::SectorNumber:
+		return m_sectorNumber;
+
+	case IdeRegister::CylinderLow:
+		return m_cylinderLow;
+
+	case IdeRegister::CylinderHigh:
+		return m_cylinderHigh;
+
+	case IdeRegister::DeviceHead:
+		return m_deviceHead;
+
+	case IdeRegister::Status:
+		// There is no slave, so the master answers for it with no status bits set.
+		if (!IsDriveSelected())
+			return 0;
+
+		SetInterrupt(false);
+		return m_status;
+	}
+
+	return 0xff;
+}
+
+void am::Gayle::WriteIdeRegister(uint32_t offset, uint8_t value)
+{
+	if ((offset & 0x2000) == 0)
+		return;
+
+	const uint32_t reg = (offset >> 2) & 7;
+
+	if (offset & 0x1000)
+	{
+		if (reg != kAltStatus)
+			return;
+
+		const uint8_t previous = m_deviceControl;
+		m_deviceControl = value;
+
+		if (value & kControlSoftReset)
+		{
+			m_transfer = Transfer::None;
+			SetInterrupt(false);
+			m_status = StatusBits::Busy;
+		}
+		else if (previous & kControlSoftReset)
+		{
+			SetDiagnosticSignature();
+			m_status = kIdleStatus;
+		}
+		return;
+	}
+
+	// The task file registers are written on both drives, whichever is selected.
+	switch (reg)
+	{
+	case IdeRegister::Data:
+		WriteData(uint16_t(value) << 8);
+		break;
+
+	case IdeRegister::Error:
+		m_feature = value;
+		break;
+
+	case IdeRegister::SectorCount:
+		m_sectorCount = value;
+		break;
+
+	case IdeRegister::SectorNumber:
+		m_sectorNumber = value;
+		break;
+
+	case IdeRegister::CylinderLow:
+		m_cylinderLow = value;
+		break;
+
+	case IdeRegister::CylinderHigh:
+		m_cylinderHigh = value;
+		break;
+
+	case IdeRegister::DeviceHead:
+		m_deviceHead = value;
+		break;
+
+	case IdeRegister::Status:
+		if (IsDriveSelected() && !(m_deviceControl & kControlSoftReset))
+		{
+			ExecuteCommand(value);
+		}
+		break;
+	}
+}
+
+uint16_t am::Gayle::ReadData()
+{
+	if (m_transfer != Transfer::Read || !IsDriveSelected())
+		return 0xffff;
+
+	// Sectors are stored in the image as the Amiga sees them through the data register.
+	const uint16_t value = uint16_t(m_buffer[m_bufferPos] << 8) | m_buffer[m_bufferPos + 1];
+	m_bufferPos += 2;
+
+	if (m_bufferPos == m_bufferEnd)
+	{
+		if (m_sectorsLeft > 0)
+		{
+			ReadBlock();
+		}
+		else
+		{
+			m_transfer = Transfer::None;
+			m_status = kIdleStatus;
+		}
+	}
+
+	return value;
+}
+
+void am::Gayle::WriteData(uint16_t value)
+{
+	if (m_transfer != Transfer::Write || !IsDriveSelected())
+		return;
+
+	m_buffer[m_bufferPos] = uint8_t(value >> 8);
+	m_buffer[m_bufferPos + 1] = uint8_t(value);
+	m_bufferPos += 2;
+
+	if (m_bufferPos == m_bufferEnd)
+	{
+		FinishWriteBlock();
+	}
+}
+
+void am::Gayle::ExecuteCommand(uint8_t command)
+{
+	SetInterrupt(false);
+	m_transfer = Transfer::None;
+	m_error = 0;
+
+	switch (command)
+	{
+	case 0x20: // READ SECTORS
+	case 0x21: // READ SECTORS (without retries)
+		StartTransfer(Transfer::Read, 1);
+		break;
+
+	case 0xc4: // READ MULTIPLE
+		if (m_multipleSectors == 0)
+		{
+			AbortCommand(ErrorBits::Aborted);
+			break;
+		}
+		StartTransfer(Transfer::Read, m_multipleSectors);
+		break;
+
+	case 0x30: // WRITE SECTORS
+	case 0x31: // WRITE SECTORS (without retries)
+		StartTransfer(Transfer::Write, 1);
+		break;
+
+	case 0xc5: // WRITE MULTIPLE
+		if (m_multipleSectors == 0)
+		{
+			AbortCommand(ErrorBits::Aborted);
+			break;
+		}
+		StartTransfer(Transfer::Write, m_multipleSectors);
+		break;
+
+	case 0x40: // READ VERIFY SECTORS
+	case 0x41: // READ VERIFY SECTORS (without retries)
+	{
+		const uint32_t lba = GetAddress();
+		const uint32_t count = m_sectorCount ? m_sectorCount : 256;
+		if (lba >= m_totalSectors || count > m_totalSectors - lba)
+		{
+			AbortCommand(ErrorBits::IdNotFound);
+			break;
+		}
+		SetAddress(lba + count - 1);
+		m_sectorCount = 0;
+		CompleteCommand();
+		break;
+	}
+
+	case 0xec: // IDENTIFY DEVICE
+		Identify();
+		break;
+
+	case 0x91: // INITIALIZE DEVICE PARAMETERS
+		if (m_sectorCount == 0)
+		{
+			AbortCommand(ErrorBits::Aborted);
+			break;
+		}
+		m_sectors = m_sectorCount;
+		m_heads = (m_deviceHead & 0x0f) + 1;
+		CompleteCommand();
+		break;
+
+	case 0xc6: // SET MULTIPLE MODE
+		if (m_sectorCount > kMaxMultipleSectors || (m_sectorCount & (m_sectorCount - 1)) != 0)
+		{
+			AbortCommand(ErrorBits::Aborted);
+			break;
+		}
+		m_multipleSectors = m_sectorCount;
+		CompleteCommand();
+		break;
+
+	case 0x90: // EXECUTE DEVICE DIAGNOSTIC
+		SetDiagnosticSignature();
+		m_status = kIdleStatus;
+		SetInterrupt(true);
+		break;
+
+	case 0xe5: // CHECK POWER MODE
+		m_sectorCount = 0xff; // active or idle
+		CompleteCommand();
+		break;
+
+	case 0xe7: // FLUSH CACHE
+		m_file.flush();
+		CompleteCommand();
+		break;
+
+	case 0xe0: // STANDBY IMMEDIATE
+	case 0xe1: // IDLE IMMEDIATE
+	case 0xe2: // STANDBY
+	case 0xe3: // IDLE
+	case 0xef: // SET FEATURES
+		// Power management and features make no difference to an image.
+		CompleteCommand();
+		break;
+
+	default:
+		if ((command & 0xf0) == 0x10) // RECALIBRATE
+		{
+			m_cylinderLow = 0;
+			m_cylinderHigh = 0;
+			CompleteCommand();
+		}
+		else if ((command & 0xf0) == 0x70) // SEEK
+		{
+			CompleteCommand();
+		}
+		else
+		{
+			AbortCommand(ErrorBits::Aborted);
+		}
+		break;
+	}
+}
+
+void am::Gayle::Identify()
+{
+	m_buffer.fill(0);
+
+	auto PutWord = [this](int word, uint16_t value)
+	{
+		m_buffer[word * 2] = uint8_t(value >> 8);
+		m_buffer[word * 2 + 1] = uint8_t(value);
+	};
+
+	// Strings are space padded, with the first character of each pair in the upper byte.
+	auto PutString = [this](int word, int numWords, std::string_view str)
+	{
+		for (size_t i = 0; i < size_t(numWords) * 2; i++)
+		{
+			m_buffer[word * 2 + i] = i < str.size() ? str[i] : ' ';
+		}
+	};
+
+	const uint32_t currentCapacity = std::min<uint32_t>(m_totalSectors, uint32_t(m_defaultCylinders) * m_heads * m_sectors);
+
+	PutWord(0, 0x0040); // fixed disk
+	PutWord(1, m_defaultCylinders);
+	PutWord(3, m_defaultHeads);
+	PutWord(6, m_defaultSectors);
+	PutString(10, 10, "GURU0001");
+	PutString(23, 4, "1.0");
+	PutString(27, 20, "GURU HARD DISK IMAGE");
+	PutWord(47, 0x8000 | kMaxMultipleSectors);
+	PutWord(49, 0x0200); // LBA supported
+	PutWord(53, 0x0001); // words 54-58 are valid
+	PutWord(54, m_defaultCylinders);
+	PutWord(55, m_heads);
+	PutWord(56, m_sectors);
+	PutWord(57, uint16_t(currentCapacity));
+	PutWord(58, uint16_t(currentCapacity >> 16));
+	PutWord(59, m_multipleSectors ? 0x0100 | m_multipleSectors : 0);
+	PutWord(60, uint16_t(m_totalSectors));
+	PutWord(61, uint16_t(m_totalSectors >> 16));
+
+	m_transfer = Transfer::Read;
+	m_sectorsLeft = 0;
+	m_bufferPos = 0;
+	m_bufferEnd = kSectorSize;
+	m_status = kIdleStatus | StatusBits::DataRequest;
+	SetInterrupt(true);
+}
+
+void am::Gayle::StartTransfer(Transfer transfer, uint32_t blockSectors)
+{
+	if (transfer == Transfer::Write && m_readOnly)
+	{
+		AbortCommand(ErrorBits::Aborted);
+		return;
+	}
+
+	m_transfer = transfer;
+	m_lba = GetAddress();
+	m_sectorsLeft = m_sectorCount ? m_sectorCount : 256;
+	m_blockSectors = blockSectors;
+
+	if (transfer == Transfer::Read)
+	{
+		ReadBlock();
+	}
+	else
+	{
+		// The first block is requested without an interrupt.
+		StartWriteBlock();
+	}
+}
+
+void am::Gayle::ReadBlock()
+{
+	const uint32_t count = std::min(m_blockSectors, m_sectorsLeft);
+	if (m_lba >= m_totalSectors || count > m_totalSectors - m_lba)
+	{
+		AbortCommand(ErrorBits::IdNotFound);
+		return;
+	}
+
+	m_file.seekg(std::streamoff(m_lba) * kSectorSize);
+	m_file.read(reinterpret_cast<char*>(m_buffer.data()), std::streamsize(count) * kSectorSize);
+	if (!m_file)
+	{
+		m_file.clear();
+		SetAddress(m_lba);
+		AbortCommand(ErrorBits::Uncorrectable);
+		return;
+	}
+
+	for (auto it = m_runAheadWrites.lower_bound(m_lba); it != m_runAheadWrites.end() && it->first < m_lba + count; ++it)
+	{
+		std::copy(it->second.begin(), it->second.end(), &m_buffer[(it->first - m_lba) * kSectorSize]);
+	}
+
+	m_lba += count;
+	m_sectorsLeft -= count;
+	SetAddress(m_lba - 1);
+	m_sectorCount = uint8_t(m_sectorsLeft);
+
+	m_bufferPos = 0;
+	m_bufferEnd = count * kSectorSize;
+	m_status = kIdleStatus | StatusBits::DataRequest;
+	SetInterrupt(true);
+}
+
+void am::Gayle::StartWriteBlock()
+{
+	const uint32_t count = std::min(m_blockSectors, m_sectorsLeft);
+	if (m_lba >= m_totalSectors || count > m_totalSectors - m_lba)
+	{
+		AbortCommand(ErrorBits::IdNotFound);
+		return;
+	}
+
+	m_sectorsLeft -= count;
+
+	m_bufferPos = 0;
+	m_bufferEnd = count * kSectorSize;
+	m_status = kIdleStatus | StatusBits::DataRequest;
+}
+
+void am::Gayle::FinishWriteBlock()
+{
+	const uint32_t count = m_bufferEnd / kSectorSize;
+
+	if (m_runningAhead)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto& sector = m_runAheadWrites[m_lba + i];
+			std::copy_n(&m_buffer[i * kSectorSize], kSectorSize, sector.begin());
+		}
+	}
+	else
+	{
+		m_file.seekp(std::streamoff(m_lba) * kSectorSize);
+		m_file.write(reinterpret_cast<const char*>(m_buffer.data()), std::streamsize(m_bufferEnd));
+		m_file.flush();
+		if (!m_file)
+		{
+			m_file.clear();
+			SetAddress(m_lba);
+			AbortCommand(ErrorBits::Uncorrectable);
+			return;
+		}
+	}
+
+	m_lba += count;
+	SetAddress(m_lba - 1);
+	m_sectorCount = uint8_t(m_sectorsLeft);
+
+	if (m_sectorsLeft > 0)
+	{
+		StartWriteBlock();
+		SetInterrupt(true);
+	}
+	else
+	{
+		CompleteCommand();
+	}
+}
+
+void am::Gayle::CompleteCommand()
+{
+	m_transfer = Transfer::None;
+	m_status = kIdleStatus;
+	SetInterrupt(true);
+}
+
+void am::Gayle::AbortCommand(uint8_t error)
+{
+	m_transfer = Transfer::None;
+	m_error = error;
+	m_status = kIdleStatus | StatusBits::Error;
+	SetInterrupt(true);
+}
+
+uint32_t am::Gayle::GetAddress() const
+{
+	if (m_deviceHead & kDeviceLba)
+	{
+		return (uint32_t(m_deviceHead & 0x0f) << 24) | (uint32_t(m_cylinderHigh) << 16) | (uint32_t(m_cylinderLow) << 8) | m_sectorNumber;
+	}
+
+	const uint32_t cylinder = (uint32_t(m_cylinderHigh) << 8) | m_cylinderLow;
+	const uint32_t head = m_deviceHead & 0x0f;
+
+	if (m_sectorNumber == 0 || m_sectorNumber > m_sectors || head >= m_heads)
+		return UINT32_MAX;
+
+	return (cylinder * m_heads + head) * m_sectors + m_sectorNumber - 1;
+}
+
+void am::Gayle::SetAddress(uint32_t lba)
+{
+	if (m_deviceHead & kDeviceLba)
+	{
+		m_sectorNumber = uint8_t(lba);
+		m_cylinderLow = uint8_t(lba >> 8);
+		m_cylinderHigh = uint8_t(lba >> 16);
+		m_deviceHead = (m_deviceHead & 0xf0) | ((lba >> 24) & 0x0f);
+		return;
+	}
+
+	if (m_heads == 0 || m_sectors == 0)
+		return;
+
+	const uint32_t cylinder = lba / (uint32_t(m_heads) * m_sectors);
+	const uint32_t head = (lba / m_sectors) % m_heads;
+	m_sectorNumber = uint8_t(lba % m_sectors + 1);
+	m_cylinderLow = uint8_t(cylinder);
+	m_cylinderHigh = uint8_t(cylinder >> 8);
+	m_deviceHead = (m_deviceHead & 0xf0) | uint8_t(head);
+}
+
+void am::Gayle::SetDiagnosticSignature()
+{
+	m_error = 0x01; // no error detected
+	m_sectorCount = 1;
+	m_sectorNumber = 1;
+	m_cylinderLow = 0;
+	m_cylinderHigh = 0;
+	m_deviceHead = 0;
+}
+
+bool am::Gayle::IsDriveSelected() const
+{
+	return IsAttached() && (m_deviceHead & kDeviceSlave) == 0;
+}
+
+void am::Gayle::SetInterrupt(bool intrq)
+{
+	m_intrq = intrq;
+
+	// Gayle latches the interrupt until it is acknowledged through its own register, so
+	// acknowledging the drive by reading its status doesn't clear it.
+	if (intrq && !(m_deviceControl & kControlInterruptDisable))
+	{
+		m_irq |= kGayleIde;
+	}
+}
+
+template <typename S, typename Self>
+void am::Gayle::Stream(S& s, Self& self)
+{
+	using util::Stream;
+
+	Stream(s, self.m_cardStatus);
+	Stream(s, self.m_irq);
+	Stream(s, self.m_intEnable);
+	Stream(s, self.m_config);
+	Stream(s, self.m_idCount);
+
+	Stream(s, self.m_error);
+	Stream(s, self.m_feature);
+	Stream(s, self.m_sectorCount);
+	Stream(s, self.m_sectorNumber);
+	Stream(s, self.m_cylinderLow);
+	Stream(s, self.m_cylinderHigh);
+	Stream(s, self.m_deviceHead);
+	Stream(s, self.m_status);
+	Stream(s, self.m_deviceControl);
+	Stream(s, self.m_intrq);
+
+	Stream(s, self.m_heads);
+	Stream(s, self.m_sectors);
+	Stream(s, self.m_multipleSectors);
+
+	Stream(s, self.m_transfer);
+	Stream(s, self.m_lba);
+	Stream(s, self.m_sectorsLeft);
+	Stream(s, self.m_blockSectors);
+	Stream(s, self.m_bufferPos);
+	Stream(s, self.m_bufferEnd);
+	Stream(s, self.m_buffer);
+
+	if constexpr (!std::is_const_v<Self>)
+	{
+		// A damaged or made up state mustn't be able to take a transfer past the end of the buffer.
+		if (self.m_transfer > Transfer::Write || (self.m_transfer != Transfer::None && (self.m_bufferEnd > self.m_buffer.size() || self.m_bufferPos >= self.m_bufferEnd || ((self.m_bufferPos | self.m_bufferEnd) & 1) != 0)))
+		{
+			self.m_transfer = Transfer::None;
+			self.m_bufferPos = 0;
+			self.m_bufferEnd = 0;
+		}
+		self.m_blockSectors = std::min(self.m_blockSectors, kMaxMultipleSectors);
+		if (self.m_multipleSectors > kMaxMultipleSectors)
+		{
+			self.m_multipleSectors = 0;
+		}
+	}
+}
+
+template void am::Gayle::Stream<>(std::istream& s, am::Gayle& self);
+template void am::Gayle::Stream<>(std::ostream& s, const am::Gayle& self);
+template void am::Gayle::Stream<>(util::MemoryReader& s, am::Gayle& self);
+template void am::Gayle::Stream<>(util::MemoryWriter& s, const am::Gayle& self);
\ No newline at end of file
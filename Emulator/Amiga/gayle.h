@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+namespace am
+{
+	// The IDE interface of Gayle, the gate array of the A600 and A1200, with one hard drive attached
+	// as the master. The drive is a hard disk image (HDF) file holding a whole disk, rigid disk block
+	// and all, which is what the kickstart's scsi.device expects to find. Commands complete as soon as
+	// they are issued and each block of a transfer is read from, or written to, the file in one go.
+	class Gayle
+	{
+	public:
+		// Gayle's registers are at 0xda0000-0xdbffff (the IDE registers at 0xda2000-0xda3fff and its
+		// own from 0xda8000), and its identification register at 0xde1000.
+		static constexpr uint32_t kRegisterBase = 0xda'0000;
+		static constexpr uint32_t kIdRegisterBase = 0xde'0000;
+
+		static constexpr uint32_t kSectorSize = 512;
+		static constexpr uint32_t kMaxMultipleSectors = 16;
+
+		// Opens the image for reading and writing, or only for reading if it is write protected.
+		// Returns false, leaving no drive attached, if it can't be opened.
+		bool Attach(const std::string& hdfFile);
+		void Detach();
+
+		bool IsAttached() const
+		{
+			return m_file.is_open();
+		}
+
+		const std::string& GetFilename() const
+		{
+			return m_filename;
+		}
+
+		// As happens when the machine is reset.
+		void Reset();
+
+		uint8_t ReadByte(uint32_t addr);
+		uint16_t ReadWord(uint32_t addr);
+		void WriteByte(uint32_t addr, uint8_t value);
+		void WriteWord(uint32_t addr, uint16_t value);
+
+		// The image isn't part of the saved state, so while running ahead writes are kept aside,
+		// where the frames run ahead still read them back, and dropped when it ends.
+		void SetRunningAhead(bool runningAhead);
+
+		// Gayle's interrupt output, which drives the level 2 (PORTS) interrupt.
+		bool IsInterrupting() const
+		{
+			return (m_irq & m_intEnable & kGayleIde) != 0;
+		}
+
+		// Self is const when writing.
+		template <typename S, typename Self>
+		static void Stream(S& s, Self& self);
+
+	private:
+		enum class Transfer : uint8_t
+		{
+			None,
+			Read,
+			Write,
+		};
+
+		static constexpr uint8_t kGayleIde = 0x80; // bit for the IDE interrupt in Gayle's registers
+
+		uint8_t ReadGayleRegister(uint32_t offset);
+		void WriteGayleRegister(uint32_t offset, uint8_t value);
+
+		uint8_t ReadIdeRegister(uint32_t offset);
+		void WriteIdeRegister(uint32_t offset, uint8_t value);
+
+		uint16_t ReadData();
+		void WriteData(uint16_t value);
+
+		void ExecuteCommand(uint8_t command);
+		void Identify();
+		void StartTransfer(Transfer transfer, uint32_t blockSectors);
+		void ReadBlock();
+		void StartWriteBlock();
+		void FinishWriteBlock();
+		void CompleteCommand();
+		void AbortCommand(uint8_t error);
+
+		uint32_t GetAddress() const;
+		void SetAddress(uint32_t lba);
+		void SetDiagnosticSignature();
+
+		bool IsDriveSelected() const;
+		void SetInterrupt(bool intrq);
+
+		// The attached image. Not part of the saved state.
+		std::fstream m_file;
+		std::string m_filename;
+		bool m_readOnly = false;
+		uint32_t m_totalSectors = 0;
+		uint16_t m_defaultCylinders = 0;
+		uint8_t m_defaultHeads = 0;
+		uint8_t m_defaultSectors = 0;
+
+		bool m_runningAhead = false;
+		std::map<uint32_t, std::array<uint8_t, kSectorSize>> m_runAheadWrites;
+
+		// Gayle's registers.
+		uint8_t m_cardStatus = 0;
+		uint8_t m_irq = 0;
+		uint8_t m_intEnable = 0;
+		uint8_t m_config = 0;
+		uint8_t m_idCount = 0;
+
+		// The drive's task file.
+		uint8_t m_error = 0;
+		uint8_t m_feature = 0;
+		uint8_t m_sectorCount = 0;
+		uint8_t m_sectorNumber = 0;
+		uint8_t m_cylinderLow = 0;
+		uint8_t m_cylinderHigh = 0;
+		uint8_t m_deviceHead = 0;
+		uint8_t m_status = 0;
+		uint8_t m_deviceControl = 0;
+		bool m_intrq = false;
+
+		// Translation in use for CHS addressing, as set by INITIALIZE DEVICE PARAMETERS.
+		uint8_t m_heads = 0;
+		uint8_t m_sectors = 0;
+		uint8_t m_multipleSectors = 0;
+
+		Transfer m_transfer = Transfer::None;
+		uint32_t m_lba = 0;				// of the next block to transfer
+		uint32_t m_sectorsLeft = 0;		// after the block in the buffer
+		uint32_t m_blockSectors = 0;	// sectors per block (between interrupts)
+		uint32_t m_bufferPos = 0;
+		uint32_t m_bufferEnd = 0;
+		std::array<uint8_t, kMaxMultipleSectors * kSectorSize> m_buffer = {};
+	};
+}
\ No newline at end of file
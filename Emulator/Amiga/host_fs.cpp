@@ -0,0 +1,1441 @@
+#include "host_fs.h"
+#include "amiga.h"
+
+#include "util/hash.h"
+#include "util/stream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// The board's autoconfig registers: a 64K Zorro II board with a diagnostic area in its rom.
+	constexpr uint8_t kBoardType = 0xd1; // ERT_ZORROII | ERTF_DIAGVALID | 64K
+	constexpr uint8_t kProduct = 1;
+	constexpr uint16_t kManufacturer = 2011; // reserved for hobbyist and development boards
+
+	// Board layout. The rom takes the first 16K and the RAM the 32K after it.
+	constexpr uint32_t kRomSize = 0x4000;
+	constexpr uint32_t kRamOffset = 0x4000;
+	constexpr uint32_t kRamSize = 0x8000;
+
+	// In the rom. The diagnostic area, including its code and strings, is copied to RAM by the
+	// kickstart before the diagnostic routine is called.
+	constexpr uint32_t kDiagArea = 0x1000;
+	constexpr uint32_t kDiagAreaSize = 0x100;
+	constexpr uint32_t kDiagPoint = 0x1010;
+	constexpr uint32_t kExpansionName = 0x1050;
+	constexpr uint32_t kDiagName = 0x1070;
+	constexpr uint32_t kSegList = 0x2000; // preceded by its size
+	constexpr uint32_t kHandler = 0x2004;
+	constexpr uint32_t kDosName = 0x2060;
+
+	// In the RAM.
+	constexpr uint32_t kDeviceNode = 0x0000;
+	constexpr uint32_t kDeviceName = 0x0030;
+	constexpr uint32_t kBootNode = 0x0040;
+	constexpr uint32_t kVolumeNode = 0x0060;
+	constexpr uint32_t kVolumeName = 0x0090;
+	constexpr uint32_t kStarted = 0x00fc;
+	constexpr uint32_t kSlots = 0x0100;
+	constexpr uint32_t kSlotSize = 0x100;
+	constexpr uint32_t kNumSlots = (kRamSize - kSlots) / kSlotSize;
+
+	// A slot starts with a FileLock, followed by what the handler keeps for it.
+	constexpr uint32_t kFlKey = 4;
+	constexpr uint32_t kFlAccess = 8;
+	constexpr uint32_t kFlTask = 12;
+	constexpr uint32_t kFlVolume = 16;
+	constexpr uint32_t kSlotKind = 20;
+	constexpr uint32_t kSlotPosition = 24;
+	constexpr uint32_t kSlotPath = 32;
+	constexpr size_t kMaxPathLength = kSlotSize - kSlotPath - 1;
+
+	constexpr size_t kMaxVolumeNameLength = 30;
+	constexpr size_t kMaxFileNameLength = 107;
+
+	// DOS packets.
+	constexpr uint32_t kDpType = 8;
+	constexpr uint32_t kDpRes1 = 12;
+	constexpr uint32_t kDpRes2 = 16;
+	constexpr uint32_t kDpArg1 = 20;
+
+	namespace Action
+	{
+		constexpr int32_t CurrentVolume = 7;
+		constexpr int32_t LocateObject = 8;
+		constexpr int32_t FreeLock = 15;
+		constexpr int32_t DeleteObject = 16;
+		constexpr int32_t RenameObject = 17;
+		constexpr int32_t CopyDir = 19;
+		constexpr int32_t SetProtect = 21;
+		constexpr int32_t CreateDir = 22;
+		constexpr int32_t ExamineObject = 23;
+		constexpr int32_t ExamineNext = 24;
+		constexpr int32_t DiskInfo = 25;
+		constexpr int32_t Info = 26;
+		constexpr int32_t Flush = 27;
+		constexpr int32_t SetComment = 28;
+		constexpr int32_t Parent = 29;
+		constexpr int32_t SetDate = 34;
+		constexpr int32_t SameLock = 40;
+		constexpr int32_t Read = 'R';
+		constexpr int32_t Write = 'W';
+		constexpr int32_t FindUpdate = 1004;
+		constexpr int32_t FindInput = 1005;
+		constexpr int32_t FindOutput = 1006;
+		constexpr int32_t End = 1007;
+		constexpr int32_t Seek = 1008;
+		constexpr int32_t FhFromLock = 1026;
+		constexpr int32_t IsFilesystem = 1027;
+		constexpr int32_t CopyDirFh = 1030;
+		constexpr int32_t ParentFh = 1031;
+		constexpr int32_t ExamineFh = 1034;
+	}
+
+	namespace Error
+	{
+		constexpr uint32_t NoFreeStore = 103;
+		constexpr uint32_t ObjectInUse = 202;
+		constexpr uint32_t ObjectExists = 203;
+		constexpr uint32_t DirNotFound = 204;
+		constexpr uint32_t ObjectNotFound = 205;
+		constexpr uint32_t ObjectTooLarge = 207;
+		constexpr uint32_t ActionNotKnown = 209;
+		constexpr uint32_t InvalidComponentName = 210;
+		constexpr uint32_t InvalidLock = 211;
+		constexpr uint32_t ObjectWrongType = 212;
+		constexpr uint32_t DirectoryNotEmpty = 216;
+		constexpr uint32_t SeekError = 219;
+		constexpr uint32_t DiskFull = 221;
+		constexpr uint32_t DeleteProtected = 222;
+		constexpr uint32_t WriteProtected = 223;
+		constexpr uint32_t NoMoreEntries = 232;
+	}
+
+	constexpr uint32_t kDosTrue = 0xffff'ffff;
+	constexpr uint32_t kDosFalse = 0;
+
+	constexpr int32_t kSharedLock = -2;
+	constexpr int32_t kExclusiveLock = -1;
+
+	constexpr int32_t kOffsetBeginning = -1;
+	constexpr int32_t kOffsetCurrent = 0;
+	constexpr int32_t kOffsetEnd = 1;
+
+	// DeviceNode and DeviceList (volume) fields.
+	constexpr uint32_t kDolNext = 0;
+	constexpr uint32_t kDolType = 4;
+	constexpr uint32_t kDolTask = 8;
+	constexpr uint32_t kDnStackSize = 20;
+	constexpr uint32_t kDnPriority = 24;
+	constexpr uint32_t kDlVolumeDate = 16;
+	constexpr uint32_t kDnSegList = 32;
+	constexpr uint32_t kDlDiskType = 32;
+	constexpr uint32_t kDnGlobalVec = 36;
+	constexpr uint32_t kDolName = 40;
+
+	constexpr uint32_t kDltVolume = 2;
+
+	// BootNode fields.
+	constexpr uint32_t kLnType = 8;
+	constexpr uint32_t kLnPri = 9;
+	constexpr uint32_t kLnName = 10;
+	constexpr uint32_t kBnDeviceNode = 16;
+	constexpr uint8_t kNtBootNode = 16;
+
+	// Finding DOS's device list: DosLibrary->dl_Root->rn_Info->di_DevInfo.
+	constexpr uint32_t kDosRoot = 34;
+	constexpr uint32_t kRootInfo = 24;
+	constexpr uint32_t kInfoDevInfo = 4;
+
+	constexpr uint32_t kFhArg1 = 36;
+
+	// FileInfoBlock fields.
+	constexpr uint32_t kFibDiskKey = 0;
+	constexpr uint32_t kFibDirEntryType = 4;
+	constexpr uint32_t kFibFileName = 8;
+	constexpr uint32_t kFibEntryType = 120;
+	constexpr uint32_t kFibSize = 124;
+	constexpr uint32_t kFibNumBlocks = 128;
+	constexpr uint32_t kFibDate = 132;
+	constexpr uint32_t kFibLength = 260;
+
+	constexpr int32_t kStRoot = 1;
+	constexpr int32_t kStUserDir = 2;
+	constexpr int32_t kStFile = -3;
+
+	// InfoData fields.
+	constexpr uint32_t kIdDiskState = 8;
+	constexpr uint32_t kIdNumBlocks = 12;
+	constexpr uint32_t kIdNumBlocksUsed = 16;
+	constexpr uint32_t kIdBytesPerBlock = 20;
+	constexpr uint32_t kIdDiskType = 24;
+	constexpr uint32_t kIdVolumeNode = 28;
+	constexpr uint32_t kIdInUse = 32;
+	constexpr uint32_t kInfoDataLength = 36;
+
+	constexpr uint32_t kIdValidated = 82;
+	constexpr uint32_t kIdDosDisk = 0x444f'5300; // 'DOS\0'
+	constexpr uint32_t kBlockSize = 512;
+
+	// Seconds from the Unix epoch to the Amiga's, 1 January 1978.
+	constexpr int64_t kAmigaEpoch = 252'460'800;
+
+	bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y)
+		{
+			return tolower(uint8_t(x)) == tolower(uint8_t(y));
+		});
+	}
+
+	// A lock's key identifies the object locked, as some versions of DOS compare locks by key.
+	uint32_t LockKey(std::string_view path)
+	{
+		uint64_t hash = util::kFnv1aOffsetBasis;
+		for (char c : path)
+		{
+			hash ^= uint8_t(tolower(uint8_t(c)));
+			hash *= util::kFnv1aPrime;
+		}
+		return uint32_t(hash ^ (hash >> 32));
+	}
+
+	std::string_view ParentPath(std::string_view path)
+	{
+		const auto slash = path.rfind('/');
+		return slash == std::string_view::npos ? std::string_view() : path.substr(0, slash);
+	}
+
+	std::string_view LeafName(std::string_view path)
+	{
+		const auto slash = path.rfind('/');
+		return slash == std::string_view::npos ? path : path.substr(slash + 1);
+	}
+
+	std::string JoinPath(std::string_view dir, std::string_view name)
+	{
+		return dir.empty() ? std::string(name) : std::string(dir) + "/" + std::string(name);
+	}
+
+	// Names that mean something else to the host aren't allowed.
+	bool IsValidComponent(std::string_view component)
+	{
+		return !component.empty() && component != "." && component != ".." && component.find_first_of("\\:") == std::string_view::npos;
+	}
+
+	// A path relative to the mounted directory, as kept in a slot. The slots are in the board's
+	// RAM, which the guest can write to and which comes back from snapshots, so a path read from
+	// one is checked before it is used.
+	bool IsValidPath(std::string_view path)
+	{
+		if (path.empty())
+			return true;
+
+		size_t pos = 0;
+		for (;;)
+		{
+			const size_t end = std::min(path.find('/', pos), path.size());
+			if (!IsValidComponent(path.substr(pos, end - pos)))
+				return false;
+			if (end == path.size())
+				return true;
+			pos = end + 1;
+		}
+	}
+}
+
+am::HostFileSystem::HostFileSystem(Amiga& amiga)
+	: m_amiga(amiga)
+{
+}
+
+bool am::HostFileSystem::Mount(const std::string& directory)
+{
+	Unmount();
+
+	std::error_code ec;
+	if (!fs::is_directory(directory, ec))
+		return false;
+
+	m_directory = directory;
+
+	// The volume is named after the directory.
+	const auto absolute = fs::absolute(directory, ec);
+	auto name = (ec ? fs::path(directory) : absolute).lexically_normal().string();
+	while (!name.empty() && (name.back() == '/' || name.back() == '\\'))
+	{
+		name.pop_back();
+	}
+	name = name.substr(name.find_last_of("/\\:") + 1);
+	m_volumeName = name.empty() ? "Host" : name.substr(0, kMaxVolumeNameLength);
+
+	BuildRom();
+	m_ram.assign(kRamSize, 0);
+
+	Reset();
+	return true;
+}
+
+void am::HostFileSystem::Unmount()
+{
+	m_directory.clear();
+	m_volumeName.clear();
+	m_rom.clear();
+	m_ram.clear();
+	Reset();
+}
+
+void am::HostFileSystem::Reset()
+{
+	m_configured = false;
+	m_shutUp = false;
+	m_baseLow = 0;
+	m_base = 0;
+
+	CloseHostFile();
+	m_listingValid = false;
+}
+
+uint8_t am::HostFileSystem::ReadConfigByte(uint32_t addr) const
+{
+	if (!IsMounted() || m_configured || m_shutUp || (addr & 0xff'0000) != kConfigBase)
+		return 0;
+
+	// Each register is a byte split across two words, a nibble at the top of each. All but the
+	// board type and the control registers are read inverted.
+	const uint32_t offset = addr & 0xff;
+	uint8_t value = 0;
+	bool inverted = offset < 0x40;
+
+	switch (offset & 0xfc)
+	{
+	case 0x00:
+		value = kBoardType;
+		inverted = false;
+		break;
+	case 0x04:
+		value = kProduct;
+		break;
+	case 0x10:
+		value = uint8_t(kManufacturer >> 8);
+		break;
+	case 0x14:
+		value = uint8_t(kManufacturer);
+		break;
+	case 0x28:
+		value = uint8_t(kDiagArea >> 8);
+		break;
+	case 0x2c:
+		value = uint8_t(kDiagArea);
+		break;
+	}
+
+	const uint8_t nibble = (offset & 2) ? uint8_t(value << 4) : uint8_t(value & 0xf0);
+	return inverted ? uint8_t(~nibble & 0xf0) : nibble;
+}
+
+void am::HostFileSystem::WriteConfigByte(uint32_t addr, uint8_t value)
+{
+	if (!IsMounted() || m_configured || m_shutUp || (addr & 0xff'0000) != kConfigBase)
+		return;
+
+	switch (addr & 0xff)
+	{
+	case 0x4a:
+		// A19-A16 of the base address, written first.
+		m_baseLow = value;
+		break;
+	case 0x48:
+		// A23-A20 of the base address, which configures the board.
+		m_base = (uint32_t(value & 0xf0) << 16) | (uint32_t(m_baseLow & 0xf0) << 12);
+		m_configured = true;
+		break;
+	case 0x4c:
+		m_shutUp = true;
+		break;
+	}
+}
+
+uint8_t* am::HostFileSystem::GetBoardMemory(uint32_t addr, bool& readOnly)
+{
+	if (!m_configured || addr - m_base >= kBoardSize)
+		return nullptr;
+
+	const uint32_t offset = addr - m_base;
+	if (offset < kRomSize)
+	{
+		readOnly = true;
+		return m_rom.data() + offset;
+	}
+	if (offset - kRamOffset < m_ram.size())
+	{
+		readOnly = false;
+		return m_ram.data() + (offset - kRamOffset);
+	}
+	return nullptr;
+}
+
+void am::HostFileSystem::BuildRom()
+{
+	m_rom.assign(kRomSize, 0);
+
+	auto PutWords = [this](uint32_t offset, std::initializer_list<uint16_t> words)
+	{
+		for (auto word : words)
+		{
+			m_rom[offset++] = uint8_t(word >> 8);
+			m_rom[offset++] = uint8_t(word);
+		}
+	};
+
+	auto PutString = [this](uint32_t offset, std::string_view str)
+	{
+		std::copy(str.begin(), str.end(), m_rom.begin() + offset);
+	};
+
+	// The displacement of a pc relative operand, given the address of its extension word.
+	auto PcRelative = [](uint32_t extension, uint32_t target)
+	{
+		return uint16_t(target - extension);
+	};
+
+	// DiagArea: word wide, run at configuration time, no boot code.
+	PutWords(kDiagArea, {
+		0x9000,							// da_Config (DAC_WORDWIDE | DAC_CONFIGTIME), da_Flags
+		uint16_t(kDiagAreaSize),		// da_Size
+		uint16_t(kDiagPoint - kDiagArea),
+		0x0000,							// da_BootPoint
+		uint16_t(kDiagName - kDiagArea),
+	});
+
+	// The diagnostic routine adds the device to expansion's mount list, from where DOS mounts it
+	// as it starts. Called with a3 = ConfigDev and a6 = ExecBase.
+	PutWords(kDiagPoint, {
+		0x48e7, 0x3f3e,					//	movem.l	d2-d7/a2-a6,-(sp)
+		kMountTrap,						//	(a0 = BootNode for the device)
+		0x2448,							//	movea.l	a0,a2
+		0x2c78, 0x0004,					//	movea.l	4.w,a6
+		0x43fa, PcRelative(kDiagPoint + 14, kExpansionName), // lea expansionName(pc),a1
+		0x7000,							//	moveq	#0,d0
+		0x4eae, 0xfdd8,					//	jsr		OpenLibrary(a6)
+		0x2400,							//	move.l	d0,d2
+		0x6712,							//	beq.s	.done
+		0x2042,							//	movea.l	d2,a0
+		0x41e8, 0x004a,					//	lea		eb_MountList(a0),a0
+		0x224a,							//	movea.l	a2,a1
+		0x4eae, 0xfef2,					//	jsr		Enqueue(a6)
+		0x2242,							//	movea.l	d2,a1
+		0x4eae, 0xfe62,					//	jsr		CloseLibrary(a6)
+		0x7001,							// .done: moveq #1,d0
+		0x4cdf, 0x7cfc,					//	movem.l	(sp)+,d2-d7/a2-a6
+		0x4e75,							//	rts
+	});
+	PutString(kExpansionName, "expansion.library");
+	PutString(kDiagName, "Host directory");
+
+	// The handler, a single segment. It replies to each packet as soon as the emulator has
+	// serviced it.
+	PutWords(kSegList - 4, { 0x0000, 0x0020 });	// segment size, in longwords
+	PutWords(kSegList, { 0x0000, 0x0000 });		// next segment
+	PutWords(kHandler, {
+		0x2c78, 0x0004,					//	movea.l	4.w,a6
+		0x93c9,							//	suba.l	a1,a1
+		0x4eae, 0xfeda,					//	jsr		FindTask(a6)
+		0x2440,							//	movea.l	d0,a2
+		0x45ea, 0x005c,					//	lea		pr_MsgPort(a2),a2
+		0x43fa, PcRelative(kHandler + 18, kDosName), // lea dosName(pc),a1
+		0x7000,							//	moveq	#0,d0
+		0x4eae, 0xfdd8,					//	jsr		OpenLibrary(a6)
+		0x2a40,							//	movea.l	d0,a5
+		0x204a,							// .wait: movea.l a2,a0
+		0x4eae, 0xfe80,					//	jsr		WaitPort(a6)
+		0x204a,							//	movea.l	a2,a0
+		0x4eae, 0xfe8c,					//	jsr		GetMsg(a6)
+		0x4a80,							//	tst.l	d0
+		0x67f0,							//	beq.s	.wait
+		0x2240,							//	movea.l	d0,a1
+		0x2669, 0x000a,					//	movea.l	ln_Name(a1),a3
+		kPacketTrap,					//	(services the packet in a3)
+		0x206b, 0x0004,					//	movea.l	dp_Port(a3),a0
+		0x274a, 0x0004,					//	move.l	a2,dp_Port(a3)
+		0x2253,							//	movea.l	dp_Link(a3),a1
+		0x4eae, 0xfe92,					//	jsr		PutMsg(a6)
+		0x60d8,							//	bra.s	.wait
+	});
+	PutString(kDosName, "dos.library");
+}
+
+void am::HostFileSystem::Trap(uint16_t opcode, cpu::Registers& regs)
+{
+	if (opcode == kMountTrap)
+	{
+		const uint32_t deviceNode = RamAddress(kDeviceNode);
+		const uint32_t volumeNode = RamAddress(kVolumeNode);
+		const uint32_t bootNode = RamAddress(kBootNode);
+
+		// Everything the machine knew of the device is gone after a reset.
+		std::fill(m_ram.begin(), m_ram.end(), uint8_t(0));
+
+		WriteLong(deviceNode + kDnStackSize, 4096);
+		WriteLong(deviceNode + kDnPriority, 10);
+		WriteLong(deviceNode + kDnSegList, (m_base + kSegList) >> 2);
+		WriteLong(deviceNode + kDnGlobalVec, 0xffff'ffff); // no BCPL global vector
+		WriteLong(deviceNode + kDolName, RamAddress(kDeviceName) >> 2);
+		WriteBString(RamAddress(kDeviceName), "HOST", kMaxVolumeNameLength);
+
+		// Never booted from.
+		m_amiga.PokeByte(bootNode + kLnType, kNtBootNode);
+		m_amiga.PokeByte(bootNode + kLnPri, uint8_t(-128));
+		WriteLong(bootNode + kLnName, regs.a[3]);
+		WriteLong(bootNode + kBnDeviceNode, deviceNode);
+
+		WriteLong(volumeNode + kDolType, kDltVolume);
+		WriteLong(volumeNode + kDlDiskType, kIdDosDisk);
+		WriteLong(volumeNode + kDolName, RamAddress(kVolumeName) >> 2);
+		WriteBString(RamAddress(kVolumeName), m_volumeName, kMaxVolumeNameLength);
+
+		regs.a[0] = bootNode;
+		return;
+	}
+
+	const uint32_t packet = regs.a[3];
+	const uint32_t port = regs.a[2];
+
+	Reply reply = { kDosTrue, 0 };
+	if (ReadLong(RamAddress(kStarted)) == 0)
+	{
+		// The first packet is the one DOS starts the handler with.
+		Startup(regs.a[5], port);
+	}
+	else
+	{
+		reply = Service(packet, port);
+	}
+
+	WriteLong(packet + kDpRes1, reply.res1);
+	WriteLong(packet + kDpRes2, reply.res2);
+}
+
+void am::HostFileSystem::Startup(uint32_t dosBase, uint32_t port)
+{
+	const uint32_t deviceNode = RamAddress(kDeviceNode);
+	const uint32_t volumeNode = RamAddress(kVolumeNode);
+
+	WriteLong(deviceNode + kDolTask, port);
+	WriteLong(volumeNode + kDolTask, port);
+
+	std::error_code ec;
+	const auto time = fs::last_write_time(HostPath(""), ec);
+	WriteDateStamp(volumeNode + kDlVolumeDate, ec ? fs::file_time_type() : time);
+
+	// Add the volume to DOS's device list, so the volume name can be used as well as HOST:.
+	const uint32_t rootNode = ReadLong(dosBase + kDosRoot);
+	const uint32_t dosInfo = ReadLong(rootNode + kRootInfo) << 2;
+	WriteLong(volumeNode + kDolNext, ReadLong(dosInfo + kInfoDevInfo));
+	WriteLong(dosInfo + kInfoDevInfo, volumeNode >> 2);
+
+	WriteLong(RamAddress(kStarted), 1);
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Service(uint32_t packet, uint32_t port)
+{
+	const int32_t type = int32_t(ReadLong(packet + kDpType));
+
+	uint32_t arg[4];
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		arg[i] = ReadLong(packet + kDpArg1 + i * 4);
+	}
+
+	switch (type)
+	{
+	case Action::LocateObject:
+		return LocateObject(arg[0], arg[1], int32_t(arg[2]), port);
+	case Action::FreeLock:
+		return FreeLock(arg[0]);
+	case Action::CopyDir:
+		return CopyDir(arg[0], port);
+	case Action::Parent:
+		return Parent(arg[0], port);
+	case Action::SameLock:
+		return SameLock(arg[0], arg[1]);
+	case Action::ExamineObject:
+		return Examine(arg[0], arg[1] << 2);
+	case Action::ExamineNext:
+		return ExamineNext(arg[0], arg[1] << 2);
+	case Action::DiskInfo:
+		return Info(arg[0] << 2);
+	case Action::Info:
+		return Info(arg[1] << 2);
+	case Action::FindInput:
+	case Action::FindOutput:
+	case Action::FindUpdate:
+		return Open(arg[0] << 2, arg[1], arg[2], type, port);
+	case Action::FhFromLock:
+		return OpenFromLock(arg[0] << 2, arg[1]);
+	case Action::Read:
+		return Read(arg[0], arg[1], int32_t(arg[2]));
+	case Action::Write:
+		return Write(arg[0], arg[1], int32_t(arg[2]));
+	case Action::Seek:
+		return Seek(arg[0], int32_t(arg[1]), int32_t(arg[2]));
+	case Action::End:
+		return Close(arg[0]);
+	case Action::ExamineFh:
+		return ExamineFile(arg[0], arg[1] << 2);
+	case Action::ParentFh:
+		return ParentOfFile(arg[0], port);
+	case Action::CopyDirFh:
+		return CopyDirOfFile(arg[0], port);
+	case Action::DeleteObject:
+		return DeleteObject(arg[0], arg[1]);
+	case Action::RenameObject:
+		return RenameObject(arg[0], arg[1], arg[2], arg[3]);
+	case Action::CreateDir:
+		return CreateDir(arg[0], arg[1], port);
+	case Action::CurrentVolume:
+		return { RamAddress(kVolumeNode) >> 2, 0 };
+	case Action::IsFilesystem:
+	case Action::Flush:
+		return { kDosTrue, 0 };
+	case Action::SetProtect:
+	case Action::SetComment:
+	case Action::SetDate:
+		// The host file's attributes are left as they are, but saying so would only make
+		// copying programs complain.
+		return { kDosTrue, 0 };
+	default:
+		return Failure(Error::ActionNotKnown);
+	}
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::LocateObject(uint32_t lock, uint32_t name, int32_t mode, uint32_t port)
+{
+	const auto resolved = Resolve(lock, name, false);
+	if (resolved.error)
+		return Failure(resolved.error);
+
+	const uint32_t slot = AllocateSlot(SlotKind::Lock, resolved.path, mode, port);
+	if (!slot)
+		return Failure(Error::NoFreeStore);
+
+	return { slot >> 2, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::FreeLock(uint32_t lock)
+{
+	if (lock != 0)
+	{
+		const uint32_t slot = LockToSlot(lock);
+		if (!slot)
+			return Failure(Error::InvalidLock);
+
+		FreeSlot(slot);
+	}
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::CopyDir(uint32_t lock, uint32_t port)
+{
+	// A copy of the null lock (the root) is null too.
+	if (lock == 0)
+		return { 0, 0 };
+
+	const uint32_t slot = LockToSlot(lock);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	const uint32_t copy = AllocateSlot(SlotKind::Lock, GetSlotPath(slot), kSharedLock, port);
+	if (!copy)
+		return Failure(Error::NoFreeStore);
+
+	return { copy >> 2, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Parent(uint32_t lock, uint32_t port)
+{
+	if (lock == 0)
+		return { 0, 0 };
+
+	const uint32_t slot = LockToSlot(lock);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	const auto path = GetSlotPath(slot);
+	if (path.empty())
+		return { 0, 0 }; // the root has no parent
+
+	const uint32_t parent = AllocateSlot(SlotKind::Lock, ParentPath(path), kSharedLock, port);
+	if (!parent)
+		return Failure(Error::NoFreeStore);
+
+	return { parent >> 2, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::SameLock(uint32_t lock1, uint32_t lock2)
+{
+	const uint32_t slot1 = LockToSlot(lock1);
+	const uint32_t slot2 = LockToSlot(lock2);
+	if (!slot1 || !slot2)
+		return Failure(Error::InvalidLock);
+
+	return { EqualsIgnoreCase(GetSlotPath(slot1), GetSlotPath(slot2)) ? kDosTrue : kDosFalse, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Examine(uint32_t lock, uint32_t fib)
+{
+	std::string path;
+	if (lock != 0)
+	{
+		const uint32_t slot = LockToSlot(lock);
+		if (!slot)
+			return Failure(Error::InvalidLock);
+
+		path = GetSlotPath(slot);
+	}
+
+	if (!FillInfoBlock(fib, path, 0))
+		return Failure(Error::ObjectNotFound);
+
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::ExamineNext(uint32_t lock, uint32_t fib)
+{
+	std::string path;
+	if (lock != 0)
+	{
+		const uint32_t slot = LockToSlot(lock);
+		if (!slot)
+			return Failure(Error::InvalidLock);
+
+		path = GetSlotPath(slot);
+	}
+
+	// The key is the index of the next entry in the (sorted) directory. The listing is read
+	// afresh for each new scan of the directory, as the host may have changed it.
+	uint32_t index = ReadLong(fib + kFibDiskKey);
+	if (index == 0)
+	{
+		m_listingValid = false;
+	}
+
+	const auto& listing = GetListing(path);
+	while (index < listing.size())
+	{
+		const auto entryPath = JoinPath(path, listing[index++]);
+		if (entryPath.size() <= kMaxPathLength && FillInfoBlock(fib, entryPath, index))
+			return { kDosTrue, 0 };
+	}
+
+	return Failure(Error::NoMoreEntries);
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Info(uint32_t infoData)
+{
+	std::error_code ec;
+	const auto space = fs::space(HostPath(""), ec);
+
+	const uint64_t blocks = ec ? 0 : std::min<uint64_t>(space.capacity / kBlockSize, INT32_MAX);
+	const uint64_t freeBlocks = ec ? 0 : std::min<uint64_t>(space.available / kBlockSize, blocks);
+
+	for (uint32_t i = 0; i < kInfoDataLength; i += 4)
+	{
+		WriteLong(infoData + i, 0);
+	}
+	WriteLong(infoData + kIdDiskState, kIdValidated);
+	WriteLong(infoData + kIdNumBlocks, uint32_t(blocks));
+	WriteLong(infoData + kIdNumBlocksUsed, uint32_t(blocks - freeBlocks));
+	WriteLong(infoData + kIdBytesPerBlock, kBlockSize);
+	WriteLong(infoData + kIdDiskType, kIdDosDisk);
+	WriteLong(infoData + kIdVolumeNode, RamAddress(kVolumeNode) >> 2);
+	WriteLong(infoData + kIdInUse, AnySlotsUsed() ? kDosTrue : kDosFalse);
+
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Open(uint32_t fileHandle, uint32_t lock, uint32_t name, int32_t action, uint32_t port)
+{
+	const auto resolved = Resolve(lock, name, action != Action::FindInput);
+	if (resolved.error)
+		return Failure(resolved.error);
+
+	const auto hostPath = HostPath(resolved.path);
+
+	std::error_code ec;
+	if (resolved.exists && fs::is_directory(hostPath, ec))
+		return Failure(Error::ObjectWrongType);
+
+	if (action == Action::FindOutput || !resolved.exists)
+	{
+		if (m_hostFilePath == resolved.path)
+		{
+			CloseHostFile();
+		}
+
+		std::ofstream created(hostPath, std::ios::binary | std::ios::trunc);
+		if (!created.is_open())
+			return Failure(Error::WriteProtected);
+
+		m_listingValid = false;
+	}
+
+	const uint32_t slot = AllocateSlot(SlotKind::File, resolved.path, action == Action::FindOutput ? kExclusiveLock : kSharedLock, port);
+	if (!slot)
+		return Failure(Error::NoFreeStore);
+
+	WriteLong(fileHandle + kFhArg1, slot);
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::OpenFromLock(uint32_t fileHandle, uint32_t lock)
+{
+	const uint32_t slot = LockToSlot(lock);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	std::error_code ec;
+	if (fs::is_directory(HostPath(GetSlotPath(slot)), ec))
+		return Failure(Error::ObjectWrongType);
+
+	// The lock becomes the file handle.
+	WriteLong(slot + kSlotKind, uint32_t(SlotKind::File));
+	WriteLong(slot + kSlotPosition, 0);
+	WriteLong(fileHandle + kFhArg1, slot);
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Read(uint32_t slotAddr, uint32_t buffer, int32_t length)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return { kDosTrue, Error::InvalidLock }; // -1
+
+	if (length <= 0)
+		return { 0, 0 };
+
+	auto* file = GetHostFile(GetSlotPath(slot), false);
+	if (!file)
+		return { kDosTrue, Error::ObjectNotFound };
+
+	const uint32_t position = ReadLong(slot + kSlotPosition);
+	file->clear();
+	file->seekg(position);
+
+	char chunk[4096];
+	uint32_t total = 0;
+	while (total < uint32_t(length))
+	{
+		file->read(chunk, std::min<uint32_t>(sizeof(chunk), uint32_t(length) - total));
+		const auto count = uint32_t(file->gcount());
+		for (uint32_t i = 0; i < count; i++)
+		{
+			m_amiga.PokeByte(buffer + total + i, uint8_t(chunk[i]));
+		}
+		total += count;
+
+		if (count == 0 || !*file)
+			break;
+	}
+
+	WriteLong(slot + kSlotPosition, position + total);
+	return { total, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Write(uint32_t slotAddr, uint32_t buffer, int32_t length)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return { kDosTrue, Error::InvalidLock }; // -1
+
+	if (length <= 0)
+		return { 0, 0 };
+
+	auto* file = GetHostFile(GetSlotPath(slot), true);
+	if (!file)
+		return { kDosTrue, Error::WriteProtected };
+
+	const uint32_t position = ReadLong(slot + kSlotPosition);
+	file->clear();
+	file->seekp(position);
+
+	char chunk[4096];
+	uint32_t total = 0;
+	while (total < uint32_t(length))
+	{
+		const uint32_t count = std::min<uint32_t>(sizeof(chunk), uint32_t(length) - total);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			chunk[i] = char(m_amiga.PeekByte(buffer + total + i));
+		}
+		file->write(chunk, count);
+		total += count;
+	}
+
+	// Flushed straight away, so the host sees the change.
+	file->flush();
+	if (!*file)
+	{
+		CloseHostFile();
+		return { kDosTrue, Error::DiskFull };
+	}
+
+	WriteLong(slot + kSlotPosition, position + total);
+	return { total, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Seek(uint32_t slotAddr, int32_t offset, int32_t mode)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return { kDosTrue, Error::InvalidLock }; // -1
+
+	std::error_code ec;
+	const auto size = fs::file_size(HostPath(GetSlotPath(slot)), ec);
+	if (ec)
+		return { kDosTrue, Error::ObjectNotFound };
+
+	const uint32_t position = ReadLong(slot + kSlotPosition);
+
+	int64_t from;
+	switch (mode)
+	{
+	case kOffsetBeginning:
+		from = 0;
+		break;
+	case kOffsetCurrent:
+		from = position;
+		break;
+	case kOffsetEnd:
+		from = int64_t(size);
+		break;
+	default:
+		return { kDosTrue, Error::SeekError };
+	}
+
+	const int64_t newPosition = from + offset;
+	if (newPosition < 0 || uint64_t(newPosition) > size)
+		return { kDosTrue, Error::SeekError };
+
+	WriteLong(slot + kSlotPosition, uint32_t(newPosition));
+	return { position, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Close(uint32_t slotAddr)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	if (m_hostFilePath == GetSlotPath(slot))
+	{
+		CloseHostFile();
+	}
+	FreeSlot(slot);
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::ExamineFile(uint32_t slotAddr, uint32_t fib)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	if (!FillInfoBlock(fib, GetSlotPath(slot), 0))
+		return Failure(Error::ObjectNotFound);
+
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::ParentOfFile(uint32_t slotAddr, uint32_t port)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	const uint32_t parent = AllocateSlot(SlotKind::Lock, ParentPath(GetSlotPath(slot)), kSharedLock, port);
+	if (!parent)
+		return Failure(Error::NoFreeStore);
+
+	return { parent >> 2, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::CopyDirOfFile(uint32_t slotAddr, uint32_t port)
+{
+	const uint32_t slot = GetSlot(slotAddr, SlotKind::File);
+	if (!slot)
+		return Failure(Error::InvalidLock);
+
+	const uint32_t lock = AllocateSlot(SlotKind::Lock, GetSlotPath(slot), kSharedLock, port);
+	if (!lock)
+		return Failure(Error::NoFreeStore);
+
+	return { lock >> 2, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::DeleteObject(uint32_t lock, uint32_t name)
+{
+	const auto resolved = Resolve(lock, name, false);
+	if (resolved.error)
+		return Failure(resolved.error);
+
+	if (resolved.path.empty() || IsInUse(resolved.path))
+		return Failure(Error::ObjectInUse);
+
+	if (m_hostFilePath == resolved.path)
+	{
+		CloseHostFile();
+	}
+
+	std::error_code ec;
+	fs::remove(HostPath(resolved.path), ec);
+	m_listingValid = false;
+
+	if (ec == std::errc::directory_not_empty)
+		return Failure(Error::DirectoryNotEmpty);
+	if (ec)
+		return Failure(Error::DeleteProtected);
+
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::RenameObject(uint32_t fromLock, uint32_t fromName, uint32_t toLock, uint32_t toName)
+{
+	const auto from = Resolve(fromLock, fromName, false);
+	if (from.error)
+		return Failure(from.error);
+
+	const auto to = Resolve(toLock, toName, true);
+	if (to.error)
+		return Failure(to.error);
+
+	// Only a change of case may rename an object to itself.
+	if (to.exists && !EqualsIgnoreCase(from.path, to.path))
+		return Failure(Error::ObjectExists);
+
+	// Nor can a directory be moved inside itself.
+	if (from.path.empty() || to.path.starts_with(from.path + "/"))
+		return Failure(Error::ObjectInUse);
+
+	CloseHostFile();
+
+	std::error_code ec;
+	fs::rename(HostPath(from.path), HostPath(to.path), ec);
+	m_listingValid = false;
+
+	if (ec)
+		return Failure(Error::WriteProtected);
+
+	// Locks and files open on or inside the object follow it.
+	for (uint32_t i = 0; i < kNumSlots; i++)
+	{
+		const uint32_t slot = RamAddress(kSlots + i * kSlotSize);
+		if (ReadLong(slot + kSlotKind) == uint32_t(SlotKind::Free))
+			continue;
+
+		const auto path = GetSlotPath(slot);
+		if (path == from.path || path.starts_with(from.path + "/"))
+		{
+			SetSlotPath(slot, to.path + path.substr(from.path.size()));
+		}
+	}
+
+	return { kDosTrue, 0 };
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::CreateDir(uint32_t lock, uint32_t name, uint32_t port)
+{
+	const auto resolved = Resolve(lock, name, true);
+	if (resolved.error)
+		return Failure(resolved.error);
+
+	if (resolved.exists)
+		return Failure(Error::ObjectExists);
+
+	std::error_code ec;
+	fs::create_directory(HostPath(resolved.path), ec);
+	m_listingValid = false;
+
+	if (ec)
+		return Failure(Error::WriteProtected);
+
+	const uint32_t slot = AllocateSlot(SlotKind::Lock, resolved.path, kExclusiveLock, port);
+	if (!slot)
+		return Failure(Error::NoFreeStore);
+
+	return { slot >> 2, 0 };
+}
+
+am::HostFileSystem::Resolved am::HostFileSystem::Resolve(uint32_t lock, uint32_t name, bool mayNotExist)
+{
+	Resolved result;
+
+	if (lock != 0)
+	{
+		const uint32_t slot = LockToSlot(lock);
+		if (!slot)
+		{
+			result.error = Error::InvalidLock;
+			return result;
+		}
+		result.path = GetSlotPath(slot);
+	}
+
+	// A device or volume name, or a lone colon, starts from the root.
+	std::string str = ReadBString(name);
+	if (const auto colon = str.find(':'); colon != std::string::npos)
+	{
+		result.path.clear();
+		str.erase(0, colon + 1);
+	}
+
+	result.exists = true;
+
+	size_t pos = 0;
+	while (pos < str.size())
+	{
+		if (!result.exists)
+		{
+			// Only the last part of the name may be missing.
+			result.error = Error::DirNotFound;
+			return result;
+		}
+
+		if (str[pos] == '/')
+		{
+			// A leading or repeated slash is the parent directory.
+			if (result.path.empty())
+			{
+				result.error = Error::ObjectNotFound;
+				return result;
+			}
+			result.path = ParentPath(result.path);
+			pos++;
+			continue;
+		}
+
+		const size_t end = std::min(str.find('/', pos), str.size());
+		const auto component = std::string_view(str).substr(pos, end - pos);
+		pos = (end < str.size()) ? end + 1 : end;
+
+		if (!IsValidComponent(component))
+		{
+			result.error = Error::InvalidComponentName;
+			return result;
+		}
+
+		// AmigaDOS names aren't case sensitive.
+		std::string found;
+		std::error_code ec;
+		for (const auto& entry : fs::directory_iterator(HostPath(result.path), ec))
+		{
+			const auto entryName = entry.path().filename().string();
+			if (EqualsIgnoreCase(entryName, component))
+			{
+				found = entryName;
+				if (entryName == component)
+					break;
+			}
+		}
+
+		if (found.empty())
+		{
+			found = component;
+			result.exists = false;
+		}
+		result.path = JoinPath(result.path, found);
+	}
+
+	if (!result.exists && !mayNotExist)
+	{
+		result.error = Error::ObjectNotFound;
+	}
+	else if (result.path.size() > kMaxPathLength)
+	{
+		result.error = Error::ObjectTooLarge;
+	}
+	return result;
+}
+
+fs::path am::HostFileSystem::HostPath(std::string_view path) const
+{
+	// Nothing outside the mounted directory can be reached. An empty path fails whatever is done
+	// with it.
+	if (!IsValidPath(path))
+		return {};
+
+	const fs::path base(m_directory);
+	const auto hostPath = base / fs::path(path);
+
+	const auto relative = hostPath.lexically_normal().lexically_relative(base.lexically_normal());
+	if (!path.empty() && (relative.empty() || *relative.begin() == ".."))
+		return {};
+
+	return hostPath;
+}
+
+uint32_t am::HostFileSystem::AllocateSlot(SlotKind kind, std::string_view path, int32_t access, uint32_t port)
+{
+	if (path.size() > kMaxPathLength)
+		return 0;
+
+	for (uint32_t i = 0; i < kNumSlots; i++)
+	{
+		const uint32_t slot = RamAddress(kSlots + i * kSlotSize);
+		if (ReadLong(slot + kSlotKind) != uint32_t(SlotKind::Free))
+			continue;
+
+		for (uint32_t offset = 0; offset < kSlotPath; offset += 4)
+		{
+			WriteLong(slot + offset, 0);
+		}
+		WriteLong(slot + kFlKey, LockKey(path));
+		WriteLong(slot + kFlAccess, uint32_t(access));
+		WriteLong(slot + kFlTask, port);
+		WriteLong(slot + kFlVolume, RamAddress(kVolumeNode) >> 2);
+		WriteLong(slot + kSlotKind, uint32_t(kind));
+		SetSlotPath(slot, path);
+		return slot;
+	}
+	return 0;
+}
+
+void am::HostFileSystem::FreeSlot(uint32_t slot)
+{
+	WriteLong(slot + kSlotKind, uint32_t(SlotKind::Free));
+}
+
+uint32_t am::HostFileSystem::GetSlot(uint32_t addr, SlotKind kind) const
+{
+	const uint32_t first = RamAddress(kSlots);
+	if (addr < first || (addr - first) % kSlotSize != 0 || (addr - first) / kSlotSize >= kNumSlots)
+		return 0;
+
+	if (ReadLong(addr + kSlotKind) != uint32_t(kind))
+		return 0;
+
+	if (!IsValidPath(GetSlotPath(addr)))
+		return 0;
+
+	return addr;
+}
+
+uint32_t am::HostFileSystem::LockToSlot(uint32_t lock) const
+{
+	return GetSlot(lock << 2, SlotKind::Lock);
+}
+
+std::string am::HostFileSystem::GetSlotPath(uint32_t slot) const
+{
+	std::string path;
+	for (uint32_t i = 0; i < kMaxPathLength; i++)
+	{
+		const char c = char(m_amiga.PeekByte(slot + kSlotPath + i));
+		if (c == '\0')
+			break;
+		path.push_back(c);
+	}
+	return path;
+}
+
+bool am::HostFileSystem::SetSlotPath(uint32_t slot, std::string_view path)
+{
+	if (path.size() > kMaxPathLength)
+		return false;
+
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		m_amiga.PokeByte(slot + kSlotPath + uint32_t(i), uint8_t(path[i]));
+	}
+	m_amiga.PokeByte(slot + kSlotPath + uint32_t(path.size()), 0);
+	return true;
+}
+
+bool am::HostFileSystem::IsInUse(std::string_view path) const
+{
+	for (uint32_t i = 0; i < kNumSlots; i++)
+	{
+		const uint32_t slot = RamAddress(kSlots + i * kSlotSize);
+		if (ReadLong(slot + kSlotKind) != uint32_t(SlotKind::Free) && EqualsIgnoreCase(GetSlotPath(slot), path))
+			return true;
+	}
+	return false;
+}
+
+bool am::HostFileSystem::AnySlotsUsed() const
+{
+	for (uint32_t i = 0; i < kNumSlots; i++)
+	{
+		if (ReadLong(RamAddress(kSlots + i * kSlotSize) + kSlotKind) != uint32_t(SlotKind::Free))
+			return true;
+	}
+	return false;
+}
+
+bool am::HostFileSystem::FillInfoBlock(uint32_t fib, std::string_view path, uint32_t diskKey)
+{
+	const auto hostPath = HostPath(path);
+
+	std::error_code ec;
+	const auto status = fs::status(hostPath, ec);
+	if (ec || !fs::exists(status))
+		return false;
+
+	const bool isDirectory = fs::is_directory(status);
+	const int32_t type = path.empty() ? kStRoot : isDirectory ? kStUserDir : kStFile;
+
+	uint64_t size = isDirectory ? 0 : fs::file_size(hostPath, ec);
+	if (ec)
+	{
+		size = 0;
+	}
+	size = std::min<uint64_t>(size, INT32_MAX);
+
+	const auto time = fs::last_write_time(hostPath, ec);
+
+	for (uint32_t i = 0; i < kFibLength; i += 4)
+	{
+		WriteLong(fib + i, 0);
+	}
+	WriteLong(fib + kFibDiskKey, diskKey);
+	WriteLong(fib + kFibDirEntryType, uint32_t(type));
+	WriteBString(fib + kFibFileName, path.empty() ? std::string_view(m_volumeName) : LeafName(path), kMaxFileNameLength);
+	WriteLong(fib + kFibEntryType, uint32_t(type));
+	WriteLong(fib + kFibSize, uint32_t(size));
+	WriteLong(fib + kFibNumBlocks, uint32_t((size + kBlockSize - 1) / kBlockSize));
+	WriteDateStamp(fib + kFibDate, ec ? fs::file_time_type() : time);
+	return true;
+}
+
+std::fstream* am::HostFileSystem::GetHostFile(std::string_view path, bool write)
+{
+	if (m_hostFile.is_open() && m_hostFilePath == path && (m_hostFileWritable || !write))
+		return &m_hostFile;
+
+	CloseHostFile();
+
+	const auto mode = write ? (std::ios::in | std::ios::out | std::ios::binary) : (std::ios::in | std::ios::binary);
+	m_hostFile.open(HostPath(path), mode);
+	if (!m_hostFile.is_open())
+	{
+		m_hostFile.clear();
+		return nullptr;
+	}
+
+	m_hostFilePath = path;
+	m_hostFileWritable = write;
+	return &m_hostFile;
+}
+
+void am::HostFileSystem::CloseHostFile()
+{
+	if (m_hostFile.is_open())
+	{
+		m_hostFile.close();
+	}
+	m_hostFile.clear();
+	m_hostFilePath.clear();
+	m_hostFileWritable = false;
+}
+
+const std::vector<std::string>& am::HostFileSystem::GetListing(std::string_view path)
+{
+	if (m_listingValid && m_listingPath == path)
+		return m_listing;
+
+	m_listing.clear();
+	m_listingPath = path;
+	m_listingValid = true;
+
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator(HostPath(path), ec))
+	{
+		auto name = entry.path().filename().string();
+		if (name.size() <= kMaxFileNameLength)
+		{
+			m_listing.push_back(std::move(name));
+		}
+	}
+	std::sort(m_listing.begin(), m_listing.end());
+	return m_listing;
+}
+
+std::string am::HostFileSystem::ReadBString(uint32_t bptr) const
+{
+	const uint32_t addr = bptr << 2;
+	if (addr == 0)
+		return {};
+
+	std::string str(m_amiga.PeekByte(addr), '\0');
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		str[i] = char(m_amiga.PeekByte(addr + 1 + uint32_t(i)));
+	}
+	return str;
+}
+
+void am::HostFileSystem::WriteBString(uint32_t addr, std::string_view str, size_t maxLength)
+{
+	str = str.substr(0, maxLength);
+	m_amiga.PokeByte(addr, uint8_t(str.size()));
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		m_amiga.PokeByte(addr + 1 + uint32_t(i), uint8_t(str[i]));
+	}
+}
+
+void am::HostFileSystem::WriteDateStamp(uint32_t addr, fs::file_time_type time)
+{
+	const auto sinceUnixEpoch = std::chrono::file_clock::to_sys(time).time_since_epoch();
+	const int64_t seconds = std::max<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(sinceUnixEpoch).count() - kAmigaEpoch, 0);
+
+	WriteLong(addr, uint32_t(seconds / (24 * 60 * 60)));	// days
+	WriteLong(addr + 4, uint32_t(seconds % (24 * 60 * 60) / 60));	// minutes
+	WriteLong(addr + 8, uint32_t(seconds % 60 * 50));	// ticks
+}
+
+uint32_t am::HostFileSystem::ReadLong(uint32_t addr) const
+{
+	return (uint32_t(m_amiga.PeekWord(addr)) << 16) | m_amiga.PeekWord(addr + 2);
+}
+
+void am::HostFileSystem::WriteLong(uint32_t addr, uint32_t value)
+{
+	m_amiga.PokeByte(addr, uint8_t(value >> 24));
+	m_amiga.PokeByte(addr + 1, uint8_t(value >> 16));
+	m_amiga.PokeByte(addr + 2, uint8_t(value >> 8));
+	m_amiga.PokeByte(addr + 3, uint8_t(value));
+}
+
+uint32_t am::HostFileSystem::RamAddress(uint32_t offset) const
+{
+	return m_base + kRamOffset + offset;
+}
+
+am::HostFileSystem::Reply am::HostFileSystem::Failure(uint32_t error)
+{
+	return { kDosFalse, error };
+}
+
+template <typename S, typename Self>
+void am::HostFileSystem::Stream(S& s, Self& self)
+{
+	using util::Stream;
+	using util::StreamVector;
+
+	Stream(s, self.m_configured);
+	Stream(s, self.m_shutUp);
+	Stream(s, self.m_baseLow);
+	Stream(s, self.m_base);
+	StreamVector(s, self.m_ram);
+}
+
+template void am::HostFileSystem::Stream<>(std::istream& s, am::HostFileSystem& self);
+template void am::HostFileSystem::Stream<>(std::ostream& s, const am::HostFileSystem& self);
+template void am::HostFileSystem::Stream<>(util::MemoryReader& s, am::HostFileSystem& self);
+template void am::HostFileSystem::Stream<>(util::MemoryWriter& s, const am::HostFileSystem& self);
\ No newline at end of file
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "68000.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+namespace am
+{
+	class Amiga;
+
+	// Mounts a directory of the host as an AmigaDOS volume, HOST:, so files can be shared with the
+	// emulated machine without going through disk images.
+	//
+	// The directory is presented as a Zorro II autoconfig board with a small expansion rom. Kickstart
+	// (1.3 or later) configures the board and calls its diagnostic routine, which adds a DOS device
+	// for it to the mount list. The device's handler is a few instructions of 68000 code in the rom
+	// that waits for DOS packets and passes each one to the emulator with a line 1111 opcode. The
+	// emulator services the packet with host file operations there and then, so from the machine's
+	// point of view every request completes instantly.
+	//
+	// All the state the machine sees (locks, file handles and their positions) is kept in RAM on the
+	// board, which is part of the saved state. The files themselves are not, so changes made to
+	// them are not undone by loading an earlier state.
+	class HostFileSystem
+	{
+	public:
+		static constexpr uint32_t kConfigBase = 0xe8'0000;
+		static constexpr uint32_t kBoardSize = 0x1'0000;
+
+		explicit HostFileSystem(Amiga& amiga);
+
+		// Returns false, leaving nothing mounted, if the directory doesn't exist. The board only
+		// appears to the machine from its next reset.
+		bool Mount(const std::string& directory);
+		void Unmount();
+
+		bool IsMounted() const
+		{
+			return !m_directory.empty();
+		}
+
+		const std::string& GetDirectory() const
+		{
+			return m_directory;
+		}
+
+		// As happens when the machine is reset.
+		void Reset();
+
+		// The board's registers in the autoconfig space, before it has been given its address.
+		uint8_t ReadConfigByte(uint32_t addr) const;
+		void WriteConfigByte(uint32_t addr, uint8_t value);
+
+		// The board's rom and RAM, once it has been configured. Returns null for any other address.
+		uint8_t* GetBoardMemory(uint32_t addr, bool& readOnly);
+
+		static bool IsTrap(uint16_t opcode)
+		{
+			return opcode == kMountTrap || opcode == kPacketTrap;
+		}
+
+		// Called for the traps in the board's rom.
+		void Trap(uint16_t opcode, cpu::Registers& regs);
+
+		// Self is const when writing.
+		template <typename S, typename Self>
+		static void Stream(S& s, Self& self);
+
+	private:
+		static constexpr uint16_t kMountTrap = 0xfe00;
+		static constexpr uint16_t kPacketTrap = 0xfe01;
+
+		enum class SlotKind : uint32_t
+		{
+			Free,
+			Lock,
+			File,
+		};
+
+		struct Reply
+		{
+			uint32_t res1;
+			uint32_t res2;
+		};
+
+		// Whatever is found resolving a name, and the DOS error code if it wasn't.
+		struct Resolved
+		{
+			std::string path; // relative to the mounted directory, with '/' separators
+			bool exists = false;
+			uint32_t error = 0;
+		};
+
+		void BuildRom();
+		void Startup(uint32_t dosBase, uint32_t port);
+		Reply Service(uint32_t packet, uint32_t port);
+
+		Reply LocateObject(uint32_t lock, uint32_t name, int32_t mode, uint32_t port);
+		Reply FreeLock(uint32_t lock);
+		Reply CopyDir(uint32_t lock, uint32_t port);
+		Reply Parent(uint32_t lock, uint32_t port);
+		Reply SameLock(uint32_t lock1, uint32_t lock2);
+		Reply Examine(uint32_t lock, uint32_t fib);
+		Reply ExamineNext(uint32_t lock, uint32_t fib);
+		Reply Info(uint32_t infoData);
+		Reply Open(uint32_t fileHandle, uint32_t lock, uint32_t name, int32_t action, uint32_t port);
+		Reply OpenFromLock(uint32_t fileHandle, uint32_t lock);
+		Reply Read(uint32_t slot, uint32_t buffer, int32_t length);
+		Reply Write(uint32_t slot, uint32_t buffer, int32_t length);
+		Reply Seek(uint32_t slot, int32_t offset, int32_t mode);
+		Reply Close(uint32_t slot);
+		Reply ExamineFile(uint32_t slot, uint32_t fib);
+		Reply ParentOfFile(uint32_t slot, uint32_t port);
+		Reply CopyDirOfFile(uint32_t slot, uint32_t port);
+		Reply DeleteObject(uint32_t lock, uint32_t name);
+		Reply RenameObject(uint32_t fromLock, uint32_t fromName, uint32_t toLock, uint32_t toName);
+		Reply CreateDir(uint32_t lock, uint32_t name, uint32_t port);
+
+		Resolved Resolve(uint32_t lock, uint32_t name, bool mayNotExist);
+		std::filesystem::path HostPath(std::string_view path) const;
+
+		// Locks and file handles each take a slot in the board's RAM.
+		uint32_t AllocateSlot(SlotKind kind, std::string_view path, int32_t access, uint32_t port);
+		void FreeSlot(uint32_t slot);
+		uint32_t GetSlot(uint32_t addr, SlotKind kind) const; // 0 if addr isn't a slot of that kind with a valid path
+		uint32_t LockToSlot(uint32_t lock) const;
+		std::string GetSlotPath(uint32_t slot) const;
+		bool SetSlotPath(uint32_t slot, std::string_view path);
+		bool IsInUse(std::string_view path) const;
+		bool AnySlotsUsed() const;
+
+		// Returns false if the object doesn't exist.
+		bool FillInfoBlock(uint32_t fib, std::string_view path, uint32_t diskKey);
+
+		// Open host files and directory listings are kept between packets, as most are followed by
+		// another for the same file or directory.
+		std::fstream* GetHostFile(std::string_view path, bool write);
+		void CloseHostFile();
+		const std::vector<std::string>& GetListing(std::string_view path);
+
+		std::string ReadBString(uint32_t bptr) const;
+		void WriteBString(uint32_t addr, std::string_view str, size_t maxLength);
+		void WriteDateStamp(uint32_t addr, std::filesystem::file_time_type time);
+		uint32_t ReadLong(uint32_t addr) const;
+		void WriteLong(uint32_t addr, uint32_t value);
+
+		uint32_t RamAddress(uint32_t offset) const;
+
+		static Reply Failure(uint32_t error);
+
+		Amiga& m_amiga;
+
+		// What is mounted. Not part of the saved state.
+		std::string m_directory;
+		std::string m_volumeName;
+		std::vector<uint8_t> m_rom;
+
+		std::fstream m_hostFile;
+		std::string m_hostFilePath;
+		bool m_hostFileWritable = false;
+
+		std::vector<std::string> m_listing;
+		std::string m_listingPath;
+		bool m_listingValid = false;
+
+		// Autoconfig state.
+		bool m_configured = false;
+		bool m_shutUp = false;
+		uint8_t m_baseLow = 0;
+		uint32_t m_base = 0;
+
+		std::vector<uint8_t> m_ram;
+	};
+}
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "mfm.h"
 #include "util/endian.h"
 
+#include <algorithm>
+#include <cstring>
+
 std::pair<uint32_t, uint32_t> am::EncodeMFM(uint32_t value)
 {
 	const uint32_t mask = 0x55555555;
@@ -11,26 +14,20 @@ std::pair<uint32_t, uint32_t> am::EncodeMFM(uint32_t value)
 	return { odd, even };
 }
 
-void am::EncodeDiskImage(const std::vector<uint8_t>& data, DiskImage& encodedImage)
+void am::EncodeTrack(const uint8_t* data, size_t size, int c, int h, uint8_t* track)
 {
-	encodedImage.clear();
-	encodedImage.resize(kCylindersPerDisk);
-
-	std::vector<uint8_t>* track = nullptr;
-	bool lastBitOne = false;
-
 	auto WriteWord = [&](size_t& off, uint16_t w)
 	{
-		(*track)[off++] = uint8_t(w >> 8);
-		(*track)[off++] = uint8_t(w);
+		track[off++] = uint8_t(w >> 8);
+		track[off++] = uint8_t(w);
 	};
 
 	auto WriteLong = [&](size_t& off, uint32_t l)
 	{
-		(*track)[off++] = uint8_t(l >> 24);
-		(*track)[off++] = uint8_t(l >> 16);
-		(*track)[off++] = uint8_t(l >> 8);
-		(*track)[off++] = uint8_t(l);
+		track[off++] = uint8_t(l >> 24);
+		track[off++] = uint8_t(l >> 16);
+		track[off++] = uint8_t(l >> 8);
+		track[off++] = uint8_t(l);
 	};
 
 	auto WriteEncodedLong = [&](size_t& off, uint32_t l)
@@ -46,7 +43,7 @@ void am::EncodeDiskImage(const std::vector<uint8_t>& data, DiskImage& encodedIma
 
 		for (size_t p = start; p < end; p++)
 		{
-			auto& b = (*track)[p];
+			auto& b = track[p];
 
 			for (uint8_t syncBit = 0x40; syncBit != 0; syncBit >>= 2)
 			{
@@ -60,86 +57,372 @@ void am::EncodeDiskImage(const std::vector<uint8_t>& data, DiskImage& encodedIma
 		}
 	};
 
-	for (int c = 0; c < kCylindersPerDisk; c++)
+	memset(track, 0, kMfmTrackSize);
+
+	size_t ptr = 0;
+	size_t syncStartPtr;
+
+	for (int s = 0; s < kSectorsPerTrack; s++)
 	{
-		encodedImage[c].resize(kTracksPerCylinder);
+		WriteWord(ptr, 0xaaaa);
+		WriteWord(ptr, 0xaaaa);
+		WriteWord(ptr, 0x4489);
+		WriteWord(ptr, 0x4489);
+
+		syncStartPtr = ptr;
+
+		uint32_t info = 0xff000000;
+		info |= uint32_t(c * 2 + h) << 16;
+		info |= uint32_t(s) << 8;
+		info |= uint32_t(11 - s); // sectors until end of track.
+
+		uint32_t headerChecksum = 0;
+
+		auto encodedInfo = EncodeMFM(info);
 
-		for (int h = 0; h < kTracksPerCylinder; h++)
+		WriteLong(ptr, encodedInfo.first);
+		WriteLong(ptr, encodedInfo.second);
+
+		headerChecksum ^= encodedInfo.first;
+		headerChecksum ^= encodedInfo.second;
+
+		ptr += 0x20;
+
+		WriteEncodedLong(ptr, headerChecksum);
+
+		uint32_t checkSum = 0;
+
+		const size_t sectorOffset = size_t(s) * kDecodedBytesPerSector;
+
+		// A short image reads as zeros past its end.
+		uint8_t decodedData[kDecodedBytesPerSector] = {};
+		if (sectorOffset < size)
 		{
-			track = &encodedImage[c][h];
+			memcpy(decodedData, &data[sectorOffset], std::min(size - sectorOffset, size_t(kDecodedBytesPerSector)));
+		}
 
-			track->resize(kMfmSectorSize * kSectorsPerTrack + kMfmGapSize);
+		size_t oddPtr = ptr + 0x8;
+		size_t evenPtr = oddPtr + 0x200;
 
-			size_t ptr = 0;
-			size_t syncStartPtr;
+		for (int d = 0; d < kDecodedBytesPerSector / 4; d++)
+		{
+			uint32_t data32;
+			memcpy(&data32, &decodedData[d * 4], 4);
+			data32 = SwapEndian(data32);
 
-			for (int s = 0; s < kSectorsPerTrack; s++)
-			{
-				WriteWord(ptr, 0xaaaa);
-				WriteWord(ptr, 0xaaaa);
-				WriteWord(ptr, 0x4489);
-				WriteWord(ptr, 0x4489);
+			auto encoded = EncodeMFM(data32);
 
-				syncStartPtr = ptr;
+			checkSum ^= encoded.first;
+			checkSum ^= encoded.second;
 
-				uint32_t info = 0xff000000;
-				info |= uint32_t(c * 2 + h) << 16;
-				info |= uint32_t(s) << 8;
-				info |= uint32_t(11 - s); // sectors until end of track.
+			WriteLong(oddPtr, encoded.first);
+			WriteLong(evenPtr, encoded.second);
+		}
 
-				uint32_t headerChecksum = 0;
+		WriteEncodedLong(ptr, checkSum);
 
-				auto encodedInfo = EncodeMFM(info);
+		ptr += 0x400;
 
-				bool lastBitOne = false;
+		AddSyncBits(syncStartPtr, ptr);
+	}
 
-				WriteLong(ptr, encodedInfo.first);
-				WriteLong(ptr, encodedInfo.second);
+	// Certain programs (e.g. first samurai) seem to expect some bits set in the sector gap.
+	// So write out an arbitrary pattern.
+	for (int i = 0; i < kMfmGapSize; i += 2)
+	{
+		WriteWord(ptr, kGapPattern);
+	}
+}
 
-				headerChecksum ^= encodedInfo.first;
-				headerChecksum ^= encodedInfo.second;
+int am::DecodeTrack(const uint8_t* encodedTrack, int track, uint8_t* decodedTrack)
+{
+	auto ReadByte = [&](size_t off)
+	{
+		return encodedTrack[off % kMfmTrackSize];
+	};
 
-				ptr += 0x20;
+	auto ReadWord = [&](size_t off)
+	{
+		return uint16_t((ReadByte(off) << 8) | ReadByte(off + 1));
+	};
 
-				WriteEncodedLong(ptr, headerChecksum);
+	auto ReadLong = [&](size_t off)
+	{
+		return (uint32_t(ReadWord(off)) << 16) | ReadWord(off + 2);
+	};
 
-				uint32_t checkSum = 0;
+	auto ReadDecodedLong = [&](size_t oddOff, size_t evenOff)
+	{
+		const uint32_t mask = 0x55555555;
+		return ((ReadLong(oddOff) & mask) << 1) | (ReadLong(evenOff) & mask);
+	};
 
-				const auto adfOffset = (((c * kTracksPerCylinder + h) * kSectorsPerTrack) + s) * kDecodedBytesPerSector;
+	std::bitset<kSectorsPerTrack> decoded;
 
-				auto decodedData = &data[adfOffset];
+	for (size_t sync = 0; sync < kMfmTrackSize; sync++)
+	{
+		// A sector starts after two sync words.
+		if (ReadWord(sync) != 0x4489 || ReadWord(sync + 2) != 0x4489 || ReadWord(sync + 4) == 0x4489)
+			continue;
 
-				size_t oddPtr = ptr + 0x8;
-				size_t evenPtr = oddPtr + 0x200;
+		const size_t header = sync + 4;
 
-				for (int d = 0; d < kDecodedBytesPerSector / 4; d++)
-				{
-					uint32_t data32;
-					memcpy(&data32, &decodedData[d * 4], 4);
-					data32 = SwapEndian(data32);
+		const uint32_t info = ReadDecodedLong(header, header + 4);
+		const int sectorTrack = (info >> 16) & 0xff;
+		const int sector = (info >> 8) & 0xff;
 
-					auto encoded = EncodeMFM(data32);
+		if ((info >> 24) != 0xff || sectorTrack != track || sector >= kSectorsPerTrack || decoded[sector])
+			continue;
 
-					checkSum ^= encoded.first;
-					checkSum ^= encoded.second;
+		const size_t dataChecksumOffset = header + 0x30;
+		const size_t oddOffset = header + 0x38;
+		const size_t evenOffset = oddOffset + kDecodedBytesPerSector;
 
-					WriteLong(oddPtr, encoded.first);
-					WriteLong(evenPtr, encoded.second);
-				}
+		uint32_t checksum = 0;
+		for (size_t off = oddOffset; off < evenOffset + kDecodedBytesPerSector; off += 4)
+		{
+			checksum ^= ReadLong(off);
+		}
+		checksum &= 0x55555555;
 
-				WriteEncodedLong(ptr, checkSum);
+		if (checksum != ReadDecodedLong(dataChecksumOffset, dataChecksumOffset + 4))
+			continue;
 
-				ptr += 0x400;
+		uint8_t* out = decodedTrack + sector * kDecodedBytesPerSector;
+		for (int d = 0; d < kDecodedBytesPerSector / 4; d++)
+		{
+			const uint32_t value = ReadDecodedLong(oddOffset + d * 4, evenOffset + d * 4);
+			out[d * 4] = uint8_t(value >> 24);
+			out[d * 4 + 1] = uint8_t(value >> 16);
+			out[d * 4 + 2] = uint8_t(value >> 8);
+			out[d * 4 + 3] = uint8_t(value);
+		}
 
-				AddSyncBits(syncStartPtr, ptr);
-			}
+		decoded.set(sector);
+	}
+
+	return int(decoded.count());
+}
+
+uint16_t am::ReadTrackWord(const uint8_t* track, uint32_t bitLength, uint32_t position)
+{
+	const uint32_t byte = position / 8;
+	const uint32_t bit = position % 8;
+
+	if (position + 16 <= bitLength)
+	{
+		uint32_t bits = (uint32_t(track[byte]) << 16) | (uint32_t(track[byte + 1]) << 8);
+		if (bit != 0)
+		{
+			bits |= track[byte + 2];
+		}
+		return uint16_t(bits >> (8 - bit));
+	}
+
+	// The word wraps round the end of the track, which needn't end on a byte boundary.
+	uint16_t value = 0;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const uint32_t p = (position + i) % bitLength;
+		value = uint16_t((value << 1) | ((track[p / 8] >> (7 - p % 8)) & 1));
+	}
+	return value;
+}
+
+void am::WriteTrackWord(uint8_t* track, uint32_t bitLength, uint32_t position, uint16_t value)
+{
+	const uint32_t byte = position / 8;
+	const uint32_t bit = position % 8;
+
+	if (position + 16 <= bitLength)
+	{
+		const uint32_t shift = 8 - bit;
+		const uint32_t bits = uint32_t(value) << shift;
+		const uint32_t mask = 0xffffu << shift;
+
+		for (uint32_t i = 0; i < (bit != 0 ? 3u : 2u); i++)
+		{
+			const uint8_t byteMask = uint8_t(mask >> (16 - i * 8));
+			track[byte + i] = uint8_t((track[byte + i] & ~byteMask) | ((bits >> (16 - i * 8)) & byteMask));
+		}
+		return;
+	}
+
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const uint32_t p = (position + i) % bitLength;
+		const uint8_t mask = uint8_t(0x80 >> (p % 8));
+		if ((value & (0x8000 >> i)) != 0)
+		{
+			track[p / 8] |= mask;
+		}
+		else
+		{
+			track[p / 8] &= ~mask;
+		}
+	}
+}
+
+void am::FindSyncWord(const uint8_t* encodedTrack, uint32_t bitLength, uint16_t syncWord, std::vector<uint32_t>& positions)
+{
+	uint32_t position = 0;
+
+	if (bitLength >= 24)
+	{
+		// Go through the track a byte at a time. Every 16 bit sequence starting within the current
+		// byte has the byte after it as its middle 8 bits, which must equal a different byte of the
+		// sync word at each alignment. A table indexed by that byte gives the alignments that can
+		// match, so most bytes are passed over with one lookup.
+		std::array<uint8_t, 256> alignments = {};
+		for (uint32_t bit = 0; bit < 8; bit++)
+		{
+			alignments[(syncWord >> bit) & 0xff] |= uint8_t(1 << bit);
+		}
 
-			// Certain programs (e.g. first samurai) seem to expect some bits set in the sector gap.
-			// So write out an arbitrary pattern.
-			for (int i = 0; i < kMfmGapSize; i += 2)
+		const uint32_t wholeBytes = (bitLength - 23) / 8 + 1;
+
+		for (uint32_t i = 0; i < wholeBytes; i++)
+		{
+			const uint32_t candidates = alignments[encodedTrack[i + 1]];
+			if (candidates == 0)
+				continue;
+
+			const uint32_t window = (uint32_t(encodedTrack[i]) << 16) | (uint32_t(encodedTrack[i + 1]) << 8) | encodedTrack[i + 2];
+
+			for (uint32_t bit = 0; bit < 8; bit++)
 			{
-				WriteWord(ptr, kGapPattern);
+				if ((candidates & (1u << bit)) != 0 && uint16_t(window >> (8 - bit)) == syncWord)
+				{
+					positions.push_back(i * 8 + bit);
+				}
 			}
 		}
+
+		position = wholeBytes * 8;
+	}
+
+	// The last few positions, where the sequence wraps round the end of the track.
+	for (; position < bitLength; position++)
+	{
+		if (ReadTrackWord(encodedTrack, bitLength, position) == syncWord)
+		{
+			positions.push_back(position);
+		}
 	}
+}
+
+bool am::ReadTrackLayout(std::span<const uint8_t> data, std::array<TrackLayout, kTracksPerDisk>& layout)
+{
+	layout.fill({});
+
+	auto ReadWord = [&](size_t off) { return uint16_t((data[off] << 8) | data[off + 1]); };
+	auto ReadLong = [&](size_t off) { return (uint32_t(ReadWord(off)) << 16) | ReadWord(off + 2); };
+
+	constexpr char kExtendedId[] = "UAE-1ADF";
+	constexpr size_t kHeaderSize = 12;
+	constexpr size_t kTrackHeaderSize = 12;
+
+	if (data.size() < kHeaderSize || memcmp(data.data(), kExtendedId, 8) != 0)
+	{
+		for (int track = 0; track < kTracksPerDisk; track++)
+		{
+			auto& t = layout[track];
+			const size_t offset = size_t(track) * kDecodedTrackSize;
+			t.offset = uint32_t(offset);
+			t.size = offset < data.size() ? uint32_t(std::min(data.size() - offset, size_t(kDecodedTrackSize))) : 0;
+			t.bitLength = kMfmTrackSize * 8;
+		}
+		return true;
+	}
+
+	const int numTracks = ReadWord(10);
+	size_t offset = kHeaderSize + size_t(numTracks) * kTrackHeaderSize;
+	if (offset > data.size())
+		return false;
+
+	for (int track = 0; track < numTracks; track++)
+	{
+		const size_t header = kHeaderSize + size_t(track) * kTrackHeaderSize;
+		const uint16_t type = ReadWord(header + 2);
+		const uint32_t size = ReadLong(header + 4);
+		const uint32_t bitLength = ReadLong(header + 8);
+
+		// Raw tracks are limited to what disk DMA can address (and far longer than any real track).
+		constexpr uint32_t kMaxRawTrackSize = 0x8000;
+
+		if (size > data.size() - offset || (type == 1 && (size > kMaxRawTrackSize || bitLength > size * 8)) || type > 1)
+			return false;
+
+		if (track < kTracksPerDisk)
+		{
+			auto& t = layout[track];
+			t.offset = uint32_t(offset);
+			t.size = size;
+			t.raw = (type == 1);
+			t.bitLength = t.raw ? bitLength : kMfmTrackSize * 8;
+		}
+
+		offset += size;
+	}
+
+	return true;
+}
+
+bool am::DiskImage::Reset(std::span<const uint8_t> data)
+{
+	m_slot.fill(-1);
+	m_buffer.clear();
+	m_modified.reset();
+
+	for (auto& index : m_syncIndex)
+	{
+		index.clear();
+	}
+
+	if (!ReadTrackLayout(data, m_layout))
+	{
+		m_layout.fill({});
+		return false;
+	}
+
+	return true;
+}
+
+std::span<const uint32_t> am::DiskImage::GetSyncPositions(std::span<const uint8_t> data, int cylinder, int side, uint16_t syncWord)
+{
+	const int track = cylinder * kTracksPerCylinder + side;
+	const uint8_t* encoded = GetTrack(data, cylinder, side);
+
+	if (encoded == nullptr)
+		return {};
+
+	auto& index = m_syncIndex[track];
+	for (auto& entry : index)
+	{
+		if (entry.syncWord == syncWord)
+			return entry.positions;
+	}
+
+	auto& entry = index.emplace_back();
+	entry.syncWord = syncWord;
+	FindSyncWord(encoded, m_layout[track].bitLength, syncWord, entry.positions);
+	return entry.positions;
+}
+
+void am::DiskImage::Encode(std::span<const uint8_t> data, int track)
+{
+	if (m_buffer.empty())
+	{
+		// Room for every sector track, so the buffer never moves.
+		const auto sectorTracks = std::count_if(m_layout.begin(), m_layout.end(), [](const TrackLayout& t) { return t.bitLength != 0 && !t.raw; });
+		m_buffer.reserve(size_t(sectorTracks) * kMfmTrackSize);
+	}
+
+	const auto& layout = m_layout[track];
+	m_slot[track] = int16_t(m_buffer.size() / kMfmTrackSize);
+	m_buffer.resize(m_buffer.size() + kMfmTrackSize);
+
+	EncodeTrack(layout.size != 0 ? &data[layout.offset] : nullptr, layout.size, track / kTracksPerCylinder, track % kTracksPerCylinder,
+		&m_buffer[size_t(m_slot[track]) * kMfmTrackSize]);
+	m_syncIndex[track].clear();
 }
\ No newline at end of file
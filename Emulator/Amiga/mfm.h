@@ -1,7 +1,11 @@
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <span>
 #include <vector>
 #include <utility>
+#include <stddef.h>
 #include <stdint.h>
 
 namespace am
@@ -14,10 +18,137 @@ namespace am
 	const int kMfmGapSize = 30;
 	const int kMfmSectorSize = kMfmSectorHeaderSize + kDecodedBytesPerSector * 2;
 	const uint16_t kGapPattern = 0x5050;
+	const int kMfmTrackSize = kMfmSectorSize * kSectorsPerTrack + kMfmGapSize;
+	const int kTracksPerDisk = kCylindersPerDisk * kTracksPerCylinder;
 
-	using DiskImage = std::vector<std::vector<std::vector<uint8_t>>>;
+	const int kDecodedTrackSize = kSectorsPerTrack * kDecodedBytesPerSector;
 
 	std::pair<uint32_t, uint32_t> EncodeMFM(uint32_t value);
-	void EncodeDiskImage(const std::vector<uint8_t>& data, DiskImage& encodedImage);
 
+	// Encodes the AmigaDOS sectors of one track into the kMfmTrackSize bytes at encodedTrack. Only
+	// size bytes of sector data are available; the rest of the track reads as zeros.
+	void EncodeTrack(const uint8_t* sectorData, size_t size, int cylinder, int side, uint8_t* encodedTrack);
+
+	// Decodes the AmigaDOS sectors found in an encoded track (which may start anywhere, as the track is
+	// circular) into decodedTrack, which holds kSectorsPerTrack sectors. Sectors that are missing,
+	// fail their checksum or belong to another track are left untouched. Returns the number decoded.
+	int DecodeTrack(const uint8_t* encodedTrack, int track, uint8_t* decodedTrack);
+
+	// Reads the 16 bits starting at a bit position of an encoded track bitLength bits long, wrapping
+	// round the end of the track.
+	uint16_t ReadTrackWord(const uint8_t* encodedTrack, uint32_t bitLength, uint32_t position);
+
+	// Replaces the 16 bits starting at a bit position of an encoded track, as ReadTrackWord.
+	void WriteTrackWord(uint8_t* encodedTrack, uint32_t bitLength, uint32_t position, uint16_t value);
+
+	// Finds every bit position in an encoded track at which the 16 bits starting there (wrapping
+	// round the end of the track) equal syncWord. Positions are added to the list in order.
+	void FindSyncWord(const uint8_t* encodedTrack, uint32_t bitLength, uint16_t syncWord, std::vector<uint32_t>& positions);
+
+	// Where a track is found in a disk image file.
+	struct TrackLayout
+	{
+		uint32_t offset = 0;		// into the image data
+		uint32_t size = 0;			// bytes of image data belonging to the track
+		uint32_t bitLength = 0;		// of the encoded track; 0 for an unformatted track
+		bool raw = false;			// the image holds the MFM encoded track rather than its sectors
+	};
+
+	// Works out where each track is in a disk image. This is either a plain ADF, which holds the
+	// sectors of each track in turn, or an extended ADF ("UAE-1ADF"), which has a table of tracks that
+	// may each be either sectors or a raw MFM bitstream (for custom formats and copy protection).
+	// Returns false if the image is an extended ADF with a broken table.
+	bool ReadTrackLayout(std::span<const uint8_t> data, std::array<TrackLayout, kTracksPerDisk>& layout);
+
+	// The MFM encoded form of a disk as seen by disk DMA. Raw tracks are used where they are in the
+	// image data. Sector tracks are encoded the first time they are accessed, into a buffer that only
+	// grows to hold the sector tracks of the disk, so inserting a disk costs nothing up front.
+	class DiskImage
+	{
+	public:
+		DiskImage()
+		{
+			m_slot.fill(-1);
+		}
+
+		// Forgets all encoded tracks and reads the layout of new image data. Returns false (leaving
+		// every track unformatted) if the data isn't a valid image.
+		bool Reset(std::span<const uint8_t> data);
+
+		// The encoded track, or null for an unformatted track.
+		const uint8_t* GetTrack(std::span<const uint8_t> data, int cylinder, int side)
+		{
+			const int track = cylinder * kTracksPerCylinder + side;
+			const auto& layout = m_layout[track];
+
+			if (layout.bitLength == 0)
+				return nullptr;
+
+			if (layout.raw)
+				return &data[layout.offset];
+
+			if (m_slot[track] < 0)
+			{
+				Encode(data, track);
+			}
+			return &m_buffer[size_t(m_slot[track]) * kMfmTrackSize];
+		}
+
+		// As GetTrack, but for writing to. The track is marked as modified. Raw tracks are written
+		// in the image data itself.
+		uint8_t* GetTrackForWriting(std::span<uint8_t> data, int cylinder, int side)
+		{
+			GetTrack(data, cylinder, side);
+			const int track = cylinder * kTracksPerCylinder + side;
+			m_modified.set(track);
+			m_syncIndex[track].clear();
+
+			const auto& layout = m_layout[track];
+			if (layout.bitLength == 0)
+				return nullptr;
+
+			if (layout.raw)
+				return &data[layout.offset];
+
+			return &m_buffer[size_t(m_slot[track]) * kMfmTrackSize];
+		}
+
+		uint32_t GetTrackBitLength(int cylinder, int side) const
+		{
+			return m_layout[cylinder * kTracksPerCylinder + side].bitLength;
+		}
+
+		const TrackLayout& GetTrackLayout(int track) const
+		{
+			return m_layout[track];
+		}
+
+		// Bit positions on the track at which syncWord is found, in order. Worked out the first time
+		// each sync word is looked for on a track and kept until the track changes. Empty if the
+		// track isn't on the disk.
+		std::span<const uint32_t> GetSyncPositions(std::span<const uint8_t> data, int cylinder, int side, uint16_t syncWord);
+
+		// Returns the tracks written to since the last call.
+		std::bitset<kTracksPerDisk> TakeModifiedTracks()
+		{
+			auto modified = m_modified;
+			m_modified.reset();
+			return modified;
+		}
+
+	private:
+		void Encode(std::span<const uint8_t> data, int track);
+
+		struct SyncIndex
+		{
+			uint16_t syncWord;
+			std::vector<uint32_t> positions;
+		};
+
+		std::array<TrackLayout, kTracksPerDisk> m_layout;
+		std::array<int16_t, kTracksPerDisk> m_slot;	// of each encoded track in m_buffer; -1 when not encoded
+		std::vector<uint8_t> m_buffer;
+		std::bitset<kTracksPerDisk> m_modified;
+		std::vector<SyncIndex> m_syncIndex[kTracksPerDisk];
+	};
 }
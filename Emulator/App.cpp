@@ -10,6 +10,12 @@
 #include "disk_image.h"
 #include "disk_activity.h"
 #include "log_viewer.h"
+#include "rom_image.h"
+#include "rewind_buffer.h"
+#include "boot_cache.h"
+#include "movie.h"
+#include "disk_writer.h"
+#include "disk_library.h"
 
 #include "util/file.h"
 #include "util/key_codes.h"
@@ -33,6 +39,12 @@ namespace
 	constexpr int PAL_CClockFreq = 3546895;
 	constexpr int NTSC_CClockFreq = 3579545;
 
+	constexpr double PAL_FrameRate = 50.0;
+
+	// Rewind captures a restore point every few frames and plays them back at twice normal speed.
+	constexpr int kRewindFramesPerRestorePoint = 5;
+	constexpr double kRewindSpeed = 2.0;
+
 	// Replicate some GLFW input constants here...
 	constexpr int GLFW_RELEASE = 0;
 	constexpr int GLFW_PRESS = 1;
@@ -47,6 +59,13 @@ namespace
 
 	using util::Key;
 
+	bool LoadReferencedDisk(const std::string& fileLocation, std::vector<uint8_t>& data)
+	{
+		auto [file, archFile] = util::SplitOn(fileLocation, "::");
+		std::string name;
+		return LoadDiskImage(std::filesystem::path(file), archFile, data, name);
+	}
+
 	struct AmigaKeyMap
 	{
 		Key key;
@@ -152,106 +171,6 @@ namespace
 		{ Key::KEY_RIGHT_SUPER,   0x67 },
 	};
 
-	constexpr char cloantoRomSig[] = "AMIROMTYPE1";
-	constexpr size_t cloantoRomSigLen = _countof(cloantoRomSig) - 1;
-
-	std::pair<bool, std::string> CheckRom(std::string_view romFile)
-	{
-		if (romFile.empty())
-		{
-			return { false, "No Rom File selected." };
-		}
-
-		std::filesystem::path file(romFile);
-		const auto displayFilename = file.filename().string();
-
-		if (!std::filesystem::exists(file))
-		{
-			return { false, "Rom file does not exist." };
-		}
-
-		auto size = std::filesystem::file_size(file);
-
-		if (size == 524'288)
-		{
-			// ok, assume unencrypted rom.
-			return { true, "File OK, unencrypted." };
-		}
-
-		if (size == 524'299)
-		{
-			std::vector<uint8_t> header;
-			if (!util::LoadBinaryHeader(std::string(romFile), header, cloantoRomSigLen))
-				return { false, "Rom file unaccessible." };
-
-			if (memcmp(header.data(), cloantoRomSig, cloantoRomSigLen) != 0)
-				return { false, "Rom file has unrecognised header." };
-
-			auto romkeyFile = file.parent_path() / "rom.key";
-			if (!std::filesystem::exists(romkeyFile))
-				return { false, "Rom encrypted but no rom.key file found." };
-
-			return { true, "File OK, encrypted." };
-		}
-
-		// Reject rom of any other size.
-		return { false, "Rom file was unexpected size (expected 512Kib)" };
-	}
-
-	std::vector<uint8_t> LoadRom(const std::string& romFile)
-	{
-		std::filesystem::path file(romFile);
-		const auto displayFilename = file.filename().string();
-
-		std::vector<uint8_t> rom;
-		if (!util::LoadBinaryFile(romFile, rom))
-		{
-			printf("ERROR: rom '%s' not loaded.\n", displayFilename.c_str());
-			return rom;
-		}
-
-		if (rom.size() < cloantoRomSigLen
-			|| memcmp(rom.data(), cloantoRomSig, cloantoRomSigLen) != 0)
-		{
-			printf("INFO : Rom file '%s' is unencrypted\n", displayFilename.c_str());
-			printf("INFO : Rom size %llu bytes.\n", rom.size());
-			return rom;
-		}
-
-		// It's a scrambled Cloanto rom file. Locate rom.key file to decrypt
-
-		auto romkeyFile = file.parent_path() / "rom.key";
-		std::vector<uint8_t> romkey;
-
-		if (!util::LoadBinaryFile(romkeyFile.string(), romkey))
-		{
-			printf("ERROR: rom '%s' was encypted but rom.key file not available (must be in same directory).\n", displayFilename.c_str());
-			return rom;
-		}
-
-		if (romkey.empty())
-		{
-			printf("ERROR: rom '%s' was encypted but rom.key file failed to load or was empty.\n", displayFilename.c_str());
-		}
-
-		size_t writePtr = 0;
-		size_t readPtr = cloantoRomSigLen;
-		size_t keyPtr = 0;
-
-		while (readPtr < rom.size())
-		{
-			rom[writePtr++] = rom[readPtr++] ^ romkey[keyPtr++];
-			if (keyPtr == romkey.size())
-				keyPtr = 0;
-		}
-
-		rom.resize(writePtr);
-
-		printf("INFO : Rom file '%s' successfully decrypted.\n", displayFilename.c_str());
-		printf("INFO : Rom size %llu bytes.\n", rom.size());
-		return rom;
-	}
-
 	class SettingsWindow : public guru::Dialog
 	{
 	public:
@@ -260,6 +179,8 @@ namespace
 			, m_feSettings(&feSettings)
 		{
 			strncpy_s(m_adfDirBuffer, m_appSettings->adfDir.data(), sizeof(m_adfDirBuffer));
+			strncpy_s(m_hardDiskBuffer, m_appSettings->hardDiskFile.data(), sizeof(m_hardDiskBuffer));
+			strncpy_s(m_hostDirBuffer, m_appSettings->hostDirectory.data(), sizeof(m_hostDirBuffer));
 
 			auto [romGood, why] = CheckRom(m_appSettings->romFile);
 			m_romFileStatusText = why;
@@ -295,6 +216,14 @@ namespace
 					}
 					ImGui::SliderFloat("Brightness Adjust", &m_feSettings->brightnessAdjust, 0.1f, 2.0f);
 
+					ImGui::SliderInt("Frame Skip", &m_appSettings->frameSkip, 0, 5);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("Number of frames to skip drawing after each drawn frame");
+
+					ImGui::SliderInt("Run Ahead", &m_appSettings->runAheadFrames, 0, 4);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("Show frames this far ahead of the emulation to reduce input lag.\nToo many frames and the game will skip.");
+
 					ImGui::EndTabItem();
 				}
 				if (ImGui::BeginTabItem("Dirs"))
@@ -334,6 +263,32 @@ namespace
 					ImGui::InputText("##RomFile", const_cast<char*>(m_appSettings->romFile.c_str()), m_appSettings->romFile.length(), ImGuiInputTextFlags_ReadOnly);
 					ImGui::SameLine();
 					ImGui::Text(m_romFileStatusText.c_str());
+
+					if (ActiveButton("Apply##HardDisk", m_hardDiskModified))
+					{
+						m_appSettings->hardDiskFile = m_hardDiskBuffer;
+						m_hardDiskModified = false;
+					}
+					ImGui::SameLine();
+					if (ImGui::InputText("Hard disk (HDF)", m_hardDiskBuffer, sizeof(m_hardDiskBuffer)))
+					{
+						m_hardDiskModified = true;
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("Attached to an A600/A1200 style IDE interface on the next reset.\nNeeds kickstart 2.05 or later.");
+
+					if (ActiveButton("Apply##HostDir", m_hostDirModified))
+					{
+						m_appSettings->hostDirectory = m_hostDirBuffer;
+						m_hostDirModified = false;
+					}
+					ImGui::SameLine();
+					if (ImGui::InputText("Host directory", m_hostDirBuffer, sizeof(m_hostDirBuffer)))
+					{
+						m_hostDirModified = true;
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("Mounted as the DOS device HOST: on the next reset.\nNeeds kickstart 1.3 or later.");
 				}
 				ImGui::EndTabBar();
 			}
@@ -362,8 +317,12 @@ namespace
 		guru::FrontEndSettings* m_feSettings;
 		std::unique_ptr<ImGui::FileBrowser> m_fileDialog;
 		char m_adfDirBuffer[256] = { '\0' };
+		char m_hardDiskBuffer[256] = { '\0' };
+		char m_hostDirBuffer[256] = { '\0' };
 		std::string m_romFileStatusText;
 		bool m_adfDirModified = false;
+		bool m_hardDiskModified = false;
+		bool m_hostDirModified = false;
 
 	};
 }
@@ -377,14 +336,26 @@ guru::AmigaApp::AmigaApp(const std::filesystem::path& programDir, const std::fil
 
 	m_amiga = std::make_unique<am::Amiga>(am::ChipRamConfig::ChipRam1Mib, &m_log);
 
+	UpdateDiskWriter(false);
+
 	if (!m_settings.romFile.empty())
 	{
-		const auto rom = LoadRom(m_settings.romFile);
-		m_amiga->SetRom(rom);
+		SetRomFromSettings();
+		SetHardDiskFromSettings();
+		SetHostDirectoryFromSettings();
+		FastBootIfEnabled();
 	}
 
 	m_symbols = std::make_unique<am::Symbols>();
 
+	// The catalogue is brought up to date in the background, and again whenever the ADF directory
+	// is changed.
+	m_diskLibrary = std::make_unique<DiskLibrary>(GetOrCreateLocalAppDir() / "disk library.bin");
+	m_diskLibraryDir = m_settings.adfDir;
+	m_diskLibrary->Scan(m_diskLibraryDir);
+
+	m_rewindBuffer = std::make_unique<RewindBuffer>(size_t(std::max(m_settings.rewindMemoryMb, 1)) << 20, kRewindFramesPerRestorePoint);
+
 	m_debugger = std::make_unique<Debugger>(this, m_amiga.get(), m_symbols.get());
 	m_ccDebugger = std::make_unique<CCDebugger>(this, m_amiga.get());
 	m_variableWatch = std::make_unique<VariableWatch>(m_amiga.get(), m_symbols.get());
@@ -413,6 +384,7 @@ guru::AmigaApp::~AmigaApp()
 
 void guru::AmigaApp::SetAudioPlayer(am::AudioPlayer* player)
 {
+	m_audioPlayer = player;
 	m_amiga->SetAudioPlayer(player);
 }
 
@@ -432,15 +404,197 @@ void guru::AmigaApp::SetRunning(bool running)
 
 void guru::AmigaApp::Reset()
 {
+	StopMovie();
+	m_rewindBuffer->Clear();
+
 	if (!m_settings.romFile.empty())
 	{
-		const auto rom = LoadRom(m_settings.romFile);
-		m_amiga->SetRom(rom);
+		SetRomFromSettings();
 	}
 	else
 	{
 		m_amiga->Reset();
 	}
+
+	SetHardDiskFromSettings();
+	SetHostDirectoryFromSettings();
+	FastBootIfEnabled();
+}
+
+void guru::AmigaApp::SetRomFromSettings()
+{
+	// Encrypted roms can't be mapped and are decrypted into memory instead.
+	if (auto mappedRom = MapRom(m_settings.romFile))
+	{
+		m_amiga->SetRom(std::move(mappedRom));
+	}
+	else
+	{
+		m_amiga->SetRom(LoadRom(m_settings.romFile));
+	}
+}
+
+void guru::AmigaApp::SetHardDiskFromSettings()
+{
+	// Only changed on a reset, as the kickstart looks for the drive as it boots.
+	if (m_settings.hardDiskFile == m_amiga->GetHardDiskFilename())
+		return;
+
+	m_amiga->RemoveHardDisk();
+
+	if (!m_settings.hardDiskFile.empty() && !m_amiga->SetHardDisk(m_settings.hardDiskFile))
+	{
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't open hard disk image : " + m_settings.hardDiskFile);
+	}
+}
+
+void guru::AmigaApp::SetHostDirectoryFromSettings()
+{
+	// Only changed on a reset, as the kickstart configures the expansion board as it boots.
+	if (m_settings.hostDirectory == m_amiga->GetHostDirectory())
+		return;
+
+	m_amiga->UnmountHostDirectory();
+
+	if (!m_settings.hostDirectory.empty() && !m_amiga->MountHostDirectory(m_settings.hostDirectory))
+	{
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't find host directory : " + m_settings.hostDirectory);
+	}
+}
+
+void guru::AmigaApp::FastBootIfEnabled()
+{
+	if (m_settings.fastBoot)
+	{
+		FastBoot(*m_amiga, GetOrCreateLocalAppDir() / "boot cache");
+	}
+}
+
+void guru::AmigaApp::StartMovieRecording(const std::filesystem::path& file)
+{
+	if (HasHardDisk())
+	{
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't record a movie while a hard disk is attached");
+		return;
+	}
+
+	StopMovie();
+	UpdateDiskWriter(true);
+	UpdateDiskProtection();
+
+	auto recorder = std::make_unique<MovieRecorder>();
+	if (recorder->Start(*m_amiga, file))
+	{
+		m_movieRecorder = std::move(recorder);
+	}
+	else
+	{
+		UpdateDiskWriter(false);
+	}
+}
+
+void guru::AmigaApp::PlayMovie(const std::filesystem::path& file)
+{
+	if (HasHardDisk())
+	{
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't play a movie while a hard disk is attached");
+		return;
+	}
+
+	StopMovie();
+	UpdateDiskWriter(true);
+
+	auto player = std::make_unique<MoviePlayer>();
+	if (!player->Open(*m_amiga, file, LoadReferencedDisk))
+	{
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't play movie : " + player->GetError());
+		UpdateDiskWriter(false);
+		return;
+	}
+
+	m_moviePlayer = std::move(player);
+	m_rewindBuffer->Clear();
+	m_debugger->Refresh();
+}
+
+bool guru::AmigaApp::HasHardDisk() const
+{
+	// The hard disk image isn't part of the saved state, so putting the machine back to an earlier
+	// state would leave the disk ahead of it, and the filesystem's next write would corrupt the
+	// image. Rewind, snapshots and movies are all unavailable while one is attached.
+	return !m_amiga->GetHardDiskFilename().empty();
+}
+
+void guru::AmigaApp::StopMovie()
+{
+	m_movieRecorder.reset();
+	m_moviePlayer.reset();
+	UpdateDiskWriter(false);
+}
+
+void guru::AmigaApp::UpdateDiskProtection()
+{
+	if (m_diskWriter)
+	{
+		for (const auto& file : m_diskWriter->TakeFailures())
+		{
+			m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't save disk writes to " + file.string());
+
+			// Protect the disk from now on, so its next write fails where the guest can see it.
+			for (int i = 0; i < 4; i++)
+			{
+				const auto& fileLocation = m_amiga->GetDiskFilename(i);
+				if (!fileLocation.empty() && (file == fileLocation || file == GetDiskOverlayPath(fileLocation)))
+				{
+					m_diskCanSave[i] = false;
+				}
+			}
+		}
+	}
+
+	// A movie plays back with the write protection it was recorded with.
+	if (m_moviePlayer)
+		return;
+
+	// A disk is only writable if what is written to it can be saved.
+	for (int i = 0; i < 4; i++)
+	{
+		const auto& fileLocation = m_amiga->GetDiskFilename(i);
+		if (fileLocation != m_diskSaveChecked[i])
+		{
+			m_diskSaveChecked[i] = fileLocation;
+			m_diskCanSave[i] = !fileLocation.empty() && CanSaveDisk(fileLocation);
+		}
+
+		m_amiga->SetDiskWriteProtected(i, !m_diskWriter || !m_diskCanSave[i]);
+	}
+}
+
+bool guru::AmigaApp::HasWritableDisk() const
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (!m_amiga->IsDiskWriteProtected(i))
+			return true;
+	}
+	return false;
+}
+
+void guru::AmigaApp::UpdateDiskWriter(bool movieActive)
+{
+	// The writes are held back rather than saved during a movie: it refers to disk files by their
+	// contents, so they mustn't change under it, and a replay shouldn't write to the user's disks
+	// at all.
+	if (m_settings.saveDiskWrites != (m_diskWriter != nullptr))
+	{
+		m_diskWriter = m_settings.saveDiskWrites ? std::make_unique<DiskWriter>() : nullptr;
+		m_amiga->SetDiskWriteHandler(m_diskWriter.get());
+	}
+
+	if (m_diskWriter)
+	{
+		m_diskWriter->SetHoldingWrites(movieActive);
+	}
 }
 
 bool guru::AmigaApp::SetDiskImage(int drive, std::string& pathToImage)
@@ -464,6 +618,12 @@ bool guru::AmigaApp::SetDiskImage(int drive, std::string& pathToImage)
 
 bool guru::AmigaApp::Update()
 {
+	if (m_settings.adfDir != m_diskLibraryDir)
+	{
+		m_diskLibraryDir = m_settings.adfDir;
+		m_diskLibrary->Scan(m_diskLibraryDir);
+	}
+
 	if (m_isStarting)
 	{
 		m_last = std::chrono::high_resolution_clock::now();
@@ -472,6 +632,12 @@ bool guru::AmigaApp::Update()
 	else if (m_isRunning)
 	{
 		m_joystickState.buttons |= m_emulatedJoystickState.buttons;
+		if (m_moviePlayer)
+		{
+			// The movie supplies the input; keep the joystick state current so nothing is
+			// sent as a change when playback ends.
+			m_oldJoystickState = m_joystickState;
+		}
 
 		const auto buttonsDiff = m_joystickState.buttons ^ m_oldJoystickState.buttons;
 
@@ -487,6 +653,22 @@ bool guru::AmigaApp::Update()
 
 		m_oldJoystickState = m_joystickState;
 
+		m_amiga->SetFrameSkip(m_settings.frameSkip);
+
+		// A movie plays back with the setting it was recorded with, and the header only holds the
+		// one setting, so it can't change while recording either.
+		if (!m_moviePlayer && !m_movieRecorder)
+		{
+			m_amiga->SetTurboFloppy(m_settings.turboFloppy);
+		}
+
+		UpdateDiskWriter(m_movieRecorder || m_moviePlayer);
+		UpdateDiskProtection();
+
+		// Disk contents aren't part of the saved state either, so a disk that can be written to
+		// would be left ahead of the machine by rewinding too.
+		const bool rewindEnabled = m_settings.rewindEnabled && !HasHardDisk() && !HasWritableDisk();
+
 		auto now = std::chrono::high_resolution_clock::now();
 
 		std::chrono::duration<double> diff = now - m_last;
@@ -494,14 +676,78 @@ bool guru::AmigaApp::Update()
 
 		if (diff < std::chrono::duration < double>(0.5))
 		{
-			const int cclks = int(std::round((diff * PAL_CClockFreq).count()));
-			m_isRunning = m_amiga->ExecuteFor(cclks);
+			if (m_rewinding && rewindEnabled && !m_moviePlayer)
+			{
+				// The recorded input no longer follows on from the rewound state.
+				m_movieRecorder.reset();
+				Rewind(diff.count());
+			}
+			else
+			{
+				const int cclks = int(std::round((diff * PAL_CClockFreq).count()));
+				if (m_moviePlayer)
+				{
+					m_isRunning = m_moviePlayer->ExecuteFor(cclks);
+					if (m_moviePlayer->IsFinished())
+					{
+						m_moviePlayer.reset();
+					}
+				}
+				else
+				{
+					m_isRunning = m_amiga->ExecuteFor(cclks);
+				}
+
+				if (rewindEnabled)
+				{
+					m_rewindBuffer->Update(*m_amiga);
+				}
+
+				// Once a new frame has started, show the one the current input will lead to
+				// instead of the one just finished.
+				if (m_isRunning && m_settings.runAheadFrames > 0 && m_amiga->GetFrameCount() != m_runAheadFrame)
+				{
+					m_amiga->RunAhead(m_settings.runAheadFrames);
+					m_runAheadFrame = m_amiga->GetFrameCount();
+				}
+			}
+		}
+
+		if (!rewindEnabled && !m_rewindBuffer->IsEmpty())
+		{
+			m_rewindBuffer->Clear();
 		}
 	}
 
 	return !m_isQuitting;
 }
 
+void guru::AmigaApp::Rewind(double seconds)
+{
+	m_rewindFrames += seconds * PAL_FrameRate * kRewindSpeed;
+
+	bool stepped = false;
+	while (m_rewindFrames >= kRewindFramesPerRestorePoint)
+	{
+		if (!m_rewindBuffer->StepBack(*m_amiga))
+		{
+			m_rewindFrames = 0.0;
+			break;
+		}
+		m_rewindFrames -= kRewindFramesPerRestorePoint;
+		stepped = true;
+	}
+
+	if (stepped)
+	{
+		// Screen contents aren't part of the saved state, so run a frame (without sound) to show
+		// where we have got back to.
+		m_amiga->SetAudioPlayer(nullptr);
+		m_amiga->ExecuteFrame();
+		m_amiga->SetAudioPlayer(m_audioPlayer);
+	}
+}
+
 void guru::AmigaApp::Render(int displayWidth, int displayHeight)
 {
 	ImGui::PushFont(m_feSettings.highDPI ? m_highDpiFont : m_lowDpiFont);
@@ -566,7 +812,48 @@ void guru::AmigaApp::Render(int displayWidth, int displayHeight)
 			{
 				auto path = GetOrCreateLocalAppDir();
 				path /= "snap.bin";
-				SaveSnapshot(path);
+				SaveSnapshot(path, false);
+			}
+
+			if (ImGui::MenuItem("Quick Save Snapshot With Disks", ""))
+			{
+				auto path = GetOrCreateLocalAppDir();
+				path /= "snap.bin";
+				SaveSnapshot(path, true);
+			}
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Store the inserted disk images in the snapshot rather than referring to their files");
+
+			ImGui::Separator();
+
+			if (ImGui::MenuItem("Record Movie", "", m_movieRecorder != nullptr))
+			{
+				if (m_movieRecorder)
+				{
+					StopMovie();
+				}
+				else
+				{
+					auto path = GetOrCreateLocalAppDir();
+					path /= "movie.gmv";
+					StartMovieRecording(path);
+				}
+			}
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Record all input from now on so the session can be replayed exactly");
+
+			if (ImGui::MenuItem("Play Movie", "", m_moviePlayer != nullptr))
+			{
+				if (m_moviePlayer)
+				{
+					StopMovie();
+				}
+				else
+				{
+					auto path = GetLocalAppDir();
+					path /= "movie.gmv";
+					PlayMovie(path);
+				}
 			}
 
 			ImGui::Separator();
@@ -589,6 +876,22 @@ void guru::AmigaApp::Render(int displayWidth, int displayHeight)
 			if (ImGui::IsItemHovered())
 				ImGui::SetTooltip("Arrow keys + ctrl simulate joystick input");
 
+			ImGui::MenuItem("Fast Boot", "", &m_settings.fastBoot);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Skip the start of the Kickstart boot on reset using a cached state");
+
+			ImGui::MenuItem("Turbo Floppy", "", &m_settings.turboFloppy, !m_moviePlayer && !m_movieRecorder);
+			if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+				ImGui::SetTooltip("Load from floppy disks much faster. A few disks with custom loaders may not work with this.\nThis can't be changed while a movie is recording or playing");
+
+			ImGui::MenuItem("Save Disk Writes", "", &m_settings.saveDiskWrites);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Let the Amiga write to floppy disks and save the changes to the disk image files.\nDisks are write protected when this is off.\nDisks whose files can't be written to stay write protected.\nWhile a movie is recording, the changes aren't saved, and a movie plays back with the write protection it was recorded with");
+
+			ImGui::MenuItem("Rewind", "F12", &m_settings.rewindEnabled);
+			if (ImGui::IsItemHovered())
+				ImGui::SetTooltip("Keep a history of recent states. Hold F12 to go back in time.\nNot available while a hard disk is attached or a floppy disk can be written to");
+
 			if (ImGui::MenuItem("Fullscreen/Windowed", "", m_feSettings.fullScreen))
 			{
 				m_feSettings.fullScreen = !m_feSettings.fullScreen;
@@ -672,6 +975,17 @@ bool guru::AmigaApp::SetKey(int key, int action, int mods)
 		return true;
 	}
 
+	if (Key(key) == Key::KEY_F12)
+	{
+		// Hold F12 to rewind. The Amiga keyboard has no F12 so it works in either input mode.
+		if (action == GLFW_PRESS || action == GLFW_RELEASE)
+		{
+			m_rewinding = (action == GLFW_PRESS);
+			m_rewindFrames = 0.0;
+		}
+		return true;
+	}
+
 	if (m_inputMode == InputMode::GuiHasFocus)
 	{
 		if (Key(key) == Key::KEY_F1)
@@ -735,11 +1049,17 @@ void guru::AmigaApp::SetMouseButton(int button, int action, int mods)
 	if (button < 0 || button > 2)
 		return;
 
+	if (m_moviePlayer)
+		return;
+
 	m_amiga->SetControllerButton(0, button, (action == GLFW_PRESS));
 }
 
 void guru::AmigaApp::SetMouseMove(double xMove, double yMove)
 {
+	if (m_moviePlayer)
+		return;
+
 	m_amiga->SetMouseMove(int(std::floor(xMove / 2)), int(std::floor(yMove / 2)));
 }
 
@@ -748,6 +1068,9 @@ void guru::AmigaApp::ConvertAndSendKeyCode(util::Key key, bool down)
 	if (!m_isRunning && down == true)
 		return; // do not queue new key presses while the emulator is paused
 
+	if (m_moviePlayer)
+		return;
+
 	auto it = m_keyMap.find(key);
 	if (it == m_keyMap.end())
 		return;
@@ -777,40 +1100,38 @@ std::filesystem::path guru::AmigaApp::GetOrCreateLocalAppDir()
 
 void guru::AmigaApp::LoadSnapshot(const std::filesystem::path& file)
 {
+	if (HasHardDisk())
+	{
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Can't load a snapshot while a hard disk is attached");
+		return;
+	}
+
 	std::ifstream ifile(file, std::ios::binary);
 	if (!ifile.is_open())
 		return;
 
-	if (!m_amiga->ReadSnapshot(ifile))
+	std::vector<std::string> missingDisks;
+	if (!m_amiga->ReadSnapshot(ifile, LoadReferencedDisk, &missingDisks))
 		return;
 
-	for (int i = 0; i < 4; i++)
+	for (const auto& fileLocation : missingDisks)
 	{
-		std::string fileLocation;
-		util::StreamString(ifile, fileLocation);
-
-		if (fileLocation != m_amiga->GetDiskFilename(i))
-		{
-			SetDiskImage(i, fileLocation);
-		}
+		m_log.AddMessage(m_amiga->GetTotalCClocks(), "Snapshot disk is missing or has changed : " + fileLocation);
 	}
 
+	StopMovie();
+	m_rewindBuffer->Clear();
+
 	m_debugger->Refresh();
 }
 
-void guru::AmigaApp::SaveSnapshot(const std::filesystem::path& file)
+void guru::AmigaApp::SaveSnapshot(const std::filesystem::path& file, bool embedDisks)
 {
 	std::ofstream ofile(file, std::ios::out | std::ios::binary);
 	if (!ofile.is_open())
 		return;
 
-	m_amiga->WriteSnapshot(ofile);
-
-	for (int i = 0; i < 4; i++)
-	{
-		util::StreamString(ofile, m_amiga->GetDiskFilename(i));
-	}
-
+	m_amiga->WriteSnapshot(ofile, embedDisks);
 }
 
 void guru::AmigaApp::OpenMemoryEditor()
@@ -843,6 +1164,31 @@ void guru::AmigaApp::LoadSettings()
 		{
 			m_settings.romFile = romFile.value();
 		}
+
+		if (auto hardDiskFile = GetStringKey(systemSection, "hardDisk"))
+		{
+			m_settings.hardDiskFile = hardDiskFile.value();
+		}
+
+		if (auto hostDirectory = GetStringKey(systemSection, "hostDirectory"))
+		{
+			m_settings.hostDirectory = hostDirectory.value();
+		}
+
+		if (auto fastBoot = GetBoolKey(systemSection, "fastBoot"))
+		{
+			m_settings.fastBoot = fastBoot.value();
+		}
+
+		if (auto turboFloppy = GetBoolKey(systemSection, "turboFloppy"))
+		{
+			m_settings.turboFloppy = turboFloppy.value();
+		}
+
+		if (auto saveDiskWrites = GetBoolKey(systemSection, "saveDiskWrites"))
+		{
+			m_settings.saveDiskWrites = saveDiskWrites.value();
+		}
 	}
 
 	{
@@ -874,6 +1220,16 @@ void guru::AmigaApp::LoadSettings()
 		{
 			m_feSettings.brightnessAdjust = float(brightnessAdjust.value());
 		}
+
+		if (auto frameSkip = GetIntKey(displaySection, "frameSkip"))
+		{
+			m_settings.frameSkip = int(frameSkip.value());
+		}
+
+		if (auto runAheadFrames = GetIntKey(displaySection, "runAheadFrames"))
+		{
+			m_settings.runAheadFrames = int(runAheadFrames.value());
+		}
 	}
 
 	{
@@ -892,6 +1248,19 @@ void guru::AmigaApp::LoadSettings()
 		}
 	}
 
+	{
+		auto rewindSection = GetSection(ini, "Rewind");
+		if (auto enabled = GetBoolKey(rewindSection, "enabled"))
+		{
+			m_settings.rewindEnabled = enabled.value();
+		}
+
+		if (auto memoryMb = GetIntKey(rewindSection, "memoryMb"))
+		{
+			m_settings.rewindMemoryMb = int(memoryMb.value());
+		}
+	}
+
 }
 
 void guru::AmigaApp::SaveSettings()
@@ -900,6 +1269,11 @@ void guru::AmigaApp::SaveSettings()
 	{
 		auto& systemSection = ini.m_sections["System"];
 		SetStringKey(systemSection, "rom", m_settings.romFile);
+		SetStringKey(systemSection, "hardDisk", m_settings.hardDiskFile);
+		SetStringKey(systemSection, "hostDirectory", m_settings.hostDirectory);
+		SetBoolKey(systemSection, "fastBoot", m_settings.fastBoot);
+		SetBoolKey(systemSection, "turboFloppy", m_settings.turboFloppy);
+		SetBoolKey(systemSection, "saveDiskWrites", m_settings.saveDiskWrites);
 	}
 
 	{
@@ -913,6 +1287,8 @@ void guru::AmigaApp::SaveSettings()
 		SetFloatKey(displaySection, "crtWarpX", m_feSettings.crtWarpX);
 		SetFloatKey(displaySection, "crtWarpY", m_feSettings.crtWarpY);
 		SetFloatKey(displaySection, "brightnessAdjust", m_feSettings.brightnessAdjust);
+		SetIntKey(displaySection, "frameSkip", m_settings.frameSkip);
+		SetIntKey(displaySection, "runAheadFrames", m_settings.runAheadFrames);
 	}
 	{
 		auto& directoriesSection = ini.m_sections["Directories"];
@@ -924,6 +1300,12 @@ void guru::AmigaApp::SaveSettings()
 		SetBoolKey(inputSection, "joystickEmulation", m_settings.joystickEmulation);
 	}
 
+	{
+		auto& rewindSection = ini.m_sections["Rewind"];
+		SetBoolKey(rewindSection, "enabled", m_settings.rewindEnabled);
+		SetIntKey(rewindSection, "memoryMb", m_settings.rewindMemoryMb);
+	}
+
 	auto appDir = GetOrCreateLocalAppDir();
 	util::SaveIniFile(ini, appDir / "guru.ini");
 }
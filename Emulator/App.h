@@ -5,6 +5,7 @@
 
 #include "util/log.h"
 
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
@@ -34,6 +35,11 @@ namespace guru
 	class DiskManager;
 	class LogViewer;
 	class DiskActivity;
+	class RewindBuffer;
+	class MovieRecorder;
+	class MoviePlayer;
+	class DiskWriter;
+	class DiskLibrary;
 
 	struct JoystickState
 	{
@@ -45,8 +51,17 @@ namespace guru
 	struct AppSettings
 	{
 		bool joystickEmulation = false;
+		bool fastBoot = false;
+		bool turboFloppy = false;
+		bool saveDiskWrites = false;
+		int frameSkip = 0;
+		int runAheadFrames = 0;
+		bool rewindEnabled = false;
+		int rewindMemoryMb = 64;
 		std::string adfDir;
 		std::string romFile;
+		std::string hardDiskFile;
+		std::string hostDirectory;
 	};
 
 	struct FrontEndSettings
@@ -95,6 +110,11 @@ namespace guru
 			return m_settings;
 		}
 
+		const DiskLibrary* GetDiskLibrary() const
+		{
+			return m_diskLibrary.get();
+		}
+
 		bool SetKey(int key, int action, int mods);
 		void SetMouseButton(int button, int action, int mods);
 		void SetMouseMove(double xMove, double yMove);
@@ -129,10 +149,25 @@ namespace guru
 		void ConvertAndSendKeyCode(util::Key key, bool down);
 
 		void LoadSnapshot(const std::filesystem::path& file);
-		void SaveSnapshot(const std::filesystem::path& file);
+		void SaveSnapshot(const std::filesystem::path& file, bool embedDisks);
 
 		void OpenMemoryEditor();
 
+		void Rewind(double seconds);
+
+		void SetRomFromSettings();
+		void SetHardDiskFromSettings();
+		void SetHostDirectoryFromSettings();
+		void FastBootIfEnabled();
+
+		void StartMovieRecording(const std::filesystem::path& file);
+		void PlayMovie(const std::filesystem::path& file);
+		void StopMovie();
+		bool HasHardDisk() const;
+		void UpdateDiskWriter(bool movieActive);
+		void UpdateDiskProtection();
+		bool HasWritableDisk() const;
+
 		void LoadSettings();
 		void SaveSettings();
 
@@ -152,6 +187,9 @@ namespace guru
 
 		std::chrono::steady_clock::time_point m_last;
 
+		std::unique_ptr<DiskWriter> m_diskWriter;
+		std::array<std::string, 4> m_diskSaveChecked;
+		std::array<bool, 4> m_diskCanSave = {};
 		std::unique_ptr<am::Amiga> m_amiga;
 
 		std::unique_ptr<Debugger> m_debugger;
@@ -159,12 +197,25 @@ namespace guru
 		std::unique_ptr<VariableWatch> m_variableWatch;
 		std::unique_ptr<MemoryEditor> m_memoryEditor;
 		std::unique_ptr<DiskManager> m_diskManager;
+		std::unique_ptr<DiskLibrary> m_diskLibrary;
+		std::string m_diskLibraryDir;
 		std::unique_ptr<DiskActivity> m_diskActivity;
 		std::unique_ptr<LogViewer> m_logViewer;
 		std::unique_ptr<Dialog> m_displayOptionsWindows;
 
 		std::unique_ptr<am::Symbols> m_symbols;
 
+		std::unique_ptr<RewindBuffer> m_rewindBuffer;
+		bool m_rewinding = false;
+		double m_rewindFrames = 0.0;
+
+		uint64_t m_runAheadFrame = 0;
+
+		std::unique_ptr<MovieRecorder> m_movieRecorder;
+		std::unique_ptr<MoviePlayer> m_moviePlayer;
+
+		am::AudioPlayer* m_audioPlayer = nullptr;
+
 		enum class InputMode
 		{
 			EmulatorHasFocus,
@@ -8,21 +8,23 @@ void guru::OpenAlPlayer::Setup()
 		m_context = alcCreateContext(m_device, 0);
 		alcMakeContextCurrent(m_context);
 
-		for (int i = 0; i < audio::kNumOfStereoSources; i++)
+		ALCint frequency = 0;
+		alcGetIntegerv(m_device, ALC_FREQUENCY, 1, &frequency);
+		if (frequency > 0)
 		{
-			auto& channel = m_channel[i];
-			alGenBuffers(ALsizei(channel.buffers.size()), channel.buffers.data());
+			m_playbackFrequency = frequency;
 		}
 
-		alGenSources(audio::kNumOfStereoSources, m_source.data());
+		alGenBuffers(ALsizei(m_buffers.size()), m_buffers.data());
+
+		alGenSources(1, &m_source);
 		if (alGetError() == AL_NO_ERROR)
 		{
 			m_soundEnabled = true;
 		}
 
-		float newVolume = 0.1f;
-		alSourcef(m_source[0], AL_GAIN, newVolume);
-		alSourcef(m_source[1], AL_GAIN, newVolume);
+		float newVolume = 0.2f;
+		alSourcef(m_source, AL_GAIN, newVolume);
 	}
 }
 
@@ -30,13 +32,8 @@ void guru::OpenAlPlayer::Shutdown()
 {
 	if (m_context)
 	{
-		alDeleteSources(audio::kNumOfStereoSources, m_source.data());
-
-		for (int i = 0; i < audio::kNumOfStereoSources; i++)
-		{
-			auto& channel = m_channel[i];
-			alDeleteBuffers(ALsizei(channel.buffers.size()), channel.buffers.data());
-		}
+		alDeleteSources(1, &m_source);
+		alDeleteBuffers(ALsizei(m_buffers.size()), m_buffers.data());
 
 		alcMakeContextCurrent(0);
 		alcDestroyContext(m_context);
@@ -52,78 +49,75 @@ void guru::OpenAlPlayer::Shutdown()
 
 void guru::OpenAlPlayer::AddAudioBuffer(const am::AudioBuffer* buffer)
 {
-	for (int s = 0; s < audio::kNumOfStereoSources; s++)
-	{
-		auto& source = m_source[s];
-		auto& audioChannel = m_channel[s];
+	const auto* data = buffer->data();
+	const auto size = ALsizei(buffer->size() * sizeof(int16_t));
 
-		ALint playing;
-		alGetSourcei(source, AL_SOURCE_STATE, &playing);
-		if (playing != AL_PLAYING)
+	ALint playing;
+	alGetSourcei(m_source, AL_SOURCE_STATE, &playing);
+	if (playing != AL_PLAYING)
+	{
+		if (m_playing)
 		{
-			if (audioChannel.playing)
-			{
-				printf("Audio stalled... rebuffering...\n");
-				alSourcei(source, AL_BUFFER, 0); // unqueue all buffers
-				audioChannel.playing = false;
-			}
+			printf("Audio stalled... rebuffering...\n");
+			alSourcei(m_source, AL_BUFFER, 0); // unqueue all buffers
+			m_playing = false;
+		}
 
-			ALint buffersQueued;
-			alGetSourcei(source, AL_BUFFERS_QUEUED, &buffersQueued);
+		ALint buffersQueued;
+		alGetSourcei(m_source, AL_BUFFERS_QUEUED, &buffersQueued);
 
-			if (buffersQueued < audio::kNumBuffers)
-			{
-				alBufferData(audioChannel.buffers[buffersQueued], AL_FORMAT_STEREO8, (*buffer)[s].data(), am::kAudioBufferLength * 2, audio::kPlaybackFrequency);
-				ALenum error = alGetError();
-				if (error != AL_NO_ERROR)
-					__debugbreak();
+		if (buffersQueued < audio::kNumBuffers)
+		{
+			alBufferData(m_buffers[buffersQueued], AL_FORMAT_STEREO16, data, size, m_playbackFrequency);
+			ALenum error = alGetError();
+			if (error != AL_NO_ERROR)
+				__debugbreak();
 
-				alSourceQueueBuffers(source, 1, &audioChannel.buffers[buffersQueued]);
-				error = alGetError();
-				if (error != AL_NO_ERROR)
-					__debugbreak();
+			alSourceQueueBuffers(m_source, 1, &m_buffers[buffersQueued]);
+			error = alGetError();
+			if (error != AL_NO_ERROR)
+				__debugbreak();
 
-				buffersQueued++;
-			}
+			buffersQueued++;
+		}
 
-			if (buffersQueued == audio::kMinBuffersToStartPlayback)
-			{
-				// All buffers full - Restart playing.
-				alSourcePlay(source);
-				audioChannel.playing = true;
-			}
+		if (buffersQueued == audio::kMinBuffersToStartPlayback)
+		{
+			// All buffers full - Restart playing.
+			alSourcePlay(m_source);
+			m_playing = true;
+		}
+	}
+	else
+	{
+		ALint bufferProcessed;
+		alGetSourcei(m_source, AL_BUFFERS_PROCESSED, &bufferProcessed);
+		if (bufferProcessed > 0)
+		{
+			ALuint alBuffer;
+			alSourceUnqueueBuffers(m_source, 1, &alBuffer);
+			alBufferData(alBuffer, AL_FORMAT_STEREO16, data, size, m_playbackFrequency);
+
+			alSourceQueueBuffers(m_source, 1, &alBuffer);
+			ALenum error = alGetError();
+			if (error != AL_NO_ERROR)
+				__debugbreak();
 		}
 		else
 		{
-			ALint bufferProcessed;
-			alGetSourcei(source, AL_BUFFERS_PROCESSED, &bufferProcessed);
-			if (bufferProcessed > 0)
+			ALint buffersQueued;
+			alGetSourcei(m_source, AL_BUFFERS_QUEUED, &buffersQueued);
+
+
+			if (buffersQueued < audio::kNumBuffers)
 			{
-				ALuint alBuffer;
-				alSourceUnqueueBuffers(source, 1, &alBuffer);
-				alBufferData(alBuffer, AL_FORMAT_STEREO8, (*buffer)[s].data(), am::kAudioBufferLength * 2, audio::kPlaybackFrequency);
-
-				alSourceQueueBuffers(source, 1, &alBuffer);
-				ALenum error = alGetError();
-				if (error != AL_NO_ERROR)
-					__debugbreak();
+				alBufferData(m_buffers[buffersQueued], AL_FORMAT_STEREO16, data, size, m_playbackFrequency);
+				alSourceQueueBuffers(m_source, 1, &m_buffers[buffersQueued]);
 			}
 			else
 			{
-				ALint buffersQueued;
-				alGetSourcei(source, AL_BUFFERS_QUEUED, &buffersQueued);
-
-
-				if (buffersQueued < audio::kNumBuffers)
-				{
-					alBufferData(audioChannel.buffers[buffersQueued], AL_FORMAT_STEREO8, (*buffer)[s].data(), am::kAudioBufferLength * 2, audio::kPlaybackFrequency);
-					alSourceQueueBuffers(source, 1, &audioChannel.buffers[buffersQueued]);
-				}
-				else
-				{
-					// No buffers have finished processing!
-					printf("Buffer full - audio dropped!\n");
-				}
+				// No buffers have finished processing!
+				printf("Buffer full - audio dropped!\n");
 			}
 		}
 	}
@@ -11,10 +11,8 @@ namespace guru
 {
 	namespace audio
 	{
-		constexpr int kNumOfStereoSources = 2;
 		constexpr int kNumBuffers = 8;
 		constexpr int kMinBuffersToStartPlayback = 6;
-		constexpr int kPlaybackFrequency = 35469;
 	}
 
 	class OpenAlPlayer : public am::AudioPlayer
@@ -24,18 +22,20 @@ namespace guru
 		void Shutdown();
 		virtual void AddAudioBuffer(const am::AudioBuffer* buffer) override;
 
-	private:
-
-		struct AudioChannel
+		// The device's own rate, so OpenAL has no resampling of its own to do.
+		virtual int GetSampleRate() const override
 		{
-			std::array<ALuint, audio::kNumBuffers> buffers;
-			bool playing = false;
-		};
+			return m_playbackFrequency;
+		}
+
+	private:
 		ALCdevice* m_device = nullptr;
 		ALCcontext* m_context = nullptr;
 
-		std::array<ALuint, 2> m_source;
-		std::array<AudioChannel, 2> m_channel;
+		ALuint m_source = 0;
+		std::array<ALuint, audio::kNumBuffers> m_buffers;
+		bool m_playing = false;
+		int m_playbackFrequency = am::kDefaultAudioSampleRate;
 
 		bool m_soundEnabled = false;
 	};
@@ -0,0 +1,75 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+
+guru::BatchRunner::BatchRunner(int numThreads)
+{
+	if (numThreads <= 0)
+	{
+		numThreads = std::max(int(std::thread::hardware_concurrency()), 1);
+	}
+
+	m_workers.reserve(numThreads);
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_workers.emplace_back(&BatchRunner::WorkerLoop, this);
+	}
+}
+
+guru::BatchRunner::~BatchRunner()
+{
+	Wait();
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobQueued.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void guru::BatchRunner::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_jobQueued.notify_one();
+}
+
+void guru::BatchRunner::Wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_jobsFinished.wait(lock, [this]() { return m_jobs.empty() && m_jobsRunning == 0; });
+}
+
+void guru::BatchRunner::WorkerLoop()
+{
+	std::unique_lock lock(m_mutex);
+
+	for (;;)
+	{
+		m_jobQueued.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+
+		if (m_jobs.empty())
+			return;
+
+		auto job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		m_jobsRunning++;
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		m_jobsRunning--;
+		if (m_jobs.empty() && m_jobsRunning == 0)
+		{
+			m_jobsFinished.notify_all();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace guru
+{
+	/// A pool of worker threads for running many emulations side by side, e.g. batch
+	/// compatibility or regression runs.
+	///
+	/// The core keeps no mutable global state, so any number of am::Amiga instances can run at
+	/// once provided each is only used from one thread at a time. A job should create (or be
+	/// handed) its own instance, along with its own util::Log, and run it to completion.
+	class BatchRunner
+	{
+	public:
+		/// A numThreads of 0 uses one worker per hardware thread.
+		explicit BatchRunner(int numThreads = 0);
+		~BatchRunner();
+
+		BatchRunner(const BatchRunner&) = delete;
+		BatchRunner& operator=(const BatchRunner&) = delete;
+
+		/// Queues a job to be run on the next free worker.
+		void Submit(std::function<void()> job);
+
+		/// Blocks until every submitted job has finished.
+		void Wait();
+
+		int GetNumThreads() const
+		{
+			return int(m_workers.size());
+		}
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobQueued;
+		std::condition_variable m_jobsFinished;
+		int m_jobsRunning = 0;
+		bool m_stopping = false;
+	};
+}
\ No newline at end of file
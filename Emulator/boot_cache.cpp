@@ -0,0 +1,132 @@
+#include "boot_cache.h"
+
+#include "util/hash.h"
+
+#include <fstream>
+#include <cstdio>
+
+namespace
+{
+	// Give up looking for the first drive access after this long.
+	constexpr uint64_t kMaxBootCClocks = 3546895 * 30;
+
+	// Bump if the way the boot point is chosen changes, so old cache files are not used.
+	constexpr uint32_t kBootCacheVersion = 1;
+
+	uint64_t BootKey(const am::Amiga& amiga)
+	{
+		const uint32_t config[] = {
+			kBootCacheVersion,
+			uint32_t(amiga.GetChipRamConfig()),
+			uint32_t(amiga.GetAgnusVersion()),
+		};
+
+		auto hash = util::Fnv1a64(amiga.GetRom());
+		return util::Fnv1a64({ reinterpret_cast<const uint8_t*>(config), sizeof(config) }, hash);
+	}
+
+	enum class CreateResult
+	{
+		Ok,
+		NoDriveAccess,
+		Failed,
+	};
+
+	// Boots a copy of the machine up to the first drive access and saves it to file.
+	CreateResult CreateBootState(const am::Amiga& amiga, const std::filesystem::path& file)
+	{
+		util::Log log(16);
+		am::Amiga scratch(amiga.GetChipRamConfig(), &log);
+
+		const std::vector<uint8_t> rom(amiga.GetRom().begin(), amiga.GetRom().end());
+
+		// First find out when the drive is accessed ...
+		scratch.SetRom(rom);
+		while (scratch.GetFirstDriveSelectCClock() == 0 && scratch.GetTotalCClocks() < kMaxBootCClocks)
+		{
+			if (!scratch.ExecuteFrame())
+				return CreateResult::Failed;
+		}
+
+		const auto bootPoint = scratch.GetFirstDriveSelectCClock();
+		if (bootPoint == 0)
+			return CreateResult::NoDriveAccess;
+
+		// ... then run again from reset and stop just before it.
+		scratch.SetRom(rom);
+		if (!scratch.ExecuteFor(bootPoint))
+			return CreateResult::Failed;
+
+		// Write to a temporary file first so other instances never see a partial file.
+		auto tempFile = file;
+		tempFile += ".tmp";
+
+		{
+			std::ofstream ofile(tempFile, std::ios::out | std::ios::binary);
+			if (!ofile.is_open())
+				return CreateResult::Failed;
+
+			scratch.WriteSnapshot(ofile);
+			if (!ofile)
+				return CreateResult::Failed;
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tempFile, file, ec);
+		return ec ? CreateResult::Failed : CreateResult::Ok;
+	}
+
+	bool LoadBootState(const std::filesystem::path& file, am::Amiga& amiga)
+	{
+		std::ifstream ifile(file, std::ios::binary);
+		if (!ifile.is_open())
+			return false;
+
+		// Read into a scratch machine and transfer just the state, so the disks inserted in the
+		// real one are kept.
+		util::Log log(16);
+		am::Amiga scratch(amiga.GetChipRamConfig(), &log);
+		if (!scratch.ReadSnapshot(ifile))
+			return false;
+
+		am::SavedState state;
+		scratch.SaveState(state);
+		return amiga.LoadState(state);
+	}
+}
+
+bool guru::FastBoot(am::Amiga& amiga, const std::filesystem::path& cacheDir)
+{
+	if (amiga.GetTotalCClocks() != 0 || amiga.GetRom().empty() || !amiga.GetHardDiskFilename().empty() || !amiga.GetHostDirectory().empty())
+		return false;
+
+	char filename[32];
+	snprintf(filename, sizeof(filename), "boot-%016llx", (unsigned long long)BootKey(amiga));
+	const auto file = cacheDir / (std::string(filename) + ".snap");
+
+	// Remembers roms that never access a drive, so they aren't booted for nothing every time.
+	const auto noBootFile = cacheDir / (std::string(filename) + ".none");
+
+	if (LoadBootState(file, amiga))
+		return true;
+
+	std::error_code ec;
+	if (std::filesystem::exists(noBootFile, ec))
+		return false;
+
+	// Missing, or unreadable by this version of the emulator.
+	std::filesystem::create_directories(cacheDir, ec);
+
+	switch (CreateBootState(amiga, file))
+	{
+	case CreateResult::Ok:
+		return LoadBootState(file, amiga);
+
+	case CreateResult::NoDriveAccess:
+		std::ofstream(noBootFile, std::ios::out | std::ios::binary);
+		return false;
+
+	default:
+		return false;
+	}
+}
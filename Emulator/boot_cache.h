@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Amiga/amiga.h"
+
+#include <filesystem>
+
+namespace guru
+{
+	/// Skips the start of the Kickstart boot by restoring a cached machine state.
+	///
+	/// The state cached is the one just before the rom first selects a floppy drive, as nothing up to
+	/// that point depends on the inserted disks. Restoring it is exactly equivalent to having run
+	/// from reset. The cache file is named after a hash of the rom, chip ram configuration and Agnus
+	/// version, so changing any of those simply misses the cache. On a miss the boot is run once on
+	/// a scratch machine and the result stored in cacheDir.
+	///
+	/// Call straight after a reset (SetRom or Reset). Inserted disks are left alone. Returns false,
+	/// leaving the machine untouched, if the rom never selects a drive (so is probably not a
+	/// Kickstart) or the state could not be restored, or if a hard disk is attached or a host
+	/// directory mounted, as the rom reads or configures those before it gets to the floppy drives.
+	bool FastBoot(am::Amiga& amiga, const std::filesystem::path& cacheDir);
+}
@@ -1,4 +1,5 @@
 #include "disk_image.h"
+#include "disk_writer.h"
 
 #include "util/file.h"
 #include "util/scope_guard.h"
@@ -6,19 +7,32 @@
 
 #include "minizip/unzip.h"
 
+#include <zlib.h>
+
+#include <deque>
+#include <fstream>
+#include <mutex>
+
 namespace
 {
-	bool LoadZippedImage(const std::string& zipFilename, std::string_view archFile, std::vector<uint8_t>& image, std::string& adfName)
+	// A zip's entries and where each is in its central directory.
+	struct ZipDirectory
+	{
+		std::string zipFilename;
+		uintmax_t fileSize = 0;
+		std::filesystem::file_time_type modifiedTime;
+		std::vector<std::pair<std::string, uLong>> entries;
+	};
+
+	// The directories of recently opened zips, so that opening another disk from a multi-disk
+	// archive goes straight to its entry rather than walking the directory again. Shared between
+	// threads, as the disk library scans in the background.
+	constexpr size_t kMaxCachedZipDirectories = 32;
+	std::mutex gZipDirectoryMutex;
+	std::deque<ZipDirectory> gZipDirectories;
+
+	bool ReadZipDirectory(unzFile zipfile, ZipDirectory& directory)
 	{
-		unzFile zipfile = unzOpen(zipFilename.c_str());
-		if (!zipfile)
-			return false;
-
-		auto zipguard = util::make_scope_guard([&]()
-			{
-				unzClose(zipfile);
-			});
-
 		if (unzGoToFirstFile(zipfile) != UNZ_OK)
 			return false;
 
@@ -37,8 +51,75 @@ namespace
 				return false;
 			}
 
-			std::string file = filename;
+			directory.entries.emplace_back(filename, unzGetOffset(zipfile));
+
+			if (unzGoToNextFile(zipfile) != UNZ_OK)
+				break;
+		}
+
+		return true;
+	}
+
+	// Returns the entries of an open zip, from the cache if the file hasn't changed since it was
+	// last read.
+	bool GetZipDirectory(const std::string& zipFilename, unzFile zipfile, std::vector<std::pair<std::string, uLong>>& entries)
+	{
+		std::error_code ec;
+		ZipDirectory directory;
+		directory.zipFilename = zipFilename;
+		directory.fileSize = std::filesystem::file_size(zipFilename, ec);
+		directory.modifiedTime = std::filesystem::last_write_time(zipFilename, ec);
+
+		{
+			std::lock_guard lock(gZipDirectoryMutex);
+
+			for (auto& cached : gZipDirectories)
+			{
+				if (cached.zipFilename == zipFilename && cached.fileSize == directory.fileSize && cached.modifiedTime == directory.modifiedTime)
+				{
+					entries = cached.entries;
+					return true;
+				}
+			}
+		}
+
+		if (!ReadZipDirectory(zipfile, directory))
+			return false;
+
+		entries = directory.entries;
+
+		if (!ec)
+		{
+			std::lock_guard lock(gZipDirectoryMutex);
+
+			std::erase_if(gZipDirectories, [&](const ZipDirectory& cached) { return cached.zipFilename == zipFilename; });
+			gZipDirectories.push_front(std::move(directory));
+			if (gZipDirectories.size() > kMaxCachedZipDirectories)
+			{
+				gZipDirectories.pop_back();
+			}
+		}
+
+		return true;
+	}
+
+	bool LoadZippedImage(const std::string& zipFilename, std::string_view archFile, std::vector<uint8_t>& image, std::string& adfName)
+	{
+		unzFile zipfile = unzOpen(zipFilename.c_str());
+		if (!zipfile)
+			return false;
+
+		auto zipguard = util::make_scope_guard([&]()
+			{
+				unzClose(zipfile);
+			});
+
+		std::vector<std::pair<std::string, uLong>> entries;
+		if (!GetZipDirectory(zipFilename, zipfile, entries))
+			return false;
 
+		for (auto& [file, offset] : entries)
+		{
 			bool match = false;
 
 			if (archFile.empty())
@@ -52,8 +133,13 @@ namespace
 
 			if (match)
 			{
-				if (unzOpenCurrentFile(zipfile) != UNZ_OK)
+				unz_file_info file_info;
+				if (unzSetOffset(zipfile, offset) != UNZ_OK
+					|| unzGetCurrentFileInfo(zipfile, &file_info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK
+					|| unzOpenCurrentFile(zipfile) != UNZ_OK)
+				{
 					return false;
+				}
 
 				auto fileguard = util::make_scope_guard([&]()
 					{
@@ -70,14 +156,52 @@ namespace
 				adfName = file;
 				return true;
 			}
-
-			if (unzGoToNextFile(zipfile) != UNZ_OK)
-				break;
 		}
 
 		return false;
 	}
 
+	// Loads a gzip compressed (ADZ) image. The uncompressed size is in the gzip trailer, so the image
+	// is inflated straight from the file into a buffer of the right size.
+	bool LoadGzippedImage(const std::filesystem::path& path, std::vector<uint8_t>& image)
+	{
+		// Far bigger than any disk image; guards against a corrupt trailer.
+		constexpr uint32_t kMaxImageSize = 16 << 20;
+
+		uint8_t trailer[4];
+		{
+			std::ifstream file(path, std::ios::in | std::ios::binary);
+			if (!file.seekg(-4, std::ios::end) || !file.read(reinterpret_cast<char*>(trailer), sizeof(trailer)))
+				return false;
+		}
+
+		const uint32_t size = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (uint32_t(trailer[3]) << 24);
+		if (size == 0 || size > kMaxImageSize)
+			return false;
+
+		gzFile gzfile = gzopen(path.string().c_str(), "rb");
+		if (!gzfile)
+			return false;
+
+		auto gzguard = util::make_scope_guard([&]()
+			{
+				gzclose(gzfile);
+			});
+
+		image.resize(size);
+		if (gzread(gzfile, image.data(), size) != int(size))
+			return false;
+
+		// Anything more means the trailer was wrong (or there are several gzip members).
+		uint8_t extra;
+		return gzread(gzfile, &extra, 1) == 0;
+	}
+
+	bool IsGzipped(const std::filesystem::path& path)
+	{
+		return (util::ToUpper(path.extension().string()) == ".ADZ");
+	}
+
 } // namespace
 
 bool guru::IsArchive(const std::filesystem::path& path)
@@ -96,35 +220,18 @@ std::vector<std::string> guru::ListFilesFromZip(const std::filesystem::path& zip
 			unzClose(zipfile);
 		});
 
-	if (unzGoToFirstFile(zipfile) != UNZ_OK)
+	std::vector<std::pair<std::string, uLong>> entries;
+	if (!GetZipDirectory(zipPath.string(), zipfile, entries))
 		return {};
 
-	char filename[512];
-
 	std::vector<std::string> files;
 
-	for (;;)
+	for (auto& [file, offset] : entries)
 	{
-		unz_file_info file_info;
-		if (unzGetCurrentFileInfo(
-			zipfile,
-			&file_info,
-			filename,
-			_countof(filename),
-			NULL, 0, NULL, 0) != UNZ_OK)
-		{
-			return {};
-		}
-
-		std::string file = filename;
-
 		if (util::EndsWith(util::ToUpper(file), extension))
 		{
-			files.emplace_back(std::move(file));
+			files.push_back(file);
 		}
-
-		if (unzGoToNextFile(zipfile) != UNZ_OK)
-			break;
 	}
 
 	return files;
@@ -136,6 +243,8 @@ bool guru::LoadDiskImage(const std::filesystem::path& path, std::string_view arc
 
 	bool isGood = false;
 
+	std::string fileLocation = path.string();
+
 	if (IsArchive(path))
 	{
 		std::string zippedFile;
@@ -143,10 +252,27 @@ bool guru::LoadDiskImage(const std::filesystem::path& path, std::string_view arc
 
 		name += "::";
 		name += zippedFile;
+
+		if (!archFile.empty())
+		{
+			fileLocation += "::";
+			fileLocation += archFile;
+		}
+	}
+	else if (IsGzipped(path))
+	{
+		isGood = LoadGzippedImage(path, image);
 	}
 	else
 	{
-		isGood = util::LoadBinaryFile(path.string(), image);
+		return util::LoadBinaryFile(path.string(), image);
+	}
+
+	// Anything written to an archived or compressed disk is kept in an overlay beside it.
+	std::vector<uint8_t> overlay;
+	if (isGood && util::LoadBinaryFile(GetDiskOverlayPath(fileLocation).string(), overlay) && overlay.size() == image.size())
+	{
+		image = std::move(overlay);
 	}
 
 	return isGood;
@@ -0,0 +1,430 @@
+#include "disk_library.h"
+
+#include "disk_image.h"
+
+#include "Amiga/mfm.h"
+
+#include "util/file.h"
+#include "util/hash.h"
+#include "util/stream.h"
+#include "util/strings.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <tuple>
+
+namespace
+{
+	// Bump if the catalogue file format (or what is stored in it) changes, so old catalogues are
+	// rebuilt rather than misread.
+	constexpr uint32_t kCatalogueVersion = 2;
+	constexpr char kCatalogueId[4] = { 'G', 'D', 'L', 'B' };
+
+	// Save progress every so many changed files, so an interrupted first scan of a large
+	// collection doesn't have to start again.
+	constexpr int kFilesBetweenSaves = 500;
+
+	bool IsDiskFile(const std::filesystem::path& path)
+	{
+		const auto name = util::ToLower(path.filename().string());
+
+		// Overlays hold writes to disks in archives and are found through their archive.
+		if (util::EndsWith(name, ".writes.adf"))
+			return false;
+
+		return util::EndsWith(name, ".adf") || util::EndsWith(name, ".adz") || util::EndsWith(name, ".zip");
+	}
+
+	bool EntryLess(const guru::DiskLibraryEntry& a, const guru::DiskLibraryEntry& b)
+	{
+		return std::tie(a.path, a.archiveEntry) < std::tie(b.path, b.archiveEntry);
+	}
+
+	std::string MakeSearchText(const guru::DiskLibraryEntry& entry)
+	{
+		auto text = std::filesystem::path(entry.path).filename().string();
+		text += ' ';
+		text += entry.archiveEntry;
+		text += ' ';
+		text += entry.volumeName;
+		return util::ToLower(std::move(text));
+	}
+
+	// The volume name from the root block of an AmigaDOS disk, which is the first sector of the
+	// middle track.
+	std::string ReadVolumeName(const std::vector<uint8_t>& image)
+	{
+		constexpr int kRootTrack = am::kTracksPerDisk / 2;
+		constexpr size_t kBlockSize = am::kDecodedBytesPerSector;
+		constexpr size_t kNameOffset = kBlockSize - 80;
+		constexpr size_t kMaxNameLength = 30;
+
+		std::array<am::TrackLayout, am::kTracksPerDisk> layout;
+		if (!am::ReadTrackLayout(image, layout))
+			return {};
+
+		const auto& track = layout[kRootTrack];
+		if (track.raw || track.size < kBlockSize)
+			return {};
+
+		const uint8_t* block = &image[track.offset];
+
+		auto ReadLong = [block](size_t off)
+		{
+			return (uint32_t(block[off]) << 24) | (uint32_t(block[off + 1]) << 16) | (uint32_t(block[off + 2]) << 8) | block[off + 3];
+		};
+
+		constexpr uint32_t kHeaderType = 2;
+		constexpr uint32_t kRootSecondaryType = 1;
+
+		if (ReadLong(0) != kHeaderType || ReadLong(kBlockSize - 4) != kRootSecondaryType)
+			return {};
+
+		const size_t length = std::min(size_t(block[kNameOffset]), kMaxNameLength);
+		return std::string(reinterpret_cast<const char*>(block + kNameOffset + 1), length);
+	}
+
+	void ScanFile(const std::filesystem::path& file, uint64_t fileSize, int64_t modifiedTime, std::vector<guru::DiskLibraryEntry>& entries)
+	{
+		std::vector<std::string> archiveEntries;
+		if (guru::IsArchive(file))
+		{
+			archiveEntries = guru::ListFilesFromZip(file, ".ADF");
+		}
+		else
+		{
+			archiveEntries.emplace_back();
+		}
+
+		for (auto& archiveEntry : archiveEntries)
+		{
+			std::vector<uint8_t> image;
+			std::string name;
+			if (!guru::LoadDiskImage(file, archiveEntry, image, name))
+				continue;
+
+			guru::DiskLibraryEntry entry;
+			entry.path = file.generic_string();
+			entry.archiveEntry = archiveEntry;
+			entry.fileSize = fileSize;
+			entry.modifiedTime = modifiedTime;
+			entry.hash = util::Fnv1a64(image);
+			entry.volumeName = ReadVolumeName(image);
+			entry.searchText = MakeSearchText(entry);
+			entries.push_back(std::move(entry));
+		}
+	}
+
+} // namespace
+
+guru::DiskLibrary::DiskLibrary(const std::filesystem::path& catalogueFile)
+	: m_catalogueFile(catalogueFile)
+{
+	Load();
+}
+
+guru::DiskLibrary::~DiskLibrary()
+{
+	m_stopScan = true;
+	if (m_scanThread.joinable())
+	{
+		m_scanThread.join();
+	}
+}
+
+void guru::DiskLibrary::Scan(const std::filesystem::path& directory)
+{
+	m_stopScan = true;
+	if (m_scanThread.joinable())
+	{
+		m_scanThread.join();
+	}
+
+	m_stopScan = false;
+	m_scanning = true;
+	m_filesScanned = 0;
+	m_scanThread = std::thread(&DiskLibrary::ScanThread, this, directory);
+}
+
+std::vector<guru::DiskLibraryEntry> guru::DiskLibrary::Search(std::string_view query, size_t maxResults) const
+{
+	std::vector<std::string> words;
+	const auto lowerQuery = util::ToLower(std::string(query));
+	for (size_t start = 0; start < lowerQuery.size();)
+	{
+		auto end = lowerQuery.find(' ', start);
+		if (end == std::string::npos)
+		{
+			end = lowerQuery.size();
+		}
+		if (end > start)
+		{
+			words.push_back(lowerQuery.substr(start, end - start));
+		}
+		start = end + 1;
+	}
+
+	std::vector<DiskLibraryEntry> results;
+
+	std::lock_guard lock(m_mutex);
+
+	for (auto& entry : m_entries)
+	{
+		const bool match = std::all_of(words.begin(), words.end(), [&entry](const std::string& word)
+			{
+				return entry.searchText.find(word) != std::string::npos;
+			});
+
+		if (match)
+		{
+			results.push_back(entry);
+			if (results.size() == maxResults)
+				break;
+		}
+	}
+
+	return results;
+}
+
+std::vector<guru::DiskLibraryEntry> guru::DiskLibrary::GetFileEntries(const std::filesystem::path& file) const
+{
+	std::error_code ec;
+	const auto fileSize = std::filesystem::file_size(file, ec);
+	if (ec)
+		return {};
+
+	const auto modifiedTime = std::filesystem::last_write_time(file, ec).time_since_epoch().count();
+	if (ec)
+		return {};
+
+	DiskLibraryEntry key;
+	key.path = file.generic_string();
+
+	std::lock_guard lock(m_mutex);
+
+	std::vector<DiskLibraryEntry> entries;
+	for (auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, EntryLess); it != m_entries.end() && it->path == key.path; ++it)
+	{
+		if (it->fileSize != fileSize || it->modifiedTime != modifiedTime)
+			return {};
+
+		entries.push_back(*it);
+	}
+
+	return entries;
+}
+
+void guru::DiskLibrary::ScanThread(std::filesystem::path directory)
+{
+	std::error_code ec;
+	if (directory.empty() || !std::filesystem::is_directory(directory, ec))
+	{
+		m_scanning = false;
+		return;
+	}
+
+	std::set<std::string> seen;
+	int changedFiles = 0;
+
+	const auto options = std::filesystem::directory_options::skip_permission_denied;
+	for (auto it = std::filesystem::recursive_directory_iterator(directory, options, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+	{
+		if (m_stopScan)
+		{
+			m_scanning = false;
+			return;
+		}
+
+		std::error_code fileEc;
+		if (!it->is_regular_file(fileEc) || !IsDiskFile(it->path()))
+			continue;
+
+		const auto fileSize = it->file_size(fileEc);
+		const auto modifiedTime = it->last_write_time(fileEc).time_since_epoch().count();
+		if (fileEc)
+			continue;
+
+		const auto path = it->path().generic_string();
+		seen.insert(path);
+		m_filesScanned++;
+
+		DiskLibraryEntry key;
+		key.path = path;
+
+		{
+			std::lock_guard lock(m_mutex);
+
+			auto first = std::lower_bound(m_entries.begin(), m_entries.end(), key, EntryLess);
+			auto last = first;
+			bool unchanged = true;
+			for (; last != m_entries.end() && last->path == path; ++last)
+			{
+				unchanged = unchanged && last->fileSize == uint64_t(fileSize) && last->modifiedTime == modifiedTime;
+			}
+
+			if (first != last && unchanged)
+				continue;
+
+			if (first == last)
+			{
+				auto empty = m_emptyFiles.find(path);
+				if (empty != m_emptyFiles.end() && empty->second.fileSize == uint64_t(fileSize) && empty->second.modifiedTime == modifiedTime)
+					continue;
+			}
+		}
+
+		// New or changed, so (re)read it. The catalogue isn't locked meanwhile, so searches carry on.
+		std::vector<DiskLibraryEntry> scanned;
+		ScanFile(it->path(), fileSize, modifiedTime, scanned);
+		std::sort(scanned.begin(), scanned.end(), EntryLess);
+
+		{
+			std::lock_guard lock(m_mutex);
+
+			auto first = std::lower_bound(m_entries.begin(), m_entries.end(), key, EntryLess);
+			auto last = first;
+			while (last != m_entries.end() && last->path == path)
+			{
+				++last;
+			}
+
+			first = m_entries.erase(first, last);
+			m_entries.insert(first, std::make_move_iterator(scanned.begin()), std::make_move_iterator(scanned.end()));
+
+			if (scanned.empty())
+			{
+				m_emptyFiles[path] = { uint64_t(fileSize), modifiedTime };
+			}
+			else
+			{
+				m_emptyFiles.erase(path);
+			}
+		}
+
+		if (++changedFiles % kFilesBetweenSaves == 0)
+		{
+			Save();
+		}
+	}
+
+	// Forget files that have gone.
+	{
+		std::lock_guard lock(m_mutex);
+		std::erase_if(m_entries, [&seen](const DiskLibraryEntry& entry) { return !seen.contains(entry.path); });
+		std::erase_if(m_emptyFiles, [&seen](const auto& file) { return !seen.contains(file.first); });
+	}
+
+	Save();
+	m_scanning = false;
+}
+
+void guru::DiskLibrary::Load()
+{
+	// Read from memory, so a damaged catalogue can't make a string longer than the file.
+	std::vector<uint8_t> data;
+	if (!util::LoadBinaryFile(m_catalogueFile.string(), data))
+		return;
+
+	util::MemoryReader reader(data.data(), data.size());
+
+	char id[4] = {};
+	uint32_t version = 0;
+	uint64_t count = 0;
+	util::Stream(reader, id);
+	util::Stream(reader, version);
+	util::Stream(reader, count);
+
+	if (reader.Failed() || memcmp(id, kCatalogueId, sizeof(id)) != 0 || version != kCatalogueVersion)
+		return;
+
+	std::vector<DiskLibraryEntry> entries;
+
+	for (uint64_t i = 0; i < count && !reader.Failed(); i++)
+	{
+		DiskLibraryEntry entry;
+		util::StreamString(reader, entry.path);
+		util::StreamString(reader, entry.archiveEntry);
+		util::Stream(reader, entry.fileSize);
+		util::Stream(reader, entry.modifiedTime);
+		util::Stream(reader, entry.hash);
+		util::StreamString(reader, entry.volumeName);
+		entry.searchText = MakeSearchText(entry);
+		entries.push_back(std::move(entry));
+	}
+
+	std::map<std::string, ScannedFile> emptyFiles;
+	uint64_t emptyCount = 0;
+	util::Stream(reader, emptyCount);
+
+	for (uint64_t i = 0; i < emptyCount && !reader.Failed(); i++)
+	{
+		std::string path;
+		ScannedFile scanned;
+		util::StreamString(reader, path);
+		util::Stream(reader, scanned.fileSize);
+		util::Stream(reader, scanned.modifiedTime);
+		emptyFiles[path] = scanned;
+	}
+
+	if (reader.Failed())
+		return;
+
+	std::sort(entries.begin(), entries.end(), EntryLess);
+
+	std::lock_guard lock(m_mutex);
+	m_entries = std::move(entries);
+	m_emptyFiles = std::move(emptyFiles);
+}
+
+void guru::DiskLibrary::Save() const
+{
+	std::vector<DiskLibraryEntry> entries;
+	std::map<std::string, ScannedFile> emptyFiles;
+	{
+		std::lock_guard lock(m_mutex);
+		entries = m_entries;
+		emptyFiles = m_emptyFiles;
+	}
+
+	// Write to a temporary file first so a crash never leaves a partial catalogue.
+	auto tempFile = m_catalogueFile;
+	tempFile += ".tmp";
+
+	{
+		std::ofstream file(tempFile, std::ios::out | std::ios::binary);
+		if (!file.is_open())
+			return;
+
+		file.write(kCatalogueId, sizeof(kCatalogueId));
+		util::Stream(file, kCatalogueVersion);
+		util::Stream(file, uint64_t(entries.size()));
+
+		for (auto& entry : entries)
+		{
+			util::StreamString(file, entry.path);
+			util::StreamString(file, entry.archiveEntry);
+			util::Stream(file, entry.fileSize);
+			util::Stream(file, entry.modifiedTime);
+			util::Stream(file, entry.hash);
+			util::StreamString(file, entry.volumeName);
+		}
+
+		util::Stream(file, uint64_t(emptyFiles.size()));
+
+		for (auto& [path, scanned] : emptyFiles)
+		{
+			util::StreamString(file, path);
+			util::Stream(file, scanned.fileSize);
+			util::Stream(file, scanned.modifiedTime);
+		}
+
+		if (!file)
+			return;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempFile, m_catalogueFile, ec);
+}
\ No newline at end of file
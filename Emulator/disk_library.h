@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace guru
+{
+	struct DiskLibraryEntry
+	{
+		std::string path;			// of the file holding the disk
+		std::string archiveEntry;	// name of the disk within the archive, or empty for a plain file
+		uint64_t fileSize = 0;
+		int64_t modifiedTime = 0;	// of the file, in the file clock's ticks
+		uint64_t hash = 0;			// util::Fnv1a64 of the disk image
+		std::string volumeName;		// from the root block, or empty if not an AmigaDOS disk
+
+		// Lower case copy of everything searched on.
+		std::string searchText;
+	};
+
+	/// A catalogue of every disk in the ADF directory, kept in a file so it persists between
+	/// sessions. A background thread brings it up to date after it is loaded, only opening files
+	/// that are new or have changed since they were last scanned, so a large collection costs
+	/// nothing to browse once it has been scanned once.
+	class DiskLibrary
+	{
+	public:
+		DiskLibrary(const std::filesystem::path& catalogueFile);
+		~DiskLibrary();
+
+		DiskLibrary(const DiskLibrary&) = delete;
+		DiskLibrary& operator=(const DiskLibrary&) = delete;
+
+		/// Starts scanning a directory (and its subdirectories), abandoning any scan in progress.
+		/// Entries for files outside the directory are dropped when the scan completes.
+		void Scan(const std::filesystem::path& directory);
+
+		bool IsScanning() const
+		{
+			return m_scanning;
+		}
+
+		/// Number of files looked at by the current (or last) scan.
+		int GetFilesScanned() const
+		{
+			return m_filesScanned;
+		}
+
+		/// Entries whose file name, archive entry or volume name contains all the space separated
+		/// words of the query (case insensitive), up to maxResults of them.
+		std::vector<DiskLibraryEntry> Search(std::string_view query, size_t maxResults) const;
+
+		/// The disks found in a file, if it has been scanned and hasn't changed since.
+		std::vector<DiskLibraryEntry> GetFileEntries(const std::filesystem::path& file) const;
+
+	private:
+		void ScanThread(std::filesystem::path directory);
+		void Load();
+		void Save() const;
+
+		struct ScannedFile
+		{
+			uint64_t fileSize = 0;
+			int64_t modifiedTime = 0;
+		};
+
+		std::filesystem::path m_catalogueFile;
+
+		// Sorted by path, then archive entry.
+		std::vector<DiskLibraryEntry> m_entries;
+
+		// Files that were scanned but held no disks (such as an archive of something else), so they
+		// aren't opened again until they change.
+		std::map<std::string, ScannedFile> m_emptyFiles;
+
+		mutable std::mutex m_mutex;
+
+		std::thread m_scanThread;
+		std::atomic<bool> m_scanning = false;
+		std::atomic<bool> m_stopScan = false;
+		std::atomic<int> m_filesScanned = 0;
+	};
+}
\ No newline at end of file
@@ -10,6 +10,12 @@
 #include <imgui.h>
 #include "3rd Party/imfilebrowser.h"
 
+namespace
+{
+	// More than this many matches aren't worth listing; the search needs narrowing.
+	constexpr size_t kMaxSearchResults = 500;
+}
+
 guru::DiskManager::DiskManager(guru::AmigaApp* app)
 	: m_app(app)
 {
@@ -27,7 +33,7 @@ bool guru::DiskManager::Draw()
 {
 	const auto scale = ImGui::GetFrameHeightWithSpacing();
 
-	ImGui::SetNextWindowSize(ImVec2(40 * scale, 15 * scale), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(40 * scale, 30 * scale), ImGuiCond_FirstUseEver);
 
 	bool open = true;
 	bool expanded = ImGui::Begin("DiskManager", &open);
@@ -98,6 +104,68 @@ bool guru::DiskManager::Draw()
 		ImGui::PopStyleVar(2);
 	}
 
+	const DiskLibraryEntry* libraryChoice = nullptr;
+
+	if (ImGui::CollapsingHeader("Disk Library", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		auto library = m_app->GetDiskLibrary();
+
+		ImGui::PushItemWidth(10 * scale);
+		ImGui::Combo("##LIBRARYDRIVE", &m_libraryDrive, driveNameLabels, 4);
+		ImGui::PopItemWidth();
+
+		ImGui::SameLine();
+
+		ImGui::PushItemWidth(-1);
+		const bool searchChanged = ImGui::InputText("##SEARCH", m_searchText, sizeof(m_searchText));
+		ImGui::PopItemWidth();
+
+		// Keep searching while the scan is in progress so new disks show up.
+		if (searchChanged || !m_searchDone || library->IsScanning())
+		{
+			m_searchResults = library->Search(m_searchText, kMaxSearchResults);
+			m_searchDone = true;
+		}
+
+		if (library->IsScanning())
+		{
+			ImGui::Text("Scanning ADF directory... (%d files)", library->GetFilesScanned());
+		}
+
+		ImGui::BeginChild("##LIBRARY", ImVec2(0, 0), true, 0);
+
+		for (size_t i = 0; i < m_searchResults.size(); i++)
+		{
+			auto& entry = m_searchResults[i];
+
+			std::string label = std::filesystem::path(entry.path).filename().string();
+			if (!entry.archiveEntry.empty())
+			{
+				label += "::";
+				label += entry.archiveEntry;
+			}
+			if (!entry.volumeName.empty())
+			{
+				label += "  [";
+				label += entry.volumeName;
+				label += "]";
+			}
+			label += "##";
+			label += std::to_string(i);
+
+			if (ImGui::Selectable(label.c_str()))
+			{
+				libraryChoice = &entry;
+			}
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("%s", entry.path.c_str());
+			}
+		}
+
+		ImGui::EndChild();
+	}
+
 	ImGui::End();
 
 	m_fileDialog->Display();
@@ -115,13 +183,29 @@ bool guru::DiskManager::Draw()
 		}
 	};
 
+	if (libraryChoice)
+	{
+		m_selectedDrive = m_libraryDrive;
+		LoadDiskFile(libraryChoice->path, libraryChoice->archiveEntry);
+	}
+
 	if (m_fileDialog->HasSelected())
 	{
 		m_selectedFile = m_fileDialog->GetSelected();
 
 		if (IsArchive(m_selectedFile))
 		{
-			m_archiveFiles = ListFilesFromZip(m_selectedFile, ".ADF");
+			// The library already knows what is in the archive, unless it is new or has changed.
+			m_archiveFiles.clear();
+			for (auto& entry : m_app->GetDiskLibrary()->GetFileEntries(m_selectedFile))
+			{
+				m_archiveFiles.push_back(entry.archiveEntry);
+			}
+
+			if (m_archiveFiles.empty())
+			{
+				m_archiveFiles = ListFilesFromZip(m_selectedFile, ".ADF");
+			}
 			if (m_archiveFiles.empty())
 			{
 				// No ADFs in the archive.
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "disk_library.h"
+
 #include <memory>
 #include <vector>
 #include <string>
@@ -30,5 +32,10 @@ namespace guru
 		int m_selectedDrive = 0;
 		std::filesystem::path m_selectedFile;
 		std::vector<std::string> m_archiveFiles;
+
+		int m_libraryDrive = 0;
+		char m_searchText[128] = {};
+		bool m_searchDone = false;
+		std::vector<DiskLibraryEntry> m_searchResults;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "disk_writer.h"
+
+#include "util/strings.h"
+
+#include <fstream>
+#include <utility>
+
+namespace
+{
+	bool IsInArchive(const std::string& fileLocation)
+	{
+		auto [file, archFile] = util::SplitOn(fileLocation, "::");
+		const auto extension = util::ToLower(std::filesystem::path(file).extension().string());
+		return !archFile.empty() || extension == ".zip" || extension == ".adz";
+	}
+}
+
+std::filesystem::path guru::GetDiskOverlayPath(const std::string& fileLocation)
+{
+	auto [file, archFile] = util::SplitOn(fileLocation, "::");
+
+	std::string overlay(file);
+	if (!archFile.empty())
+	{
+		std::string entry(archFile);
+		for (auto& c : entry)
+		{
+			if (c == '/' || c == '\\' || c == ':')
+				c = '_';
+		}
+		overlay += "-" + entry;
+	}
+	overlay += ".writes.adf";
+
+	return overlay;
+}
+
+bool guru::CanSaveDisk(const std::string& fileLocation)
+{
+	if (!IsInArchive(fileLocation))
+	{
+		std::fstream file(fileLocation, std::ios::in | std::ios::out | std::ios::binary);
+		return file.is_open();
+	}
+
+	const auto overlay = GetDiskOverlayPath(fileLocation);
+
+	std::error_code ec;
+	if (std::filesystem::exists(overlay, ec))
+	{
+		std::fstream file(overlay, std::ios::in | std::ios::out | std::ios::binary);
+		return file.is_open();
+	}
+
+	// An empty overlay would be taken for the disk, so try creating one under another name.
+	auto testFile = overlay;
+	testFile += ".tmp";
+
+	bool created = false;
+	{
+		std::ofstream file(testFile, std::ios::out | std::ios::binary);
+		created = file.is_open();
+	}
+	std::filesystem::remove(testFile, ec);
+	return created;
+}
+
+guru::DiskWriter::DiskWriter()
+	: m_worker(&DiskWriter::WorkerLoop, this)
+{
+}
+
+guru::DiskWriter::~DiskWriter()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_stopping = true;
+	}
+	m_writeQueued.notify_one();
+	m_worker.join();
+}
+
+void guru::DiskWriter::TrackWritten(const am::FloppyDisk& disk, size_t offset, std::span<const uint8_t> data)
+{
+	if (m_holdingWrites)
+	{
+		m_heldDisks.insert(disk.fileLocation);
+	}
+
+	if (m_heldDisks.contains(disk.fileLocation))
+		return;
+
+	Write write;
+
+	if (IsInArchive(disk.fileLocation))
+	{
+		write.file = GetDiskOverlayPath(disk.fileLocation);
+
+		if (m_overlays.insert(write.file).second)
+		{
+			std::error_code ec;
+			if (!std::filesystem::exists(write.file, ec))
+			{
+				// First write to this disk: the overlay starts as a copy of the whole (already
+				// updated) disk.
+				write.offset = 0;
+				write.data.assign(disk.GetData().begin(), disk.GetData().end());
+			}
+		}
+	}
+	else
+	{
+		write.file = disk.fileLocation;
+	}
+
+	if (write.data.empty())
+	{
+		write.offset = offset;
+		write.data.assign(data.begin(), data.end());
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_writes.push_back(std::move(write));
+	}
+	m_writeQueued.notify_one();
+}
+
+void guru::DiskWriter::DiskEjected(const am::FloppyDisk& disk)
+{
+	m_heldDisks.erase(disk.fileLocation);
+	Flush();
+}
+
+void guru::DiskWriter::Flush()
+{
+	std::unique_lock lock(m_mutex);
+	m_writesDone.wait(lock, [this]() { return m_writes.empty() && !m_writing; });
+}
+
+std::vector<std::filesystem::path> guru::DiskWriter::TakeFailures()
+{
+	std::lock_guard lock(m_mutex);
+	return std::exchange(m_failures, {});
+}
+
+void guru::DiskWriter::WorkerLoop()
+{
+	std::unique_lock lock(m_mutex);
+
+	for (;;)
+	{
+		m_writeQueued.wait(lock, [this]() { return m_stopping || !m_writes.empty(); });
+
+		if (m_writes.empty())
+			return;
+
+		auto write = std::move(m_writes.front());
+		m_writes.pop_front();
+		m_writing = true;
+
+		lock.unlock();
+
+		// Create the file if needed (for a new overlay), otherwise update it in place.
+		std::fstream file(write.file, std::ios::in | std::ios::out | std::ios::binary);
+		if (!file.is_open())
+		{
+			file.open(write.file, std::ios::out | std::ios::binary);
+		}
+
+		bool ok = file.is_open();
+		if (ok)
+		{
+			file.seekp(write.offset);
+			file.write(reinterpret_cast<const char*>(write.data.data()), write.data.size());
+			file.flush();
+			ok = bool(file);
+		}
+
+		lock.lock();
+
+		if (!ok)
+		{
+			m_failures.push_back(write.file);
+		}
+
+		m_writing = false;
+		if (m_writes.empty())
+		{
+			m_writesDone.notify_all();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Amiga/amiga.h"
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace guru
+{
+	/// Where writes to a disk that can't be updated in place (one inside an archive, or a gzip
+	/// compressed ADZ) are kept. The overlay is a complete ADF that is loaded in place of the
+	/// archived image when it exists.
+	std::filesystem::path GetDiskOverlayPath(const std::string& fileLocation);
+
+	/// Whether writes to a disk can be saved: its file, or for a disk in an archive its overlay,
+	/// can be written to.
+	bool CanSaveDisk(const std::string& fileLocation);
+
+	/// Saves the tracks written by the emulated machine back to each disk's file, or to an overlay
+	/// file for disks inside archives. The file writes happen on a background thread so the
+	/// emulation never waits on them.
+	class DiskWriter : public am::DiskWriteHandler
+	{
+	public:
+		DiskWriter();
+		~DiskWriter();
+
+		virtual void TrackWritten(const am::FloppyDisk& disk, size_t offset, std::span<const uint8_t> data) override;
+		virtual void DiskEjected(const am::FloppyDisk& disk) override;
+
+		/// Blocks until everything queued has been written.
+		void Flush();
+
+		/// The files that writes have failed to be saved to since the last call.
+		std::vector<std::filesystem::path> TakeFailures();
+
+		/// While set, writes stay in the disk held in memory and aren't saved. A disk written to in
+		/// that time isn't saved at all until it is ejected, as its file would otherwise end up
+		/// with only some of the changes.
+		void SetHoldingWrites(bool hold)
+		{
+			m_holdingWrites = hold;
+		}
+
+	private:
+		struct Write
+		{
+			std::filesystem::path file;
+			size_t offset;
+			std::vector<uint8_t> data;
+		};
+
+		void WorkerLoop();
+
+		std::thread m_worker;
+		std::mutex m_mutex;
+		std::condition_variable m_writeQueued;
+		std::condition_variable m_writesDone;
+		std::deque<Write> m_writes;
+		bool m_writing = false;
+		bool m_stopping = false;
+		std::vector<std::filesystem::path> m_failures;
+
+		// Overlays created (or found) this session, so they are only created once. Only used on
+		// the emulation thread.
+		std::set<std::filesystem::path> m_overlays;
+
+		// Disks with writes that were held back. Only used on the emulation thread.
+		bool m_holdingWrites = false;
+		std::set<std::string> m_heldDisks;
+	};
+}
\ No newline at end of file
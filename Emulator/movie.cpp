@@ -0,0 +1,410 @@
+#include "movie.h"
+
+#include "util/file.h"
+#include "util/hash.h"
+#include "util/stream.h"
+
+#include <zlib.h>
+
+#include <sstream>
+
+namespace
+{
+	// A movie file is a header (including host settings that affect the emulation, such as turbo
+	// floppy) and the starting snapshot, followed by the input events. Each event
+	// is the colour clocks since the previous one, its type, then its values, with numbers stored
+	// as zigzag varints. The recording ends with kEndOfMovie, timestamped when it was stopped.
+	constexpr char kMovieMagic[8] = "GuRuMov";
+	constexpr uint32_t kMovieVersion = 3;
+	constexpr uint8_t kEndOfMovie = 0xff;
+
+	int NumValues(am::InputType type)
+	{
+		switch (type)
+		{
+		case am::InputType::ControllerButton:
+			return 3;
+		case am::InputType::JoystickMove:
+		case am::InputType::MouseMove:
+		case am::InputType::DiskInsert:
+		case am::InputType::DiskWriteProtect:
+			return 2;
+		default:
+			return 1;
+		}
+	}
+
+	void WriteVarint(std::ostream& os, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			os.put(char(uint8_t(value) | 0x80));
+			value >>= 7;
+		}
+		os.put(char(value));
+	}
+
+	void WriteSigned(std::ostream& os, int64_t value)
+	{
+		WriteVarint(os, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+	}
+
+	uint64_t ReadVarint(util::MemoryReader& r)
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t b = 0;
+			r.Read(&b, 1);
+			value |= uint64_t(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return value;
+		}
+		r.SetFailed();
+		return 0;
+	}
+
+	int64_t ReadSigned(util::MemoryReader& r)
+	{
+		const auto value = ReadVarint(r);
+		return int64_t(value >> 1) ^ -int64_t(value & 1);
+	}
+}
+
+guru::MovieRecorder::~MovieRecorder()
+{
+	Stop();
+}
+
+bool guru::MovieRecorder::Start(am::Amiga& amiga, const std::filesystem::path& file, bool embedDisks)
+{
+	Stop();
+
+	m_file.open(file, std::ios::out | std::ios::binary);
+	if (!m_file.is_open())
+		return false;
+
+	std::ostringstream snapshot;
+	amiga.WriteSnapshot(snapshot, true);
+	const auto snapshotData = snapshot.str();
+
+	util::Stream(m_file, kMovieMagic);
+	util::Stream(m_file, kMovieVersion);
+	util::Stream(m_file, util::Fnv1a64(amiga.GetRom()));
+	util::Stream(m_file, amiga.GetTurboFloppy());
+	util::Stream(m_file, uint64_t(snapshotData.size()));
+	m_file.write(snapshotData.data(), snapshotData.size());
+
+	m_amiga = &amiga;
+	m_embedDisks = embedDisks;
+	m_lastCClock = amiga.GetTotalCClocks();
+	amiga.SetInputRecorder(this);
+
+	return bool(m_file);
+}
+
+void guru::MovieRecorder::Stop()
+{
+	if (!m_amiga)
+		return;
+
+	m_amiga->SetInputRecorder(nullptr);
+
+	WriteVarint(m_file, m_amiga->GetTotalCClocks() - m_lastCClock);
+	m_file.put(char(kEndOfMovie));
+	m_file.close();
+
+	m_amiga = nullptr;
+}
+
+void guru::MovieRecorder::RecordInput(const am::InputEvent& event)
+{
+	WriteVarint(m_file, event.cclock - m_lastCClock);
+	m_file.put(char(event.type));
+	m_lastCClock = event.cclock;
+
+	const int32_t values[] = { event.a, event.b, event.c };
+	for (int i = 0; i < NumValues(event.type); i++)
+	{
+		WriteSigned(m_file, values[i]);
+	}
+
+	if (event.type == am::InputType::DiskInsert && event.disk)
+	{
+		auto& disk = *event.disk;
+		util::StreamString(m_file, disk.fileLocation);
+		util::StreamString(m_file, disk.displayName);
+		const auto data = disk.GetData();
+		util::Stream(m_file, util::Fnv1a64(data));
+		util::Stream(m_file, m_embedDisks);
+
+		if (m_embedDisks)
+		{
+			uLongf compressedSize = compressBound(uLong(data.size()));
+			std::vector<uint8_t> compressed(compressedSize);
+			compress2(compressed.data(), &compressedSize, data.data(), uLong(data.size()), Z_BEST_SPEED);
+
+			util::Stream(m_file, uint64_t(data.size()));
+			util::Stream(m_file, uint64_t(compressedSize));
+			m_file.write(reinterpret_cast<const char*>(compressed.data()), compressedSize);
+		}
+	}
+
+	// Keep the file usable if the emulator dies mid-recording.
+	m_file.flush();
+}
+
+bool guru::MoviePlayer::Open(am::Amiga& amiga, const std::filesystem::path& file, const am::SnapshotDiskLoader& loadDisk)
+{
+	m_amiga = nullptr;
+	m_events.clear();
+	m_nextEvent = 0;
+	m_error.clear();
+
+	std::vector<uint8_t> data;
+	if (!util::LoadBinaryFile(file.string(), data))
+	{
+		m_error = "Failed to read movie file";
+		return false;
+	}
+
+	util::MemoryReader reader(data.data(), data.size());
+
+	char magic[sizeof(kMovieMagic)] = {};
+	uint32_t version = 0;
+	uint64_t romHash = 0;
+	bool turboFloppy = false;
+	uint64_t snapshotSize = 0;
+
+	util::Stream(reader, magic);
+	util::Stream(reader, version);
+	util::Stream(reader, romHash);
+	util::Stream(reader, turboFloppy);
+	util::Stream(reader, snapshotSize);
+
+	if (reader.Failed() || memcmp(magic, kMovieMagic, sizeof(magic)) != 0 || version != kMovieVersion)
+	{
+		m_error = "Not a movie file, or from an incompatible version";
+		return false;
+	}
+
+	if (romHash != util::Fnv1a64(amiga.GetRom()))
+	{
+		m_error = "Movie was recorded with a different rom";
+		return false;
+	}
+
+	if (snapshotSize > reader.Remaining())
+	{
+		m_error = "Movie file is truncated";
+		return false;
+	}
+
+	const size_t snapshotOffset = data.size() - reader.Remaining();
+	std::vector<uint8_t> snapshot(data.begin() + snapshotOffset, data.begin() + snapshotOffset + size_t(snapshotSize));
+	reader = util::MemoryReader(data.data() + snapshotOffset + snapshotSize, data.size() - snapshotOffset - size_t(snapshotSize));
+
+	// Read all the events up front, so any problem with the movie shows up now rather than part
+	// way through playing it.
+	uint64_t cclock = 0;
+	bool ended = false;
+
+	while (reader.Remaining() > 0)
+	{
+		cclock += ReadVarint(reader);
+
+		uint8_t type = 0;
+		util::Stream(reader, type);
+
+		if (type == kEndOfMovie)
+		{
+			ended = true;
+			break;
+		}
+
+		if (type > uint8_t(am::InputType::DiskWriteProtect))
+		{
+			reader.SetFailed();
+			break;
+		}
+
+		auto& event = m_events.emplace_back();
+		event.input.cclock = cclock;
+		event.input.type = am::InputType(type);
+
+		int32_t* values[] = { &event.input.a, &event.input.b, &event.input.c };
+		for (int i = 0; i < NumValues(event.input.type); i++)
+		{
+			*values[i] = int32_t(ReadSigned(reader));
+		}
+
+		if (event.input.type == am::InputType::DiskInsert)
+		{
+			uint64_t hash = 0;
+			bool embedded = false;
+
+			util::StreamString(reader, event.fileLocation);
+			util::StreamString(reader, event.displayName);
+			util::Stream(reader, hash);
+			util::Stream(reader, embedded);
+
+			if (embedded)
+			{
+				uint64_t size = 0;
+				uint64_t compressedSize = 0;
+				util::Stream(reader, size);
+				util::Stream(reader, compressedSize);
+
+				std::vector<uint8_t> compressed;
+				if (compressedSize > reader.Remaining())
+				{
+					reader.SetFailed();
+					break;
+				}
+				compressed.resize(size_t(compressedSize));
+				reader.Read(compressed.data(), compressed.size());
+
+				event.data.resize(size_t(size));
+				uLongf destSize = uLongf(size);
+				if (uncompress(event.data.data(), &destSize, compressed.data(), uLong(compressed.size())) != Z_OK || destSize != size)
+				{
+					reader.SetFailed();
+					break;
+				}
+			}
+			else if (!loadDisk || !loadDisk(event.fileLocation, event.data))
+			{
+				m_error = "Failed to load disk image '" + event.fileLocation + "'";
+				return false;
+			}
+
+			if (util::Fnv1a64(event.data) != hash)
+			{
+				m_error = "Disk image '" + event.fileLocation + "' is not the one recorded";
+				return false;
+			}
+		}
+
+		if (reader.Failed())
+			break;
+	}
+
+	if (reader.Failed())
+	{
+		m_error = "Movie file is corrupt";
+		return false;
+	}
+
+	std::istringstream snapshotStream(std::string(snapshot.begin(), snapshot.end()));
+	if (!amiga.ReadSnapshot(snapshotStream, loadDisk))
+	{
+		m_error = "Failed to restore the movie's starting state";
+		return false;
+	}
+
+	amiga.SetTurboFloppy(turboFloppy);
+
+	m_startCClock = amiga.GetTotalCClocks();
+
+	// Event times are relative to the start.
+	for (auto& event : m_events)
+	{
+		event.input.cclock += m_startCClock;
+	}
+
+	// A recording that was never stopped ends at its last input.
+	m_endCClock = m_startCClock + cclock;
+	if (!ended && !m_events.empty())
+	{
+		m_endCClock = m_events.back().input.cclock;
+	}
+
+	m_amiga = &amiga;
+	return true;
+}
+
+bool guru::MoviePlayer::IsFinished() const
+{
+	return !m_amiga || (m_nextEvent == m_events.size() && m_amiga->GetTotalCClocks() >= m_endCClock);
+}
+
+void guru::MoviePlayer::ApplyDueInput()
+{
+	const auto now = m_amiga->GetTotalCClocks();
+
+	while (m_nextEvent < m_events.size() && m_events[m_nextEvent].input.cclock <= now)
+	{
+		auto& event = m_events[m_nextEvent++];
+		auto& input = event.input;
+
+		switch (input.type)
+		{
+		case am::InputType::ControllerButton:
+			m_amiga->SetControllerButton(input.a, input.b, input.c != 0);
+			break;
+		case am::InputType::JoystickMove:
+			m_amiga->SetJoystickMove(input.a, input.b);
+			break;
+		case am::InputType::MouseMove:
+			m_amiga->SetMouseMove(input.a, input.b);
+			break;
+		case am::InputType::KeyPress:
+			m_amiga->QueueKeyPress(uint8_t(input.a));
+			break;
+		case am::InputType::DiskInsert:
+			m_amiga->SetDisk(input.a, event.fileLocation, event.displayName, std::vector<uint8_t>(event.data), input.b != 0);
+			break;
+		case am::InputType::DiskEject:
+			m_amiga->EjectDisk(input.a);
+			break;
+		case am::InputType::DiskWriteProtect:
+			m_amiga->SetDiskWriteProtected(input.a, input.b != 0);
+			break;
+		}
+	}
+}
+
+bool guru::MoviePlayer::ExecuteFor(uint64_t cclocks)
+{
+	if (!m_amiga)
+		return false;
+
+	const auto runTill = m_amiga->GetTotalCClocks() + cclocks;
+
+	while (m_amiga->GetTotalCClocks() < runTill)
+	{
+		ApplyDueInput();
+
+		auto stopAt = runTill;
+		if (m_nextEvent < m_events.size())
+		{
+			stopAt = std::min(stopAt, m_events[m_nextEvent].input.cclock);
+		}
+
+		if (!m_amiga->ExecuteFor(stopAt - m_amiga->GetTotalCClocks()))
+			return false;
+	}
+
+	ApplyDueInput();
+	return true;
+}
+
+bool guru::MoviePlayer::ExecuteFrame()
+{
+	if (!m_amiga)
+		return false;
+
+	const auto frame = m_amiga->GetFrameCount();
+
+	while (m_amiga->GetFrameCount() == frame)
+	{
+		ApplyDueInput();
+
+		const auto stopAt = (m_nextEvent < m_events.size()) ? m_events[m_nextEvent].input.cclock : UINT64_MAX;
+		if (!m_amiga->ExecuteFrame(stopAt))
+			return false;
+	}
+
+	ApplyDueInput();
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Amiga/amiga.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace guru
+{
+	/// Records a session as a movie: a snapshot of the starting state (with its disks embedded)
+	/// followed by every input applied to the machine, timestamped in colour clocks. Disks inserted
+	/// during the recording are stored as a file reference and content hash unless embedDisks is set.
+	class MovieRecorder : public am::InputRecorder
+	{
+	public:
+		~MovieRecorder();
+
+		bool Start(am::Amiga& amiga, const std::filesystem::path& file, bool embedDisks = false);
+		void Stop();
+
+		bool IsRecording() const
+		{
+			return m_amiga != nullptr;
+		}
+
+		virtual void RecordInput(const am::InputEvent& event) override;
+
+	private:
+		am::Amiga* m_amiga = nullptr;
+		std::ofstream m_file;
+		bool m_embedDisks = false;
+		uint64_t m_lastCClock = 0;
+	};
+
+	/// Plays back a movie. Open restores the starting state, including each disk's write protection,
+	/// and the turbo floppy setting it was recorded with; the Execute functions then run the
+	/// emulation, applying each recorded input at exactly the colour clock it was recorded at.
+	class MoviePlayer
+	{
+	public:
+		/// Fails if the movie can't be read, was recorded with a different rom, or a referenced disk
+		/// can't be loaded or doesn't match the one recorded.
+		bool Open(am::Amiga& amiga, const std::filesystem::path& file, const am::SnapshotDiskLoader& loadDisk = {});
+
+		bool ExecuteFor(uint64_t cclocks);
+		bool ExecuteFrame();
+
+		/// True once the emulation has reached the point the recording was stopped.
+		bool IsFinished() const;
+
+		uint64_t GetStartCClock() const
+		{
+			return m_startCClock;
+		}
+
+		uint64_t GetEndCClock() const
+		{
+			return m_endCClock;
+		}
+
+		const std::string& GetError() const
+		{
+			return m_error;
+		}
+
+	private:
+		struct Event
+		{
+			am::InputEvent input;
+			std::string fileLocation;
+			std::string displayName;
+			std::vector<uint8_t> data;
+		};
+
+		void ApplyDueInput();
+
+		am::Amiga* m_amiga = nullptr;
+		std::vector<Event> m_events;
+		size_t m_nextEvent = 0;
+		uint64_t m_startCClock = 0;
+		uint64_t m_endCClock = 0;
+		std::string m_error;
+	};
+}
@@ -0,0 +1,242 @@
+#include "rewind_buffer.h"
+
+#include "util/stream.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+
+guru::RewindBuffer::RewindBuffer(size_t memoryBudget, int framesPerRestorePoint, int restorePointsPerKeyframe)
+	: m_memoryBudget(memoryBudget)
+	, m_framesPerRestorePoint(std::max(framesPerRestorePoint, 1))
+	, m_restorePointsPerKeyframe(std::max(restorePointsPerKeyframe, 1))
+{
+}
+
+void guru::RewindBuffer::Clear()
+{
+	m_segments.clear();
+	m_memoryUsed = 0;
+	m_keyframeId = 0;
+}
+
+uint64_t guru::RewindBuffer::GetFramesHeld() const
+{
+	if (m_segments.empty())
+		return 0;
+
+	return m_lastCaptureFrame - m_segments.front().frame;
+}
+
+void guru::RewindBuffer::Update(am::Amiga& amiga)
+{
+	const auto frame = amiga.GetFrameCount();
+
+	if (!m_segments.empty())
+	{
+		if (frame < m_lastCaptureFrame)
+		{
+			// The machine was reset, or went back in time some other way. Start again.
+			Clear();
+		}
+		else if (frame - m_lastCaptureFrame < uint64_t(m_framesPerRestorePoint))
+		{
+			return;
+		}
+	}
+
+	m_lastCaptureFrame = frame;
+
+	const Segment* latest = m_segments.empty() ? nullptr : &m_segments.back();
+
+	if (!latest || latest->closed || latest->id != m_keyframeId || int(latest->deltas.size()) + 1 >= m_restorePointsPerKeyframe)
+	{
+		StartSegment(amiga);
+	}
+	else
+	{
+		AddDelta(amiga);
+	}
+
+	TrimToBudget();
+}
+
+bool guru::RewindBuffer::StepBack(am::Amiga& amiga)
+{
+	if (m_segments.empty())
+		return false;
+
+	auto& segment = m_segments.back();
+
+	if (!LoadKeyframe(segment))
+	{
+		Clear();
+		return false;
+	}
+
+	bool ok = false;
+
+	if (segment.deltas.empty())
+	{
+		ok = amiga.LoadState(m_keyframe);
+		m_memoryUsed -= SegmentSize(segment);
+		m_segments.pop_back();
+
+		// Deltas are only valid against the keyframe the machine last saved as its base, so
+		// continuing from here needs a new segment.
+		if (!m_segments.empty())
+		{
+			m_segments.back().closed = true;
+		}
+	}
+	else
+	{
+		ok = Decompress(segment.deltas.back());
+		if (ok)
+		{
+			util::MemoryReader reader(m_scratch.data(), m_scratch.size());
+			util::StreamVector(reader, m_delta.core);
+			util::StreamVector(reader, m_delta.chipRamPages);
+			util::StreamVector(reader, m_delta.slowRamPages);
+			util::StreamVector(reader, m_delta.pageData);
+			util::Stream(reader, m_delta.frameCount);
+			m_delta.baseGeneration = m_keyframe.baseGeneration;
+
+			ok = !reader.Failed() && amiga.LoadDeltaState(m_keyframe, m_delta);
+		}
+
+		m_memoryUsed -= segment.deltas.back().size();
+		segment.deltas.pop_back();
+
+		segment.closed = true;
+	}
+
+	if (!ok)
+	{
+		Clear();
+		return false;
+	}
+
+	m_lastCaptureFrame = amiga.GetFrameCount();
+	return true;
+}
+
+void guru::RewindBuffer::StartSegment(am::Amiga& amiga)
+{
+	if (!m_segments.empty() && m_segments.back().id == m_keyframeId && m_segments.back().keyframe.empty())
+	{
+		// Only the latest keyframe is kept uncompressed. Pack the previous one before it is
+		// overwritten.
+		auto& previous = m_segments.back();
+
+		util::MemoryWriter writer(m_scratch);
+		util::StreamVector(writer, m_keyframe.core);
+		util::StreamVector(writer, m_keyframe.chipRam);
+		util::StreamVector(writer, m_keyframe.slowRam);
+		util::Stream(writer, m_keyframe.baseGeneration);
+		util::Stream(writer, m_keyframe.frameCount);
+		Compress(previous.keyframe);
+
+		m_memoryUsed += previous.keyframe.size();
+	}
+
+	amiga.SaveBaseState(m_keyframe);
+
+	auto& segment = m_segments.emplace_back();
+	segment.id = m_nextSegmentId++;
+	segment.frame = amiga.GetFrameCount();
+	m_keyframeId = segment.id;
+}
+
+void guru::RewindBuffer::AddDelta(am::Amiga& amiga)
+{
+	amiga.SaveDeltaState(m_delta);
+
+	util::MemoryWriter writer(m_scratch);
+	util::StreamVector(writer, m_delta.core);
+	util::StreamVector(writer, m_delta.chipRamPages);
+	util::StreamVector(writer, m_delta.slowRamPages);
+	util::StreamVector(writer, m_delta.pageData);
+	util::Stream(writer, m_delta.frameCount);
+
+	auto& segment = m_segments.back();
+	Compress(segment.deltas.emplace_back());
+	m_memoryUsed += segment.deltas.back().size();
+}
+
+bool guru::RewindBuffer::LoadKeyframe(const Segment& segment)
+{
+	if (segment.id == m_keyframeId)
+		return true;
+
+	if (!Decompress(segment.keyframe))
+		return false;
+
+	util::MemoryReader reader(m_scratch.data(), m_scratch.size());
+	util::StreamVector(reader, m_keyframe.core);
+	util::StreamVector(reader, m_keyframe.chipRam);
+	util::StreamVector(reader, m_keyframe.slowRam);
+	util::Stream(reader, m_keyframe.baseGeneration);
+	util::Stream(reader, m_keyframe.frameCount);
+
+	if (reader.Failed())
+		return false;
+
+	m_keyframeId = segment.id;
+	return true;
+}
+
+void guru::RewindBuffer::TrimToBudget()
+{
+	const size_t keyframeSize = m_keyframe.core.size() + m_keyframe.chipRam.size() + m_keyframe.slowRam.size();
+
+	while (m_segments.size() > 1 && m_memoryUsed + keyframeSize > m_memoryBudget)
+	{
+		m_memoryUsed -= SegmentSize(m_segments.front());
+		m_segments.pop_front();
+	}
+}
+
+size_t guru::RewindBuffer::SegmentSize(const Segment& segment) const
+{
+	size_t size = segment.keyframe.size();
+	for (auto& delta : segment.deltas)
+	{
+		size += delta.size();
+	}
+	return size;
+}
+
+void guru::RewindBuffer::Compress(std::vector<uint8_t>& out)
+{
+	// Uncompressed size first, then the deflated data.
+	const uint64_t size = m_scratch.size();
+	uLongf compressedSize = compressBound(uLong(size));
+
+	out.resize(sizeof(size) + compressedSize);
+	memcpy(out.data(), &size, sizeof(size));
+
+	if (compress2(out.data() + sizeof(size), &compressedSize, m_scratch.data(), uLong(size), Z_BEST_SPEED) != Z_OK)
+	{
+		compressedSize = 0;
+	}
+
+	out.resize(sizeof(size) + compressedSize);
+	out.shrink_to_fit();
+}
+
+bool guru::RewindBuffer::Decompress(const std::vector<uint8_t>& in)
+{
+	uint64_t size = 0;
+	if (in.size() <= sizeof(size))
+		return false;
+
+	memcpy(&size, in.data(), sizeof(size));
+	m_scratch.resize(size_t(size));
+
+	uLongf outSize = uLongf(size);
+	if (uncompress(m_scratch.data(), &outSize, in.data() + sizeof(size), uLong(in.size() - sizeof(size))) != Z_OK)
+		return false;
+
+	return outSize == size;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Amiga/amiga.h"
+
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+namespace guru
+{
+	/// Keeps a history of recent machine states for rewinding, within a fixed memory budget.
+	///
+	/// Every few frames a restore point is captured. Restore points are grouped into segments,
+	/// each starting with a full keyframe (Amiga::SaveBaseState) followed by deltas holding only
+	/// the RAM pages written since the keyframe. Everything is zlib compressed except the keyframe
+	/// of the most recent segment, which is kept as-is so that stepping back within it only has
+	/// to inflate one small delta. When over budget the oldest segments are dropped.
+	class RewindBuffer
+	{
+	public:
+		RewindBuffer(size_t memoryBudget, int framesPerRestorePoint, int restorePointsPerKeyframe = 16);
+
+		/// Call after running the emulation. Captures a restore point when enough frames have
+		/// passed since the last one.
+		void Update(am::Amiga& amiga);
+
+		/// Restores the most recent restore point and removes it from the buffer. Returns false
+		/// if there is nothing left to rewind to.
+		bool StepBack(am::Amiga& amiga);
+
+		void Clear();
+
+		bool IsEmpty() const
+		{
+			return m_segments.empty();
+		}
+
+		size_t GetMemoryUsed() const
+		{
+			return m_memoryUsed;
+		}
+
+		/// Number of emulated frames covered by the restore points currently held.
+		uint64_t GetFramesHeld() const;
+
+	private:
+		struct Segment
+		{
+			uint64_t id = 0;
+			uint64_t frame = 0;
+			std::vector<uint8_t> keyframe; // compressed; empty while this is the latest segment
+			std::vector<std::vector<uint8_t>> deltas;
+			bool closed = false; // rewound into, so the next capture starts a new segment
+		};
+
+		void StartSegment(am::Amiga& amiga);
+		void AddDelta(am::Amiga& amiga);
+		bool LoadKeyframe(const Segment& segment);
+		void TrimToBudget();
+
+		void Compress(std::vector<uint8_t>& out);
+		bool Decompress(const std::vector<uint8_t>& in);
+
+		size_t SegmentSize(const Segment& segment) const;
+
+	private:
+		size_t m_memoryBudget;
+		int m_framesPerRestorePoint;
+		int m_restorePointsPerKeyframe;
+
+		std::deque<Segment> m_segments;
+		size_t m_memoryUsed = 0;
+		uint64_t m_nextSegmentId = 1;
+		uint64_t m_lastCaptureFrame = 0;
+
+		// Uncompressed keyframe and the id of the segment it belongs to.
+		am::SavedState m_keyframe;
+		uint64_t m_keyframeId = 0;
+
+		am::DeltaState m_delta;
+		std::vector<uint8_t> m_scratch;
+	};
+}
@@ -0,0 +1,128 @@
+#include "rom_image.h"
+
+#include "util/file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+namespace
+{
+	constexpr char cloantoRomSig[] = "AMIROMTYPE1";
+	constexpr size_t cloantoRomSigLen = std::size(cloantoRomSig) - 1;
+}
+
+std::pair<bool, std::string> guru::CheckRom(std::string_view romFile)
+{
+	if (romFile.empty())
+	{
+		return { false, "No Rom File selected." };
+	}
+
+	std::filesystem::path file(romFile);
+	const auto displayFilename = file.filename().string();
+
+	if (!std::filesystem::exists(file))
+	{
+		return { false, "Rom file does not exist." };
+	}
+
+	auto size = std::filesystem::file_size(file);
+
+	if (size == 524'288)
+	{
+		// ok, assume unencrypted rom.
+		return { true, "File OK, unencrypted." };
+	}
+
+	if (size == 524'299)
+	{
+		std::vector<uint8_t> header;
+		if (!util::LoadBinaryHeader(std::string(romFile), header, cloantoRomSigLen))
+			return { false, "Rom file unaccessible." };
+
+		if (memcmp(header.data(), cloantoRomSig, cloantoRomSigLen) != 0)
+			return { false, "Rom file has unrecognised header." };
+
+		auto romkeyFile = file.parent_path() / "rom.key";
+		if (!std::filesystem::exists(romkeyFile))
+			return { false, "Rom encrypted but no rom.key file found." };
+
+		return { true, "File OK, encrypted." };
+	}
+
+	// Reject rom of any other size.
+	return { false, "Rom file was unexpected size (expected 512Kib)" };
+}
+
+std::vector<uint8_t> guru::LoadRom(const std::string& romFile)
+{
+	std::filesystem::path file(romFile);
+	const auto displayFilename = file.filename().string();
+
+	std::vector<uint8_t> rom;
+	if (!util::LoadBinaryFile(romFile, rom))
+	{
+		printf("ERROR: rom '%s' not loaded.\n", displayFilename.c_str());
+		return rom;
+	}
+
+	if (rom.size() < cloantoRomSigLen
+		|| memcmp(rom.data(), cloantoRomSig, cloantoRomSigLen) != 0)
+	{
+		printf("INFO : Rom file '%s' is unencrypted\n", displayFilename.c_str());
+		printf("INFO : Rom size %zu bytes.\n", rom.size());
+		return rom;
+	}
+
+	// It's a scrambled Cloanto rom file. Locate rom.key file to decrypt
+
+	auto romkeyFile = file.parent_path() / "rom.key";
+	std::vector<uint8_t> romkey;
+
+	if (!util::LoadBinaryFile(romkeyFile.string(), romkey))
+	{
+		printf("ERROR: rom '%s' was encypted but rom.key file not available (must be in same directory).\n", displayFilename.c_str());
+		return rom;
+	}
+
+	if (romkey.empty())
+	{
+		printf("ERROR: rom '%s' was encypted but rom.key file failed to load or was empty.\n", displayFilename.c_str());
+	}
+
+	size_t writePtr = 0;
+	size_t readPtr = cloantoRomSigLen;
+	size_t keyPtr = 0;
+
+	while (readPtr < rom.size())
+	{
+		rom[writePtr++] = rom[readPtr++] ^ romkey[keyPtr++];
+		if (keyPtr == romkey.size())
+			keyPtr = 0;
+	}
+
+	rom.resize(writePtr);
+
+	printf("INFO : Rom file '%s' successfully decrypted.\n", displayFilename.c_str());
+	printf("INFO : Rom size %zu bytes.\n", rom.size());
+	return rom;
+}
+
+std::shared_ptr<const util::MappedFile> guru::MapRom(const std::string& romFile)
+{
+	auto mapped = util::MappedFile::Open(romFile);
+	if (!mapped)
+		return nullptr;
+
+	const auto rom = mapped->GetData();
+	if (rom.size() >= cloantoRomSigLen
+		&& memcmp(rom.data(), cloantoRomSig, cloantoRomSigLen) == 0)
+		return nullptr;
+
+	const auto displayFilename = std::filesystem::path(romFile).filename().string();
+	printf("INFO : Rom file '%s' is unencrypted, mapped\n", displayFilename.c_str());
+	printf("INFO : Rom size %zu bytes.\n", rom.size());
+	return mapped;
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "util/mapped_file.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace guru
+{
+	/// Checks a kickstart rom file is usable. Returns success and a description of the rom status.
+	std::pair<bool, std::string> CheckRom(std::string_view romFile);
+
+	/// Loads a kickstart rom file, decrypting it with the accompanying rom.key if necessary.
+	std::vector<uint8_t> LoadRom(const std::string& romFile);
+
+	/// Maps an unencrypted kickstart rom file into memory so it can be shared (see
+	/// am::Amiga::SetRom). Returns null if the rom is encrypted or can't be mapped, in which case
+	/// it must be loaded with LoadRom instead.
+	std::shared_ptr<const util::MappedFile> MapRom(const std::string& romFile);
+}
\ No newline at end of file
@@ -16,13 +16,23 @@ __forceinline uint32_t SwapEndian(uint32_t v)
 	return _byteswap_ulong(v);
 }
 
-#else
+#elif defined(__GNUC__) || defined(__clang__)
 
-// TODO : intrinsic endian swap functions for other compilers/architectures
+inline uint16_t SwapEndian(uint16_t v)
+{
+	return __builtin_bswap16(v);
+}
+
+inline uint32_t SwapEndian(uint32_t v)
+{
+	return __builtin_bswap32(v);
+}
+
+#else
 
-inline SwapEndian(uint16_t v)
+inline uint16_t SwapEndian(uint16_t v)
 {
-	return (((v >> 8) & 0xff) | ((v & 0xff) << 8));
+	return uint16_t(((v >> 8) & 0xff) | ((v & 0xff) << 8));
 }
 
 inline uint32_t SwapEndian(uint32_t v)
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <span>
+#include <stdint.h>
+
+namespace util
+{
+	constexpr uint64_t kFnv1aOffsetBasis = 0xcbf29ce484222325;
+	constexpr uint64_t kFnv1aPrime = 0x100000001b3;
+
+	// 64-bit FNV-1a hash. Fast and stable across platforms; used for identifying frames, roms and disk images.
+	// Not suitable for anything security related.
+	inline uint64_t Fnv1a64(std::span<const uint8_t> data, uint64_t hash = kFnv1aOffsetBasis)
+	{
+		for (auto b : data)
+		{
+			hash ^= b;
+			hash *= kFnv1aPrime;
+		}
+		return hash;
+	}
+}
\ No newline at end of file
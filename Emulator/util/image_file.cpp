@@ -0,0 +1,75 @@
+#include "image_file.h"
+
+#include <zlib.h>
+
+#include <fstream>
+#include <vector>
+
+namespace
+{
+	void AppendBigEndian32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(uint8_t(value >> 24));
+		out.push_back(uint8_t(value >> 16));
+		out.push_back(uint8_t(value >> 8));
+		out.push_back(uint8_t(value));
+	}
+
+	void WriteChunk(std::ofstream& os, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> header;
+		AppendBigEndian32(header, uint32_t(data.size()));
+		header.insert(header.end(), type, type + 4);
+		os.write(reinterpret_cast<const char*>(header.data()), header.size());
+		os.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+		uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+		crc = crc32(crc, data.data(), uInt(data.size()));
+
+		std::vector<uint8_t> footer;
+		AppendBigEndian32(footer, uint32_t(crc));
+		os.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+	}
+}
+
+bool util::SavePng(const std::string& filename, int width, int height, const uint32_t* pixels)
+{
+	std::ofstream os(filename, std::ios::out | std::ios::binary);
+	if (!os.is_open())
+		return false;
+
+	static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	os.write(reinterpret_cast<const char*>(kSignature), sizeof(kSignature));
+
+	std::vector<uint8_t> ihdr;
+	AppendBigEndian32(ihdr, uint32_t(width));
+	AppendBigEndian32(ihdr, uint32_t(height));
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(6); // colour type: RGBA
+	ihdr.push_back(0); // compression method
+	ihdr.push_back(0); // filter method
+	ihdr.push_back(0); // no interlace
+	WriteChunk(os, "IHDR", ihdr);
+
+	// Each scanline is prefixed with its filter type (0 = none).
+	const size_t rowBytes = size_t(width) * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((rowBytes + 1) * height);
+	for (int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		auto row = reinterpret_cast<const uint8_t*>(pixels + size_t(y) * width);
+		raw.insert(raw.end(), row, row + rowBytes);
+	}
+
+	uLongf compressedSize = compressBound(uLong(raw.size()));
+	std::vector<uint8_t> idat(compressedSize);
+	if (compress2(idat.data(), &compressedSize, raw.data(), uLong(raw.size()), Z_BEST_SPEED) != Z_OK)
+		return false;
+	idat.resize(compressedSize);
+	WriteChunk(os, "IDAT", idat);
+
+	WriteChunk(os, "IEND", {});
+
+	return os.good();
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+namespace util
+{
+	/// Saves 32-bit pixels (in memory byte order R, G, B, A) as a PNG file.
+	bool SavePng(const std::string& filename, int width, int height, const uint32_t* pixels);
+}
\ No newline at end of file
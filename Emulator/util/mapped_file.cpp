@@ -0,0 +1,98 @@
+#include "mapped_file.h"
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <filesystem>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const util::MappedFile> util::MappedFile::Open(const std::string& filename)
+{
+	std::shared_ptr<MappedFile> mapped(new MappedFile);
+
+#ifdef _MSC_VER
+
+	const auto path = std::filesystem::path(filename).wstring();
+
+	HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	mapped->m_file = file;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		return nullptr;
+
+	HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+		return nullptr;
+
+	mapped->m_mapping = mapping;
+
+	void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+		return nullptr;
+
+	mapped->m_data = static_cast<const uint8_t*>(data);
+	mapped->m_size = size_t(size.QuadPart);
+
+#else
+
+	const int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat info;
+	if (::fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return nullptr;
+	}
+
+	// The mapping holds its own reference to the file.
+	void* data = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if (data == MAP_FAILED)
+		return nullptr;
+
+	mapped->m_data = static_cast<const uint8_t*>(data);
+	mapped->m_size = size_t(info.st_size);
+
+#endif
+
+	return mapped;
+}
+
+util::MappedFile::~MappedFile()
+{
+#ifdef _MSC_VER
+
+	if (m_data)
+	{
+		::UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		::CloseHandle(m_mapping);
+	}
+	if (m_file)
+	{
+		::CloseHandle(m_file);
+	}
+
+#else
+
+	if (m_data)
+	{
+		::munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+
+#endif
+}
\ No newline at end of file
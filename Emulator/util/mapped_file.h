@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string>
+#include <stdint.h>
+
+namespace util
+{
+	/// A whole file mapped read-only into memory. Pages are only read in when touched and are
+	/// shared with every other mapping of the file, in this process or any other, so many
+	/// emulator instances using the same rom or disk cost no more memory than one.
+	class MappedFile
+	{
+	public:
+		/// Returns null if the file can't be opened or mapped (or is empty).
+		static std::shared_ptr<const MappedFile> Open(const std::string& filename);
+
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		std::span<const uint8_t> GetData() const
+		{
+			return { m_data, m_size };
+		}
+
+	private:
+		MappedFile() = default;
+
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+
+#ifdef _MSC_VER
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
\ No newline at end of file
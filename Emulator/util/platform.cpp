@@ -2,6 +2,30 @@
 
 #ifdef _MSC_VER
 #include <shlobj_core.h>
+#else
+#include <cstdlib>
+#endif
+
+#ifndef _MSC_VER
+namespace
+{
+	// Follows the XDG base directory spec: use the environment variable if set,
+	// otherwise fall back to the given directory relative to $HOME.
+	std::filesystem::path GetXdgDirectory(const char* envVar, const char* homeRelative)
+	{
+		if (const char* dir = std::getenv(envVar); dir && *dir)
+		{
+			return std::filesystem::path(dir);
+		}
+
+		if (const char* home = std::getenv("HOME"); home && *home)
+		{
+			return std::filesystem::path(home) / homeRelative;
+		}
+
+		return std::filesystem::temp_directory_path();
+	}
+}
 #endif
 
 std::filesystem::path util::GetLocalDataDirectory()
@@ -21,7 +45,9 @@ std::filesystem::path util::GetLocalDataDirectory()
 	return path;
 
 #else
-#	error "Implement util::GetLocalDataDirectory"
+
+	return GetXdgDirectory("XDG_DATA_HOME", ".local/share");
+
 #endif
 }
 
@@ -41,6 +67,8 @@ std::filesystem::path util::GetAppDataDirectory()
 	return path;
 
 #else
-#	error "Implement util::GetAppDataDirectory"
+
+	return GetXdgDirectory("XDG_CONFIG_HOME", ".config");
+
 #endif
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <istream>
 #include <ostream>
 #include <vector>
+#include <cstring>
+#include <stdint.h>
 
 namespace util
 {
@@ -53,4 +55,132 @@ namespace util
 		str = chars.data();
 	}
 
+	/// Appends to a memory buffer. Clears the buffer first but keeps its capacity, so saving
+	/// into the same buffer repeatedly doesn't allocate.
+	class MemoryWriter
+	{
+	public:
+		explicit MemoryWriter(std::vector<uint8_t>& buffer)
+			: m_buffer(buffer)
+		{
+			m_buffer.clear();
+		}
+
+		void Write(const void* data, size_t size)
+		{
+			if (size == 0)
+				return;
+
+			// Grown then copied into, rather than inserted, as GCC's inlining of insert()
+			// leads it to false -Wstringop-overflow warnings.
+			const size_t pos = m_buffer.size();
+			m_buffer.resize(pos + size);
+			memcpy(m_buffer.data() + pos, data, size);
+		}
+
+	private:
+		std::vector<uint8_t>& m_buffer;
+	};
+
+	/// Reads from a memory buffer written by MemoryWriter. Reading past the end zero fills and
+	/// marks the reader as failed.
+	class MemoryReader
+	{
+	public:
+		MemoryReader(const uint8_t* data, size_t size)
+			: m_data(data)
+			, m_size(size)
+		{
+		}
+
+		void Read(void* data, size_t size)
+		{
+			if (size > m_size - m_pos)
+			{
+				memset(data, 0, size);
+				SetFailed();
+				return;
+			}
+
+			memcpy(data, m_data + m_pos, size);
+			m_pos += size;
+		}
+
+		size_t Remaining() const
+		{
+			return m_size - m_pos;
+		}
+
+		bool Failed() const
+		{
+			return m_failed;
+		}
+
+		void SetFailed()
+		{
+			m_pos = m_size;
+			m_failed = true;
+		}
+
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_pos = 0;
+		bool m_failed = false;
+	};
+
+	template <typename T>
+	void Stream(MemoryWriter& w, const T& v)
+	{
+		w.Write(&v, sizeof(T));
+	}
+
+	template <typename T>
+	void Stream(MemoryReader& r, T& v)
+	{
+		r.Read(&v, sizeof(T));
+	}
+
+	template <typename T>
+	void StreamVector(MemoryWriter& w, const std::vector<T>& v)
+	{
+		const size_t size = v.size();
+		w.Write(&size, sizeof(size));
+		w.Write(v.data(), size * sizeof(T));
+	}
+
+	template <typename T>
+	void StreamVector(MemoryReader& r, std::vector<T>& v)
+	{
+		size_t len = 0;
+		r.Read(&len, sizeof(len));
+		if (len > r.Remaining() / sizeof(T))
+		{
+			r.SetFailed();
+			return;
+		}
+		v.resize(len);
+		r.Read(v.data(), len * sizeof(T));
+	}
+
+	inline void StreamString(MemoryWriter& w, std::string_view str)
+	{
+		const size_t len = str.length();
+		w.Write(&len, sizeof(len));
+		w.Write(str.data(), len);
+	}
+
+	inline void StreamString(MemoryReader& r, std::string& str)
+	{
+		size_t len = 0;
+		r.Read(&len, sizeof(len));
+		if (len > r.Remaining())
+		{
+			r.SetFailed();
+			return;
+		}
+		str.resize(len);
+		r.Read(str.data(), len);
+	}
+
 }
\ No newline at end of file
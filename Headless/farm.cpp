@@ -0,0 +1,671 @@
+// guru-farm : compatibility regression runs over a collection of disk images.
+//
+// Boots every ADF in a directory (or zip archive) on its own worker thread, runs each for a fixed
+// number of frames while applying a shared input script, and hashes the screen at regular
+// checkpoints. The hashes and run times are compared against a stored baseline so that both
+// emulation changes and performance regressions show up in a single report.
+//
+// An input script is a text file with one input per line, applied at the start of the given frame:
+//
+//   # frame  input
+//   250      key 40 down           (amiga keycode in hex)
+//   255      key 40 up
+//   300      button 1 0 down       (controller, button)
+//   400      joystick 1 0          (x, y: -1, 0 or 1)
+//   500      mouse 20 -5           (relative move)
+//
+// A baseline is a tab separated text file of "title, frame, hash" lines plus a "title, time,
+// seconds" line per title, as written by --write-baseline.
+
+#include "Amiga/amiga.h"
+#include "rom_image.h"
+#include "boot_cache.h"
+#include "batch_runner.h"
+#include "util/file.h"
+#include "util/hash.h"
+#include "util/log.h"
+#include "util/mapped_file.h"
+#include "util/strings.h"
+
+#if defined(GURU_FARM_ZIP)
+#include "disk_image.h"
+#endif
+
+#include "3rd Party/cxxopts.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int PAL_CClockFreq = 3546895;
+
+	std::optional<am::ChipRamConfig> ChipRamFromKib(int kib)
+	{
+		switch (kib)
+		{
+		case 256: return am::ChipRamConfig::ChipRam256k;
+		case 512: return am::ChipRamConfig::ChipRam512k;
+		case 1024: return am::ChipRamConfig::ChipRam1Mib;
+		case 2048: return am::ChipRamConfig::ChipRam2Mib;
+		default: return std::nullopt;
+		}
+	}
+
+	struct Title
+	{
+		std::string name;
+		std::filesystem::path file;
+		std::string archFile; // entry within a zip archive, or empty
+	};
+
+	enum class InputAction
+	{
+		Key,
+		Button,
+		Joystick,
+		Mouse,
+	};
+
+	struct ScriptedInput
+	{
+		uint64_t frame;
+		InputAction action;
+		int a;
+		int b;
+		bool down;
+	};
+
+	struct Baseline
+	{
+		std::map<uint64_t, uint64_t> hashes;
+		std::optional<double> time;
+	};
+
+	struct TitleResult
+	{
+		bool loaded = false;
+		std::optional<uint64_t> stoppedAtFrame;
+		std::vector<std::pair<uint64_t, uint64_t>> hashes;
+		double hostTime = 0.0;
+		double emulatedTime = 0.0;
+	};
+
+	bool IsAdf(const std::filesystem::path& path)
+	{
+		return util::ToLower(path.extension().string()) == ".adf";
+	}
+
+	bool IsZip(const std::filesystem::path& path)
+	{
+		return util::ToLower(path.extension().string()) == ".zip";
+	}
+
+	void AddTitlesFromZip(const std::filesystem::path& zip, std::vector<Title>& titles)
+	{
+#if defined(GURU_FARM_ZIP)
+		for (auto& entry : guru::ListFilesFromZip(zip, ".ADF"))
+		{
+			titles.push_back({ zip.filename().string() + "::" + entry, zip, entry });
+		}
+#else
+		printf("Warning : built without zip support, skipping '%s'\n", zip.string().c_str());
+#endif
+	}
+
+	std::vector<Title> FindTitles(const std::filesystem::path& collection)
+	{
+		std::vector<Title> titles;
+
+		if (IsZip(collection))
+		{
+			AddTitlesFromZip(collection, titles);
+			return titles;
+		}
+
+		std::error_code ec;
+		for (auto& entry : std::filesystem::recursive_directory_iterator(collection, ec))
+		{
+			if (!entry.is_regular_file())
+				continue;
+
+			const auto& path = entry.path();
+			if (IsAdf(path))
+			{
+				titles.push_back({ std::filesystem::relative(path, collection).generic_string(), path, {} });
+			}
+			else if (IsZip(path))
+			{
+				AddTitlesFromZip(path, titles);
+			}
+		}
+
+		std::sort(titles.begin(), titles.end(), [](const Title& a, const Title& b) { return a.name < b.name; });
+		return titles;
+	}
+
+	bool InsertTitle(am::Amiga& amiga, const Title& title)
+	{
+		// Plain images are mapped rather than loaded, so titles that are never written to share the
+		// file's pages instead of each worker holding its own copy.
+		if (title.archFile.empty())
+			return amiga.SetDisk(0, title.file.string(), title.name, util::MappedFile::Open(title.file.string()));
+
+#if defined(GURU_FARM_ZIP)
+		std::vector<uint8_t> data;
+		std::string name;
+		if (!guru::LoadDiskImage(title.file, title.archFile, data, name))
+			return false;
+
+		return amiga.SetDisk(0, title.file.string() + "::" + title.archFile, title.name, std::move(data));
+#else
+		return false;
+#endif
+	}
+
+	bool LoadInputScript(const std::string& file, std::vector<ScriptedInput>& script)
+	{
+		std::ifstream in(file);
+		if (!in.is_open())
+			return false;
+
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(in, line))
+		{
+			lineNumber++;
+
+			if (auto comment = line.find('#'); comment != std::string::npos)
+			{
+				line.resize(comment);
+			}
+
+			std::istringstream ss(line);
+			uint64_t frame;
+			std::string action;
+			if (!(ss >> frame >> action))
+				continue;
+
+			ScriptedInput input = { frame, InputAction::Key, 0, 0, false };
+			std::string state;
+			bool ok = false;
+
+			if (action == "key")
+			{
+				input.action = InputAction::Key;
+				ok = bool(ss >> std::hex >> input.a >> state);
+			}
+			else if (action == "button")
+			{
+				input.action = InputAction::Button;
+				ok = bool(ss >> input.a >> input.b >> state);
+			}
+			else if (action == "joystick")
+			{
+				input.action = InputAction::Joystick;
+				ok = bool(ss >> input.a >> input.b);
+			}
+			else if (action == "mouse")
+			{
+				input.action = InputAction::Mouse;
+				ok = bool(ss >> input.a >> input.b);
+			}
+
+			if (!state.empty())
+			{
+				input.down = (state == "down");
+				ok = ok && (state == "down" || state == "up");
+			}
+
+			if (!ok)
+			{
+				printf("Error : can't parse input script line %d : '%s'\n", lineNumber, line.c_str());
+				return false;
+			}
+
+			script.push_back(input);
+		}
+
+		std::stable_sort(script.begin(), script.end(), [](const ScriptedInput& a, const ScriptedInput& b) { return a.frame < b.frame; });
+		return true;
+	}
+
+	void ApplyInput(am::Amiga& amiga, const ScriptedInput& input)
+	{
+		switch (input.action)
+		{
+		case InputAction::Key:
+			amiga.QueueKeyPress(uint8_t(input.a | (input.down ? 0x00 : 0x80)));
+			break;
+		case InputAction::Button:
+			amiga.SetControllerButton(input.a, input.b, input.down);
+			break;
+		case InputAction::Joystick:
+			amiga.SetJoystickMove(input.a, input.b);
+			break;
+		case InputAction::Mouse:
+			amiga.SetMouseMove(input.a, input.b);
+			break;
+		}
+	}
+
+	bool LoadBaseline(const std::string& file, std::map<std::string, Baseline>& baseline)
+	{
+		std::ifstream in(file);
+		if (!in.is_open())
+			return false;
+
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(in, line))
+		{
+			lineNumber++;
+
+			auto [name, rest] = util::SplitOn(line, "\t");
+			auto [key, value] = util::SplitOn(rest, "\t");
+			if (name.empty() || key.empty() || value.empty())
+				continue;
+
+			try
+			{
+				auto& entry = baseline[std::string(name)];
+				if (key == "time")
+				{
+					entry.time = std::stod(std::string(value));
+				}
+				else
+				{
+					entry.hashes[std::stoull(std::string(key))] = std::stoull(std::string(value), nullptr, 16);
+				}
+			}
+			catch (const std::logic_error&)
+			{
+				// std::invalid_argument or std::out_of_range
+				printf("Error : can't parse baseline line %d : '%s'\n", lineNumber, line.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Mapped when possible, so every worker runs from the same copy of the rom. Encrypted roms
+	// have to be decrypted into memory.
+	struct Rom
+	{
+		std::shared_ptr<const util::MappedFile> file;
+		std::vector<uint8_t> data;
+
+		void SetOn(am::Amiga& amiga) const
+		{
+			if (file)
+			{
+				amiga.SetRom(file);
+			}
+			else
+			{
+				amiga.SetRom(data);
+			}
+		}
+	};
+
+	struct RunOptions
+	{
+		am::ChipRamConfig chipRam;
+		std::string bootCacheDir;
+		uint64_t numFrames;
+		int checkpoint;
+		bool turboFloppy;
+	};
+
+	TitleResult RunTitle(const Title& title, const Rom& rom, const RunOptions& options, const std::vector<ScriptedInput>& script)
+	{
+		TitleResult result;
+
+		util::Log log(16);
+		am::Amiga amiga(options.chipRam, &log);
+		rom.SetOn(amiga);
+		amiga.SetTurboFloppy(options.turboFloppy);
+
+		if (!InsertTitle(amiga, title))
+			return result;
+
+		result.loaded = true;
+
+		if (!options.bootCacheDir.empty())
+		{
+			guru::FastBoot(amiga, options.bootCacheDir);
+		}
+
+		amiga.SetFrameSkip(options.checkpoint - 1);
+
+		const auto startTime = std::chrono::steady_clock::now();
+		const auto startCClocks = amiga.GetTotalCClocks();
+
+		auto nextInput = script.begin();
+		for (uint64_t frame = 0; frame < options.numFrames; frame++)
+		{
+			for (; nextInput != script.end() && nextInput->frame <= frame; ++nextInput)
+			{
+				ApplyInput(amiga, *nextInput);
+			}
+
+			if (!amiga.ExecuteFrame())
+			{
+				result.stoppedAtFrame = frame;
+				break;
+			}
+
+			if ((frame % options.checkpoint) != 0)
+				continue;
+
+			const auto* screen = amiga.GetScreen();
+			const auto hash = util::Fnv1a64({ reinterpret_cast<const uint8_t*>(screen->data()), screen->size() * sizeof(am::ColourRef) });
+			result.hashes.emplace_back(frame, hash);
+		}
+
+		const std::chrono::duration<double> hostTime = std::chrono::steady_clock::now() - startTime;
+		result.hostTime = hostTime.count();
+		result.emulatedTime = double(amiga.GetTotalCClocks() - startCClocks) / PAL_CClockFreq;
+
+		return result;
+	}
+
+	enum class Verdict
+	{
+		Pass,
+		New,
+		Changed,
+		Slower,
+		Failed,
+	};
+
+	Verdict Judge(const TitleResult& result, const Baseline* baseline, double slowdownTolerance, std::string& detail)
+	{
+		if (!result.loaded)
+		{
+			detail = "can't load disk image";
+			return Verdict::Failed;
+		}
+
+		if (result.stoppedAtFrame)
+		{
+			detail = "emulation stopped at frame " + std::to_string(*result.stoppedAtFrame);
+			return Verdict::Failed;
+		}
+
+		if (!baseline)
+			return Verdict::New;
+
+		for (auto& [frame, hash] : result.hashes)
+		{
+			auto it = baseline->hashes.find(frame);
+			if (it == baseline->hashes.end())
+				continue;
+
+			if (it->second != hash)
+			{
+				detail = "first differs at frame " + std::to_string(frame);
+				return Verdict::Changed;
+			}
+		}
+
+		if (baseline->time && *baseline->time > 0.0 && result.hostTime > *baseline->time * (1.0 + slowdownTolerance))
+		{
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), "%+.0f%% time", (result.hostTime / *baseline->time - 1.0) * 100.0);
+			detail = buffer;
+			return Verdict::Slower;
+		}
+
+		return Verdict::Pass;
+	}
+
+	const char* VerdictName(Verdict verdict)
+	{
+		switch (verdict)
+		{
+		case Verdict::Pass: return "pass";
+		case Verdict::New: return "new";
+		case Verdict::Changed: return "CHANGED";
+		case Verdict::Slower: return "SLOWER";
+		case Verdict::Failed: return "FAILED";
+		}
+		return "?";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string romFile;
+	std::string collection;
+	std::string inputFile;
+	std::string baselineFile;
+	std::string writeBaselineFile;
+	std::string reportFile;
+	std::string bootCacheDir;
+	uint64_t numFrames = 0;
+	int checkpoint = 50;
+	int chipRamKib = 512;
+	int numThreads = 0;
+	double slowdownTolerance = 0.0;
+	bool turboFloppy = false;
+
+	cxxopts::Options options("guru-farm", "Guru Amiga Emulator compatibility regression runner");
+	options.add_options()
+		("r,rom", "kickstart rom file", cxxopts::value<std::string>()->default_value(""))
+		("d,disks", "directory (searched recursively) or zip archive of ADF disk images to run", cxxopts::value<std::string>()->default_value(""))
+		("i,inputs", "input script applied to every title", cxxopts::value<std::string>()->default_value(""))
+		("f,frames", "number of frames to run each title for", cxxopts::value<uint64_t>()->default_value("1500"))
+		("c,checkpoint", "hash the screen every Nth frame (intermediate frames are not drawn)", cxxopts::value<int>()->default_value("50"))
+		("chipram", "chip ram size in KiB (256, 512, 1024 or 2048)", cxxopts::value<int>()->default_value("512"))
+		("j,threads", "number of titles to run at once (0 = one per hardware thread)", cxxopts::value<int>()->default_value("0"))
+		("baseline", "compare against this baseline", cxxopts::value<std::string>()->default_value(""))
+		("write-baseline", "write the results of this run as a new baseline", cxxopts::value<std::string>()->default_value(""))
+		("slowdown", "percentage a title's run time may exceed its baseline time before it is reported", cxxopts::value<double>()->default_value("25"))
+		("report", "also write the report to this file", cxxopts::value<std::string>()->default_value(""))
+		("turbo-floppy", "complete disk transfers instantly and spin disks faster")
+		("boot-cache", "skip the start of the kickstart boot using a state cached in this directory", cxxopts::value<std::string>()->default_value(""))
+		("h,help", "show help");
+
+	try
+	{
+		auto result = options.parse(argc, argv);
+		if (result.count("help"))
+		{
+			printf("%s\n", options.help().c_str());
+			return 0;
+		}
+
+		romFile = result["rom"].as<std::string>();
+		collection = result["disks"].as<std::string>();
+		inputFile = result["inputs"].as<std::string>();
+		numFrames = result["frames"].as<uint64_t>();
+		checkpoint = result["checkpoint"].as<int>();
+		chipRamKib = result["chipram"].as<int>();
+		numThreads = result["threads"].as<int>();
+		baselineFile = result["baseline"].as<std::string>();
+		writeBaselineFile = result["write-baseline"].as<std::string>();
+		slowdownTolerance = result["slowdown"].as<double>() / 100.0;
+		reportFile = result["report"].as<std::string>();
+		bootCacheDir = result["boot-cache"].as<std::string>();
+		turboFloppy = result.count("turbo-floppy") != 0;
+	}
+	catch (cxxopts::OptionParseException& e)
+	{
+		printf("Error : %s\n\n", e.what());
+		printf("%s\n", options.help().c_str());
+		return -1;
+	}
+
+	const auto chipRam = ChipRamFromKib(chipRamKib);
+	if (romFile.empty() || collection.empty() || !chipRam || checkpoint < 1)
+	{
+		printf("%s\n", options.help().c_str());
+		return -1;
+	}
+
+	auto [romOk, romStatus] = guru::CheckRom(romFile);
+	if (!romOk)
+	{
+		printf("Error : %s\n", romStatus.c_str());
+		return 1;
+	}
+
+	Rom rom;
+	rom.file = guru::MapRom(romFile);
+	if (!rom.file)
+	{
+		rom.data = guru::LoadRom(romFile);
+	}
+
+	if (!rom.file && rom.data.empty())
+	{
+		printf("Error : failed to load rom '%s'\n", romFile.c_str());
+		return 1;
+	}
+
+	std::vector<ScriptedInput> script;
+	if (!inputFile.empty() && !LoadInputScript(inputFile, script))
+	{
+		printf("Error : failed to load input script '%s'\n", inputFile.c_str());
+		return 1;
+	}
+
+	const auto titles = FindTitles(collection);
+	if (titles.empty())
+	{
+		printf("Error : no disk images found in '%s'\n", collection.c_str());
+		return 1;
+	}
+
+	std::map<std::string, Baseline> baseline;
+	if (!baselineFile.empty() && !LoadBaseline(baselineFile, baseline))
+	{
+		printf("Error : failed to load baseline '%s'\n", baselineFile.c_str());
+		return 1;
+	}
+
+	if (!bootCacheDir.empty())
+	{
+		// Fill the cache up front so the workers only ever read it.
+		util::Log log(16);
+		am::Amiga amiga(*chipRam, &log);
+		rom.SetOn(amiga);
+		if (!guru::FastBoot(amiga, bootCacheDir))
+		{
+			printf("Warning : fast boot not possible with this rom, booting normally\n");
+			bootCacheDir.clear();
+		}
+	}
+
+	const RunOptions runOptions = { *chipRam, bootCacheDir, numFrames, checkpoint, turboFloppy };
+
+	std::vector<TitleResult> results(titles.size());
+	std::mutex printMutex;
+	size_t numFinished = 0;
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	{
+		guru::BatchRunner runner(numThreads);
+		printf("Running %zu titles for %llu frames on %d threads\n", titles.size(), (unsigned long long)numFrames, runner.GetNumThreads());
+
+		for (size_t i = 0; i < titles.size(); i++)
+		{
+			runner.Submit([&, i]()
+			{
+				results[i] = RunTitle(titles[i], rom, runOptions, script);
+
+				std::lock_guard lock(printMutex);
+				printf("[%zu/%zu] %s (%.1fs)\n", ++numFinished, titles.size(), titles[i].name.c_str(), results[i].hostTime);
+			});
+		}
+
+		runner.Wait();
+	}
+
+	const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - startTime;
+
+	// Report
+
+	std::ostringstream report;
+	std::map<Verdict, int> counts;
+	double totalHostTime = 0.0;
+	double totalEmulatedTime = 0.0;
+
+	char line[512];
+	snprintf(line, sizeof(line), "%-8s %8s %8s  %-40s %s\n", "result", "time", "speed", "title", "detail");
+	report << line;
+
+	for (size_t i = 0; i < titles.size(); i++)
+	{
+		const auto& result = results[i];
+		auto it = baseline.find(titles[i].name);
+
+		std::string detail;
+		const auto verdict = Judge(result, it != baseline.end() ? &it->second : nullptr, slowdownTolerance, detail);
+		counts[verdict]++;
+
+		totalHostTime += result.hostTime;
+		totalEmulatedTime += result.emulatedTime;
+
+		const double speed = result.hostTime > 0.0 ? result.emulatedTime / result.hostTime : 0.0;
+		snprintf(line, sizeof(line), "%-8s %7.2fs %7.1fx  %-40s %s\n", VerdictName(verdict), result.hostTime, speed, titles[i].name.c_str(), detail.c_str());
+		report << line;
+	}
+
+	snprintf(line, sizeof(line), "\n%zu titles : %d pass, %d new, %d changed, %d slower, %d failed\n", titles.size(),
+		counts[Verdict::Pass], counts[Verdict::New], counts[Verdict::Changed], counts[Verdict::Slower], counts[Verdict::Failed]);
+	report << line;
+	snprintf(line, sizeof(line), "%.1fs emulated, %.1fs total run time, %.1fs wall clock (%.1fx realtime overall)\n",
+		totalEmulatedTime, totalHostTime, wallTime.count(), wallTime.count() > 0.0 ? totalEmulatedTime / wallTime.count() : 0.0);
+	report << line;
+
+	printf("\n%s", report.str().c_str());
+
+	if (!reportFile.empty())
+	{
+		std::ofstream out(reportFile);
+		out << report.str();
+		if (!out)
+		{
+			printf("Error : failed to write '%s'\n", reportFile.c_str());
+		}
+	}
+
+	if (!writeBaselineFile.empty())
+	{
+		std::ofstream out(writeBaselineFile);
+		for (size_t i = 0; i < titles.size(); i++)
+		{
+			if (!results[i].loaded || results[i].stoppedAtFrame)
+				continue;
+
+			for (auto& [frame, hash] : results[i].hashes)
+			{
+				snprintf(line, sizeof(line), "%s\t%llu\t%016llx\n", titles[i].name.c_str(), (unsigned long long)frame, (unsigned long long)hash);
+				out << line;
+			}
+			snprintf(line, sizeof(line), "%s\ttime\t%.3f\n", titles[i].name.c_str(), results[i].hostTime);
+			out << line;
+		}
+		if (!out)
+		{
+			printf("Error : failed to write '%s'\n", writeBaselineFile.c_str());
+		}
+	}
+
+	const bool regressed = counts[Verdict::Changed] + counts[Verdict::Slower] + counts[Verdict::Failed] > 0;
+	return regressed ? 2 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,293 @@
+// guru-headless : runs the emulation core without a window, GUI or audio device.
+//
+// Boots a kickstart rom (optionally with floppy images inserted), runs a fixed number of
+// frames as fast as possible and optionally writes per-frame hashes, screenshots and audio.
+
+#include "Amiga/amiga.h"
+#include "rom_image.h"
+#include "boot_cache.h"
+#include "movie.h"
+#include "util/file.h"
+#include "util/hash.h"
+#include "util/image_file.h"
+#include "util/log.h"
+#include "util/mapped_file.h"
+
+#include "wav_writer.h"
+
+#include "3rd Party/cxxopts.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr int PAL_CClockFreq = 3546895;
+	constexpr int kNeverDraw = 1 << 30;
+
+	std::optional<am::ChipRamConfig> ChipRamFromKib(int kib)
+	{
+		switch (kib)
+		{
+		case 256: return am::ChipRamConfig::ChipRam256k;
+		case 512: return am::ChipRamConfig::ChipRam512k;
+		case 1024: return am::ChipRamConfig::ChipRam1Mib;
+		case 2048: return am::ChipRamConfig::ChipRam2Mib;
+		default: return std::nullopt;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string romFile;
+	std::string diskFile[4];
+	std::string hardDiskFile;
+	std::string hostDir;
+	uint64_t numFrames = 0;
+	int every = 1;
+	int chipRamKib = 512;
+	std::string hashFile;
+	std::string screenshotDir;
+	std::string audioFile;
+	std::string bootCacheDir;
+	std::string movieFile;
+	bool framesGiven = false;
+	bool turboFloppy = false;
+
+	cxxopts::Options options("guru-headless", "Guru Amiga Emulator (headless)");
+	options.add_options()
+		("r,rom", "kickstart rom file", cxxopts::value<std::string>()->default_value(""))
+		("df0", "disk image file for drive DF0", cxxopts::value<std::string>()->default_value(""))
+		("df1", "disk image file for drive DF1", cxxopts::value<std::string>()->default_value(""))
+		("df2", "disk image file for drive DF2", cxxopts::value<std::string>()->default_value(""))
+		("df3", "disk image file for drive DF3", cxxopts::value<std::string>()->default_value(""))
+		("hdf", "hard disk image file, attached to an A600/A1200 style IDE interface", cxxopts::value<std::string>()->default_value(""))
+		("host-dir", "host directory to mount as the DOS device HOST: (kickstart 1.3 or later)", cxxopts::value<std::string>()->default_value(""))
+		("f,frames", "number of frames to run", cxxopts::value<uint64_t>()->default_value("500"))
+		("e,every", "only hash/screenshot every Nth frame (intermediate frames are not drawn)", cxxopts::value<int>()->default_value("1"))
+		("chipram", "chip ram size in KiB (256, 512, 1024 or 2048)", cxxopts::value<int>()->default_value("512"))
+		("hashes", "write a hash of each output frame to this file", cxxopts::value<std::string>()->default_value(""))
+		("screenshots", "write a PNG of each output frame to this directory", cxxopts::value<std::string>()->default_value(""))
+		("audio", "write audio output to this WAV file", cxxopts::value<std::string>()->default_value(""))
+		("movie", "replay this movie (its starting state replaces the rom's boot); runs to the end of the movie unless --frames is given", cxxopts::value<std::string>()->default_value(""))
+		("turbo-floppy", "complete disk transfers instantly and spin disks faster")
+		("boot-cache", "skip the start of the kickstart boot using a state cached in this directory (frames are then counted from the first drive access)", cxxopts::value<std::string>()->default_value(""))
+		("h,help", "show help");
+
+	try
+	{
+		auto result = options.parse(argc, argv);
+		if (result.count("help"))
+		{
+			printf("%s\n", options.help().c_str());
+			return 0;
+		}
+
+		romFile = result["rom"].as<std::string>();
+		for (int i = 0; i < 4; i++)
+		{
+			diskFile[i] = result["df" + std::to_string(i)].as<std::string>();
+		}
+		hardDiskFile = result["hdf"].as<std::string>();
+		hostDir = result["host-dir"].as<std::string>();
+		numFrames = result["frames"].as<uint64_t>();
+		framesGiven = result.count("frames") != 0;
+		every = result["every"].as<int>();
+		chipRamKib = result["chipram"].as<int>();
+		hashFile = result["hashes"].as<std::string>();
+		screenshotDir = result["screenshots"].as<std::string>();
+		audioFile = result["audio"].as<std::string>();
+		bootCacheDir = result["boot-cache"].as<std::string>();
+		movieFile = result["movie"].as<std::string>();
+		turboFloppy = result.count("turbo-floppy") != 0;
+	}
+	catch (cxxopts::OptionParseException& e)
+	{
+		printf("Error : %s\n\n", e.what());
+		printf("%s\n", options.help().c_str());
+		return -1;
+	}
+
+	const auto chipRam = ChipRamFromKib(chipRamKib);
+	if (romFile.empty() || !chipRam || every < 1)
+	{
+		printf("%s\n", options.help().c_str());
+		return -1;
+	}
+
+	auto [romOk, romStatus] = guru::CheckRom(romFile);
+	if (!romOk)
+	{
+		printf("Error : %s\n", romStatus.c_str());
+		return 1;
+	}
+
+	util::Log log(1000);
+	am::Amiga amiga(*chipRam, &log);
+
+	if (auto mappedRom = guru::MapRom(romFile))
+	{
+		amiga.SetRom(std::move(mappedRom));
+	}
+	else
+	{
+		auto rom = guru::LoadRom(romFile);
+		if (rom.empty())
+		{
+			printf("Error : failed to load rom '%s'\n", romFile.c_str());
+			return 1;
+		}
+		amiga.SetRom(rom);
+	}
+	amiga.SetTurboFloppy(turboFloppy);
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (diskFile[i].empty())
+			continue;
+
+		if (!amiga.SetDisk(i, diskFile[i], std::filesystem::path(diskFile[i]).filename().string(), util::MappedFile::Open(diskFile[i])))
+		{
+			printf("Error : failed to load disk image '%s'\n", diskFile[i].c_str());
+			return 1;
+		}
+	}
+
+	if (!hardDiskFile.empty() && !amiga.SetHardDisk(hardDiskFile))
+	{
+		printf("Error : failed to open hard disk image '%s'\n", hardDiskFile.c_str());
+		return 1;
+	}
+
+	if (!hostDir.empty() && !amiga.MountHostDirectory(hostDir))
+	{
+		printf("Error : host directory '%s' not found\n", hostDir.c_str());
+		return 1;
+	}
+
+	if (!bootCacheDir.empty() && !guru::FastBoot(amiga, bootCacheDir))
+	{
+		const char* why = !hardDiskFile.empty() ? "hard disk" : !hostDir.empty() ? "host directory" : "rom";
+		printf("Warning : fast boot not possible with this %s, booting normally\n", why);
+	}
+
+	guru::MoviePlayer moviePlayer;
+	const bool playingMovie = !movieFile.empty();
+	if (playingMovie)
+	{
+		// The hard disk image isn't part of the movie's starting state, and the replay would write
+		// to it.
+		if (!hardDiskFile.empty())
+		{
+			printf("Error : a movie can't be played with a hard disk attached\n");
+			return 1;
+		}
+
+		auto loadDisk = [](const std::string& fileLocation, std::vector<uint8_t>& data)
+		{
+			return util::LoadBinaryFile(fileLocation, data);
+		};
+
+		if (!moviePlayer.Open(amiga, movieFile, loadDisk))
+		{
+			printf("Error : %s : '%s'\n", moviePlayer.GetError().c_str(), movieFile.c_str());
+			return 1;
+		}
+
+		if (!framesGiven)
+		{
+			numFrames = UINT64_MAX;
+		}
+	}
+
+	guru::WavWriter wavWriter;
+	if (!audioFile.empty())
+	{
+		if (!wavWriter.Open(audioFile))
+		{
+			printf("Error : failed to create '%s'\n", audioFile.c_str());
+			return 1;
+		}
+		amiga.SetAudioPlayer(&wavWriter);
+	}
+
+	FILE* hashes = nullptr;
+	if (!hashFile.empty())
+	{
+		hashes = fopen(hashFile.c_str(), "w");
+		if (!hashes)
+		{
+			printf("Error : failed to create '%s'\n", hashFile.c_str());
+			return 1;
+		}
+	}
+
+	if (!screenshotDir.empty())
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(screenshotDir, ec);
+	}
+
+	const bool outputFrames = hashes || !screenshotDir.empty();
+
+	// Frames that will never be looked at don't need to be drawn.
+	amiga.SetFrameSkip(outputFrames ? every - 1 : kNeverDraw);
+
+	const auto startTime = std::chrono::steady_clock::now();
+	const auto startCClocks = amiga.GetTotalCClocks();
+
+	bool stopped = false;
+	for (uint64_t frame = 0; frame < numFrames; frame++)
+	{
+		if (playingMovie && !framesGiven && moviePlayer.IsFinished())
+			break;
+
+		if (!(playingMovie ? moviePlayer.ExecuteFrame() : amiga.ExecuteFrame()))
+		{
+			printf("Emulation stopped at frame %llu (pc = %08x)\n", (unsigned long long)frame, amiga.GetCpu()->GetRegisters().pc);
+			stopped = true;
+			break;
+		}
+
+		if (!outputFrames || (frame % every) != 0)
+			continue;
+
+		const auto* screen = amiga.GetScreen();
+
+		if (hashes)
+		{
+			const auto hash = util::Fnv1a64({ reinterpret_cast<const uint8_t*>(screen->data()), screen->size() * sizeof(am::ColourRef) });
+			fprintf(hashes, "%llu %016llx\n", (unsigned long long)frame, (unsigned long long)hash);
+		}
+
+		if (!screenshotDir.empty())
+		{
+			char filename[32];
+			snprintf(filename, sizeof(filename), "frame%06llu.png", (unsigned long long)frame);
+			const auto path = (std::filesystem::path(screenshotDir) / filename).string();
+			if (!util::SavePng(path, am::kScreenBufferWidth, am::kScreenBufferHeight, screen->data()))
+			{
+				printf("Error : failed to write '%s'\n", path.c_str());
+			}
+		}
+	}
+
+	const std::chrono::duration<double> hostTime = std::chrono::steady_clock::now() - startTime;
+	const double emulatedTime = double(amiga.GetTotalCClocks() - startCClocks) / PAL_CClockFreq;
+
+	if (hashes)
+	{
+		fclose(hashes);
+	}
+	wavWriter.Close();
+
+	printf("%llu frames, %.2fs emulated in %.2fs (%.1fx realtime)\n", (unsigned long long)amiga.GetFrameCount(),
+		emulatedTime, hostTime.count(), hostTime.count() > 0.0 ? emulatedTime / hostTime.count() : 0.0);
+
+	return stopped ? 2 : 0;
+}
\ No newline at end of file
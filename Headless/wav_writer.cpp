@@ -0,0 +1,91 @@
+#include "wav_writer.h"
+
+#include <vector>
+
+namespace
+{
+	constexpr int kNumChannels = 2;
+	constexpr int kBytesPerSample = 2;
+
+	void Write16(std::ofstream& os, uint16_t value)
+	{
+		const char bytes[2] = { char(value), char(value >> 8) };
+		os.write(bytes, 2);
+	}
+
+	void Write32(std::ofstream& os, uint32_t value)
+	{
+		const char bytes[4] = { char(value), char(value >> 8), char(value >> 16), char(value >> 24) };
+		os.write(bytes, 4);
+	}
+}
+
+guru::WavWriter::~WavWriter()
+{
+	Close();
+}
+
+bool guru::WavWriter::Open(const std::string& filename)
+{
+	Close();
+
+	m_file.open(filename, std::ios::out | std::ios::binary);
+	if (!m_file.is_open())
+		return false;
+
+	m_numSampleFrames = 0;
+	WriteHeader();
+	return m_file.good();
+}
+
+void guru::WavWriter::Close()
+{
+	if (!m_file.is_open())
+		return;
+
+	// Rewrite the header now the data size is known.
+	m_file.seekp(0);
+	WriteHeader();
+	m_file.close();
+}
+
+void guru::WavWriter::AddAudioBuffer(const am::AudioBuffer* buffer)
+{
+	if (!m_file.is_open())
+		return;
+
+	// The buffer is already interleaved 16-bit stereo, so only the byte order needs seeing to.
+	std::vector<char> out;
+	out.reserve(am::kAudioBufferLength * kNumChannels * kBytesPerSample);
+
+	for (auto value : *buffer)
+	{
+		const auto sample = uint16_t(value);
+		out.push_back(char(sample));
+		out.push_back(char(sample >> 8));
+	}
+
+	m_file.write(out.data(), out.size());
+	m_numSampleFrames += am::kAudioBufferLength;
+}
+
+void guru::WavWriter::WriteHeader()
+{
+	const uint32_t dataSize = m_numSampleFrames * kNumChannels * kBytesPerSample;
+
+	m_file.write("RIFF", 4);
+	Write32(m_file, 36 + dataSize);
+	m_file.write("WAVE", 4);
+
+	m_file.write("fmt ", 4);
+	Write32(m_file, 16);
+	Write16(m_file, 1); // PCM
+	Write16(m_file, kNumChannels);
+	Write32(m_file, am::kDefaultAudioSampleRate);
+	Write32(m_file, am::kDefaultAudioSampleRate * kNumChannels * kBytesPerSample);
+	Write16(m_file, kNumChannels * kBytesPerSample);
+	Write16(m_file, kBytesPerSample * 8);
+
+	m_file.write("data", 4);
+	Write32(m_file, dataSize);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Amiga/audio.h"
+
+#include <fstream>
+#include <string>
+#include <stdint.h>
+
+namespace guru
+{
+	/// Audio player that writes the 16-bit stereo output to a WAV file, at the default sample rate.
+	class WavWriter : public am::AudioPlayer
+	{
+	public:
+		~WavWriter();
+
+		bool Open(const std::string& filename);
+		void Close();
+
+		virtual void AddAudioBuffer(const am::AudioBuffer* buffer) override;
+
+	private:
+		void WriteHeader();
+
+	private:
+		std::ofstream m_file;
+		uint32_t m_numSampleFrames = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,332 @@
+// MfmTest : checks the MFM track handling that disk DMA is built on.
+//
+// Covers encoding and decoding sectors, reading and writing words that wrap round the end of
+// a track of any bit length, finding sync words at every bit alignment, and reading the track
+// table of extended ADF images. Prints each failure and returns non-zero if there were any.
+
+#include "Amiga/mfm.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int g_numChecks = 0;
+	int g_numFailed = 0;
+
+	void Check(bool passed, const std::string& what)
+	{
+		g_numChecks++;
+		if (!passed)
+		{
+			g_numFailed++;
+			printf("FAILED : %s\n", what.c_str());
+		}
+	}
+
+	std::string Format(const char* format, uint32_t a, uint32_t b = 0)
+	{
+		char buffer[128];
+		snprintf(buffer, sizeof(buffer), format, a, b);
+		return buffer;
+	}
+
+	bool GetBit(const std::vector<uint8_t>& track, uint32_t position)
+	{
+		return (track[position / 8] & (0x80 >> (position % 8))) != 0;
+	}
+
+	void SetBit(std::vector<uint8_t>& track, uint32_t position, bool value)
+	{
+		const uint8_t mask = uint8_t(0x80 >> (position % 8));
+		track[position / 8] = value ? uint8_t(track[position / 8] | mask) : uint8_t(track[position / 8] & ~mask);
+	}
+
+	std::vector<uint8_t> RandomBytes(std::mt19937& rng, size_t size)
+	{
+		std::vector<uint8_t> bytes(size);
+		for (auto& b : bytes)
+		{
+			b = uint8_t(rng());
+		}
+		return bytes;
+	}
+
+	void TestEncodeDecode(std::mt19937& rng)
+	{
+		const int tracks[] = { 0, 1, 80, am::kTracksPerDisk - 1 };
+
+		for (int track : tracks)
+		{
+			const auto sectors = RandomBytes(rng, am::kDecodedTrackSize);
+			std::vector<uint8_t> encoded(am::kMfmTrackSize);
+			am::EncodeTrack(sectors.data(), sectors.size(), track / am::kTracksPerCylinder, track % am::kTracksPerCylinder, encoded.data());
+
+			std::vector<uint8_t> decoded(am::kDecodedTrackSize);
+			Check(am::DecodeTrack(encoded.data(), track, decoded.data()) == am::kSectorsPerTrack && decoded == sectors,
+				Format("track %u decodes to the sectors it was encoded from", track));
+
+			// The track is circular, so it decodes the same from any starting point.
+			std::rotate(encoded.begin(), encoded.begin() + 1000, encoded.end());
+			std::fill(decoded.begin(), decoded.end(), 0);
+			Check(am::DecodeTrack(encoded.data(), track, decoded.data()) == am::kSectorsPerTrack && decoded == sectors,
+				Format("track %u decodes when read from another position", track));
+
+			const int otherTrack = (track + 1) % am::kTracksPerDisk;
+			Check(am::DecodeTrack(encoded.data(), otherTrack, decoded.data()) == 0,
+				Format("track %u doesn't decode as track %u", track, otherTrack));
+		}
+
+		// Sectors past the end of the data read as zeros.
+		{
+			const auto sectors = RandomBytes(rng, 3 * am::kDecodedBytesPerSector + 100);
+			std::vector<uint8_t> encoded(am::kMfmTrackSize);
+			am::EncodeTrack(sectors.data(), sectors.size(), 5, 1, encoded.data());
+
+			std::vector<uint8_t> expected(am::kDecodedTrackSize, 0);
+			std::copy(sectors.begin(), sectors.end(), expected.begin());
+
+			std::vector<uint8_t> decoded(am::kDecodedTrackSize, 0xaa);
+			Check(am::DecodeTrack(encoded.data(), 11, decoded.data()) == am::kSectorsPerTrack && decoded == expected,
+				"a partial track decodes with the missing data as zeros");
+		}
+
+		// A sector that fails its checksum is left as it was.
+		{
+			const auto sectors = RandomBytes(rng, am::kDecodedTrackSize);
+			std::vector<uint8_t> encoded(am::kMfmTrackSize);
+			am::EncodeTrack(sectors.data(), sectors.size(), 0, 0, encoded.data());
+
+			// Flip a data bit in the sector stored third on the track.
+			encoded[2 * am::kMfmSectorSize + am::kMfmSectorHeaderSize + 40] ^= 0x01;
+
+			std::vector<uint8_t> decoded(am::kDecodedTrackSize, 0xaa);
+			const int numDecoded = am::DecodeTrack(encoded.data(), 0, decoded.data());
+
+			int untouched = 0;
+			for (int sector = 0; sector < am::kSectorsPerTrack; sector++)
+			{
+				const auto* out = &decoded[sector * am::kDecodedBytesPerSector];
+				const auto* in = &sectors[sector * am::kDecodedBytesPerSector];
+				if (std::all_of(out, out + am::kDecodedBytesPerSector, [](uint8_t b) { return b == 0xaa; }))
+				{
+					untouched++;
+				}
+				else
+				{
+					Check(memcmp(out, in, am::kDecodedBytesPerSector) == 0, Format("sector %u of a damaged track decodes", sector));
+				}
+			}
+			Check(numDecoded == am::kSectorsPerTrack - 1 && untouched == 1, "a damaged sector is skipped");
+		}
+	}
+
+	void TestTrackWords(std::mt19937& rng)
+	{
+		// Odd lengths, so that words wrap round a track that doesn't end on a byte boundary.
+		const uint32_t bitLengths[] = { 16, 17, 23, 83, 101, 203 };
+
+		for (uint32_t bitLength : bitLengths)
+		{
+			auto track = RandomBytes(rng, (bitLength + 7) / 8);
+			auto expected = track;
+
+			for (uint32_t position = 0; position < bitLength; position++)
+			{
+				uint16_t value = 0;
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					value = uint16_t((value << 1) | (GetBit(expected, (position + i) % bitLength) ? 1 : 0));
+				}
+				Check(am::ReadTrackWord(track.data(), bitLength, position) == value,
+					Format("read at bit %u of a %u bit track", position, bitLength));
+
+				const uint16_t newValue = uint16_t(rng());
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					SetBit(expected, (position + i) % bitLength, (newValue & (0x8000 >> i)) != 0);
+				}
+				am::WriteTrackWord(track.data(), bitLength, position, newValue);
+
+				// Includes the unused bits after the end of the track, which mustn't change.
+				Check(track == expected, Format("write at bit %u of a %u bit track", position, bitLength));
+			}
+		}
+	}
+
+	void TestSyncWords()
+	{
+		const uint16_t kSync = 0x4489;
+
+		// A whole standard track, and an odd length one.
+		const uint32_t bitLengths[] = { am::kMfmTrackSize * 8, 1001 };
+
+		for (uint32_t bitLength : bitLengths)
+		{
+			for (uint32_t position = 0; position < bitLength; position++)
+			{
+				// Every alignment near the start and end of the track, and a spread in between.
+				if (position >= 64 && position + 64 < bitLength && position % 37 != 0)
+					continue;
+
+				std::vector<uint8_t> track((bitLength + 7) / 8, 0);
+				am::WriteTrackWord(track.data(), bitLength, position, kSync);
+
+				std::vector<uint32_t> positions;
+				am::FindSyncWord(track.data(), bitLength, kSync, positions);
+				Check(positions == std::vector<uint32_t>{ position }, Format("sync word at bit %u of a %u bit track", position, bitLength));
+
+				// A second one further on is found after it.
+				const uint32_t second = (position + 16 + position % 8) % bitLength;
+				if (second > position + 16 || (second < position && second + bitLength >= position + 32))
+				{
+					am::WriteTrackWord(track.data(), bitLength, second, kSync);
+
+					positions.clear();
+					am::FindSyncWord(track.data(), bitLength, kSync, positions);
+
+					const auto expected = second > position ? std::vector<uint32_t>{ position, second } : std::vector<uint32_t>{ second, position };
+					Check(positions == expected, Format("sync words at bits %u and %u", position, second));
+				}
+			}
+		}
+	}
+
+	struct ExtendedTrack
+	{
+		uint16_t type = 0;
+		uint32_t size = 0;
+		uint32_t bitLength = 0;
+	};
+
+	// An extended ADF with the given track table, followed by dataSize bytes of zeros for the tracks.
+	std::vector<uint8_t> MakeExtendedAdf(const std::vector<ExtendedTrack>& tracks, size_t dataSize)
+	{
+		std::vector<uint8_t> image = { 'U', 'A', 'E', '-', '1', 'A', 'D', 'F' };
+
+		auto PutWord = [&](uint16_t w)
+		{
+			image.push_back(uint8_t(w >> 8));
+			image.push_back(uint8_t(w));
+		};
+
+		auto PutLong = [&](uint32_t l)
+		{
+			PutWord(uint16_t(l >> 16));
+			PutWord(uint16_t(l));
+		};
+
+		PutWord(0);
+		PutWord(uint16_t(tracks.size()));
+
+		for (const auto& track : tracks)
+		{
+			PutWord(0);
+			PutWord(track.type);
+			PutLong(track.size);
+			PutLong(track.bitLength);
+		}
+
+		image.resize(image.size() + dataSize, 0);
+		return image;
+	}
+
+	void TestSyncPositions()
+	{
+		// A raw track 1001 bits long with a sync word wrapping round its end, then a sector track.
+		constexpr uint32_t kRawBits = 1001;
+		constexpr uint32_t kRawSize = (kRawBits + 7) / 8;
+		constexpr size_t kHeaderSize = 12 + 2 * 12;
+
+		auto image = MakeExtendedAdf({ { 1, kRawSize, kRawBits }, { 0, am::kDecodedTrackSize, 0 } }, kRawSize + am::kDecodedTrackSize);
+		am::WriteTrackWord(&image[kHeaderSize], kRawBits, kRawBits - 6, 0x4489);
+
+		am::DiskImage disk;
+		Check(disk.Reset(image), "extended ADF with a raw track is accepted");
+		Check(disk.GetTrackBitLength(0, 0) == kRawBits, "raw track has its own bit length");
+
+		const auto raw = disk.GetSyncPositions(image, 0, 0, 0x4489);
+		Check(raw.size() == 1 && raw[0] == kRawBits - 6, "sync word wrapping round the end of a raw track is found");
+
+		// Each sector starts with two sync words.
+		const auto sectors = disk.GetSyncPositions(image, 0, 1, 0x4489);
+		const uint8_t* encoded = disk.GetTrack(image, 0, 1);
+		Check(sectors.size() == 2 * am::kSectorsPerTrack, "two sync words are found for each sector");
+		Check(std::all_of(sectors.begin(), sectors.end(), [&](uint32_t p) { return am::ReadTrackWord(encoded, am::kMfmTrackSize * 8, p) == 0x4489; }),
+			"sector track sync positions hold the sync word");
+
+		// Writing to the track forgets what was found on it.
+		uint8_t* writable = disk.GetTrackForWriting(image, 0, 0);
+		am::WriteTrackWord(writable, kRawBits, 100, 0x4489);
+		const auto rewritten = disk.GetSyncPositions(image, 0, 0, 0x4489);
+		Check(rewritten.size() == 2 && rewritten[0] == 100 && rewritten[1] == kRawBits - 6, "sync words are found again after a track is written");
+
+		Check(disk.GetSyncPositions(image, 1, 0, 0x4489).empty(), "a track that isn't on the disk has no sync words");
+	}
+
+	void TestTrackLayout()
+	{
+		std::array<am::TrackLayout, am::kTracksPerDisk> layout;
+
+		// A plain ADF is all sector tracks.
+		{
+			std::vector<uint8_t> adf(size_t(am::kDecodedTrackSize) * am::kTracksPerDisk);
+			Check(am::ReadTrackLayout(adf, layout), "plain ADF is accepted");
+			Check(std::all_of(layout.begin(), layout.end(), [](const am::TrackLayout& t) { return !t.raw && t.size == am::kDecodedTrackSize && t.bitLength == am::kMfmTrackSize * 8; }),
+				"plain ADF tracks are all full sector tracks");
+		}
+
+		// A valid table, with tracks past its end unformatted.
+		{
+			const auto image = MakeExtendedAdf({ { 0, am::kDecodedTrackSize, 0 }, { 1, 100, 800 } }, am::kDecodedTrackSize + 100);
+			Check(am::ReadTrackLayout(image, layout), "valid extended ADF is accepted");
+			Check(!layout[0].raw && layout[0].offset == 36 && layout[0].bitLength == am::kMfmTrackSize * 8, "extended ADF sector track layout");
+			Check(layout[1].raw && layout[1].offset == 36 + am::kDecodedTrackSize && layout[1].size == 100 && layout[1].bitLength == 800, "extended ADF raw track layout");
+			Check(layout[2].bitLength == 0 && layout[am::kTracksPerDisk - 1].bitLength == 0, "tracks past the end of the table are unformatted");
+		}
+
+		struct Malformed
+		{
+			const char* what;
+			std::vector<uint8_t> image;
+		};
+
+		const Malformed malformed[] = {
+			{ "table runs past the end of the file", [] { auto image = MakeExtendedAdf({ { 0, 0, 0 }, { 0, 0, 0 } }, 0); image.resize(30); return image; }() },
+			{ "track runs past the end of the file", MakeExtendedAdf({ { 0, am::kDecodedTrackSize, 0 } }, am::kDecodedTrackSize - 1) },
+			{ "later track runs past the end of the file", MakeExtendedAdf({ { 0, 100, 0 }, { 1, 100, 800 } }, 199) },
+			{ "raw track has more bits than bytes", MakeExtendedAdf({ { 1, 100, 801 } }, 100) },
+			{ "raw track is too long for disk DMA", MakeExtendedAdf({ { 1, 0x8001, 8 } }, 0x8001) },
+			{ "track has an unknown type", MakeExtendedAdf({ { 2, 100, 800 } }, 100) },
+			{ "track size is huge", MakeExtendedAdf({ { 0, 0xffffffff, 0 } }, 100) },
+		};
+
+		for (const auto& test : malformed)
+		{
+			Check(!am::ReadTrackLayout(test.image, layout), std::string("extended ADF is rejected when the ") + test.what);
+
+			am::DiskImage disk;
+			Check(!disk.Reset(test.image) && disk.GetTrackBitLength(0, 0) == 0, std::string("disk is unformatted when the ") + test.what);
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(12345);
+
+	TestEncodeDecode(rng);
+	TestTrackWords(rng);
+	TestSyncWords();
+	TestSyncPositions();
+	TestTrackLayout();
+
+	printf("%d checks, %d failed\n", g_numChecks, g_numFailed);
+
+	return g_numFailed == 0 ? 0 : 1;
+}
\ No newline at end of file